@@ -0,0 +1,202 @@
+// Compares strategies for keeping LveBvh in sync with moving objects, and
+// BVH frustum culling against a linear scan.
+//
+//   make bench && ./build/bvh_bench [objectCount] [movingFraction]
+
+#include "../include/lve_bvh.hpp"
+#include "../include/lve_camera.hpp"
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lve;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+struct Scene {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> velocities;
+  std::vector<LveAabb> bounds;
+};
+
+LveAabb boundsAt(const glm::vec3 &position) {
+  LveAabb box{};
+  box.min = position - glm::vec3{0.5f};
+  box.max = position + glm::vec3{0.5f};
+  return box;
+}
+
+Scene makeScene(size_t count, float worldSize) {
+  std::mt19937 rng{1234};
+  std::uniform_real_distribution<float> position{-worldSize, worldSize};
+  std::uniform_real_distribution<float> velocity{-1.f, 1.f};
+
+  Scene scene;
+  scene.positions.resize(count);
+  scene.velocities.resize(count);
+  scene.bounds.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    scene.positions[i] = {position(rng), position(rng) * 0.1f, position(rng)};
+    scene.velocities[i] = {velocity(rng), 0.f, velocity(rng)};
+    scene.bounds[i] = boundsAt(scene.positions[i]);
+  }
+  return scene;
+}
+
+void moveObjects(Scene &scene, size_t movingCount, float dt) {
+  for (size_t i = 0; i < movingCount; i++) {
+    scene.positions[i] += scene.velocities[i] * dt;
+    scene.bounds[i] = boundsAt(scene.positions[i]);
+  }
+}
+
+void report(const std::string &name, double totalMs, int frames,
+            const LveBvh &bvh) {
+  std::cout << std::left << std::setw(28) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(3)
+            << totalMs / frames << " ms/frame   sah cost "
+            << std::setprecision(1) << bvh.getCost() << "   height "
+            << bvh.height() << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  const float movingFraction = argc > 2 ? std::strtof(argv[2], nullptr) : 0.1f;
+  const size_t movingCount = static_cast<size_t>(count * movingFraction);
+  const float worldSize = 2000.f;
+  const int frames = 30;
+  const float dt = 1.f / 60.f;
+
+  std::cout << count << " objects, " << movingCount << " moving per frame"
+            << std::endl;
+
+  std::vector<std::pair<LveBvh::id_t, LveAabb>> batch(count);
+  Scene baseScene = makeScene(count, worldSize);
+  for (size_t i = 0; i < count; i++) {
+    batch[i] = {static_cast<LveBvh::id_t>(i), baseScene.bounds[i]};
+  }
+
+  // build
+  {
+    LveBvh bvh{};
+    auto start = Clock::now();
+    bvh.insertBatch(batch);
+    report("batch build", millisecondsSince(start), 1, bvh);
+  }
+
+  // strategy 1: rebuild from scratch every frame
+  {
+    Scene scene = baseScene;
+    LveBvh bvh{0.f};
+    bvh.insertBatch(batch);
+    double total = 0.0;
+    for (int frame = 0; frame < frames; frame++) {
+      moveObjects(scene, movingCount, dt);
+      auto start = Clock::now();
+      for (size_t i = 0; i < movingCount; i++) {
+        bvh.update(static_cast<LveBvh::id_t>(i), scene.bounds[i]);
+      }
+      bvh.rebuild();
+      total += millisecondsSince(start);
+    }
+    report("rebuild every frame", total, frames, bvh);
+  }
+
+  // strategy 2: incremental refit of fat leaves only
+  {
+    Scene scene = baseScene;
+    LveBvh bvh{};
+    bvh.insertBatch(batch);
+    double total = 0.0;
+    for (int frame = 0; frame < frames; frame++) {
+      moveObjects(scene, movingCount, dt);
+      auto start = Clock::now();
+      for (size_t i = 0; i < movingCount; i++) {
+        bvh.update(static_cast<LveBvh::id_t>(i), scene.bounds[i]);
+      }
+      total += millisecondsSince(start);
+    }
+    report("refit", total, frames, bvh);
+  }
+
+  // strategy 3: refit, rebuilding once the tree has degraded by 25%
+  {
+    Scene scene = baseScene;
+    LveBvh bvh{};
+    bvh.insertBatch(batch);
+    float baseCost = bvh.getCost();
+    int rebuilds = 0;
+    double total = 0.0;
+    for (int frame = 0; frame < frames; frame++) {
+      moveObjects(scene, movingCount, dt);
+      auto start = Clock::now();
+      for (size_t i = 0; i < movingCount; i++) {
+        bvh.update(static_cast<LveBvh::id_t>(i), scene.bounds[i]);
+      }
+      if (frame % 10 == 9 && bvh.getCost() > baseCost * 1.25f) {
+        bvh.rebuild();
+        baseCost = bvh.getCost();
+        rebuilds++;
+      }
+      total += millisecondsSince(start);
+    }
+    report("refit + rebuild (" + std::to_string(rebuilds) + "x)", total,
+           frames, bvh);
+  }
+
+  // culling: bvh frustum query vs linear scan
+  {
+    LveBvh bvh{};
+    bvh.insertBatch(batch);
+
+    LveCamera camera{};
+    camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, 0.1f,
+                                    500.f);
+    camera.setViewTarget(glm::vec3{0.f, -10.f, 0.f},
+                         glm::vec3{100.f, 0.f, 100.f});
+    LveFrustum frustum = LveFrustum::fromMatrix(camera.getProjectionMatrix() *
+                                                camera.getViewMatrix());
+
+    std::vector<LveBvh::id_t> visible;
+    visible.reserve(count);
+    auto start = Clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+      visible.clear();
+      bvh.queryFrustum(frustum, visible);
+    }
+    double bvhMs = millisecondsSince(start) / frames;
+    size_t bvhVisible = visible.size();
+
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+      visible.clear();
+      for (size_t i = 0; i < count; i++) {
+        if (frustum.intersectsAabb(baseScene.bounds[i])) {
+          visible.push_back(static_cast<LveBvh::id_t>(i));
+        }
+      }
+    }
+    double linearMs = millisecondsSince(start) / frames;
+
+    std::cout << "frustum cull: bvh " << std::setprecision(3) << bvhMs
+              << " ms (" << bvhVisible << " visible), linear " << linearMs
+              << " ms (" << visible.size() << " visible)" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
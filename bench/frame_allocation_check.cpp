@@ -0,0 +1,216 @@
+// Checks that a steady-state frame's transient CPU work never touches the
+// heap. Global operator new is replaced with a counting one, then the
+// per-frame pattern of the engine is run for a few hundred frames: the
+// frame arena is begun, a render queue is filled and sorted from it, and a
+// worker thread fills its own sub-arena. Every allocation after warm-up,
+// on any thread, is a failure.
+//
+// It covers these containers on their own, not FirstApp's frame loop:
+// culling, the render graph, descriptor and uniform writes and the
+// texture streamer need a device and are not exercised here.
+//
+//   make check
+
+#include "../include/lve_frame_arena.hpp"
+#include "../include/lve_render_queue.hpp"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace {
+std::atomic<uint64_t> heapAllocations{0};
+
+void *countedAllocate(std::size_t size) {
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void *countedAllocate(std::size_t size, std::align_val_t alignment) {
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  std::size_t align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  std::size_t rounded = (size + align - 1) / align * align;
+  if (void *ptr = std::aligned_alloc(align, rounded == 0 ? align : rounded)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+} // namespace
+
+void *operator new(std::size_t size) { return countedAllocate(size); }
+void *operator new[](std::size_t size) { return countedAllocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAllocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAllocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, alignment);
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+using namespace lve;
+
+namespace {
+
+constexpr uint32_t FRAMES = 600;
+// every frame index has merged its overflow blocks by then
+constexpr uint32_t WARMUP_FRAMES = 4 * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+constexpr uint32_t DRAWS = 4096;
+constexpr uint32_t WORKER_ITEMS = 16 * 1024;
+
+// xorshift, so the keys vary from frame to frame without <random>
+uint32_t nextRandom(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// A thread that fills its sub-arena of the current frame when asked, as
+// the culling and streaming workers do. Waiting on it allocates nothing.
+class Worker {
+public:
+  explicit Worker(LveFrameArena &arena) : arena{arena} {
+    thread = std::thread{[this] { run(); }};
+  }
+  ~Worker() {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      quit = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+
+  void runFrame() {
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      pending = true;
+    }
+    wake.notify_one();
+    std::unique_lock<std::mutex> lock{mutex};
+    done.wait(lock, [this] { return !pending; });
+  }
+
+  float checksum = 0.f;
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;) {
+      wake.wait(lock, [this] { return pending || quit; });
+      if (quit) {
+        return;
+      }
+      float *items = arena.workerAlloc<float>(WORKER_ITEMS);
+      for (uint32_t i = 0; i < WORKER_ITEMS; i++) {
+        items[i] = static_cast<float>(i);
+      }
+      checksum += items[WORKER_ITEMS - 1];
+      pending = false;
+      done.notify_one();
+    }
+  }
+
+  LveFrameArena &arena;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  bool pending = false;
+  bool quit = false;
+};
+
+} // namespace
+
+int main() {
+  // deliberately small, so the first frames overflow and grow it
+  LveFrameArena arena{16 * 1024};
+  LveRenderQueue queue{};
+  Worker worker{arena};
+  uint32_t random = 2463534242u;
+  uint64_t checksum = 0;
+  uint64_t allocationsAfterWarmup = 0;
+  uint32_t framesWithAllocations = 0;
+
+  for (uint32_t frame = 0; frame < FRAMES; frame++) {
+    const uint64_t before = heapAllocations.load();
+
+    arena.beginFrame(
+        static_cast<int>(frame % LveSwapChain::MAX_FRAMES_IN_FLIGHT));
+    queue.begin(arena.frameAllocator(), DRAWS);
+    queue.resetStats();
+    for (uint32_t i = 0; i < DRAWS; i++) {
+      LveRenderQueue::Draw draw{};
+      draw.objectId = i;
+      uint32_t bits = nextRandom(random);
+      float depth = static_cast<float>(bits & 0xffff) / 65535.f;
+      queue.push(LveRenderQueue::makeKey(bits >> 29, (bits >> 20) & 0xff,
+                                         i % 64, depth),
+                 draw);
+    }
+    queue.sort();
+    checksum += queue.size();
+    worker.runFrame();
+
+    const uint64_t allocations = heapAllocations.load() - before;
+    if (frame >= WARMUP_FRAMES && allocations > 0) {
+      allocationsAfterWarmup += allocations;
+      framesWithAllocations++;
+    }
+  }
+
+  const auto stats = arena.getStats();
+  std::cout << FRAMES << " frames of " << DRAWS << " sorted draws and "
+            << WORKER_ITEMS << " worker items, arena capacity "
+            << (stats.capacity >> 10) << " KiB (checksum "
+            << checksum + static_cast<uint64_t>(worker.checksum) << ")"
+            << std::endl;
+  if (allocationsAfterWarmup > 0) {
+    std::cout << "FAIL: " << allocationsAfterWarmup
+              << " heap allocations in " << framesWithAllocations
+              << " frames after the first " << WARMUP_FRAMES << std::endl;
+    return 1;
+  }
+  std::cout << "ok: no heap allocations after the first " << WARMUP_FRAMES
+            << " frames in the frame arena, render queue and worker "
+               "sub-arenas (FirstApp's frame loop is not covered)"
+            << std::endl;
+  return 0;
+}
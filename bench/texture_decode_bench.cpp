@@ -0,0 +1,104 @@
+// CPU decode throughput of LveBlockDecoder per BC format: the cost of
+// textures streamed on devices without textureCompressionBC.
+//
+//   make bench && ./build/texture_decode_bench [size] [iterations]
+
+#include "../include/lve_block_decoder.hpp"
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace lve;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// random blocks exercise every BC1 colour mode and BC7 partition
+std::vector<uint8_t> makeBlocks(LveBlockFormat format, uint32_t size,
+                                int bc7Mode = -1) {
+  std::mt19937 rng{1234};
+  std::vector<uint8_t> blocks(LveBlockDecoder::levelBytes(format, size, size));
+  for (auto &byte : blocks) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  if (bc7Mode >= 0) {
+    for (size_t i = 0; i < blocks.size(); i += 16) {
+      blocks[i] = static_cast<uint8_t>(
+          (blocks[i] & ~((2u << bc7Mode) - 1)) | (1u << bc7Mode));
+    }
+  }
+  return blocks;
+}
+
+void report(const std::string &name, double totalMs, int iterations,
+            uint32_t size, size_t compressedBytes) {
+  double ms = totalMs / iterations;
+  double texels = static_cast<double>(size) * size;
+  std::cout << std::left << std::setw(14) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(3) << ms
+            << " ms/level" << std::setw(10) << std::setprecision(1)
+            << texels / (ms * 1000.0) << " Mtexel/s" << std::setw(10)
+            << compressedBytes / (ms * 1000.0) << " MB/s in   "
+            << std::setprecision(1)
+            << texels * 4.0 / static_cast<double>(compressedBytes) << ":1"
+            << std::endl;
+}
+
+double run(LveBlockFormat format, const std::vector<uint8_t> &blocks,
+           uint32_t size, int iterations) {
+  // warm up, and keep the result alive so the decode is not optimized away
+  size_t checksum = LveBlockDecoder::decode(format, blocks.data(), size, size)
+                        .pixels[0];
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    LveImageData image =
+        LveBlockDecoder::decode(format, blocks.data(), size, size);
+    checksum += image.pixels[image.pixels.size() / 2];
+  }
+  double ms = millisecondsSince(start);
+  if (checksum == static_cast<size_t>(-1)) {
+    std::cout << checksum << std::endl;
+  }
+  return ms;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t size =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 2048;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  std::cout << size << "x" << size << " level, " << iterations
+            << " iterations, single thread" << std::endl;
+
+  for (LveBlockFormat format :
+       {LveBlockFormat::BC1, LveBlockFormat::BC2, LveBlockFormat::BC3,
+        LveBlockFormat::BC4, LveBlockFormat::BC5, LveBlockFormat::BC7}) {
+    std::vector<uint8_t> blocks = makeBlocks(format, size);
+    report(LveBlockDecoder::name(format), run(format, blocks, size, iterations),
+           iterations, size, blocks.size());
+  }
+
+  // BC7 cost depends heavily on the mode encoders picked
+  for (int mode = 0; mode < 8; mode++) {
+    std::vector<uint8_t> blocks = makeBlocks(LveBlockFormat::BC7, size, mode);
+    report("BC7 mode " + std::to_string(mode),
+           run(LveBlockFormat::BC7, blocks, size, iterations), iterations,
+           size, blocks.size());
+  }
+  return 0;
+}
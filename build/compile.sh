@@ -1,2 +1,4 @@
 /Users/mubeensikandar/VulkanSDK/1.4.313.0/macOS/bin/glslc shaders/simple_shader.vert -o shaders/simple_shader.vert.spv
 /Users/mubeensikandar/VulkanSDK/1.4.313.0/macOS/bin/glslc shaders/simple_shader.frag -o shaders/simple_shader.frag.spv
+/Users/mubeensikandar/VulkanSDK/1.4.313.0/macOS/bin/glslc shaders/hiz_reduce.comp -o shaders/hiz_reduce.comp.spv
+/Users/mubeensikandar/VulkanSDK/1.4.313.0/macOS/bin/glslc shaders/simple_shader_bindless.vert -o shaders/simple_shader_bindless.vert.spv
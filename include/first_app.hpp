@@ -1,20 +1,76 @@
 #pragma once
 
+#include "lve_archive.hpp"
+#include "lve_bindless.hpp"
+#include "lve_bvh.hpp"
+#include "lve_clustered_lights.hpp"
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
+#include "lve_frame_arena.hpp"
 #include "lve_gameobject.hpp"
+#include "lve_hiz.hpp"
+#include "lve_pipeline_library.hpp"
+#include "lve_render_graph.hpp"
 #include "lve_renderer.hpp"
+#include "lve_ring_buffer.hpp"
+#include "lve_shader_hot_reload.hpp"
+#include "lve_shadow_cascades.hpp"
+#include "lve_task_graph.hpp"
+#include "lve_texture_streamer.hpp"
 #include "lve_window.hpp"
 #include "vulkan/vulkan_core.h"
 
 // std
+#include <array>
+#include <chrono>
+#include <memory>
 #include <vector>
 
 namespace lve {
+class SimpleRenderSystem;
+
 class FirstApp {
 public:
   static constexpr int WIDTH = 800;
   static constexpr int HEIGHT = 600;
 
+  // lay down depth first so the colour pass shades each pixel once
+  static constexpr bool ENABLE_DEPTH_PREPASS = true;
+  // reference object data through one bindless table when descriptor
+  // indexing is available; classic per-draw sets otherwise
+  static constexpr bool ENABLE_BINDLESS = true;
+  // rebuild pipelines when shaders/*.vert|frag are saved; needs libshaderc
+  static constexpr bool ENABLE_SHADER_HOT_RELOAD = true;
+  // Startup builds every pipeline variant before the first frame; OnDemand
+  // builds each in the background when first drawn (V cycles view modes)
+  static constexpr LvePipelineLibrary::Mode PIPELINE_COMPILE_MODE =
+      LvePipelineLibrary::Mode::Startup;
+  // render straight into image views (Vulkan 1.3 or VK_KHR_dynamic_rendering)
+  // instead of through render pass and framebuffer objects, when supported
+  static constexpr bool ENABLE_DYNAMIC_RENDERING = true;
+  // most samples the main pass is multisampled with, fewer when the device
+  // cannot; M cycles down to one and back. It needs dynamic rendering, which
+  // can resolve depth too for the Hi-Z build.
+  static constexpr VkSampleCountFlagBits MSAA_SAMPLES = VK_SAMPLE_COUNT_4_BIT;
+  // point lights circling the scene, each shaded only by the fragments in
+  // the froxels it reaches
+  static constexpr uint32_t POINT_LIGHT_COUNT = 2048;
+  // VRAM the streamed textures may use. Kept below what the scene's
+  // textures need at full resolution, so getting close to them evicts the
+  // ones out of view; residency is printed with the frame stats
+  static constexpr VkDeviceSize TEXTURE_BUDGET_BYTES = 384 * 1024;
+  // read assets from the archive `make pack` builds when it exists. The
+  // SPIR-V of shaders hot-reload watches is still read from loose files,
+  // since it rewrites them.
+  static constexpr bool USE_ASSET_ARCHIVE = true;
+  static constexpr const char *ASSET_ARCHIVE = "build/assets.lvepak";
+  // GPU by index, UUID or part of its name; empty uses the best scoring one.
+  // The LVE_DEVICE environment variable overrides it.
+  static constexpr const char *PREFERRED_DEVICE = "";
+  // compiled pipelines are kept here between runs; the first run after a
+  // driver update or on another GPU compiles everything again
+  static constexpr const char *PIPELINE_CACHE_FILE = "build/pipeline_cache.bin";
+
   FirstApp();
   ~FirstApp();
 
@@ -24,12 +80,94 @@ public:
   void run();
 
 private:
-  void loadGameObjects();
+  void loadGameObjects(LveTaskGraph &startup,
+                       LveTaskGraph::TaskId textureStreamerTask);
+  void buildRenderGraph();
+  void createRenderSystem();
+  void createPointLights();
+  void updatePointLights(float time);
+  void updateOrbiter(float time);
   void renderGameObjects(VkCommandBuffer commandBuffer);
+  static bool mountAssetArchive();
+
+  // time to first frame is measured from here
+  std::chrono::steady_clock::time_point startTime =
+      std::chrono::steady_clock::now();
+  // first, so everything below loads its assets through the archive
+  bool assetArchiveMounted = mountAssetArchive();
 
   LveWindow lveWindow{WIDTH, HEIGHT, "Vulkan Tutorial"};
-  LveDevice lveDevice{lveWindow};
-  LveRenderer lveRenderer{lveWindow, lveDevice};
-  std::vector<LveGameObject> gameObjects;
+  LveDevice lveDevice{lveWindow, PREFERRED_DEVICE};
+  // everything below that takes long to build is made by the startup graph
+  // in the constructor, alongside the rest
+  std::unique_ptr<LveRenderer> lveRenderer;
+  // the frame's passes, declared once the swap chain's formats are known
+  // and again when the sample count changes (G prints what it compiled to)
+  std::unique_ptr<LveRenderGraph> renderGraph;
+  LveRenderGraph::ResourceId swapChainImage = 0;
+  LveRenderGraph::ResourceId sceneDepth = 0;
+  LveRenderGraph::PassId depthPrepassPass = 0;
+  LveRenderGraph::PassId mainPass = 0;
+  // per cascade; caches only for the cached ones
+  std::array<LveRenderGraph::ResourceId, LveShadowCascades::CASCADE_COUNT>
+      shadowMaps{};
+  std::array<LveRenderGraph::ResourceId, LveShadowCascades::CASCADE_COUNT>
+      shadowCaches{};
+  LveRenderGraph::PassId shadowPass = 0;
+  // the swap chain the graph's framebuffers were made for
+  uint64_t renderGraphSwapChain = 0;
+
+  // the sample counts M cycles through, with the GPU time of the frames
+  // rendered with each
+  struct MsaaMode {
+    VkSampleCountFlagBits samples;
+    double gpuMilliseconds = 0;
+    uint32_t frames = 0;
+  };
+  std::vector<MsaaMode> msaaModes;
+  size_t msaaMode = 0;
+  // frames whose timestamps are from before the last switch
+  int msaaUntimedFrames = 0;
+  LvePipelineLibrary pipelineLibrary{lveDevice, PIPELINE_COMPILE_MODE};
+  LveGameObject::Map gameObjects;
+  // the one object that moves, circling the face
+  LveGameObject::id_t orbiterId = 0;
+
+  // scene bounds for culling and spatial queries; objects that move must be
+  // refit with sceneBvh.update(id, obj.getWorldBounds())
+  LveBvh sceneBvh{};
+  std::vector<LveGameObject::id_t> visibleObjects;
+
+  // occlusion against the depth of frames already retired
+  std::unique_ptr<LveHiZ> hiZ;
+
+  LveFrameArena frameArena{};
+  // per-frame camera and object uniforms
+  LveRingBuffer uniformRing{lveDevice, 256 * 1024};
+  LveClusteredLights clusteredLights{lveDevice};
+  // each light's circle around the scene, and where that puts it this frame
+  struct LightOrbit {
+    glm::vec3 center;
+    float radius;
+    float speed; // radians per second
+    float phase;
+  };
+  std::vector<LightOrbit> lightOrbits;
+  std::vector<LveClusteredLights::PointLight> pointLights;
+  // the sun: static objects stay cached in its distant cascades while it
+  // holds still
+  LveShadowCascades shadowCascades{lveDevice, LveShadowCascades::Config{}};
+  glm::vec3 sunDirection = glm::normalize(glm::vec3{.4f, 1.f, .3f});
+  LveDescriptorLayoutCache descriptorLayoutCache{lveDevice};
+  LvePipelineLayoutCache pipelineLayoutCache{lveDevice, descriptorLayoutCache};
+  LveFrameDescriptorAllocator frameDescriptors{lveDevice};
+  // null when bindless is disabled or unsupported
+  std::unique_ptr<LveBindlessTable> bindlessTable;
+  // created after bindlessTable so it can register textures in it
+  std::unique_ptr<LveTextureStreamer> textureStreamer;
+  // null when disabled or built without libshaderc
+  std::unique_ptr<LveShaderHotReload> shaderHotReload;
+  // last: it draws through most of the above
+  std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
 };
 } // namespace lve
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "lve_compression.hpp"
+#include "lve_mapped_file.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// A read-only pack of asset files, looked up by their relative path
+// (e.g. "shaders/simple_shader.vert.spv").
+//
+// Layout: a header, the table of contents (entries sorted by path hash,
+// then the chunk table and path strings), then every entry's data in the
+// order it was packed. Each entry starts on an alignment() boundary and
+// is split into chunks of chunkSize bytes, compressed independently with
+// the entry's codec; a chunk that does not shrink is stored raw. An entry
+// stored raw can be read in place. A compressed entry has its chunks
+// decompressed in parallel.
+//
+// The archive is mapped in one piece, so opening it and reading what is
+// needed at startup is a few large sequential reads instead of a lookup
+// and an open for every file.
+class LveArchive {
+public:
+  static constexpr uint32_t DEFAULT_ALIGNMENT = 256; // covers copy offsets
+  static constexpr uint32_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+  static constexpr uint32_t NOT_FOUND = ~0u;
+
+  // Throws std::runtime_error if the file is missing or not a valid archive
+  explicit LveArchive(const std::string &filepath);
+
+  LveArchive(const LveArchive &) = delete;
+  LveArchive &operator=(const LveArchive &) = delete;
+
+  // Index of the entry packed as path, or NOT_FOUND
+  uint32_t find(const std::string &path) const;
+  uint32_t entryCount() const { return static_cast<uint32_t>(entries.size()); }
+  std::string path(uint32_t entry) const;
+  size_t size(uint32_t entry) const; // uncompressed
+  size_t storedSize(uint32_t entry) const;
+  uint32_t alignment() const { return dataAlignment; }
+
+  // The entry's bytes inside the mapping when every chunk is stored raw,
+  // nullptr otherwise
+  const char *storedData(uint32_t entry) const;
+  // Writes size(entry) bytes to dst. With a pool, chunks are shared
+  // between the calling thread and the pool's workers; the call returns
+  // once all of them are done, so it may run on one of those workers.
+  // Throws std::runtime_error on corrupt data or a codec not built in.
+  void read(uint32_t entry, void *dst, LveThreadPool *pool = nullptr) const;
+  // A view of the stored bytes, or a new buffer read() into
+  LveMappedFile open(uint32_t entry, LveThreadPool *pool = nullptr) const;
+
+  // Starts reading the whole archive into memory in the background
+  void prefetch() const { file.willNeed(); }
+
+  // Mounted archives are searched, newest first, before the filesystem by
+  // openFile(). Mount at startup, before threads read assets; archives
+  // stay mounted until the process exits. Returns false when there is no
+  // file at filepath and throws when it is not a valid archive.
+  static bool mount(const std::string &filepath);
+  // false for paths read loose
+  static bool isMountedFile(const std::string &path);
+  static uint32_t mountedFileCount();
+  // Makes openFile() read path from disk even when a mounted archive
+  // holds it, for files rewritten while running, like the SPIR-V shader
+  // hot-reload compiles. May be called while other threads read assets.
+  static void readLoose(const std::string &path);
+  // The file from a mounted archive if one holds path, else from disk
+  static LveMappedFile openFile(
+      const std::string &path,
+      LveMappedFile::Access access = LveMappedFile::Access::Sequential,
+      LveThreadPool *pool = nullptr);
+
+  // "./a\\b" and "a/b" name the same entry
+  static std::string normalizePath(const std::string &path);
+  static uint64_t hashPath(const std::string &normalizedPath);
+
+private:
+  friend class LveArchiveWriter;
+
+  static constexpr uint32_t MAGIC = 0x4b41504c; // "LPAK"
+  static constexpr uint32_t VERSION = 1;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t alignment;
+    uint32_t chunkSize;
+    uint32_t entryCount;
+    uint32_t chunkCount;
+    uint32_t pathBytes;
+    uint32_t reserved;
+  };
+
+  struct Entry {
+    uint64_t pathHash;
+    uint64_t offset; // of the first chunk, from the start of the archive
+    uint64_t size;
+    uint32_t pathOffset; // into the path strings
+    uint32_t pathLength;
+    uint32_t firstChunk; // into the chunk table
+    uint32_t codec;      // LveCompression::Codec
+  };
+
+  void validate(const std::string &filepath);
+  size_t chunkBytes(const Entry &entry, uint32_t chunk) const;
+  void readChunk(const Entry &entry, uint32_t chunk, char *dst) const;
+
+  LveMappedFile file;
+  uint32_t dataAlignment = DEFAULT_ALIGNMENT;
+  uint32_t chunkSize = DEFAULT_CHUNK_SIZE;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> chunkStoredSizes;
+  // where each chunk starts, from its entry's offset
+  std::vector<uint64_t> chunkOffsets;
+  const char *paths = nullptr;
+};
+
+// Builds an LveArchive. The packer tool (tools/lve_pack.cpp) is a thin
+// command line over this.
+class LveArchiveWriter {
+public:
+  explicit LveArchiveWriter(
+      uint32_t alignment = LveArchive::DEFAULT_ALIGNMENT,
+      uint32_t chunkSize = LveArchive::DEFAULT_CHUNK_SIZE);
+
+  // Entries are laid out in the order they are added, so add them in the
+  // order they are loaded. Throws on a duplicate path or a codec that was
+  // not built in.
+  void addFile(const std::string &path, const std::string &sourceFilepath,
+               LveCompression::Codec codec);
+  void addBytes(const std::string &path, const void *bytes, size_t size,
+                LveCompression::Codec codec);
+
+  // Compresses every chunk on pool's workers and writes the archive;
+  // throws std::runtime_error if it cannot be written
+  void write(const std::string &filepath, LveThreadPool &pool);
+
+  size_t uncompressedBytes() const;
+  size_t storedBytes() const { return written; }
+
+private:
+  void add(const std::string &path, LveMappedFile data,
+           LveCompression::Codec codec);
+
+  struct Source {
+    std::string path;
+    LveCompression::Codec codec;
+    LveMappedFile data;
+  };
+
+  uint32_t alignment;
+  uint32_t chunkSize;
+  std::vector<Source> sources;
+  size_t written = 0;
+};
+
+} // namespace lve
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_swapchain.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// One global descriptor set holding large update-after-bind arrays of
+// sampled images (binding 0) and storage buffers (binding 1).
+//
+// Resources are registered once and referenced from shaders by the integer
+// index returned here, carried in push constants or instance data, so draws
+// no longer switch descriptor sets. Descriptors can be written while the set
+// is bound by frames in flight; released indices are only handed out again
+// after MAX_FRAMES_IN_FLIGHT frames, once nothing in flight can read them.
+// Requires LveDevice::bindlessSupported.
+class LveBindlessTable {
+public:
+  static constexpr uint32_t IMAGE_BINDING = 0;
+  static constexpr uint32_t STORAGE_BUFFER_BINDING = 1;
+  static constexpr uint32_t INVALID_INDEX = ~0u;
+
+  // clamped to the device's update-after-bind limits
+  static constexpr uint32_t MAX_IMAGES = 16384;
+  static constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+
+  explicit LveBindlessTable(LveDevice &device);
+  ~LveBindlessTable();
+
+  LveBindlessTable(const LveBindlessTable &) = delete;
+  LveBindlessTable &operator=(const LveBindlessTable &) = delete;
+
+  // recycles indices released while frameIndex was last recorded
+  void beginFrame(int frameIndex);
+
+  uint32_t addImage(VkImageView imageView, VkSampler sampler,
+                    VkImageLayout layout);
+  uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                            VkDeviceSize range = VK_WHOLE_SIZE);
+  void releaseImage(uint32_t index);
+  void releaseStorageBuffer(uint32_t index);
+
+  VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+  VkDescriptorSet getSet() const { return descriptorSet; }
+  void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+            uint32_t setIndex,
+            VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+  uint32_t imageCapacity() const { return images.capacity; }
+  uint32_t storageBufferCapacity() const { return storageBuffers.capacity; }
+  uint32_t imagesInUse() const { return images.inUse; }
+  uint32_t storageBuffersInUse() const { return storageBuffers.inUse; }
+
+private:
+  // index allocator for one binding's array
+  struct Slots {
+    uint32_t capacity = 0;
+    uint32_t next = 0;
+    uint32_t inUse = 0;
+    std::vector<uint32_t> freeList;
+    std::array<std::vector<uint32_t>, LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+        pending{};
+  };
+
+  uint32_t acquire(Slots &slots, const char *what);
+  void release(Slots &slots, uint32_t index);
+
+  void createSetLayout();
+  void createDescriptorSet();
+
+  LveDevice &lveDevice;
+  VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+  Slots images{};
+  Slots storageBuffers{};
+  int currentFrame = 0;
+};
+
+} // namespace lve
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "lve_image.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+namespace lve {
+
+// Block compressed formats, independent of their sRGB/UNORM variant
+enum class LveBlockFormat { BC1, BC2, BC3, BC4, BC5, BC6H, BC7 };
+
+// CPU decompression of BC blocks for devices without textureCompressionBC.
+//
+// Output is RGBA8 laid out like any LveImageData. BC4 and BC5 decode to
+// (r, 0, 0, 255) and (r, g, 0, 255), as the hardware samples them. BC6H
+// holds HDR data with no RGBA8 equivalent and is not decoded.
+class LveBlockDecoder {
+public:
+  static constexpr uint32_t BLOCK_SIZE = 4;
+
+  static uint32_t blockBytes(LveBlockFormat format);
+  static const char *name(LveBlockFormat format);
+  static bool canDecode(LveBlockFormat format) {
+    return format != LveBlockFormat::BC6H;
+  }
+
+  // bytes of a width x height level
+  static size_t levelBytes(LveBlockFormat format, uint32_t width,
+                           uint32_t height);
+
+  // Decodes a whole level. blocks holds levelBytes(format, width, height)
+  // bytes in row-major block order.
+  static LveImageData decode(LveBlockFormat format, const uint8_t *blocks,
+                             uint32_t width, uint32_t height);
+
+  // one 4x4 block into 16 RGBA8 texels, row-major
+  static void decodeBlock(LveBlockFormat format, const uint8_t *block,
+                          uint8_t *rgba);
+};
+
+} // namespace lve
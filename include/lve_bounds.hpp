@@ -0,0 +1,74 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <limits>
+
+namespace lve {
+
+// Axis aligned bounding box. A default constructed box is empty (inverted)
+// so that expanding it by the first point yields that point.
+struct LveAabb {
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+  bool isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  void expand(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void expand(const LveAabb &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+  glm::vec3 extent() const { return max - min; }
+
+  float surfaceArea() const {
+    glm::vec3 d = max - min;
+    return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  bool contains(const LveAabb &other) const {
+    return min.x <= other.min.x && min.y <= other.min.y &&
+           min.z <= other.min.z && other.max.x <= max.x &&
+           other.max.y <= max.y && other.max.z <= max.z;
+  }
+
+  bool overlaps(const LveAabb &other) const {
+    return min.x <= other.max.x && other.min.x <= max.x &&
+           min.y <= other.max.y && other.min.y <= max.y &&
+           min.z <= other.max.z && other.min.z <= max.z;
+  }
+
+  static LveAabb merge(const LveAabb &a, const LveAabb &b) {
+    LveAabb result = a;
+    result.expand(b);
+    return result;
+  }
+
+  // Bounds of this box after an affine transform (Arvo's method)
+  LveAabb transformed(const glm::mat4 &m) const {
+    LveAabb result{};
+    result.min = result.max = glm::vec3(m[3]);
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        float a = m[j][i] * min[j];
+        float b = m[j][i] * max[j];
+        result.min[i] += a < b ? a : b;
+        result.max[i] += a < b ? b : a;
+      }
+    }
+    return result;
+  }
+};
+
+} // namespace lve
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "lve_bounds.hpp"
+#include "lve_frustum.hpp"
+
+// std
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Dynamic bounding volume hierarchy over object world bounds.
+//
+// Leaves store "fat" boxes padded by a margin, so small motions are absorbed
+// without touching the tree. Objects that escape their fat box are refit in
+// place: the leaf grows and its ancestors are re-unioned up to the root. This
+// keeps per-frame updates cheap but slowly degrades tree quality, so callers
+// can compare getCost() against the cost after the last rebuild() and rebuild
+// from scratch when it has drifted too far.
+class LveBvh {
+public:
+  using id_t = unsigned int;
+
+  explicit LveBvh(float margin = 0.1f);
+
+  LveBvh(const LveBvh &) = delete;
+  LveBvh &operator=(const LveBvh &) = delete;
+
+  void insert(id_t id, const LveAabb &bounds);
+  void remove(id_t id);
+
+  // Batch operations. Inserting into an empty tree builds it top-down, which
+  // gives a much better tree than repeated single inserts.
+  void insertBatch(const std::vector<std::pair<id_t, LveAabb>> &objects);
+  void removeBatch(const std::vector<id_t> &ids);
+
+  // Incremental refit. Returns true if the tree had to change.
+  bool update(id_t id, const LveAabb &bounds);
+
+  // Full top-down rebuild (binned SAH) from the current leaf boxes
+  void rebuild();
+
+  void clear();
+
+  // Queries append the ids of every intersecting object to result
+  void queryFrustum(const LveFrustum &frustum,
+                    std::vector<id_t> &result) const;
+  void queryAabb(const LveAabb &bounds, std::vector<id_t> &result) const;
+  void queryRay(const glm::vec3 &origin, const glm::vec3 &direction,
+                float maxDistance, std::vector<id_t> &result) const;
+
+  size_t size() const { return leaves.size(); }
+  int height() const;
+  // of everything in the tree, padded by the leaf margin; empty without
+  // leaves
+  LveAabb getBounds() const {
+    return root == NULL_NODE ? LveAabb{} : nodes[root].bounds;
+  }
+
+  // Surface area heuristic cost of the tree, normalised by the root area
+  float getCost() const;
+
+private:
+  static constexpr int32_t NULL_NODE = -1;
+
+  struct Node {
+    LveAabb bounds;
+    int32_t parent = NULL_NODE;
+    int32_t child1 = NULL_NODE;
+    int32_t child2 = NULL_NODE;
+    id_t id = 0;
+
+    bool isLeaf() const { return child1 == NULL_NODE; }
+  };
+
+  struct BuildEntry {
+    LveAabb bounds;
+    glm::vec3 centroid;
+    int32_t node;
+  };
+
+  int32_t allocateNode();
+  void freeNode(int32_t node);
+
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  void refitAncestors(int32_t node);
+  int32_t buildRange(std::vector<BuildEntry> &entries, size_t begin,
+                     size_t end);
+
+  LveAabb fatten(const LveAabb &bounds) const;
+
+  float margin;
+  int32_t root = NULL_NODE;
+  std::vector<Node> nodes;
+  int32_t freeList = NULL_NODE;
+  std::unordered_map<id_t, int32_t> leaves;
+
+  // traversal stack reused between queries, so queries are not reentrant
+  mutable std::vector<std::pair<int32_t, uint32_t>> stack;
+};
+
+} // namespace lve
@@ -23,9 +23,12 @@ public:
 
   const glm::mat4 &getProjectionMatrix() const { return projectionMatrix; };
   const glm::mat4 &getViewMatrix() const { return viewMatrix; };
+  const glm::mat4 &getInverseViewMatrix() const { return inverseViewMatrix; };
+  glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
 
 private:
   glm::mat4 projectionMatrix{1.f};
   glm::mat4 viewMatrix{1.f};
+  glm::mat4 inverseViewMatrix{1.f};
 };
 } // namespace lve
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "lve_camera.hpp"
+#include "lve_device.hpp"
+#include "lve_ring_buffer.hpp"
+#include "vulkan/vulkan_core.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Point lights binned into a froxel grid for clustered forward shading.
+//
+// The camera's frustum is cut into GRID_X x GRID_Y screen tiles and GRID_Z
+// slices, spaced exponentially in view depth between the projection's near
+// and far planes so froxels stay roughly cube shaped. update() bins the
+// frame's lights on the CPU: a light only visits the froxels its sphere can
+// reach, slice by slice, so the cost follows the screen volume lights cover
+// rather than lights times froxels. Lights outside the frustum are dropped.
+//
+// The result goes to a storage buffer ring: the visible lights, an (offset,
+// count) pair per froxel and one array of light indices the pairs point
+// into. A fragment finds its froxel from gl_FragCoord and its depth, and
+// only loops over that froxel's lights; there are no per-object light lists.
+class LveClusteredLights {
+public:
+  static constexpr uint32_t GRID_X = 16;
+  static constexpr uint32_t GRID_Y = 9;
+  static constexpr uint32_t GRID_Z = 24;
+  static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+  // std430, matches simple_shader.frag
+  struct PointLight {
+    glm::vec3 position{}; // world space
+    float radius = 1.f;   // no light at all beyond it
+    glm::vec3 color{1.f}; // premultiplied by intensity
+    float padding = 0.f;
+  };
+
+  // std140, the tail of GlobalUbo in simple_shader.frag: what maps a
+  // fragment to its froxel
+  struct ShaderParams {
+    glm::vec2 tileScale{}; // tiles per pixel
+    float nearPlane = 0.f;
+    float farPlane = 0.f;
+    // slice = log(view depth) * sliceScale + sliceBias
+    float sliceScale = 0.f;
+    float sliceBias = 0.f;
+  };
+
+  struct Stats {
+    uint32_t lights = 0;
+    uint32_t visibleLights = 0;
+    // light references over all froxels, and the most in one
+    uint32_t lightIndices = 0;
+    uint32_t maxClusterLights = 0;
+    double binMilliseconds = 0;
+  };
+
+  explicit LveClusteredLights(LveDevice &device);
+
+  LveClusteredLights(const LveClusteredLights &) = delete;
+  LveClusteredLights &operator=(const LveClusteredLights &) = delete;
+
+  // Call after the frame's fence wait
+  void beginFrame(int frameIndex);
+  // Bins lights for the camera's current view and perspective projection,
+  // rendered at extent
+  void update(const LveCamera &camera, VkExtent2D extent,
+              const std::vector<PointLight> &lights);
+
+  const ShaderParams &getShaderParams() const { return params; }
+  // this frame's buffers, for the storage buffer descriptors of
+  // simple_shader.frag
+  VkDescriptorBufferInfo getLightBuffer() const { return lightBuffer; }
+  VkDescriptorBufferInfo getClusterBuffer() const { return clusterBuffer; }
+  VkDescriptorBufferInfo getIndexBuffer() const { return indexBuffer; }
+
+  const Stats &getStats() const { return stats; }
+
+private:
+  // the froxels one light reaches in one slice
+  struct Span {
+    uint32_t slice;
+    uint32_t minX, maxX;
+    uint32_t minY, maxY;
+  };
+
+  // False when the light reaches no froxel
+  bool findSpans(const glm::vec3 &center, float radius); // view space
+  // Falls back to empty buffers when the ring is full; it grows for the
+  // next time this frame index comes round
+  bool allocate(VkDeviceSize size, VkDescriptorBufferInfo &info, void *&data);
+
+  LveRingBuffer ring;
+  int frameIndex = 0;
+
+  ShaderParams params{};
+  // projection terms, for the froxel bounds
+  float xScale = 1.f;
+  float yScale = 1.f;
+  std::vector<float> sliceDepths; // GRID_Z + 1 boundaries
+
+  VkDescriptorBufferInfo lightBuffer{};
+  VkDescriptorBufferInfo clusterBuffer{};
+  VkDescriptorBufferInfo indexBuffer{};
+
+  // reused every frame so binning does not allocate
+  std::vector<Span> spans;
+  std::vector<uint32_t> spanEnds; // per visible light, into spans
+  std::vector<uint32_t> visibleLights;
+  std::vector<uint32_t> clusterOffsets;
+
+  Stats stats{};
+};
+
+} // namespace lve
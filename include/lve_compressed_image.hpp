@@ -0,0 +1,49 @@
+#pragma once
+
+#include "lve_block_decoder.hpp"
+#include "lve_mapped_file.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// A block compressed 2D texture as stored on disk, mips finest first.
+// Levels point into data, the mapped file, and are ready to be copied to
+// staging for vkCmdCopyBufferToImage.
+struct LveCompressedImage {
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    size_t offset; // into data
+    size_t size;
+  };
+
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  LveBlockFormat blockFormat = LveBlockFormat::BC1;
+  bool srgb = false;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<Level> levels;
+  LveMappedFile data; // the whole file
+
+  const uint8_t *levelData(size_t level) const {
+    return reinterpret_cast<const uint8_t *>(data.data()) +
+           levels[level].offset;
+  }
+
+  // DDS (legacy DXTn/ATIn FourCCs or a DX10 header) and KTX2 without
+  // supercompression, holding BC1-BC7. Arrays, cubemaps and 3D textures
+  // are rejected. Throws std::runtime_error on anything else.
+  static LveCompressedImage load(const std::string &filepath);
+  static LveCompressedImage parse(LveMappedFile bytes,
+                                  const std::string &filepath);
+  // by extension: .dds or .ktx2
+  static bool isCompressedFile(const std::string &filepath);
+};
+
+} // namespace lve
@@ -0,0 +1,30 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Codecs for asset archive chunks. LZ4 (block format) is built in and
+// decompresses at memory speed; Zstd compresses smaller and needs libzstd
+// (LVE_ZSTD, see the Makefile). All functions are thread safe.
+class LveCompression {
+public:
+  enum class Codec : uint32_t { None = 0, Lz4 = 1, Zstd = 2 };
+
+  static bool isAvailable(Codec codec);
+  static const char *name(Codec codec);
+
+  // Replaces dst with the compressed bytes; throws std::runtime_error if
+  // the codec was not built in
+  static void compress(Codec codec, const void *src, size_t size,
+                       std::vector<uint8_t> &dst);
+  // Fills dst with exactly dstSize bytes; false on corrupt input, a size
+  // mismatch or a codec that was not built in
+  static bool decompress(Codec codec, const void *src, size_t srcSize,
+                         void *dst, size_t dstSize);
+};
+
+} // namespace lve
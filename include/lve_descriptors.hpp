@@ -0,0 +1,177 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_swapchain.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Deduplicates descriptor set layouts. Layouts are keyed by their bindings
+// (sorted by binding number) and create flags, so any two systems asking for
+// the same interface share one VkDescriptorSetLayout and stay compatible.
+// The cache owns every layout it returns.
+class LveDescriptorLayoutCache {
+public:
+  explicit LveDescriptorLayoutCache(LveDevice &device);
+  ~LveDescriptorLayoutCache();
+
+  LveDescriptorLayoutCache(const LveDescriptorLayoutCache &) = delete;
+  LveDescriptorLayoutCache &
+  operator=(const LveDescriptorLayoutCache &) = delete;
+
+  // Immutable samplers are not supported
+  VkDescriptorSetLayout
+  getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings,
+            VkDescriptorSetLayoutCreateFlags flags = 0);
+
+  size_t size() const;
+
+private:
+  struct LayoutKey {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    VkDescriptorSetLayoutCreateFlags flags;
+
+    bool operator==(const LayoutKey &other) const;
+  };
+
+  struct LayoutKeyHash {
+    size_t operator()(const LayoutKey &key) const;
+  };
+
+  LveDevice &lveDevice;
+  mutable std::mutex mutex;
+  std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+};
+
+// Deduplicates pipeline layouts by their set layouts and push constant
+// ranges, so pipelines built from the same shader interface share one
+// VkPipelineLayout. Set layouts come from, and stay owned by, the descriptor
+// layout cache; the cache owns every pipeline layout it returns.
+class LvePipelineLayoutCache {
+public:
+  LvePipelineLayoutCache(LveDevice &device,
+                         LveDescriptorLayoutCache &setLayoutCache);
+  ~LvePipelineLayoutCache();
+
+  LvePipelineLayoutCache(const LvePipelineLayoutCache &) = delete;
+  LvePipelineLayoutCache &operator=(const LvePipelineLayoutCache &) = delete;
+
+  VkPipelineLayout
+  getLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+            const std::vector<VkPushConstantRange> &pushConstantRanges);
+
+  LveDescriptorLayoutCache &getSetLayoutCache() { return setLayoutCache; }
+  size_t size() const;
+
+private:
+  struct LayoutKey {
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+
+    bool operator==(const LayoutKey &other) const;
+  };
+
+  struct LayoutKeyHash {
+    size_t operator()(const LayoutKey &key) const;
+  };
+
+  LveDevice &lveDevice;
+  LveDescriptorLayoutCache &setLayoutCache;
+  mutable std::mutex mutex;
+  std::unordered_map<LayoutKey, VkPipelineLayout, LayoutKeyHash> layouts;
+};
+
+// Allocates descriptor sets from a growing list of pools. When a pool runs
+// out another is taken, each larger than the last, so callers never size
+// pools up front. reset() returns every set at once by resetting the pools,
+// which is how transient per-frame sets are freed.
+class LveDescriptorAllocator {
+public:
+  struct PoolRatio {
+    VkDescriptorType type;
+    float perSet;
+  };
+
+  static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+  static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+  explicit LveDescriptorAllocator(LveDevice &device);
+  ~LveDescriptorAllocator();
+
+  LveDescriptorAllocator(const LveDescriptorAllocator &) = delete;
+  LveDescriptorAllocator &operator=(const LveDescriptorAllocator &) = delete;
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  void reset();
+
+  uint32_t poolCount() const {
+    return static_cast<uint32_t>(usedPools.size() + freePools.size());
+  }
+  uint32_t setsAllocated() const { return allocatedSets; }
+
+private:
+  VkDescriptorPool grabPool();
+  VkDescriptorPool createPool(uint32_t setCount);
+
+  LveDevice &lveDevice;
+  VkDescriptorPool currentPool = VK_NULL_HANDLE;
+  std::vector<VkDescriptorPool> usedPools;
+  std::vector<VkDescriptorPool> freePools;
+  uint32_t setsPerPool = INITIAL_SETS_PER_POOL;
+  uint32_t allocatedSets = 0;
+};
+
+// One LveDescriptorAllocator per frame in flight for sets that only live for
+// a frame. beginFrame(i) resets frame i's pools once its fence has signalled.
+class LveFrameDescriptorAllocator {
+public:
+  explicit LveFrameDescriptorAllocator(LveDevice &device);
+
+  void beginFrame(int frameIndex);
+  LveDescriptorAllocator &current() { return *allocators[currentFrame]; }
+
+private:
+  std::array<std::unique_ptr<LveDescriptorAllocator>,
+             LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      allocators{};
+  int currentFrame = 0;
+};
+
+// Collects descriptor writes and applies them in one vkUpdateDescriptorSets.
+// Fixed capacity, so per-frame use does not touch the heap.
+class LveDescriptorWriter {
+public:
+  static constexpr uint32_t MAX_WRITES = 16;
+
+  LveDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorType type,
+                                   const VkDescriptorBufferInfo &bufferInfo);
+  // arrayElement picks the descriptor in an arrayed binding
+  LveDescriptorWriter &writeImage(uint32_t binding, VkDescriptorType type,
+                                  const VkDescriptorImageInfo &imageInfo,
+                                  uint32_t arrayElement = 0);
+
+  void update(LveDevice &device, VkDescriptorSet set);
+
+private:
+  struct Write {
+    uint32_t binding;
+    VkDescriptorType type;
+    VkDescriptorBufferInfo bufferInfo;
+    VkDescriptorImageInfo imageInfo;
+    bool isImage;
+    uint32_t arrayElement;
+  };
+
+  std::array<Write, MAX_WRITES> writes{};
+  uint32_t writeCount = 0;
+};
+
+} // namespace lve
@@ -4,6 +4,13 @@
 #include "vulkan/vulkan_core.h"
 
 // std lib headers
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace lve {
@@ -17,11 +24,29 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    // families without graphics: transfer only (a copy engine) and compute.
+    // Unset when the device has none, as on lavapipe.
+    uint32_t transferFamily;
+    uint32_t computeFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;
+    bool computeFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// What device memory is used for, as broken down in the memory stats
+enum class MemoryCategory : uint32_t {
+    Geometry,      // vertex and index buffers
+    Texture,
+    RenderTarget,  // attachments and images written on the GPU
+    Uniform,       // per-frame uniform and storage rings
+    Staging,       // upload rings and one-off copies
+    Readback,
+    Other,
+    Count
+};
+
 class LveDevice {
   public:
 #ifdef NDEBUG
@@ -30,7 +55,13 @@ class LveDevice {
     const bool enableValidationLayers = true;
 #endif
 
-    LveDevice(LveWindow& window);
+    // Every GPU is scored on its type, VRAM, queues and optional features,
+    // and the best suitable one is used. preferredDevice, or the LVE_DEVICE
+    // environment variable which overrides it, picks one instead: an index
+    // into the logged list, a UUID, or part of the name (the best scoring
+    // match). Throws if nothing suitable matches.
+    static constexpr const char* DEVICE_ENV_VAR = "LVE_DEVICE";
+    explicit LveDevice(LveWindow& window, const std::string& preferredDevice = "");
     ~LveDevice();
 
     // Not copyable or movable
@@ -38,20 +69,49 @@ class LveDevice {
     LveDevice& operator=(const LveDevice&) = delete;
 
     VkCommandPool getCommandPool() { return commandPool; }
+    // one pool per queue, for the thread that records frames
+    VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+    VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+    // shared by every pipeline; safe to use from several threads at once
+    VkPipelineCache getPipelineCache() { return pipelineCache; }
+    // Merges a cache written by savePipelineCache() into the device's, so
+    // pipelines compiled by an earlier run are not compiled again. Data from
+    // another GPU or driver is ignored. The merge is not synchronized with
+    // pipeline creation: call it before any pipeline is built. Returns false
+    // when nothing was loaded.
+    bool loadPipelineCache(const std::string& filepath);
+    // Returns false, after printing why, when the file cannot be written
+    bool savePipelineCache(const std::string& filepath);
     VkDevice device() { return device_; }
     VkSurfaceKHR surface() { return surface_; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    // graphicsQueue() itself when the device has no such family. Queues are
+    // not locked: submit to them from the thread that records frames.
+    VkQueue transferQueue() { return transferQueue_; }
+    VkQueue computeQueue() { return computeQueue_; }
+    uint32_t graphicsQueueFamily() const { return queueFamilyIndices.graphicsFamily; }
+    uint32_t transferQueueFamily() const;
+    uint32_t computeQueueFamily() const;
+    // work on these queues runs alongside rendering, and exclusive resources
+    // shared with the graphics queue must change owner (see below)
+    bool hasDedicatedTransferQueue() const { return queueFamilyIndices.transferFamilyHasValue; }
+    bool hasAsyncComputeQueue() const { return queueFamilyIndices.computeFamilyHasValue; }
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    // Highest sample count colour and depth attachments both support, up
+    // to limit
+    VkSampleCountFlagBits maxUsableSampleCount(VkSampleCountFlagBits limit) const;
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
                                  VkFormatFeatureFlags features);
 
     // Buffer Helper Functions
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                      VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+                      VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+                      MemoryCategory category = MemoryCategory::Other);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -59,9 +119,99 @@ class LveDevice {
                            uint32_t layerCount);
 
     void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
-                             VkImage& image, VkDeviceMemory& imageMemory);
+                             VkImage& image, VkDeviceMemory& imageMemory,
+                             MemoryCategory category = MemoryCategory::Other);
+    // Tracked allocation for memory the caller binds itself, e.g. one block
+    // shared by several images; any thread
+    VkDeviceMemory allocateMemory(const VkMemoryRequirements& requirements,
+                                  VkMemoryPropertyFlags properties, MemoryCategory category);
+    // Frees memory from createBuffer(), createImageWithInfo() or
+    // allocateMemory(); any thread
+    void freeMemory(VkDeviceMemory memory);
+
+    // Memory budget. Per heap, the budget and this process's usage come
+    // from VK_EXT_memory_budget when the device has it: the driver's figures
+    // as of the last updateMemoryBudget(), plus what the engine allocated
+    // since. Without it the usage is the engine's own allocations and the
+    // budget MEMORY_BUDGET_FALLBACK of the heap.
+    static constexpr float MEMORY_BUDGET_FALLBACK = 0.8f;
+    // pressure callbacks run once usage passes this share of the budget
+    static constexpr float MEMORY_PRESSURE_THRESHOLD = 0.9f;
+
+    struct MemoryHeapStats {
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;
+        VkDeviceSize peakUsage = 0;
+        bool deviceLocal = false;
+    };
+    struct MemoryStats {
+        std::vector<MemoryHeapStats> heaps;
+        // the engine's own allocations
+        std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+        std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryPeakBytes{};
+        uint32_t allocations = 0;
+        uint64_t pressureEvents = 0;
+        bool budgetExtension = false;
+    };
+    MemoryStats getMemoryStats() const;
+    static const char* memoryCategoryName(MemoryCategory category);
+
+    struct MemoryPressure {
+        uint32_t heapIndex;
+        bool deviceLocal;
+        // to get back under MEMORY_PRESSURE_THRESHOLD of the budget
+        VkDeviceSize bytesToFree;
+        // an allocation of bytesToFree on this heap failed and is retried
+        // once the callbacks return, so freeing has to happen now
+        bool allocationFailed = false;
+    };
+    // Asked to free (or schedule freeing) about bytesToFree from the heap,
+    // e.g. by evicting streamed data; returns how much it let go of.
+    // Callbacks run on the render thread, from updateMemoryBudget(), and on
+    // whichever thread failed to allocate, from allocateMemory().
+    using MemoryPressureCallback = std::function<VkDeviceSize(const MemoryPressure&)>;
+    uint32_t addMemoryPressureCallback(MemoryPressureCallback callback);
+    void removeMemoryPressureCallback(uint32_t id);
+    // Render thread, once per frame: re-reads the driver's budget and runs
+    // the pressure callbacks for every heap that is over the threshold, or
+    // that an allocation since the last call would have taken over it
+    void updateMemoryBudget();
+
+    // Queue family ownership transfer of an exclusive image whose contents
+    // must survive the move: record the release on the queue that wrote it,
+    // and the acquire, with the same families and layouts, on the queue that
+    // uses it next, after a semaphore wait. Nothing is recorded when both
+    // families are the same.
+    void releaseImageOwnership(VkCommandBuffer commandBuffer, VkImage image,
+                               const VkImageSubresourceRange& range, VkImageLayout oldLayout,
+                               VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                               VkPipelineStageFlags srcStage, VkAccessFlags srcAccess);
+    void acquireImageOwnership(VkCommandBuffer commandBuffer, VkImage image,
+                               const VkImageSubresourceRange& range, VkImageLayout oldLayout,
+                               VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                               VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    // vkCmdBeginRendering/vkCmdEndRendering, or their KHR forms on devices
+    // older than 1.3; only with dynamicRenderingSupported
+    void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo& renderingInfo);
+    void cmdEndRendering(VkCommandBuffer commandBuffer);
 
     VkPhysicalDeviceProperties properties;
+    // features actually enabled on the logical device
+    VkPhysicalDeviceFeatures enabledFeatures{};
+
+    // descriptor indexing (core in 1.2, VK_EXT_descriptor_indexing before);
+    // true when everything LveBindlessTable needs was enabled
+    bool bindlessSupported = false;
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
+    // dynamic rendering (core in 1.3, VK_KHR_dynamic_rendering before):
+    // rendering straight into image views, without render pass or
+    // framebuffer objects
+    bool dynamicRenderingSupported = false;
+    // how multisampled depth can be resolved (core in 1.2); none before.
+    // SAMPLE_ZERO is always among them when any are.
+    VkResolveModeFlags depthResolveModes = 0;
 
   private:
     void createInstance();
@@ -70,27 +220,77 @@ class LveDevice {
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createCommandPool();
+    void createPipelineCache();
+    void createMemoryTracking();
+
+    // with memoryMutex held
+    VkDeviceSize heapUsage(uint32_t heapIndex) const;
+    VkDeviceSize heapBudget(uint32_t heapIndex) const;
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
+    uint64_t scoreDevice(VkPhysicalDevice device);
+    static std::string deviceUuid(VkPhysicalDevice device);
+    static bool matchesPreference(const std::string& preference, uint32_t index,
+                                  const VkPhysicalDeviceProperties& properties,
+                                  const std::string& uuid);
     std::vector<const char*> getRequiredExtensions();
     bool checkValidationLayerSupport();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     void hasGflwRequiredInstanceExtensions();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     LveWindow& window;
+    std::string preferredDevice;
     VkCommandPool commandPool;
+    VkCommandPool transferCommandPool;
+    VkCommandPool computeCommandPool;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 
     VkDevice device_;
     VkSurfaceKHR surface_;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue transferQueue_;
+    VkQueue computeQueue_;
+    QueueFamilyIndices queueFamilyIndices;
+
+    struct MemoryAllocation {
+        VkDeviceSize size;
+        uint32_t heapIndex;
+        MemoryCategory category;
+    };
+    struct MemoryHeapState {
+        VkDeviceSize allocated = 0;  // by the engine
+        VkDeviceSize peakUsage = 0;
+        // driver figures and the engine's total when they were read
+        VkDeviceSize driverUsage = 0;
+        VkDeviceSize driverBudget = 0;
+        VkDeviceSize allocatedAtUpdate = 0;
+        // allocations that went over the threshold since the last update
+        VkDeviceSize pressureBytes = 0;
+    };
+    PFN_vkCmdBeginRendering beginRendering = nullptr;
+    PFN_vkCmdEndRendering endRendering = nullptr;
+
+    bool memoryBudgetSupported = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    mutable std::mutex memoryMutex;
+    std::unordered_map<VkDeviceMemory, MemoryAllocation> memoryAllocations;
+    std::vector<MemoryHeapState> memoryHeaps;
+    std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+    std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryPeakBytes{};
+    uint64_t pressureEvents = 0;
+    std::vector<std::pair<uint32_t, MemoryPressureCallback>> pressureCallbacks;
+    uint32_t nextPressureCallbackId = 0;
+    // unlocked, since the callbacks free memory; returns the bytes released
+    VkDeviceSize runPressureCallbacks(const MemoryPressure& pressure);
 
     const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
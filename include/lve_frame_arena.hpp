@@ -0,0 +1,99 @@
+#pragma once
+
+#include "lve_linear_allocator.hpp"
+#include "lve_swapchain.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Transient CPU memory for one frame in flight.
+//
+// Each frame index owns a bump allocator, plus one sub-arena per worker
+// thread so workers can allocate without locking. beginFrame(i) is called
+// once frame i's fence has signalled: nothing recorded for that frame can
+// still be in use, so its memory is released by resetting the offsets.
+// Everything allocated stays valid until the same frame index comes round
+// again, MAX_FRAMES_IN_FLIGHT frames later.
+class LveFrameArena {
+public:
+  static constexpr uint32_t MAX_WORKER_ARENAS = 32;
+
+  struct Stats {
+    size_t bytesUsed = 0;   // this frame, main and worker arenas
+    size_t capacity = 0;    // all frames
+    uint32_t workerArenas = 0;
+    // heap blocks the arenas took while recording the previous frame; zero
+    // once they have grown to the steady-state working set. Allocations
+    // made elsewhere are not seen here; `make check` counts those.
+    uint64_t heapAllocationsLastFrame = 0;
+    uint64_t heapAllocationsTotal = 0;
+  };
+
+  explicit LveFrameArena(size_t initialCapacity = 256 * 1024);
+
+  LveFrameArena(const LveFrameArena &) = delete;
+  LveFrameArena &operator=(const LveFrameArena &) = delete;
+
+  // Resets every arena belonging to frameIndex. No worker may be allocating
+  // while this runs.
+  void beginFrame(int frameIndex);
+
+  // Main thread arena of the current frame
+  LveLinearAllocator &frameAllocator() {
+    return frames[currentFrame]->allocator;
+  }
+  template <typename T> T *alloc(size_t count) {
+    return frameAllocator().alloc<T>(count);
+  }
+
+  // Calling thread's sub-arena for the current frame. The first call from a
+  // thread takes a lock to claim a slot and publishes it through
+  // workerCount; later calls are lock-free. Slots are never reassigned, so
+  // readers only look at the first workerCount of them.
+  LveLinearAllocator &workerAllocator();
+  template <typename T> T *workerAlloc(size_t count) {
+    return workerAllocator().alloc<T>(count);
+  }
+
+  // Like beginFrame, only while no worker is allocating
+  Stats getStats() const;
+
+private:
+  struct Frame {
+    LveLinearAllocator allocator;
+    std::array<std::unique_ptr<LveLinearAllocator>, MAX_WORKER_ARENAS>
+        workers{};
+
+    explicit Frame(size_t capacity) : allocator{capacity} {}
+  };
+
+  uint32_t claimWorkerSlot();
+  uint64_t countHeapAllocations() const;
+
+  // distinguishes arenas in the per-thread slot cache
+  const uint64_t arenaId;
+  size_t workerCapacity;
+  std::array<std::unique_ptr<Frame>, LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      frames{};
+  std::atomic<int> currentFrame{0};
+
+  std::mutex workerMutex;
+  std::vector<std::pair<std::thread::id, uint32_t>> workerSlots;
+  // slots below this have their arenas in every frame; written under
+  // workerMutex once they exist
+  std::atomic<uint32_t> workerCount{0};
+
+  uint64_t heapAllocationsAtFrameStart = 0;
+  uint64_t heapAllocationsLastFrame = 0;
+};
+
+} // namespace lve
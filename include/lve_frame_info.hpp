@@ -0,0 +1,29 @@
+#pragma once
+
+#include "lve_camera.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_frame_arena.hpp"
+#include "lve_gameobject.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <vector>
+
+namespace lve {
+
+// Per-frame state handed to render systems
+struct FrameInfo {
+  int frameIndex;
+  float frameTime;
+  VkCommandBuffer commandBuffer;
+  LveCamera &camera;
+  LveGameObject::Map &gameObjects;
+  // ids that survived scene-level culling, in draw order
+  const std::vector<LveGameObject::id_t> &visibleObjects;
+  // transient CPU memory, valid until this frame index is reused
+  LveFrameArena &frameArena;
+  // transient descriptor sets, reset when this frame index is reused
+  LveDescriptorAllocator &frameDescriptors;
+};
+
+} // namespace lve
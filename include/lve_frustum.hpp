@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lve_bounds.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace lve {
+
+// Six clip planes extracted from a projection * view (* model) matrix
+// (Gribb/Hartmann). Planes point inwards and are normalized, so the signed
+// distance is measured in whichever space the matrix maps from.
+struct LveFrustum {
+  enum Plane {
+    PLANE_LEFT = 0,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR,
+    PLANE_COUNT
+  };
+
+  glm::vec4 planes[PLANE_COUNT];
+
+  static LveFrustum fromMatrix(const glm::mat4 &m) {
+    const glm::vec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+    const glm::vec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+    const glm::vec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+    const glm::vec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+
+    LveFrustum frustum{};
+    frustum.planes[PLANE_LEFT] = row3 + row0;
+    frustum.planes[PLANE_RIGHT] = row3 - row0;
+    frustum.planes[PLANE_BOTTOM] = row3 + row1;
+    frustum.planes[PLANE_TOP] = row3 - row1;
+    // Vulkan clip space depth is [0, w] (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+    frustum.planes[PLANE_NEAR] = row2;
+    frustum.planes[PLANE_FAR] = row3 - row2;
+
+    for (auto &plane : frustum.planes) {
+      plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+  }
+
+  bool intersectsSphere(const glm::vec3 &center, float radius) const {
+    for (const auto &plane : planes) {
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool intersectsAabb(const glm::vec3 &min, const glm::vec3 &max) const {
+    for (const auto &plane : planes) {
+      // test the corner furthest along the plane normal
+      glm::vec3 positive{plane.x >= 0.f ? max.x : min.x,
+                         plane.y >= 0.f ? max.y : min.y,
+                         plane.z >= 0.f ? max.z : min.z};
+      if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool intersectsAabb(const LveAabb &box) const {
+    return intersectsAabb(box.min, box.max);
+  }
+};
+
+} // namespace lve
@@ -1,12 +1,15 @@
 #pragma once
 
+#include "lve_bounds.hpp"
 #include "lve_model.hpp"
+#include "lve_texture_streamer.hpp"
 
 // libs
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
 #include <memory>
+#include <unordered_map>
 
 namespace lve {
 
@@ -50,6 +53,7 @@ struct TransformComponent {
 class LveGameObject {
 public:
   using id_t = unsigned int;
+  using Map = std::unordered_map<id_t, LveGameObject>;
 
   static LveGameObject createGameObject() {
     static id_t currentId = 0;
@@ -63,9 +67,21 @@ public:
 
   id_t getId() { return id; }
 
+  // World space bounds of the model under the current transform
+  LveAabb getWorldBounds() {
+    if (model == nullptr) {
+      return LveAabb{};
+    }
+    return model->getBoundingBox().transformed(transform.mat4());
+  }
+
   std::shared_ptr<LveModel> model{};
   glm::vec3 color{};
+  // streamed at the resolution the object covers on screen
+  LveTextureStreamer::TextureId texture = LveTextureStreamer::INVALID_TEXTURE;
   TransformComponent transform{};
+  // never moves, so the distant shadow cascades can keep it cached
+  bool isStatic = false;
 
 private:
   LveGameObject(id_t objId) : id{objId} {}
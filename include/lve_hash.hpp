@@ -0,0 +1,15 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <functional>
+
+namespace lve {
+
+// Mixes the hash of value into seed, as boost::hash_combine does, for the
+// caches keyed on several fields
+template <typename T> void hashCombine(std::size_t &seed, const T &value) {
+  seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+} // namespace lve
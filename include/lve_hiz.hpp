@@ -0,0 +1,122 @@
+#pragma once
+
+#include "lve_bounds.hpp"
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_renderer.hpp"
+#include "lve_swapchain.hpp"
+#include "vulkan/vulkan_core.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Hierarchical-Z occlusion culling from the previous frames' depth.
+//
+// After the main pass a compute shader reduces the depth buffer into a
+// min/max pyramid. A coarse level is copied to a host visible buffer per
+// frame in flight; once that frame's fence has signalled the CPU finishes the
+// pyramid and tests object bounds against it, using the view projection the
+// depth was rendered with. Results lag by MAX_FRAMES_IN_FLIGHT frames, so a
+// newly revealed object can appear that many frames late.
+//
+// With an async compute queue the build runs there: the frame hands the
+// depth image over and the next frame waits for the build only before it
+// clears depth, so the reduction overlaps with that frame's other work.
+class LveHiZ {
+public:
+  // coarsest GPU level copied back is the first at most this many texels wide
+  static constexpr uint32_t READBACK_MAX_SIZE = 128;
+
+  explicit LveHiZ(LveDevice &device);
+  ~LveHiZ();
+
+  LveHiZ(const LveHiZ &) = delete;
+  LveHiZ &operator=(const LveHiZ &) = delete;
+
+  bool isSupported() const { return supported; }
+
+  // Call after the frame's fence wait, before culling
+  void beginFrame(int frameIndex);
+
+  // Records the pyramid build and readback; call after the render graph
+  void record(VkCommandBuffer commandBuffer, int frameIndex,
+              LveRenderer &renderer, const glm::mat4 &projectionView);
+
+  // False only if the bounds are certainly hidden behind previous depth
+  bool isVisible(const LveAabb &worldBounds) const;
+
+private:
+  struct CpuLevel {
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> maxDepth;
+  };
+
+  struct Readback {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    glm::mat4 projectionView{1.f};
+    bool pending = false;
+  };
+
+  void createPipeline();
+  void createAsyncCompute();
+  void resize(LveSwapChain &swapChain);
+  void destroyPyramid();
+  void recordReduce(VkCommandBuffer commandBuffer, int frameIndex,
+                    uint32_t imageIndex);
+  void recordAsync(VkCommandBuffer commandBuffer, int frameIndex,
+                   LveRenderer &renderer);
+
+  LveDevice &lveDevice;
+  bool supported = false;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  std::unique_ptr<LveComputePipeline> reducePipeline;
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  // GPU pyramid, level 0 is half the depth resolution
+  LveSwapChain *currentSwapChain = nullptr;
+  VkImageView firstDepthView = VK_NULL_HANDLE;
+  VkExtent2D depthExtent{0, 0};
+  VkImage pyramidImage = VK_NULL_HANDLE;
+  VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+  std::vector<VkImageView> levelViews;
+  std::vector<VkExtent2D> levelExtents;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> depthSets; // one per swap chain image
+  std::vector<VkDescriptorSet> levelSets; // level i-1 -> level i
+  uint32_t readbackLevel = 0;
+
+  std::array<Readback, LveSwapChain::MAX_FRAMES_IN_FLIGHT> readbacks{};
+
+  // async compute, per frame in flight
+  struct ComputeFrame {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkSemaphore depthReady = VK_NULL_HANDLE; // graphics -> compute
+    VkSemaphore reduceDone = VK_NULL_HANDLE; // compute -> next frame
+    VkFence fence = VK_NULL_HANDLE;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  };
+  bool asyncCompute = false;
+  std::array<ComputeFrame, LveSwapChain::MAX_FRAMES_IN_FLIGHT> computeFrames{};
+  VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  int unwaitedReduce = -1; // frame whose reduceDone nothing waits on yet
+
+  // CPU pyramid built from the latest completed readback
+  std::vector<CpuLevel> cpuLevels;
+  glm::mat4 cpuProjectionView{1.f};
+  bool cpuValid = false;
+};
+
+} // namespace lve
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "lve_mapped_file.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// Decoded image in CPU memory: tightly packed RGBA8, rows top to bottom
+struct LveImageData {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+
+  size_t sizeBytes() const { return pixels.size(); }
+};
+
+// Dependency-free decoders for the uncompressed formats our tools export.
+// All functions are thread safe and throw std::runtime_error on bad input.
+class LveImageLoader {
+public:
+  // TGA (truecolor or grayscale, raw or RLE) and binary PPM (P6)
+  static LveImageData loadRgba8(const std::string &filepath);
+  static LveImageData decodeRgba8(const LveMappedFile &bytes,
+                                  const std::string &filepath);
+
+  // 2x2 box filter down to the next mip level; odd edges clamp
+  static LveImageData downsample(const LveImageData &source);
+
+  static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+};
+
+} // namespace lve
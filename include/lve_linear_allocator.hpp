@@ -0,0 +1,60 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+
+// Bump allocator for short-lived CPU data. Allocation is a pointer increment
+// and reset() releases everything at once; destructors are never run, so it
+// only hands out trivially destructible types.
+//
+// When a block fills up another is chained on. On the next reset() the
+// blocks are merged into one big enough for the whole high-water mark, so a
+// workload that repeats every frame stops touching the heap after warm-up.
+class LveLinearAllocator {
+public:
+  explicit LveLinearAllocator(size_t initialCapacity = 64 * 1024);
+
+  LveLinearAllocator(const LveLinearAllocator &) = delete;
+  LveLinearAllocator &operator=(const LveLinearAllocator &) = delete;
+
+  void *allocate(size_t size, size_t alignment);
+
+  // Uninitialised storage for count objects of T
+  template <typename T> T *alloc(size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "LveLinearAllocator never runs destructors");
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void reset();
+
+  size_t capacity() const;
+  size_t bytesUsed() const { return used; }
+  size_t highWaterMark() const { return peak; }
+
+  // number of blocks taken from the heap since construction
+  uint64_t heapAllocations() const { return blockAllocations; }
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+
+  void addBlock(size_t minSize);
+
+  std::vector<Block> blocks;
+  size_t offset = 0; // into blocks.back()
+  size_t used = 0;
+  size_t peak = 0;
+  uint64_t blockAllocations = 0;
+};
+
+} // namespace lve
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+// A whole file, read only, memory mapped on POSIX systems and read into a
+// heap buffer elsewhere.
+//
+// data() is at least 4-byte aligned (page aligned when mapped), so SPIR-V
+// goes to vkCreateShaderModule as uint32_t words and asset bytes go to a
+// staging buffer without passing through an intermediate copy. Pages are
+// read in as they are touched; willNeed() and prefetch() move that earlier.
+class LveMappedFile {
+public:
+  // how the contents will be read, passed on to madvise
+  enum class Access { Normal, Sequential, Random };
+
+  LveMappedFile() = default;
+  // Throws std::runtime_error if the file cannot be opened or mapped
+  explicit LveMappedFile(const std::string &filepath,
+                         Access access = Access::Sequential);
+  ~LveMappedFile();
+
+  // Owns a copy of bytes, for data that did not come from a file
+  static LveMappedFile fromBytes(const void *bytes, size_t size);
+  // Owns an uninitialised buffer, filled through writableData()
+  static LveMappedFile allocate(size_t size);
+  // Does not own bytes, which must stay valid and 4-byte aligned while the
+  // view is used (e.g. an entry of a mounted LveArchive)
+  static LveMappedFile view(const char *bytes, size_t size);
+
+  LveMappedFile(LveMappedFile &&other) noexcept;
+  LveMappedFile &operator=(LveMappedFile &&other) noexcept;
+  LveMappedFile(const LveMappedFile &) = delete;
+  LveMappedFile &operator=(const LveMappedFile &) = delete;
+
+  const char *data() const { return bytes; }
+  size_t size() const { return byteCount; }
+  bool empty() const { return byteCount == 0; }
+  bool isMapped() const { return mapping != nullptr; }
+  char operator[](size_t index) const { return bytes[index]; }
+  const uint32_t *words() const {
+    return reinterpret_cast<const uint32_t *>(bytes);
+  }
+  // only for buffers from allocate()
+  char *writableData();
+
+  // Starts reading the range in without waiting for it (MADV_WILLNEED)
+  void willNeed(size_t offset = 0, size_t length = SIZE_MAX) const;
+  // Reads every page in now; returns once the whole file is resident
+  void prefetch() const;
+  // The pages may be dropped; they are read back in if touched again
+  void dontNeed() const;
+
+private:
+  void release();
+
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  std::unique_ptr<uint32_t[]> buffer; // when not mapped
+  const char *bytes = nullptr;
+  size_t byteCount = 0;
+};
+
+// Warms the page cache for files that will be read soon, so the
+// LveMappedFile opened for them later finds their pages in memory instead
+// of waiting on the disk. Each file is mapped, faulted in and unmapped
+// again on a background thread; the page cache keeps the contents.
+class LveFilePrefetcher {
+public:
+  explicit LveFilePrefetcher(uint32_t threadCount = 1);
+  ~LveFilePrefetcher();
+
+  LveFilePrefetcher(const LveFilePrefetcher &) = delete;
+  LveFilePrefetcher &operator=(const LveFilePrefetcher &) = delete;
+
+  // Missing or unreadable files are skipped; whoever opens them later
+  // reports the error
+  void prefetch(const std::string &filepath);
+
+  uint32_t pendingFiles() const { return pending; }
+  uint64_t prefetchedBytes() const { return bytesRead; }
+
+private:
+  std::atomic<uint32_t> pending{0};
+  std::atomic<uint64_t> bytesRead{0};
+  std::atomic<bool> shuttingDown{false};
+  // declared last so the worker is joined before the counters die
+  std::unique_ptr<LveThreadPool> worker;
+};
+
+} // namespace lve
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lve_frustum.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// A small cluster of triangles occupying a contiguous range of the owning
+// model's index buffer, so it can be drawn with a plain vkCmdDrawIndexed.
+struct LveMeshlet {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  uint32_t vertexCount;
+
+  // bounding sphere in model space
+  glm::vec3 center;
+  float radius;
+
+  // normal cone around the outward normals cross(p1 - p0, p2 - p0). The
+  // cutoff is the sine of the cone half angle; 1 marks a cluster whose normals
+  // are too spread out to ever be rejected as back-facing.
+  glm::vec3 coneAxis;
+  float coneCutoff;
+};
+
+class LveMeshletBuilder {
+public:
+  static constexpr uint32_t MAX_VERTICES = 64;
+  static constexpr uint32_t MAX_TRIANGLES = 124;
+
+  // Splits the triangle list into meshlets. The index list is reordered in
+  // place so that every meshlet's triangles are contiguous.
+  static std::vector<LveMeshlet> build(const std::vector<glm::vec3> &positions,
+                                       std::vector<uint32_t> &indices);
+};
+
+struct LveMeshletDrawRange {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+};
+
+struct LveMeshletCullStats {
+  uint32_t total = 0;
+  uint32_t frustumCulled = 0;
+  uint32_t coneCulled = 0;
+};
+
+// Culls meshlets against a model-space frustum and camera position and
+// appends the surviving index ranges to drawRanges, merging adjacent ones.
+// Ranges already in drawRanges are left alone, so several draws can append
+// to one list.
+// Cone culling is only valid when the pipeline culls back faces.
+void cullMeshlets(const std::vector<LveMeshlet> &meshlets,
+                  const LveFrustum &frustum, const glm::vec3 &cameraPosition,
+                  bool coneCulling,
+                  std::vector<LveMeshletDrawRange> &drawRanges,
+                  LveMeshletCullStats &stats);
+
+} // namespace lve
@@ -1,26 +1,49 @@
 #pragma once
 
+#include "lve_bounds.hpp"
 #include "lve_device.hpp"
+#include "lve_meshlet.hpp"
 #include "vulkan/vulkan_core.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+// std
+#include <vector>
+
 namespace lve {
 class LveModel {
 public:
   struct Vertex {
     glm::vec3 position;
     glm::vec3 color;
+    glm::vec3 normal{};
 
     static std::vector<VkVertexInputBindingDescription>
     getBindingDescriptions();
     static std::vector<VkVertexInputAttributeDescription>
     getAttributeDescriptions();
+
+    bool operator==(const Vertex &other) const {
+      return position == other.position && color == other.color &&
+             normal == other.normal;
+    }
+  };
+
+  struct Builder {
+    std::vector<Vertex> vertices{};
+    std::vector<uint32_t> indices{};
+
+    // Gives every vertex of each triangle the triangle's normal, before
+    // welding so that vertices shared by faces at an angle stay apart
+    void computeFlatNormals();
+    // Collapses identical vertices and fills indices, turning a plain
+    // triangle list into an indexed one
+    void weldVertices();
   };
 
-  LveModel(LveDevice &device, const std::vector<Vertex> &vertices);
+  LveModel(LveDevice &device, const Builder &builder);
   ~LveModel();
 
   LveModel(const LveModel &) = delete;
@@ -28,13 +51,31 @@ public:
 
   void bind(VkCommandBuffer commandBuffer);
   void draw(VkCommandBuffer commandBuffer);
+  void drawRange(VkCommandBuffer commandBuffer, uint32_t firstIndex,
+                 uint32_t rangeIndexCount);
+
+  // small process-unique id, used in render queue sort keys
+  uint32_t getId() const { return id; }
+  bool hasIndexBuffer() const { return hasIndexBuffer_; }
+  const LveAabb &getBoundingBox() const { return boundingBox; }
+  const std::vector<LveMeshlet> &getMeshlets() const { return meshlets; }
 
 private:
-  void createVertexBuffer(const std::vector<Vertex> &vertices);
+  void createVertexBuffers(const std::vector<Vertex> &vertices);
+  void createIndexBuffers(const std::vector<uint32_t> &indices);
 
   LveDevice &lveDevice;
+  uint32_t id;
   VkBuffer vertexBuffer;
   VkDeviceMemory vertexBufferMemory;
   uint32_t vertexCount;
+
+  bool hasIndexBuffer_ = false;
+  VkBuffer indexBuffer;
+  VkDeviceMemory indexBufferMemory;
+  uint32_t indexCount;
+
+  std::vector<LveMeshlet> meshlets;
+  LveAabb boundingBox{};
 };
 } // namespace lve
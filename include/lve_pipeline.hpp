@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_shader_reflection.hpp"
 
 // std
 #include <string>
@@ -8,7 +9,32 @@
 
 namespace lve {
 
+class LveMappedFile;
+
+// What a pipeline draws into: a render pass and subpass, or with dynamic
+// rendering (no render pass) only the formats of the attachments
+struct PipelineRenderTarget {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    // of the attachments; pipelines rasterize with it whatever their
+    // multisampleInfo says
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    bool empty() const {
+        return renderPass == VK_NULL_HANDLE && colorFormats.empty() &&
+               depthFormat == VK_FORMAT_UNDEFINED;
+    }
+};
+
 struct PipelineConfigInfo {
+    // a 32-bit specialization constant (bool, int, uint or float bits)
+    struct SpecializationConstant {
+        uint32_t constantId;
+        uint32_t value;
+    };
+
     PipelineConfigInfo() = default;
     PipelineConfigInfo(const PipelineConfigInfo&) = delete;
     PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
@@ -23,12 +49,17 @@ struct PipelineConfigInfo {
     std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineDynamicStateCreateInfo dynamicStateInfo;
     VkPipelineLayout pipelineLayout = nullptr;
-    VkRenderPass renderPass = nullptr;
-    uint32_t subpass = 0;
+    PipelineRenderTarget renderTarget;
+    // applied to every stage; a stage that does not declare an id ignores it.
+    // Kept sorted by constantId so equal configs hash equally.
+    std::vector<SpecializationConstant> specializationConstants;
+
+    void setSpecializationConstant(uint32_t constantId, uint32_t value);
 };
 
 class LvePipeline {
   public:
+    // An empty fragFilepath creates a vertex-only (depth-only) pipeline
     LvePipeline(LveDevice& device, const std::string& vertFilepath, const std::string& fragFilepath,
                 const PipelineConfigInfo& configInfo);
     ~LvePipeline();
@@ -38,19 +69,55 @@ class LvePipeline {
 
     void bind(VkCommandBuffer commandBuffer);
 
+    // small process-unique id, used in render queue sort keys
+    uint32_t getId() const { return id; }
+
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-  private:
+    // Depth pre-pass variants: the pre-pass writes depth with no colour
+    // attachments, the main pass tests EQUAL against it without writing
+    static void depthPrepassPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    static void depthEqualPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Shadow maps: depth only, biased by the slope so lit surfaces do not
+    // shadow themselves
+    static void shadowPipelineConfigInfo(PipelineConfigInfo& configInfo);
+
+    // A copy of the file's bytes, from a mounted LveArchive when one holds
+    // filepath; shader modules map their files instead
     static std::vector<char> readFile(const std::string& filepath);
 
+  private:
     void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath,
                                 const PipelineConfigInfo& configInfo);
 
-    void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+    void createShaderModule(const LveMappedFile& code, VkShaderModule* shaderModule);
+
+    // The LveModel::Vertex attributes the vertex shader reads; throws if it
+    // reads a location the model does not provide or in another format
+    static std::vector<VkVertexInputAttributeDescription> vertexAttributesFor(
+        const LveShaderReflection& vertexReflection);
 
     LveDevice& lveDevice;
+    uint32_t id;
     VkPipeline graphicsPipeline;
     VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+};
+
+class LveComputePipeline {
+  public:
+    LveComputePipeline(LveDevice& device, const std::string& compFilepath,
+                       VkPipelineLayout pipelineLayout);
+    ~LveComputePipeline();
+
+    LveComputePipeline(const LveComputePipeline&) = delete;
+    LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+  private:
+    LveDevice& lveDevice;
+    VkPipeline computePipeline;
+    VkShaderModule compShaderModule;
 };
 } // namespace lve
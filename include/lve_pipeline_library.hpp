@@ -0,0 +1,164 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_swapchain.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// Owns pipeline variants: shader pairs built with different fixed-function
+// state or specialization constants.
+//
+// add() registers a variant under a key hashed from its shader paths, its
+// config and its specialization constants; adding an identical variant again
+// returns the same key. Variants are compiled on worker threads through the
+// device's pipeline cache, either all up front (Mode::Startup, compileAll())
+// or the first time they are asked for (Mode::OnDemand).
+//
+// get() is lock-free and never waits: until a variant is built it returns
+// null and the caller draws with a pipeline it already has, so a variant
+// that is needed mid-frame costs a few frames of fallback, not a hitch.
+// rebuild() drops a variant back to that state after its shaders changed.
+class LvePipelineLibrary {
+public:
+  using Key = uint64_t;
+  static constexpr Key INVALID_KEY = 0;
+  // open addressing; lookups stay short while the table is under half full
+  static constexpr uint32_t CAPACITY = 512;
+  static constexpr uint32_t MAX_VARIANTS = CAPACITY / 2;
+
+  // Fills in a config for the variant. Runs once on the thread calling add()
+  // and again on a worker when the variant is compiled, so it may only read
+  // state that outlives the library's pending compiles (see waitIdle()).
+  // Variants are never removed and adding one again keeps the first
+  // function, so it should capture values rather than an owner that can
+  // be destroyed and made again.
+  using ConfigFunction = std::function<void(PipelineConfigInfo &)>;
+
+  enum class Mode {
+    Startup,  // compileAll() builds every variant before the first frame
+    OnDemand, // get() queues a variant the first time it is asked for
+  };
+
+  struct Stats {
+    uint32_t variants = 0;
+    uint32_t compiled = 0;
+    uint32_t pending = 0;
+    uint32_t failed = 0;
+    // get() calls that found the variant not yet built
+    uint64_t misses = 0;
+    double compileMilliseconds = 0.0; // summed over every worker
+  };
+
+  LvePipelineLibrary(LveDevice &device, Mode mode, uint32_t workerThreads = 0);
+  ~LvePipelineLibrary();
+
+  LvePipelineLibrary(const LvePipelineLibrary &) = delete;
+  LvePipelineLibrary &operator=(const LvePipelineLibrary &) = delete;
+
+  // Render thread only, or one startup task before the first frame. An
+  // empty fragFilepath is a depth-only variant.
+  Key add(const std::string &vertFilepath, const std::string &fragFilepath,
+          ConfigFunction configure);
+
+  // Compiles every variant that is not built yet across the workers and
+  // waits for them, printing the time taken. Meant for Mode::Startup, before
+  // the first frame.
+  void compileAll();
+  // Queues the variant now rather than at its first get()
+  void prefetch(Key key);
+  // Render thread. Builds the variant again from its shader files, for
+  // when a shader hot-reload rewrote them. get() returns null until the new
+  // pipeline is built; the old one lives until no frame can be using it.
+  void rebuild(Key key);
+
+  // Any thread, lock-free. Null while the variant is compiling or queued,
+  // if it failed to compile, or if key is unknown.
+  LvePipeline *get(Key key);
+
+  // Render thread, once frameIndex's fence has signalled: frees pipelines
+  // rebuild() replaced and hands variants get() asked for to the workers.
+  // Kept out of get() so lookups never take the pool's lock.
+  void beginFrame(int frameIndex);
+  // Blocks until no compile is running or queued
+  void waitIdle();
+
+  Mode getMode() const { return mode; }
+  Stats getStats() const;
+
+  // Hash of the shader paths and every config field that reaches
+  // vkCreateGraphicsPipelines, specialization constants included
+  static Key makeKey(const std::string &vertFilepath,
+                     const std::string &fragFilepath,
+                     const PipelineConfigInfo &configInfo);
+
+private:
+  enum State : uint32_t {
+    REGISTERED, // known, not asked for yet
+    REQUESTED,  // asked for by get(), waiting for beginFrame()
+    QUEUED,     // handed to a worker
+    READY,
+    FAILED,
+  };
+
+  struct Variant {
+    // INVALID_KEY while the slot is free; published last by add()
+    std::atomic<Key> key{INVALID_KEY};
+    std::atomic<uint32_t> state{REGISTERED};
+    std::atomic<LvePipeline *> pipeline{nullptr};
+    // rebuild() was called; cleared as a compile starts reading shaders
+    std::atomic<bool> stale{false};
+
+    // written before key is published, then only read
+    std::string vertFilepath;
+    std::string fragFilepath;
+    ConfigFunction configure;
+
+    // owned here, published through pipeline
+    std::unique_ptr<LvePipeline> owned;
+  };
+
+  Variant *find(Key key);
+  void submit(Variant &variant);
+  void compile(Variant &variant);
+  // queues a stale variant that is built or failed to build
+  void requeue(Variant &variant);
+
+  LveDevice &lveDevice;
+  Mode mode;
+
+  std::array<Variant, CAPACITY> variants{};
+  uint32_t variantCount = 0;
+
+  std::atomic<uint32_t> compiledCount{0};
+  std::atomic<uint32_t> failedCount{0};
+  std::atomic<uint32_t> pendingCount{0};
+  std::atomic<uint32_t> requestedCount{0};
+  std::atomic<uint64_t> missCount{0};
+  std::atomic<uint64_t> compileMicroseconds{0};
+
+  // old pipelines of rebuilt variants: retiring until the next
+  // beginFrame, then kept with that frame until its fence signals again
+  std::mutex retiringMutex;
+  std::vector<std::unique_ptr<LvePipeline>> retiring;
+  std::array<std::vector<std::unique_ptr<LvePipeline>>,
+             LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      retired{};
+
+  std::atomic<bool> shuttingDown{false};
+  // declared last so the workers are joined before the variants die
+  std::unique_ptr<LveThreadPool> workers;
+};
+
+} // namespace lve
@@ -0,0 +1,301 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_pipeline.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// The frame as a list of passes, each declaring the images and buffers it
+// reads and writes.
+//
+// compile() works out from those declarations what the passes need:
+// - passes whose results nothing uses are culled;
+// - a barrier goes in only where a pass needs another layout, or reads or
+//   overwrites what an earlier one wrote; reads after reads in the same
+//   layout are free, and a write after reads only waits on their stages;
+// - each raster pass gets its own VkRenderPass, with load and store ops
+//   chosen from whether the contents come from, or are used by, other
+//   passes;
+// - transient images, which the graph owns and which do not outlive the
+//   frame, share memory whenever the passes using them do not overlap;
+//   attachments whose contents are never stored, like multisampled ones
+//   that are resolved, go in lazily allocated memory where the device has
+//   it, so tilers need not back them at all.
+// execute() records the passes in the order they were added. dump() prints
+// all of it.
+//
+// Imported images and buffers are owned elsewhere: they are bound each frame
+// and declared with the state the frame finds them in and must leave them
+// in. Their contents outlive the frame, so passes writing them are kept.
+// Passes that only need to run on some frames, like ones refreshing a
+// cached image, take a condition; when it fails the pass is skipped but its
+// barriers are still recorded, so the layouts stay as planned and what it
+// would have written keeps its previous contents.
+//
+// Render passes only depend on formats, sample counts and load/store ops,
+// so resize() keeps them, and every pipeline built against them. With
+// dynamic rendering there are no render pass or framebuffer objects at all:
+// raster passes render straight into the bound image views, pipelines only
+// know the attachment formats, and resize() just makes new transient images.
+class LveRenderGraph {
+public:
+  using ResourceId = uint32_t;
+  using PassId = uint32_t;
+  using ExecuteFunction = std::function<void(FrameInfo &)>;
+
+  // An imported resource's layout, and the stages and accesses of the work
+  // outside the graph that used it last or will use it next
+  struct ResourceState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    VkAccessFlags access = 0;
+  };
+
+  struct ImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    // zero follows the graph's extent
+    VkExtent2D extent = {0, 0};
+  };
+
+  enum class Usage {
+    ColorAttachment,
+    DepthAttachment,
+    DepthReadOnly, // depth attachment tested against but not written
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    UniformRead, // buffers only
+    TransferSrc,
+    TransferDst,
+    // single-sample images written by resolving an attachment
+    ColorResolve,
+    DepthResolve,
+  };
+
+  class PassBuilder {
+  public:
+    // Attachments, bound in the order declared with the depth attachment
+    // last. Without a clear they keep what earlier passes wrote.
+    PassBuilder &color(ResourceId image);
+    PassBuilder &clearColor(ResourceId image, VkClearColorValue value);
+    PassBuilder &depth(ResourceId image);
+    PassBuilder &clearDepth(ResourceId image, float depth = 1.f);
+    PassBuilder &depthReadOnly(ResourceId image);
+    // Resolves the multisampled attachment source, declared before, into
+    // the single-sample target as the pass ends. Colour is averaged; depth
+    // uses depthMode, one of LveDevice::depthResolveModes, and needs dynamic
+    // rendering.
+    PassBuilder &resolve(
+        ResourceId source, ResourceId target,
+        VkResolveModeFlagBits depthMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT);
+
+    PassBuilder &sampled(ResourceId image, VkPipelineStageFlags stages);
+    PassBuilder &storageRead(ResourceId resource, VkPipelineStageFlags stages);
+    PassBuilder &storageWrite(ResourceId resource, VkPipelineStageFlags stages);
+    PassBuilder &uniformRead(ResourceId buffer, VkPipelineStageFlags stages);
+    PassBuilder &transferSrc(ResourceId resource);
+    PassBuilder &transferDst(ResourceId resource);
+
+    // never culled, for work with effects the graph cannot see
+    PassBuilder &sideEffects();
+    // asked each frame before the pass is recorded; a pass skipped leaves
+    // what it writes as it was, so this is meant for passes that only
+    // write imported resources
+    PassBuilder &condition(std::function<bool()> predicate);
+    // recorded between the pass's barriers and, for raster passes, inside
+    // its render pass with the viewport and scissor covering the attachments
+    PassBuilder &execute(ExecuteFunction function);
+
+    PassId id() const { return pass; }
+
+  private:
+    friend class LveRenderGraph;
+    PassBuilder(LveRenderGraph &graph, PassId pass)
+        : graph{graph}, pass{pass} {}
+    PassBuilder &use(ResourceId resource, Usage usage,
+                     VkPipelineStageFlags stages, const VkClearValue *clear);
+
+    LveRenderGraph &graph;
+    PassId pass;
+  };
+
+  struct Stats {
+    uint32_t passes = 0;
+    uint32_t culledPasses = 0;
+    // per frame, conditional passes whose condition failed
+    uint32_t skippedPasses = 0;
+    uint32_t renderPasses = 0;
+    // recorded per frame: image and buffer barriers, in vkCmdPipelineBarrier
+    // calls that batch each pass's barriers together
+    uint32_t barriers = 0;
+    uint32_t barrierBatches = 0;
+    uint32_t transientImages = 0;
+    uint32_t lazyImages = 0; // in lazily allocated memory
+    uint32_t memoryBlocks = 0;
+    // what the transient images would take each on their own, and what
+    // their shared blocks do
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize allocatedBytes = 0;
+  };
+
+  // useDynamicRendering needs LveDevice::dynamicRenderingSupported
+  explicit LveRenderGraph(LveDevice &device, bool useDynamicRendering = false);
+  ~LveRenderGraph();
+
+  LveRenderGraph(const LveRenderGraph &) = delete;
+  LveRenderGraph &operator=(const LveRenderGraph &) = delete;
+
+  // Resources and passes are declared before compile()
+  ResourceId createImage(std::string name, const ImageDesc &desc);
+  ResourceId importImage(std::string name, const ImageDesc &desc,
+                         ResourceState initialState, ResourceState finalState);
+  ResourceId importBuffer(std::string name, ResourceState initialState,
+                          ResourceState finalState);
+  PassBuilder addPass(std::string name);
+
+  void compile(VkExtent2D frameExtent);
+  // After the swap chain was recreated: transient images and framebuffers
+  // are made again for the new extent. Waits for the device to go idle.
+  void resize(VkExtent2D frameExtent);
+  VkExtent2D getExtent() const { return extent; }
+
+  // This frame's handles for imported resources, before execute()
+  void bindImage(ResourceId image, VkImage handle, VkImageView view);
+  void bindBuffer(ResourceId buffer, VkBuffer handle);
+  // for descriptors of passes that sample a transient image
+  VkImageView getImageView(ResourceId image) const;
+
+  // What pipelines drawing in a raster pass are built for: its render pass,
+  // or with dynamic rendering its attachment formats, and its sample count.
+  // Empty for culled and non-raster passes.
+  PipelineRenderTarget getRenderTarget(PassId pass) const;
+  bool usesDynamicRendering() const { return dynamicRendering; }
+  bool isCulled(PassId pass) const;
+
+  void execute(FrameInfo &frameInfo);
+
+  const Stats &getStats() const { return stats; }
+  // passes, the barriers before each, and which images share memory
+  void dump(std::ostream &out) const;
+
+private:
+  struct Use {
+    ResourceId resource;
+    Usage usage;
+    VkPipelineStageFlags stages;
+    bool clear = false;
+    VkClearValue clearValue{};
+    // resolves: the attachment resolved, and how
+    ResourceId resolveSource = 0;
+    VkResolveModeFlagBits resolveMode = VK_RESOLVE_MODE_NONE;
+    // compiled: an attachment's load and store ops
+    bool load = false;
+    bool store = false;
+  };
+
+  struct Barrier {
+    ResourceId resource;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkPipelineStageFlags srcStages;
+    VkAccessFlags srcAccess;
+    VkPipelineStageFlags dstStages;
+    VkAccessFlags dstAccess;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    ExecuteFunction function;
+    std::function<bool()> condition;
+    bool sideEffects = false;
+
+    bool culled = false;
+    std::vector<Barrier> barriers; // recorded before the pass
+    // indices into uses: colour attachments, then depth, and for each the
+    // use it is resolved into, if any
+    std::vector<size_t> attachments;
+    std::vector<size_t> resolves;
+    VkRenderPass renderPass = VK_NULL_HANDLE; // owned by renderPassCache
+    std::vector<VkClearValue> clearValues;
+    std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+    // with dynamic rendering, in attachment order; views are set each frame
+    std::vector<VkRenderingAttachmentInfo> renderingAttachments;
+  };
+
+  struct Resource {
+    std::string name;
+    bool isImage = true;
+    bool imported = false;
+    ImageDesc desc{};
+    ResourceState initialState{};
+    ResourceState finalState{};
+
+    // compiled; for transients, the live passes using them
+    VkImageUsageFlags usage = 0;
+    PassId firstPass = 0;
+    PassId lastPass = 0;
+    bool used = false;
+    // only ever an attachment that is not stored
+    bool lazy = false;
+    uint32_t block = 0;
+    VkDeviceSize size = 0;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+  };
+
+  // one allocation; the transient images in it never overlap in time
+  struct MemoryBlock {
+    VkMemoryRequirements requirements{};
+    VkMemoryPropertyFlags properties = 0;
+    std::vector<ResourceId> residents; // in order of first use
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+  };
+
+  void cullPasses();
+  void findLifetimes();
+  void createTransientImages();
+  void destroyTransientImages();
+  void planBarriers();
+  void createRenderPasses();
+  void destroyFramebuffers();
+  VkExtent2D imageExtent(const Resource &resource) const;
+  // of a raster pass, from its attachments
+  VkExtent2D passExtent(const Pass &pass) const;
+  VkFramebuffer getFramebuffer(Pass &pass);
+  void beginRendering(VkCommandBuffer commandBuffer, Pass &pass);
+  void recordBarriers(VkCommandBuffer commandBuffer,
+                      const std::vector<Barrier> &barriers);
+
+  LveDevice &lveDevice;
+  const bool dynamicRendering;
+  std::vector<Pass> passes;
+  std::vector<Resource> resources;
+  std::vector<MemoryBlock> blocks;
+  std::vector<Barrier> finalBarriers; // imported resources to their final state
+  // by attachment formats and ops; kept across resizes
+  std::map<std::vector<uint32_t>, VkRenderPass> renderPassCache;
+  VkExtent2D extent{};
+  bool compiled = false;
+  Stats stats{};
+
+  // reused every frame so recording does not allocate
+  std::vector<VkImageView> attachmentViews;
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+};
+
+} // namespace lve
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "lve_gameobject.hpp"
+#include "lve_linear_allocator.hpp"
+#include "lve_model.hpp"
+#include "lve_pipeline.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <cstdint>
+
+namespace lve {
+
+// Per-frame list of draws ordered by a packed 64-bit sort key:
+//
+//   63      56 55          44 43                24 23              0
+//   | pipeline |   material   |        mesh       |      depth      |
+//
+// Sorting by the key groups draws by pipeline, then material, then mesh, so
+// submit() can skip binds that would not change any state. Within a group
+// draws go front to back, which helps early depth rejection.
+class LveRenderQueue {
+public:
+  static constexpr uint32_t PIPELINE_BITS = 8;
+  static constexpr uint32_t MATERIAL_BITS = 12;
+  static constexpr uint32_t MESH_BITS = 20;
+  static constexpr uint32_t DEPTH_BITS = 24;
+
+  struct Draw {
+    LvePipeline *pipeline;
+    LveModel *model;
+    LveGameObject::id_t objectId;
+    // dynamic offset of the draw's per-object uniform data
+    uint32_t uniformOffset;
+    // slice of the caller's meshlet draw ranges; zero draws the whole model
+    uint32_t firstRange;
+    uint32_t rangeCount;
+  };
+
+  struct Stats {
+    uint32_t draws = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t pipelineBindsSkipped = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t vertexBufferBindsSkipped = 0;
+  };
+
+  // depth is post-projection depth in [0, 1]
+  static uint64_t makeKey(uint32_t pipelineId, uint32_t materialId,
+                          uint32_t meshId, float depth);
+
+  // Starts a new frame with room for maxDraws draws. The arrays live in
+  // allocator, which must not be reset until the queue has been submitted.
+  void begin(LveLinearAllocator &allocator, uint32_t maxDraws);
+  void push(uint64_t key, const Draw &draw);
+  void sort();
+
+  // Binds state and calls drawFn(commandBuffer, draw) for each draw in key
+  // order. pipelineOverride replaces every draw's pipeline, e.g. for a
+  // depth-only pass that reuses the sorted list.
+  template <typename DrawFn>
+  void submit(VkCommandBuffer commandBuffer, DrawFn &&drawFn,
+              LvePipeline *pipelineOverride = nullptr) {
+    LvePipeline *boundPipeline = nullptr;
+    LveModel *boundModel = nullptr;
+    for (uint32_t i = 0; i < count; i++) {
+      const Draw &draw = draws[order[i]];
+      LvePipeline *pipeline =
+          pipelineOverride != nullptr ? pipelineOverride : draw.pipeline;
+      if (pipeline != boundPipeline) {
+        pipeline->bind(commandBuffer);
+        boundPipeline = pipeline;
+        stats.pipelineBinds++;
+      } else {
+        stats.pipelineBindsSkipped++;
+      }
+      // vertex buffer bindings survive pipeline changes
+      if (draw.model != boundModel) {
+        draw.model->bind(commandBuffer);
+        boundModel = draw.model;
+        stats.vertexBufferBinds++;
+      } else {
+        stats.vertexBufferBindsSkipped++;
+      }
+      drawFn(commandBuffer, draw);
+      stats.draws++;
+    }
+  }
+
+  uint32_t size() const { return count; }
+
+  // accumulated over every submit() since the last resetStats()
+  const Stats &getStats() const { return stats; }
+  void resetStats() { stats = {}; }
+
+private:
+  Draw *draws = nullptr;
+  uint64_t *keys = nullptr;
+  uint32_t *order = nullptr;
+  uint64_t *scratchKeys = nullptr;
+  uint32_t *scratchOrder = nullptr;
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  Stats stats{};
+};
+
+} // namespace lve
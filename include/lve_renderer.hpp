@@ -7,6 +7,7 @@
 #include "vulkan/vulkan_core.h"
 
 // std
+#include <array>
 #include <cassert>
 #include <memory>
 #include <vector>
@@ -20,7 +21,9 @@ public:
   LveRenderer(const LveRenderer &) = delete;
   LveRenderer &operator=(const LveRenderer &) = delete;
 
-  VkRenderPass getRenderPass() const { return lveSwapChain->getRenderPass(); }
+  LveSwapChain &getSwapChain() const { return *lveSwapChain; }
+  // changes whenever the swap chain, and with it its images, is recreated
+  uint64_t getSwapChainGeneration() const { return swapChainGeneration; }
   float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); }
   bool isFrameInProgress() const { return isFrameStarted; }
   VkCommandBuffer getCurrentCommandBuffer() const {
@@ -29,6 +32,12 @@ public:
     return commandBuffers[currentFrameIndex];
   }
 
+  uint32_t getCurrentImageIndex() const {
+    assert(isFrameStarted &&
+           "Cannot get image index when frame is not in progress");
+    return currentImageIndex;
+  }
+
   int getCurrentFrameIndex() const {
     assert(isFrameStarted &&
            "Cannot get frame index when frame is not in progress");
@@ -38,13 +47,39 @@ public:
 
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-  void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+  // Around the frame's rendering, outside any render pass; they time it too
+  void beginStatisticsQuery(VkCommandBuffer commandBuffer);
+  void endStatisticsQuery(VkCommandBuffer commandBuffer);
+
+  // Orders the frame's submission against the transfer and compute queues.
+  // Work already submitted elsewhere is waited on; work that must wait on
+  // this frame is handed over as a follow-up, which endFrame() submits right
+  // after the frame and before the swap chain can be recreated. The
+  // follow-up's arrays must stay valid until then.
+  void addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stage);
+  void addSignalSemaphore(VkSemaphore semaphore);
+  void addFollowUpSubmit(VkQueue queue, const VkSubmitInfo &submitInfo,
+                         VkFence fence);
+
+  // Pipeline statistics of what ran between the statistics query calls,
+  // from the most recently completed frame. Zero when pipelineStatisticsQuery is unsupported.
+  bool hasPipelineStatistics() const { return statisticsQueryPool != VK_NULL_HANDLE; }
+  uint64_t getVertexShaderInvocations() const { return vertexInvocations; }
+  uint64_t getFragmentShaderInvocations() const { return fragmentInvocations; }
+  // GPU time between the same calls, from timestamps, in milliseconds. Zero
+  // when the graphics queue cannot write timestamps.
+  bool hasGpuTimestamps() const { return timestampQueryPool != VK_NULL_HANDLE; }
+  double getGpuMilliseconds() const { return gpuMilliseconds; }
 
 private:
   void createCommandBuffers();
   void freeCommandBuffers();
   void recreateSwapChain();
+  void createStatisticsQueryPool();
+  void readStatistics();
+  void createTimestampQueryPool();
+  void readTimestamps();
 
   LveWindow &lveWindow;
   LveDevice &lveDevice;
@@ -54,5 +89,25 @@ private:
   uint32_t currentImageIndex{};
   int currentFrameIndex{0};
   bool isFrameStarted{false};
+  uint64_t swapChainGeneration{0};
+
+  struct FollowUpSubmit {
+    VkQueue queue;
+    VkSubmitInfo submitInfo;
+    VkFence fence;
+  };
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages;
+  std::vector<VkSemaphore> signalSemaphores;
+  std::vector<FollowUpSubmit> followUpSubmits;
+
+  VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+  std::array<bool, LveSwapChain::MAX_FRAMES_IN_FLIGHT> statisticsPending{};
+  uint64_t vertexInvocations{0};
+  uint64_t fragmentInvocations{0};
+
+  VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+  std::array<bool, LveSwapChain::MAX_FRAMES_IN_FLIGHT> timestampsPending{};
+  double gpuMilliseconds{0};
 };
 } // namespace lve
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_swapchain.hpp"
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace lve {
+
+// Persistently mapped uniform/storage buffer, one per frame in flight.
+//
+// Per-frame shader data is sub-allocated by bumping an offset that is
+// aligned for use as a dynamic uniform or storage buffer offset, so one
+// descriptor set per frame covers every allocation. beginFrame(i) rewinds
+// frame i once its fence has signalled. If a frame runs out of space the
+// failed allocations are counted and the buffer for that frame index is
+// doubled the next time it begins; callers must then rewrite descriptors
+// that point at it (see getGeneration). With TRANSFER_SRC usage the same
+// ring serves as a per-frame staging buffer for uploads.
+class LveRingBuffer {
+public:
+  struct Allocation {
+    void *data;
+    uint32_t offset; // dynamic offset into getBuffer(frameIndex)
+  };
+
+  LveRingBuffer(LveDevice &device, VkDeviceSize frameCapacity,
+                VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  ~LveRingBuffer();
+
+  LveRingBuffer(const LveRingBuffer &) = delete;
+  LveRingBuffer &operator=(const LveRingBuffer &) = delete;
+
+  void beginFrame(int frameIndex);
+
+  // False when the current frame is full
+  bool allocate(VkDeviceSize size, Allocation &allocation);
+
+  template <typename T> bool write(const T &value, uint32_t &offset) {
+    Allocation allocation{};
+    if (!allocate(sizeof(T), allocation)) {
+      return false;
+    }
+    std::memcpy(allocation.data, &value, sizeof(T));
+    offset = allocation.offset;
+    return true;
+  }
+
+  VkBuffer getBuffer(int frameIndex) const { return frames[frameIndex].buffer; }
+  // bumped whenever frameIndex's buffer is replaced
+  uint32_t getGeneration(int frameIndex) const {
+    return frames[frameIndex].generation;
+  }
+  VkDeviceSize getAlignment() const { return alignment; }
+
+  VkDeviceSize bytesUsed() const { return frames[currentFrame].offset; }
+  VkDeviceSize capacity() const { return frames[currentFrame].capacity; }
+  uint32_t failedAllocations() const {
+    return frames[currentFrame].failedAllocations;
+  }
+
+private:
+  struct Frame {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    std::byte *mapped = nullptr;
+    VkDeviceSize capacity = 0;
+    VkDeviceSize offset = 0;
+    uint32_t failedAllocations = 0;
+    uint32_t generation = 0;
+  };
+
+  void createFrameBuffer(Frame &frame, VkDeviceSize capacity);
+  void destroyFrameBuffer(Frame &frame);
+
+  LveDevice &lveDevice;
+  VkBufferUsageFlags usage;
+  VkDeviceSize alignment;
+  std::array<Frame, LveSwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+  int currentFrame = 0;
+};
+
+} // namespace lve
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "lve_pipeline.hpp"
+#include "lve_swapchain.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Rebuilds pipelines when their GLSL sources change on disk.
+//
+// Changes are picked up with inotify on Linux and by polling modification
+// times elsewhere. Changed sources are compiled with libshaderc on a worker
+// thread and written next to the source as <source>.spv, as the Makefile
+// would, then the watch's factory builds the replacement pipelines on the
+// same worker through the device's pipeline cache. beginFrame swaps all of a
+// watch's pipelines in at once, so pipelines that must agree (a depth
+// pre-pass and its EQUAL-tested colour pass) never run different shaders,
+// and destroys the ones they replaced once every frame that could have
+// bound them has retired. On a compile or link error the message is printed
+// and the running pipelines are kept.
+//
+// Watched sources' SPIR-V is read from disk from then on, past any mounted
+// LveArchive, which would only hold the version packed at build time.
+// Pipelines built before the watch must read it from disk too, so callers
+// mark those paths with LveArchive::readLoose before loading any of them.
+//
+// Without LVE_SHADERC (see the Makefile) isSupported() is false and
+// nothing is ever rebuilt.
+class LveShaderHotReload {
+public:
+  using WatchId = uint32_t;
+  using Pipelines = std::vector<std::unique_ptr<LvePipeline>>;
+  // Runs on the worker: may only use thread-safe Vulkan entry points and
+  // state that does not change while the watch exists. Returns a pipeline
+  // for each one watched, in the same order.
+  using PipelineFactory = std::function<Pipelines()>;
+  // Runs in beginFrame once a watch's pipelines were swapped in
+  using ReloadCallback = std::function<void()>;
+
+  explicit LveShaderHotReload(std::string shaderDirectory = "shaders");
+  ~LveShaderHotReload();
+
+  LveShaderHotReload(const LveShaderHotReload &) = delete;
+  LveShaderHotReload &operator=(const LveShaderHotReload &) = delete;
+
+  static bool isSupported();
+
+  // Replaces pipelines with factory() whenever one of sources changes.
+  // Sources are GLSL paths inside the shader directory, e.g.
+  // "shaders/simple_shader.vert". pipelines must outlive the watch.
+  WatchId watch(std::vector<std::unique_ptr<LvePipeline> *> pipelines,
+                std::vector<std::string> sources, PipelineFactory factory,
+                ReloadCallback reloaded = nullptr);
+  // Waits for a rebuild of this watch that is already running and drops it
+  void unwatch(WatchId id);
+
+  // Call once frameIndex's fence has signalled: frees replaced pipelines,
+  // starts rebuilds for changed sources and swaps in finished ones
+  void beginFrame(int frameIndex);
+
+  const std::string &getShaderDirectory() const { return shaderDirectory; }
+  uint32_t getReloadCount() const { return reloads; }
+
+private:
+  struct Watch {
+    std::vector<std::unique_ptr<LvePipeline> *> pipelines;
+    std::vector<std::string> sources;
+    PipelineFactory factory;
+    ReloadCallback reloaded;
+    // sources changed since the last rebuild started
+    std::vector<std::string> changed;
+    bool building = false;
+  };
+
+  // produced on the worker, consumed by beginFrame()
+  struct Rebuilt {
+    WatchId id;
+    Pipelines pipelines; // empty on failure
+    std::string error;
+  };
+
+  std::vector<std::string> pollChangedFiles();
+  void startRebuilds();
+  static void compileToSpirv(const std::string &source);
+
+  std::string shaderDirectory;
+  std::unordered_map<WatchId, Watch> watches;
+  WatchId nextWatchId = 0;
+  std::array<std::vector<std::unique_ptr<LvePipeline>>,
+             LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      retired{};
+  uint32_t reloads = 0;
+
+  // inotify instance on Linux; -1 selects the polling fallback
+  int notifyFd = -1;
+  std::unordered_map<std::string, std::filesystem::file_time_type>
+      modificationTimes;
+  std::chrono::steady_clock::time_point lastPoll{};
+
+  // shared with the worker
+  std::mutex rebuiltMutex;
+  std::vector<Rebuilt> rebuilt;
+  std::atomic<bool> shuttingDown{false};
+  // declared last so the worker is joined before anything it touches dies
+  std::unique_ptr<LveThreadPool> worker;
+};
+
+} // namespace lve
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// The interface of one or more SPIR-V modules: the descriptors they bind,
+// the push constant block they read and, for a vertex shader, the
+// attributes it consumes.
+//
+// reflect() walks the module's declarations only (decorations, types and
+// global variables), so it is cheap enough to run on every module load.
+// Stages are combined with merge(); a binding declared by several stages
+// must agree on its type and gets every stage's flag.
+struct LveShaderReflection {
+  struct DescriptorBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count; // 0 for a runtime-sized array
+    VkShaderStageFlags stages;
+  };
+
+  struct VertexInput {
+    uint32_t location;
+    VkFormat format;
+  };
+
+  VkShaderStageFlags stages = 0;
+  std::vector<DescriptorBinding> bindings; // sorted by set, then binding
+  // one block per stage; 0 when no stage declares push constants
+  uint32_t pushConstantSize = 0;
+  VkShaderStageFlags pushConstantStages = 0;
+  std::vector<VertexInput> vertexInputs; // sorted by location
+
+  // Throws on a module that is not valid SPIR-V or uses an interface type
+  // this parser does not understand. code needs 4-byte alignment.
+  static LveShaderReflection reflect(const uint32_t *code, size_t codeSize);
+  static LveShaderReflection reflect(const std::vector<char> &code);
+  // Maps and merges the modules at filepaths (empty paths are skipped)
+  static LveShaderReflection reflectFiles(
+      const std::vector<std::string> &filepaths);
+
+  void merge(const LveShaderReflection &other);
+
+  // The engine binds uniform buffers with dynamic offsets into its ring
+  // buffers; reflection cannot tell the two apart
+  void useDynamicUniformBuffers();
+
+  uint32_t setCount() const; // highest set used + 1
+  std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings(
+      uint32_t set) const;
+  std::vector<VkPushConstantRange> pushConstantRanges() const;
+};
+
+} // namespace lve
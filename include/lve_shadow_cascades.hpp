@@ -0,0 +1,185 @@
+#pragma once
+
+#include "lve_bvh.hpp"
+#include "lve_camera.hpp"
+#include "lve_device.hpp"
+#include "lve_gameobject.hpp"
+#include "vulkan/vulkan_core.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Cascaded shadow maps for one directional light.
+//
+// The camera's view, up to Config::shadowDistance, is cut into CASCADE_COUNT
+// slices, spaced between uniform and logarithmic by splitLambda. Each slice
+// gets its own depth map, rendered from the light with an orthographic
+// projection fitted around the slice's bounding sphere. A sphere does not
+// change size as the camera turns, and the projection is snapped to whole
+// texels, so shadow edges stay put while the camera moves. Its near plane is
+// pulled back to the scene's bounds, so casters between the light and the
+// slice are still drawn. Each cascade only draws the objects the BVH finds
+// in its box.
+//
+// From FIRST_CACHED_CASCADE on, the cascades cover enough ground that the
+// camera rarely leaves them. Their box is fitted with a margin and kept
+// while the slice's sphere stays inside it and the light turns less than a
+// threshold. Static objects are rendered into a separate cache image only
+// when the box is refitted; every frame the cache is copied into the map
+// when dynamic objects were drawn over it, and the dynamic objects are drawn
+// on top again. A frame with a still light and only static objects in view
+// renders nothing at all into these cascades.
+class LveShadowCascades {
+public:
+  static constexpr uint32_t CASCADE_COUNT = 4;
+  // this one and those after keep their static casters cached
+  static constexpr uint32_t FIRST_CACHED_CASCADE = 2;
+  static constexpr uint32_t RESOLUTION = 1024;
+
+  struct Config {
+    // view depth shadows end at, or the far plane if nearer
+    float shadowDistance = 10.f;
+    // 0 spaces the splits uniformly, 1 logarithmically
+    float splitLambda = .8f;
+    // how far past the slice's sphere, relative to its radius, a cached
+    // cascade is fitted
+    float cacheMargin = .15f;
+    // radians the light can turn before cached cascades are refitted
+    float lightAngleThreshold = .005f;
+  };
+
+  // std140, part of GlobalUbo in simple_shader.frag
+  struct ShaderParams {
+    glm::mat4 lightProjectionViews[CASCADE_COUNT]{};
+    glm::vec4 splitDepths{}; // view depth each cascade ends at
+    glm::vec4 texelSizes{};  // world units, for the normal offset
+  };
+  static_assert(CASCADE_COUNT == 4, "ShaderParams packs cascades in vec4s");
+
+  struct Cascade {
+    glm::mat4 lightProjectionView{1.f};
+    // drawn into the map this frame: every caster in the box for near
+    // cascades, the dynamic ones for cached cascades
+    std::vector<LveGameObject::id_t> casters;
+    // cached cascades: the static casters, drawn into the cache when
+    // renderCache is set
+    std::vector<LveGameObject::id_t> cacheCasters;
+    bool cached = false;
+    // what this frame's passes of a cached cascade do: render the cache,
+    // copy it into the map, draw casters over it
+    bool renderCache = false;
+    bool copyCache = false;
+    bool drawCasters = false;
+  };
+
+  struct Stats {
+    // per frame
+    uint32_t casterDraws = 0;
+    uint32_t cacheUpdates = 0;
+    // since startup
+    uint32_t totalCacheUpdates = 0;
+  };
+
+  LveShadowCascades(LveDevice &device, const Config &config);
+  ~LveShadowCascades();
+
+  LveShadowCascades(const LveShadowCascades &) = delete;
+  LveShadowCascades &operator=(const LveShadowCascades &) = delete;
+
+  // Fits the cascades to the camera's perspective projection and culls
+  // their casters. direction is the way the light travels.
+  void update(const LveCamera &camera, const glm::vec3 &direction,
+              const LveBvh &sceneBvh, const LveGameObject::Map &gameObjects);
+
+  // Renders a cached cascade's static casters again next frame, for
+  // when a cache pass could not draw everything
+  void invalidate(uint32_t cascade);
+  // all of them, after static objects were added, removed or moved
+  void invalidateCache();
+
+  // Copies the cache into the map, in TRANSFER_SRC_OPTIMAL and
+  // TRANSFER_DST_OPTIMAL
+  void recordCacheCopy(VkCommandBuffer commandBuffer, uint32_t cascade) const;
+
+  const Cascade &getCascade(uint32_t cascade) const {
+    return cascades[cascade];
+  }
+  const ShaderParams &getShaderParams() const { return params; }
+  // normalized, as of the last update()
+  const glm::vec3 &getLightDirection() const { return lightDirection; }
+  const Stats &getStats() const { return stats; }
+
+  // The maps start, and are left by every frame, in
+  // DEPTH_STENCIL_READ_ONLY_OPTIMAL; the caches in TRANSFER_SRC_OPTIMAL
+  VkFormat getFormat() const { return format; }
+  VkImage getImage(uint32_t cascade) const { return maps[cascade].image; }
+  VkImageView getImageView(uint32_t cascade) const {
+    return maps[cascade].view;
+  }
+  // null for cascades that are not cached
+  VkImage getCacheImage(uint32_t cascade) const {
+    return caches[cascade].image;
+  }
+  VkImageView getCacheImageView(uint32_t cascade) const {
+    return caches[cascade].view;
+  }
+  // compares with LESS_OR_EQUAL, filtered where the format allows it;
+  // outside the maps everything is lit
+  VkSampler getSampler() const { return sampler; }
+
+private:
+  struct DepthImage {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+  };
+
+  // a cached cascade's box, in the light space it was fitted in
+  struct CacheFit {
+    glm::mat4 lightView{1.f};
+    glm::vec3 lightDirection{};
+    glm::vec3 boxMin{};
+    glm::vec3 boxMax{};
+    bool valid = false;
+    bool dirty = true;
+    // the map holds casters drawn over the cache
+    bool mapHasCasters = false;
+  };
+
+  void createImages();
+  DepthImage createDepthImage(VkImageUsageFlags usage) const;
+  void createSampler();
+  // A box around the sphere in light space, snapped to texels, from the
+  // scene's nearest point towards the light to the back of the sphere
+  void fitBox(const glm::vec3 &center, float radius, float sceneNear,
+              glm::vec3 &boxMin, glm::vec3 &boxMax) const;
+  glm::mat4 lightProjection(const glm::vec3 &boxMin,
+                            const glm::vec3 &boxMax) const;
+
+  LveDevice &lveDevice;
+  Config config;
+
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::array<DepthImage, CASCADE_COUNT> maps{};
+  std::array<DepthImage, CASCADE_COUNT> caches{};
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  std::array<Cascade, CASCADE_COUNT> cascades{};
+  std::array<CacheFit, CASCADE_COUNT> fits{};
+  ShaderParams params{};
+  glm::vec3 lightDirection{0.f, 1.f, 0.f};
+  Stats stats{};
+
+  // reused every frame so culling does not allocate
+  std::vector<LveGameObject::id_t> query;
+};
+
+} // namespace lve
@@ -25,9 +25,12 @@ class LveSwapChain {
     LveSwapChain(const LveSwapChain&) = delete;
     LveSwapChain& operator=(const LveSwapChain&) = delete;
 
-    VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
-    VkRenderPass getRenderPass() { return renderPass; }
+    // The images are drawn to by the render graph, which owns the render
+    // passes and framebuffers
+    VkImage getImage(int index) { return swapChainImages[index]; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+    VkImage getDepthImage(int index) { return depthImages[index]; }
+    VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
     size_t imageCount() { return swapChainImages.size(); }
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -41,7 +44,12 @@ class LveSwapChain {
     VkFormat findDepthFormat();
 
     VkResult acquireNextImage(uint32_t* imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+    // Besides the swap chain's own semaphores, the submission can wait on
+    // and signal others, to order it against the transfer and compute queues
+    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+                                  const std::vector<VkSemaphore>& waitSemaphores = {},
+                                  const std::vector<VkPipelineStageFlags>& waitStages = {},
+                                  const std::vector<VkSemaphore>& signalSemaphores = {});
 
     bool compareSwapChainFormats(const LveSwapChain& swapChain) const {
         return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -53,8 +61,6 @@ class LveSwapChain {
     void createSwapChain();
     void createImageViews();
     void createDepthResources();
-    void createRenderPass();
-    void createFramebuffers();
     void createSyncObjects();
 
     // Helper functions
@@ -68,9 +74,6 @@ class LveSwapChain {
     VkFormat swapChainDepthFormat;
     VkExtent2D swapChainExtent;
 
-    std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkRenderPass renderPass;
-
     std::vector<VkImage> depthImages;
     std::vector<VkDeviceMemory> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// A one-shot graph of named tasks, each run once every task it depends on
+// has finished.
+//
+// Worker tasks run on an LveThreadPool; main thread tasks run on the thread
+// that calls run(), for work that touches GLFW, a queue, or state nothing
+// else locks. A task that throws stops the tasks depending on it, directly
+// or not, from running; run() waits for everything else to finish and then
+// rethrows the first exception. Timings are kept for report().
+class LveTaskGraph {
+public:
+  using TaskId = uint32_t;
+
+  enum class Affinity { Worker, Main };
+
+  struct Timing {
+    std::string name;
+    Affinity affinity;
+    bool ran; // false when skipped after a failure
+    double startMilliseconds; // from the start of run()
+    double endMilliseconds;
+  };
+
+  LveTaskGraph() = default;
+
+  LveTaskGraph(const LveTaskGraph &) = delete;
+  LveTaskGraph &operator=(const LveTaskGraph &) = delete;
+
+  // Dependencies must already be in the graph, so it cannot have cycles
+  TaskId add(std::string name, std::function<void()> work,
+             std::vector<TaskId> dependencies = {},
+             Affinity affinity = Affinity::Worker);
+
+  // Runs every task and returns once all of them are done. Call once.
+  void run(LveThreadPool &pool);
+
+  double getMilliseconds() const { return milliseconds; }
+  const std::vector<Timing> &getTimings() const { return timings; }
+  // Prints each task's span and the longest chain of dependent tasks, the
+  // part that more threads cannot shorten
+  void report() const;
+
+private:
+  struct Task {
+    std::function<void()> work;
+    std::vector<TaskId> dependents;
+    uint32_t dependencyCount = 0;
+    Affinity affinity = Affinity::Worker;
+  };
+
+  std::vector<Task> tasks;
+  std::vector<std::vector<TaskId>> taskDependencies; // for report()
+  std::vector<Timing> timings;
+  double milliseconds = 0.0;
+  bool hasRun = false;
+};
+
+} // namespace lve
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "lve_bindless.hpp"
+#include "lve_bounds.hpp"
+#include "lve_compressed_image.hpp"
+#include "lve_device.hpp"
+#include "lve_image.hpp"
+#include "lve_mapped_file.hpp"
+#include "lve_renderer.hpp"
+#include "lve_ring_buffer.hpp"
+#include "lve_swapchain.hpp"
+#include "lve_thread_pool.hpp"
+#include "vulkan/vulkan_core.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+// Streams textures in at the resolution visible objects need, within a
+// fixed VRAM budget.
+//
+// load() only registers a file. Each frame the caller request()s the mip
+// level every visible textured object needs; textures that are not yet
+// resident that finely are decoded on worker threads, downsampled to the
+// requested level and copied through a per-frame staging ring. The rest of
+// the chain is generated on the GPU with blits (or on the worker when the
+// format cannot be blitted). A finer request replaces the resident image
+// with a larger one. When the budget is exceeded, the textures requested
+// least recently are evicted, as they are when the device reports memory
+// pressure on a device-local heap. When an allocation on the render thread
+// fails, idle textures are evicted and freed on the spot so it can retry.
+// Until a texture is resident its view is a 1x1 white fallback.
+//
+// DDS and KTX2 files holding BC1-BC7 are copied to the GPU as stored, mips
+// included, when the device samples that format. Otherwise the worker
+// decompresses them to RGBA8 and they stream like any other image.
+// Files are memory mapped, and native levels are copied from the mapping
+// straight into staging.
+//
+// With a dedicated transfer queue the copies are submitted there and run
+// alongside rendering; the frame waits for them, takes the images over and
+// generates their mips. Otherwise everything is recorded into the frame.
+class LveTextureStreamer {
+public:
+  using TextureId = uint32_t;
+  static constexpr TextureId INVALID_TEXTURE = ~0u;
+
+  struct Config {
+    VkDeviceSize budgetBytes = 256ull * 1024 * 1024;
+    VkDeviceSize stagingBytesPerFrame = 16ull * 1024 * 1024;
+    uint32_t workerThreads = 0; // 0: one less than the core count
+    // textures requested within this many frames are never evicted
+    uint32_t minIdleFramesBeforeEviction = 2;
+    // read files into the page cache in the background as they are loaded
+    bool prefetchFiles = true;
+  };
+
+  struct Stats {
+    VkDeviceSize residentBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+    uint32_t residentTextures = 0;
+    uint32_t pendingDecodes = 0;
+    uint32_t uploadsLastFrame = 0;
+    VkDeviceSize stagedBytesLastFrame = 0;
+    uint64_t evictions = 0;
+    // of those, evictions asked for by the device's memory pressure callback
+    uint64_t pressureEvictions = 0;
+    uint64_t prefetchedBytes = 0;
+    bool transferQueueUploads = false;
+  };
+
+  LveTextureStreamer(LveDevice &device, const Config &config,
+                     LveBindlessTable *bindlessTable = nullptr);
+  explicit LveTextureStreamer(LveDevice &device)
+      : LveTextureStreamer(device, Config{}) {}
+  ~LveTextureStreamer();
+
+  LveTextureStreamer(const LveTextureStreamer &) = delete;
+  LveTextureStreamer &operator=(const LveTextureStreamer &) = delete;
+
+  // Registers an image file (see LveImageLoader and LveCompressedImage);
+  // nothing is decoded until the texture is first requested
+  TextureId load(const std::string &filepath);
+
+  // Marks the texture as used this frame and asks for mip levels down to
+  // mipLevel (0 is full resolution) to be resident
+  void request(TextureId id, uint32_t mipLevel);
+  // Requests the mip that gives about one texel per pixel for bounds seen
+  // from cameraPosition. projectionScaleY is projection[1][1].
+  void requestForBounds(TextureId id, const LveAabb &worldBounds,
+                        const glm::vec3 &cameraPosition, float projectionScaleY,
+                        float viewportHeight);
+
+  // Call once frameIndex's fence has signalled: frees images replaced or
+  // evicted while that frame was recorded and rewinds its staging memory
+  void beginFrame(int frameIndex);
+  // Starts decodes for this frame's requests and records finished uploads
+  // into commandBuffer, which must be outside a render pass. Copies on the
+  // transfer queue are submitted here and the frame is made to wait on them.
+  void update(VkCommandBuffer commandBuffer, LveRenderer &renderer);
+
+  // Fallback view while the texture is not resident
+  VkImageView getImageView(TextureId id) const;
+  VkSampler getSampler() const { return sampler; }
+  // LveBindlessTable::INVALID_INDEX without a table
+  uint32_t getBindlessIndex(TextureId id) const;
+  // Finest resident mip relative to the full resolution image, or
+  // NOT_RESIDENT
+  static constexpr uint32_t NOT_RESIDENT = ~0u;
+  uint32_t getResidentMip(TextureId id) const;
+
+  Stats getStats() const;
+
+  // about one texel per screen pixel along the texture's longest edge
+  static uint32_t mipForCoverage(uint32_t textureSize, float screenPixels);
+
+private:
+  struct Texture {
+    std::string filepath;
+    // unknown until the first decode finishes
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 0;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDeviceSize residentBytes = 0;
+    uint32_t residentMip = NOT_RESIDENT;
+    uint32_t bindlessIndex = LveBindlessTable::INVALID_INDEX;
+
+    uint32_t wantedMip = NOT_RESIDENT; // finest mip requested this frame
+    // largest screen coverage requested while the size is still unknown
+    float wantedCoverage = 0.f;
+    // finer mips did not fit the budget; stale once anything is evicted
+    uint32_t budgetMip = 0;
+    uint64_t budgetEpoch = 0;
+    uint64_t lastRequestedFrame = 0;
+    bool decodeInFlight = false;
+    bool failed = false;
+  };
+
+  // produced on a worker, consumed by update()
+  struct DecodedTexture {
+    TextureId id;
+    uint32_t baseWidth;
+    uint32_t baseHeight;
+    uint32_t mip; // level of levels[0] in the full chain
+    // RGBA8, or a block format whose levels hold the raw blocks
+    VkFormat format;
+    std::vector<LveImageData> levels;
+    std::string error;
+    // native block uploads: levels hold only the extents, and the blocks
+    // are copied from the mapped file, starting at level firstFileLevel
+    std::unique_ptr<LveCompressedImage> blocks;
+    uint32_t firstFileLevel = 0;
+
+    size_t levelBytes(size_t level) const;
+    const void *levelData(size_t level) const;
+  };
+
+  struct RetiredImage {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+  };
+
+  void createSampler();
+  void createFallbackTexture();
+  void createTransferCommands();
+  VkCommandBuffer beginTransferCommands();
+  void markRequested(TextureId id);
+  void startDecode(TextureId id, uint32_t mip, float coveragePixels);
+  void decodeCompressed(const std::string &filepath, uint32_t mip,
+                        float coveragePixels, DecodedTexture &result) const;
+  void createImage(VkFormat format, uint32_t width, uint32_t height,
+                   uint32_t mipLevels, VkImage &image, VkDeviceMemory &memory,
+                   VkImageView &view);
+  bool upload(VkCommandBuffer commandBuffer, DecodedTexture &decoded);
+  void recordMipChain(VkCommandBuffer commandBuffer, VkImage image,
+                      const DecodedTexture &decoded, uint32_t levelCount);
+  bool makeRoom(VkDeviceSize bytes, TextureId keep);
+  // evicts idle textures, least recently requested first, until bytes are
+  // freed or none are left; returns the bytes freed
+  VkDeviceSize evictLeastRecent(VkDeviceSize bytes, TextureId keep);
+  void evict(Texture &texture);
+  void retire(Texture &texture);
+  void destroyRetired(std::vector<RetiredImage> &images);
+
+  LveDevice &lveDevice;
+  Config config;
+  LveBindlessTable *bindlessTable;
+  bool gpuMipGeneration = false;
+  // BC formats the device samples directly; read by the workers
+  std::vector<VkFormat> nativeBlockFormats;
+
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkImage fallbackImage = VK_NULL_HANDLE;
+  VkDeviceMemory fallbackMemory = VK_NULL_HANDLE;
+  VkImageView fallbackView = VK_NULL_HANDLE;
+  uint32_t fallbackBindlessIndex = LveBindlessTable::INVALID_INDEX;
+
+  std::vector<Texture> textures;
+  std::vector<TextureId> requested; // this frame, deduplicated
+  std::vector<DecodedTexture> readyForUpload;
+  LveRingBuffer staging;
+  std::array<std::vector<RetiredImage>, LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      retired{};
+  int currentFrame = 0;
+  uint64_t frameNumber = 0;
+
+  VkDeviceSize residentBytes = 0;
+  uint32_t residentTextures = 0;
+  uint32_t uploadsLastFrame = 0;
+  VkDeviceSize stagedBytesLastFrame = 0;
+  uint64_t evictions = 0;
+  uint64_t pressureEvictions = 0;
+  uint64_t budgetEpoch = 0;
+  uint32_t pressureCallback = 0;
+  // the thread that created the streamer and makes every other call
+  std::thread::id renderThread = std::this_thread::get_id();
+  // kept out of eviction while its image is being allocated
+  TextureId uploading = INVALID_TEXTURE;
+  std::unique_ptr<LveFilePrefetcher> prefetcher;
+
+  // copies on the dedicated transfer queue, per frame in flight
+  bool transferQueueUploads = false;
+  std::array<VkCommandBuffer, LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      transferCommandBuffers{};
+  std::array<VkSemaphore, LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+      transferSemaphores{};
+  bool transferRecording = false;
+
+  // shared with the workers
+  std::mutex decodedMutex;
+  std::vector<DecodedTexture> decoded;
+  std::atomic<uint32_t> pendingDecodes{0};
+  std::atomic<bool> shuttingDown{false};
+  // declared last so workers are joined before anything they touch dies
+  std::unique_ptr<LveThreadPool> workers;
+};
+
+} // namespace lve
@@ -0,0 +1,46 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+// Fixed set of worker threads draining a FIFO of jobs.
+//
+// Jobs must not throw; catch and record failures inside the job. The
+// destructor finishes every queued job before joining the workers.
+class LveThreadPool {
+public:
+  // 0 picks hardware_concurrency() - 1, leaving a core for the render thread
+  explicit LveThreadPool(uint32_t threadCount = 0);
+  ~LveThreadPool();
+
+  LveThreadPool(const LveThreadPool &) = delete;
+  LveThreadPool &operator=(const LveThreadPool &) = delete;
+
+  void submit(std::function<void()> job);
+  // blocks until the queue is empty and no job is running
+  void waitIdle();
+
+  uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+  uint32_t pendingJobs() const;
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  mutable std::mutex mutex;
+  std::condition_variable jobAvailable;
+  std::condition_variable idle;
+  uint32_t activeJobs = 0;
+  bool stopping = false;
+};
+
+} // namespace lve
@@ -1,34 +1,169 @@
 #pragma once
 
+#include "lve_bindless.hpp"
 #include "lve_camera.hpp"
+#include "lve_clustered_lights.hpp"
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
+#include "lve_frame_info.hpp"
 #include "lve_gameobject.hpp"
+#include "lve_meshlet.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_library.hpp"
+#include "lve_render_queue.hpp"
+#include "lve_ring_buffer.hpp"
+#include "lve_shader_hot_reload.hpp"
+#include "lve_shadow_cascades.hpp"
+#include "lve_swapchain.hpp"
 #include "vulkan/vulkan_core.h"
 
 // std
+#include <array>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve {
 class SimpleRenderSystem {
 public:
-  SimpleRenderSystem(LveDevice &device, VkRenderPass renderPass);
+  // VIEW_MODE specialization constant of simple_shader.frag; LightCount
+  // shows how many lights each froxel holds, Cascades tints each shadow
+  // cascade
+  enum class ViewMode : uint32_t { Shaded, Depth, LightCount, Cascades, Count };
+
+  // target is what the main pass draws into. With a depthPrepassTarget
+  // depth is laid down in that pass first, and the main pass only tests
+  // against it
+  // Per-frame shader data is sub-allocated from uniformRing, which the
+  // caller rewinds with beginFrame once the frame's fence has signalled
+  // Fragments are lit by the point lights clusteredLights binned for the
+  // frame, and by the directional light shadowCascades was fitted for;
+  // the caller updates both before rendering. shadowTarget is what the
+  // shadow passes draw into.
+  // With a bindlessTable objects read their data through it, selected by
+  // push constants, instead of binding a descriptor set per draw
+  // With a hotReload the pipelines are rebuilt when their GLSL changes
+  // With a pipelineLibrary the debug view modes are registered in it as
+  // variants; without one only ViewMode::Shaded is drawn
+  SimpleRenderSystem(LveDevice &device, const PipelineRenderTarget &target,
+                     LveRingBuffer &uniformRing,
+                     LveClusteredLights &clusteredLights,
+                     LveShadowCascades &shadowCascades,
+                     const PipelineRenderTarget &shadowTarget,
+                     LvePipelineLayoutCache &layoutCache,
+                     const PipelineRenderTarget &depthPrepassTarget = {},
+                     LveBindlessTable *bindlessTable = nullptr,
+                     LveShaderHotReload *hotReload = nullptr,
+                     LvePipelineLibrary *pipelineLibrary = nullptr);
   ~SimpleRenderSystem();
 
   SimpleRenderSystem(const SimpleRenderSystem &) = delete;
   SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-  void renderGameObjects(VkCommandBuffer commandBuffer,
-                         std::vector<LveGameObject> &gameObjects,
-                         const LveCamera &camera);
+  // Records depth-only draws into the pre-pass. The culled draw list
+  // is kept and replayed by the following renderGameObjects call.
+  void renderDepthPrepass(FrameInfo &frameInfo);
+  void renderGameObjects(FrameInfo &frameInfo);
+  // Records depth-only draws of casters, seen through the light's
+  // lightProjectionView, into a shadow pass. False when the uniform ring
+  // ran out before every caster was drawn.
+  bool renderShadowCasters(FrameInfo &frameInfo,
+                           const glm::mat4 &lightProjectionView,
+                           const std::vector<LveGameObject::id_t> &casters);
+
+  // GLSL sources of every pipeline this system builds, all watched by
+  // hot-reload. With it on, their SPIR-V has to be marked
+  // LveArchive::readLoose before the first system is created, so pipelines
+  // built before and after a reload read the same files.
+  static std::vector<std::string> shaderSources(bool bindless);
+
+  // Views other than Shaded draw shaded until their variant has compiled
+  void setViewMode(ViewMode mode) { viewMode = mode; }
+  ViewMode getViewMode() const { return viewMode; }
+
+  const LveMeshletCullStats &getMeshletStats() const { return meshletStats; }
+  // binds issued and skipped over every pass of the last frame
+  const LveRenderQueue::Stats &getRenderQueueStats() const {
+    return renderQueue.getStats();
+  }
 
 private:
-  void createPipelineLayout();
-  void createPipeline(VkRenderPass renderPass);
+  // once per frame, by whichever pass draws first
+  void prepareDescriptorSets(FrameInfo &frameInfo);
+  void allocateDescriptorSets(FrameInfo &frameInfo);
+  void updateBindlessRing(int frameIndex);
+  void createPipelineLayout(LvePipelineLayoutCache &layoutCache);
+  void createPipeline(const PipelineRenderTarget &target,
+                      const PipelineRenderTarget &depthTarget,
+                      const PipelineRenderTarget &shadowTarget);
+  // Static, so library variants capture its arguments by value: a variant
+  // outlives the system that added it, and adding it again from a new
+  // system keeps the first closure
+  static void mainPipelineConfigInfo(PipelineConfigInfo &configInfo,
+                                     const PipelineRenderTarget &target,
+                                     VkPipelineLayout pipelineLayout,
+                                     bool depthPrepass);
+  std::unique_ptr<LvePipeline>
+  createMainPipeline(const PipelineRenderTarget &target) const;
+  std::unique_ptr<LvePipeline>
+  createDepthPipeline(const PipelineRenderTarget &target) const;
+  std::unique_ptr<LvePipeline>
+  createShadowPipeline(const PipelineRenderTarget &target) const;
+  std::string vertexShaderSource() const;
+  void addViewModeVariants(const PipelineRenderTarget &target);
+  // the main pass pipeline for the current view mode
+  LvePipeline *viewModePipeline();
+  void buildDrawList(FrameInfo &frameInfo);
+  void recordDraws(FrameInfo &frameInfo, LvePipeline *pipelineOverride);
+  void drawObject(VkCommandBuffer commandBuffer,
+                  const LveRenderQueue::Draw &draw);
 
   LveDevice &lveDevice;
-  VkPipelineLayout pipelineLayout;
+  LveRingBuffer &uniformRing;
+  LveClusteredLights &clusteredLights;
+  LveShadowCascades &shadowCascades;
+
+  // set 0: per-frame globals, the binned lights and the shadow maps, set 1:
+  // per-object data; the uniforms are dynamic uniform buffers into the
+  // frame's ring buffer.
+  // Layouts are reflected from the shaders and owned by the caches, sets are
+  // transient and reallocated every frame.
+  VkDescriptorSetLayout globalSetLayout;
+  VkDescriptorSetLayout objectSetLayout;
+  VkDescriptorSet globalSet = VK_NULL_HANDLE;
+  VkDescriptorSet objectSet = VK_NULL_HANDLE;
+  uint32_t globalOffset = 0;
+  bool descriptorSetsReady = false;
+
+  // bindless mode: set 1 is the table and each frame's ring buffer is
+  // registered in it, re-registered whenever the ring grows
+  LveBindlessTable *bindlessTable;
+  std::array<uint32_t, LveSwapChain::MAX_FRAMES_IN_FLIGHT> ringIndices{};
+  std::array<uint32_t, LveSwapChain::MAX_FRAMES_IN_FLIGHT> ringGenerations{};
+
+  VkPipelineLayout pipelineLayout; // owned by the layout cache
   std::unique_ptr<LvePipeline> lvePipeline;
+
+  bool depthPrepass;
+  std::unique_ptr<LvePipeline> depthPipeline;
+  bool drawListReady = false;
+  std::unique_ptr<LvePipeline> shadowPipeline;
+
+  LveShaderHotReload *hotReload;
+  std::vector<LveShaderHotReload::WatchId> hotReloadWatches;
+
+  // variants are built from the .spv files, and rebuilt after a hot-reload
+  LvePipelineLibrary *pipelineLibrary;
+  ViewMode viewMode = ViewMode::Shaded;
+  std::array<LvePipelineLibrary::Key, static_cast<size_t>(ViewMode::Count)>
+      viewModeKeys{};
+
+  // sorted draws for the current frame, backed by the frame arena
+  LveRenderQueue renderQueue{};
+
+  // cone culling is only sound when the pipeline discards back faces
+  bool coneCulling = false;
+  std::vector<LveMeshletDrawRange> drawRanges;
+  LveMeshletCullStats meshletStats{};
 };
 } // namespace lve
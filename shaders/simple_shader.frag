@@ -1,14 +1,198 @@
 #version 450
-// layout(location = 0) in vec3 fragColor;
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
 
 layout(location = 0) out vec4 outColor;
 
-layout(push_constant) uniform Push {
-    mat4 transform;
+// 0: shaded, 1: depth, 2: lights per froxel, 3: shadow cascades; each value
+// is its own pipeline variant, see SimpleRenderSystem::ViewMode
+layout(constant_id = 0) const uint VIEW_MODE = 0;
+// the froxel grid, set from LveClusteredLights
+layout(constant_id = 1) const uint GRID_X = 16;
+layout(constant_id = 2) const uint GRID_Y = 9;
+layout(constant_id = 3) const uint GRID_Z = 24;
+// LveShadowCascades::CASCADE_COUNT
+const uint CASCADE_COUNT = 4;
+
+// written once per frame
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    vec4 cameraPosition;
+    vec4 ambientLight; // w is intensity
+    vec4 lightDirection; // the way the directional light travels
+    vec4 lightColor; // w is intensity
+    // LveShadowCascades::ShaderParams
+    mat4 lightProjectionViews[CASCADE_COUNT];
+    vec4 splitDepths; // view depth each cascade ends at
+    vec4 shadowTexelSizes;
+    // LveClusteredLights::ShaderParams
+    vec2 tileScale;
+    float nearPlane;
+    float farPlane;
+    float sliceScale;
+    float sliceBias;
+} ubo;
+
+struct PointLight {
+    vec3 position;
+    float radius;
     vec3 color;
-} push;
+    float padding;
+};
+
+// the frame's visible lights, binned by LveClusteredLights
+layout(set = 0, binding = 1) readonly buffer Lights {
+    PointLight lights[];
+};
+// per froxel: offset into lightIndices, light count
+layout(set = 0, binding = 2) readonly buffer Clusters {
+    uvec2 clusters[];
+};
+layout(set = 0, binding = 3) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+// one per cascade, compared against with LESS_OR_EQUAL
+layout(set = 0, binding = 4) uniform sampler2DShadow shadowMaps[CASCADE_COUNT];
+
+// back from depth to view distance under the perspective projection
+float viewDepth() {
+    float n = ubo.nearPlane;
+    float f = ubo.farPlane;
+    return n * f / (f - gl_FragCoord.z * (f - n));
+}
+
+uint clusterIndex(float depth) {
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * ubo.tileScale),
+                     uvec2(GRID_X - 1, GRID_Y - 1));
+    float slice = log(depth) * ubo.sliceScale + ubo.sliceBias;
+    uint z = uint(clamp(slice, 0.0, float(GRID_Z - 1)));
+    return (z * GRID_Y + tile.y) * GRID_X + tile.x;
+}
+
+// the first cascade reaching the depth, CASCADE_COUNT past the last
+uint cascadeIndex(float depth) {
+    uint cascade = 0;
+    while (cascade < CASCADE_COUNT && depth > ubo.splitDepths[cascade]) {
+        cascade++;
+    }
+    return cascade;
+}
+
+// cascade differs between neighbouring fragments, so the array is only
+// indexed with constants; explicit LOD, as this runs in non-uniform control
+// flow
+float compareShadow(uint cascade, vec3 coord) {
+    switch (cascade) {
+    case 0u:
+        return textureLod(shadowMaps[0], coord, 0.0);
+    case 1u:
+        return textureLod(shadowMaps[1], coord, 0.0);
+    case 2u:
+        return textureLod(shadowMaps[2], coord, 0.0);
+    default:
+        return textureLod(shadowMaps[3], coord, 0.0);
+    }
+}
+
+// 1 where the directional light reaches the fragment, 0 in full shadow
+float shadow(uint cascade, vec3 normal) {
+    if (cascade >= CASCADE_COUNT) {
+        return 1.0;
+    }
+    // looked up a little off the surface, so that it does not shadow itself
+    // where it slopes away from the light
+    vec3 position = fragPosWorld + normal * ubo.shadowTexelSizes[cascade] * 1.5;
+    vec4 light = ubo.lightProjectionViews[cascade] * vec4(position, 1.0);
+    vec2 uv = light.xy * 0.5 + 0.5;
+    // casters are never beyond the far plane, so past it nothing is
+    float depth = min(light.z, 1.0);
+
+    // 3x3 PCF; each tap is itself bilinearly filtered where the format
+    // allows, so the edge is smooth over about four texels
+    vec2 texel = 1.0 / vec2(textureSize(shadowMaps[0], 0));
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += compareShadow(cascade, vec3(uv + vec2(x, y) * texel, depth));
+        }
+    }
+    return lit / 9.0;
+}
+
+// black for none, then blue through green to red at 32 or more
+vec3 heatmap(uint count) {
+    if (count == 0) {
+        return vec3(0.0);
+    }
+    float t = clamp(float(count) / 32.0, 0.0, 1.0);
+    vec3 blue = vec3(0.0, 0.0, 1.0);
+    vec3 green = vec3(0.0, 1.0, 0.0);
+    vec3 red = vec3(1.0, 0.0, 0.0);
+    return t < 0.5 ? mix(blue, green, t * 2.0) : mix(green, red, t * 2.0 - 1.0);
+}
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    if (VIEW_MODE == 1) {
+        // depth crowds towards 1; sqrt spreads it so distance stays readable
+        outColor = vec4(vec3(sqrt(1.0 - gl_FragCoord.z)), 1.0);
+        return;
+    }
+
+    float depth = viewDepth();
+    uvec2 cluster = clusters[clusterIndex(depth)];
+    if (VIEW_MODE == 2) {
+        outColor = vec4(heatmap(cluster.y), 1.0);
+        return;
+    }
+
+    vec3 normal = normalize(fragNormalWorld);
+    vec3 toCamera = ubo.cameraPosition.xyz - fragPosWorld;
+    // models do not wind consistently; light the side facing the camera
+    if (dot(normal, toCamera) < 0.0) {
+        normal = -normal;
+    }
+    vec3 viewDirection = normalize(toCamera);
+
+    vec3 diffuse = ubo.ambientLight.rgb * ubo.ambientLight.w;
+    vec3 specular = vec3(0.0);
+
+    uint cascade = cascadeIndex(depth);
+    vec3 toSun = -ubo.lightDirection.xyz;
+    float cosSun = max(dot(normal, toSun), 0.0);
+    if (cosSun > 0.0) {
+        vec3 radiance =
+            ubo.lightColor.rgb * (ubo.lightColor.w * shadow(cascade, normal));
+        diffuse += radiance * cosSun;
+        vec3 halfway = normalize(toSun + viewDirection);
+        specular +=
+            radiance * cosSun * pow(max(dot(normal, halfway), 0.0), 32.0);
+    }
+    for (uint i = 0; i < cluster.y; i++) {
+        PointLight light = lights[lightIndices[cluster.x + i]];
+        vec3 toLight = light.position - fragPosWorld;
+        float distanceSquared = max(dot(toLight, toLight), 1e-6);
+        // inverse square, windowed to reach zero at the radius the light was
+        // binned with; the 1 keeps it finite at the light
+        float falloff = distanceSquared / (light.radius * light.radius);
+        float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+        vec3 radiance =
+            light.color * (window * window / (distanceSquared + 1.0));
+
+        vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+        float cosIncidence = max(dot(normal, lightDirection), 0.0);
+        diffuse += radiance * cosIncidence;
+        vec3 halfway = normalize(lightDirection + viewDirection);
+        specular += radiance * cosIncidence *
+                    pow(max(dot(normal, halfway), 0.0), 32.0);
+    }
+    vec3 color = fragColor * diffuse + 0.25 * specular;
+    if (VIEW_MODE == 3) {
+        // red, green, blue, yellow from the nearest; untinted past the last
+        const vec3 tints[CASCADE_COUNT + 1] = vec3[](
+            vec3(1.0, 0.3, 0.3), vec3(0.3, 1.0, 0.3), vec3(0.3, 0.3, 1.0),
+            vec3(1.0, 1.0, 0.3), vec3(1.0));
+        color *= tints[cascade];
+    }
+    outColor = vec4(color, 1.0);
 }
@@ -2,17 +2,36 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+
+// the depth pre-pass and the EQUAL-tested main pass must produce bit
+// identical depth
+invariant gl_Position;
 
 // layout(location = 0) out vec3 fragColor;
 
-layout(push_constant) uniform Push {
-    mat4 transform;
-    vec3 color;
-} push;
+// written once per frame, and once per shadow cascade with the light's
+// projectionView
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    // followed by the lighting terms simple_shader.frag reads
+} ubo;
+
+// sub-allocated per draw, selected with a dynamic offset
+layout(set = 1, binding = 0) uniform ObjectUbo {
+    mat4 modelMatrix;
+    vec4 color;
+} object;
 
 void main() {
-    gl_Position = push.transform * vec4(position, 1.0);
+    vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projectionView * positionWorld;
     fragColor = color;
+    fragPosWorld = positionWorld.xyz;
+    // stays perpendicular to the surface under non-uniform scale
+    fragNormalWorld = transpose(inverse(mat3(object.modelMatrix))) * normal;
 }
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+
+// the depth pre-pass and the EQUAL-tested main pass must produce bit
+// identical depth
+invariant gl_Position;
+
+// written once per frame, and once per shadow cascade with the light's
+// projectionView
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    // followed by the lighting terms simple_shader.frag reads
+} ubo;
+
+// storage buffer array of the bindless table; per-object data lives in the
+// frame's ring buffer, laid out as ObjectUbo in simple_shader.vert
+layout(set = 1, binding = 1) readonly buffer ObjectBuffer {
+    vec4 data[];
+} buffers[];
+
+layout(push_constant) uniform Push {
+    uint objectBuffer; // bindless index of the ring buffer
+    uint objectOffset; // in vec4s
+} push;
+
+void main() {
+    uint base = push.objectOffset;
+    mat4 modelMatrix = mat4(buffers[push.objectBuffer].data[base],
+                            buffers[push.objectBuffer].data[base + 1],
+                            buffers[push.objectBuffer].data[base + 2],
+                            buffers[push.objectBuffer].data[base + 3]);
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projectionView * positionWorld;
+    fragColor = color;
+    fragPosWorld = positionWorld.xyz;
+    fragNormalWorld = transpose(inverse(mat3(modelMatrix))) * normal;
+}
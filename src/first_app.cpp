@@ -1,14 +1,20 @@
 #include "../include/first_app.hpp"
 #include "../include/keyboard_movement_controller.hpp"
 #include "../include/lve_camera.hpp"
+#include "../include/lve_frame_info.hpp"
+#include "../include/lve_frustum.hpp"
 #include "../include/lve_gameobject.hpp"
 #include "../include/simple_render_system.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
+#include <iostream>
 #include <memory>
+#include <random>
+#include <string>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,12 +23,319 @@
 
 namespace lve {
 
-FirstApp::FirstApp() { loadGameObjects(); }
+FirstApp::FirstApp() {
+  if (assetArchiveMounted) {
+    std::cout << "asset archive: " << ASSET_ARCHIVE << " ("
+              << LveArchive::mountedFileCount() << " files)" << std::endl;
+  } else {
+    std::cout << "asset archive: off, reading loose files" << std::endl;
+  }
+  if (ENABLE_BINDLESS && lveDevice.bindlessSupported) {
+    bindlessTable = std::make_unique<LveBindlessTable>(lveDevice);
+  }
+  std::cout << "bindless: "
+            << (bindlessTable ? "on" : "off, using classic descriptor sets")
+            << std::endl;
+  if (ENABLE_SHADER_HOT_RELOAD && LveShaderHotReload::isSupported()) {
+    shaderHotReload = std::make_unique<LveShaderHotReload>();
+    // before any pipeline loads them: an edit saved last run rewrote the
+    // loose SPIR-V, and the archive still holds what `make` packed
+    for (const auto &source :
+         SimpleRenderSystem::shaderSources(bindlessTable != nullptr)) {
+      LveArchive::readLoose(source + ".spv");
+    }
+  }
+  std::cout << "shader hot-reload: " << (shaderHotReload ? "on" : "off")
+            << std::endl;
+  // the Hi-Z build reads single-sample depth, so multisampled depth has to
+  // be resolved as well, which only dynamic rendering can do
+  const bool msaaSupported = ENABLE_DYNAMIC_RENDERING &&
+                             lveDevice.dynamicRenderingSupported &&
+                             lveDevice.depthResolveModes != 0;
+  const VkSampleCountFlagBits maxSamples =
+      msaaSupported ? lveDevice.maxUsableSampleCount(MSAA_SAMPLES)
+                    : VK_SAMPLE_COUNT_1_BIT;
+  const VkSampleCountFlags sampleCounts =
+      lveDevice.properties.limits.framebufferColorSampleCounts &
+      lveDevice.properties.limits.framebufferDepthSampleCounts;
+  for (uint32_t samples = VK_SAMPLE_COUNT_1_BIT; samples <= maxSamples;
+       samples <<= 1) {
+    if (samples == VK_SAMPLE_COUNT_1_BIT || (sampleCounts & samples) != 0) {
+      msaaModes.push_back({static_cast<VkSampleCountFlagBits>(samples)});
+    }
+  }
+  msaaMode = msaaModes.size() - 1;
+  if (msaaSupported) {
+    std::cout << "msaa: " << maxSamples << "x, M cycles the sample count"
+              << std::endl;
+  } else {
+    std::cout << "msaa: off, needs dynamic rendering and depth resolve"
+              << std::endl;
+  }
+
+  // Once the device exists the rest of startup is a task graph: pipelines
+  // and meshes build on the workers while the main thread creates the swap
+  // chain and uploads textures, which use the graphics queue.
+  using Affinity = LveTaskGraph::Affinity;
+  LveTaskGraph startup{};
+  // the merge into the device's cache has to finish before any pipeline
+  // is created through it
+  auto pipelineCache = startup.add("pipeline cache", [this] {
+    if (!lveDevice.loadPipelineCache(PIPELINE_CACHE_FILE)) {
+      std::cout << "pipeline cache: none loaded, compiling from scratch"
+                << std::endl;
+    }
+  });
+  auto swapChain = startup.add(
+      "swap chain",
+      [this] {
+        lveRenderer = std::make_unique<LveRenderer>(lveWindow, lveDevice);
+      },
+      {}, Affinity::Main);
+  auto renderGraphTask = startup.add(
+      "render graph", [this] { buildRenderGraph(); }, {swapChain},
+      Affinity::Main);
+  auto textureStreamerTask = startup.add(
+      "texture streamer",
+      [this] {
+        LveTextureStreamer::Config config{};
+        config.budgetBytes = TEXTURE_BUDGET_BYTES;
+        textureStreamer = std::make_unique<LveTextureStreamer>(
+            lveDevice, config, bindlessTable.get());
+      },
+      {}, Affinity::Main);
+  startup.add(
+      "hi-z pipeline", [this] { hiZ = std::make_unique<LveHiZ>(lveDevice); },
+      {pipelineCache});
+  auto renderSystem = startup.add(
+      "render system pipelines", [this] { createRenderSystem(); },
+      {pipelineCache, renderGraphTask});
+  if (pipelineLibrary.getMode() == LvePipelineLibrary::Mode::Startup) {
+    // the variants were queued on the library's own workers as they were
+    // added; this only waits for them
+    startup.add(
+        "pipeline variants", [this] { pipelineLibrary.compileAll(); },
+        {renderSystem});
+  }
+  loadGameObjects(startup, textureStreamerTask);
+  createPointLights();
+
+  LveThreadPool workers{};
+  startup.run(workers);
+  startup.report();
+}
 
 FirstApp::~FirstApp() {}
 
+void FirstApp::buildRenderGraph() {
+  using State = LveRenderGraph::ResourceState;
+  auto &swapChain = lveRenderer->getSwapChain();
+  renderGraph = std::make_unique<LveRenderGraph>(
+      lveDevice,
+      ENABLE_DYNAMIC_RENDERING && lveDevice.dynamicRenderingSupported);
+
+  // The acquire semaphore is waited on at colour output, so starting there
+  // orders the first write after it; presentation waits on a semaphore too
+  swapChainImage = renderGraph->importImage(
+      "swap chain", {swapChain.getSwapChainImageFormat()},
+      State{VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0},
+      State{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0});
+  // one per swap chain image. The Hi-Z build reads it after the graph, and
+  // an earlier build may still be reading it when the frame clears it.
+  sceneDepth = renderGraph->importImage(
+      "depth", {swapChain.findDepthFormat()},
+      State{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0},
+      State{VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT});
+
+  // Multisampled, the passes draw into transient images that the main pass
+  // resolves into the swap chain image and depth as it ends. What no later
+  // pass loads, the colour always and depth without the prepass, lives in
+  // lazily allocated memory where there is some.
+  const VkSampleCountFlagBits samples = msaaModes[msaaMode].samples;
+  LveRenderGraph::ResourceId colorTarget = swapChainImage;
+  LveRenderGraph::ResourceId depthTarget = sceneDepth;
+  if (samples != VK_SAMPLE_COUNT_1_BIT) {
+    colorTarget = renderGraph->createImage(
+        "msaa color", {swapChain.getSwapChainImageFormat(), samples});
+    depthTarget = renderGraph->createImage(
+        "msaa depth", {swapChain.findDepthFormat(), samples});
+  }
+
+  // The shadow maps live in LveShadowCascades and are bound every frame.
+  // Near cascades are cleared and drawn whole. A cached cascade is three
+  // conditional passes: the static casters into its cache, the cache copied
+  // into the map, the dynamic casters over it; every frame ends with the map
+  // ready for sampling, so the next one can skip all three.
+  const LveRenderGraph::ImageDesc shadowDesc{
+      shadowCascades.getFormat(),
+      VK_SAMPLE_COUNT_1_BIT,
+      {LveShadowCascades::RESOLUTION, LveShadowCascades::RESOLUTION}};
+  const State shadowMapRead{VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_ACCESS_SHADER_READ_BIT};
+  const State shadowCacheReady{VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0};
+  for (uint32_t i = 0; i < LveShadowCascades::CASCADE_COUNT; i++) {
+    const std::string index = std::to_string(i);
+    const bool cached = i >= LveShadowCascades::FIRST_CACHED_CASCADE;
+    // near maps are redrawn whole, so their contents can be discarded
+    shadowMaps[i] = renderGraph->importImage(
+        "shadow map " + index, shadowDesc,
+        State{cached ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                     : VK_IMAGE_LAYOUT_UNDEFINED,
+              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0},
+        shadowMapRead);
+    if (!cached) {
+      auto pass =
+          renderGraph->addPass("shadow cascade " + index)
+              .clearDepth(shadowMaps[i])
+              .execute([this, i](FrameInfo &frameInfo) {
+                const auto &cascade = shadowCascades.getCascade(i);
+                simpleRenderSystem->renderShadowCasters(
+                    frameInfo, cascade.lightProjectionView, cascade.casters);
+              })
+              .id();
+      if (i == 0) {
+        shadowPass = pass;
+      }
+      continue;
+    }
+    shadowCaches[i] = renderGraph->importImage(
+        "shadow cache " + index, shadowDesc, shadowCacheReady,
+        shadowCacheReady);
+    renderGraph->addPass("shadow cache " + index)
+        .clearDepth(shadowCaches[i])
+        .condition(
+            [this, i] { return shadowCascades.getCascade(i).renderCache; })
+        .execute([this, i](FrameInfo &frameInfo) {
+          const auto &cascade = shadowCascades.getCascade(i);
+          if (!simpleRenderSystem->renderShadowCasters(
+                  frameInfo, cascade.lightProjectionView,
+                  cascade.cacheCasters)) {
+            shadowCascades.invalidate(i);
+          }
+        });
+    renderGraph->addPass("shadow copy " + index)
+        .transferSrc(shadowCaches[i])
+        .transferDst(shadowMaps[i])
+        .condition([this, i] { return shadowCascades.getCascade(i).copyCache; })
+        .execute([this, i](FrameInfo &frameInfo) {
+          shadowCascades.recordCacheCopy(frameInfo.commandBuffer, i);
+        });
+    renderGraph->addPass("shadow dynamic " + index)
+        .depth(shadowMaps[i])
+        .condition(
+            [this, i] { return shadowCascades.getCascade(i).drawCasters; })
+        .execute([this, i](FrameInfo &frameInfo) {
+          const auto &cascade = shadowCascades.getCascade(i);
+          simpleRenderSystem->renderShadowCasters(
+              frameInfo, cascade.lightProjectionView, cascade.casters);
+        });
+  }
+
+  const VkClearColorValue background = {{0.01f, 0.01f, 0.01f, 1.0f}};
+  if (ENABLE_DEPTH_PREPASS) {
+    depthPrepassPass =
+        renderGraph->addPass("depth prepass")
+            .clearDepth(depthTarget)
+            .execute([this](FrameInfo &frameInfo) {
+              simpleRenderSystem->renderDepthPrepass(frameInfo);
+            })
+            .id();
+  }
+  auto colorPass =
+      renderGraph->addPass("main").clearColor(colorTarget, background);
+  if (ENABLE_DEPTH_PREPASS) {
+    colorPass.depthReadOnly(depthTarget);
+  } else {
+    colorPass.clearDepth(depthTarget);
+  }
+  for (auto shadowMap : shadowMaps) {
+    colorPass.sampled(shadowMap, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  }
+  if (samples != VK_SAMPLE_COUNT_1_BIT) {
+    // the farthest sample keeps Hi-Z occlusion conservative
+    colorPass.resolve(colorTarget, swapChainImage)
+        .resolve(depthTarget, sceneDepth,
+                 (lveDevice.depthResolveModes & VK_RESOLVE_MODE_MAX_BIT) != 0
+                     ? VK_RESOLVE_MODE_MAX_BIT
+                     : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT);
+  }
+  mainPass = colorPass
+                 .execute([this](FrameInfo &frameInfo) {
+                   simpleRenderSystem->renderGameObjects(frameInfo);
+                 })
+                 .id();
+
+  renderGraph->compile(swapChain.getSwapChainExtent());
+  renderGraphSwapChain = lveRenderer->getSwapChainGeneration();
+}
+
+void FirstApp::createRenderSystem() {
+  simpleRenderSystem = std::make_unique<SimpleRenderSystem>(
+      lveDevice, renderGraph->getRenderTarget(mainPass), uniformRing,
+      clusteredLights, shadowCascades, renderGraph->getRenderTarget(shadowPass),
+      pipelineLayoutCache,
+      ENABLE_DEPTH_PREPASS ? renderGraph->getRenderTarget(depthPrepassPass)
+                           : PipelineRenderTarget{},
+      bindlessTable.get(), shaderHotReload.get(), &pipelineLibrary);
+}
+
+void FirstApp::createPointLights() {
+  // seeded, so every run lights the scene the same way
+  std::mt19937 random{7};
+  std::uniform_real_distribution<float> unit{0.f, 1.f};
+  const glm::vec3 sceneCenter{0.f, 0.f, 2.5f};
+  lightOrbits.resize(POINT_LIGHT_COUNT);
+  pointLights.resize(POINT_LIGHT_COUNT);
+  for (uint32_t i = 0; i < POINT_LIGHT_COUNT; i++) {
+    LightOrbit &orbit = lightOrbits[i];
+    orbit.center = sceneCenter + glm::vec3{0.f, 1.6f * unit(random) - .8f, 0.f};
+    orbit.radius = .35f + 1.5f * unit(random);
+    orbit.speed = (.2f + .8f * unit(random)) * (i % 2 == 0 ? 1.f : -1.f);
+    orbit.phase = glm::two_pi<float>() * unit(random);
+
+    LveClusteredLights::PointLight &light = pointLights[i];
+    light.radius = .15f + .25f * unit(random);
+    // saturated hues; many overlap, so each one is dim
+    glm::vec3 hue = glm::clamp(
+        glm::abs(glm::mod(6.f * unit(random) + glm::vec3{0.f, 4.f, 2.f}, 6.f) -
+                 3.f) -
+            1.f,
+        0.f, 1.f);
+    light.color = .4f * hue;
+  }
+  updatePointLights(0.f);
+}
+
+void FirstApp::updatePointLights(float time) {
+  for (uint32_t i = 0; i < POINT_LIGHT_COUNT; i++) {
+    const LightOrbit &orbit = lightOrbits[i];
+    float angle = orbit.phase + orbit.speed * time;
+    pointLights[i].position =
+        orbit.center +
+        orbit.radius * glm::vec3{glm::cos(angle), 0.f, glm::sin(angle)};
+  }
+}
+
+void FirstApp::updateOrbiter(float time) {
+  auto &orbiter = gameObjects.at(orbiterId);
+  float angle = .6f * time;
+  orbiter.transform.translation = {.9f * glm::cos(angle), .3f,
+                                   2.5f + .9f * glm::sin(angle)};
+  orbiter.transform.rotation.y = -angle;
+  sceneBvh.update(orbiterId, orbiter.getWorldBounds());
+}
+
+bool FirstApp::mountAssetArchive() {
+  return USE_ASSET_ARCHIVE && LveArchive::mount(ASSET_ARCHIVE);
+}
+
 void FirstApp::run() {
-  SimpleRenderSystem simpleRenderSystem{lveDevice, lveRenderer.getRenderPass()};
   LveCamera camera{};
   camera.setViewTarget(glm::vec3(-1.0f, -2.0f, 2.0f),
                        glm::vec3(0.0f, 0.0f, 2.5f));
@@ -31,11 +344,19 @@ void FirstApp::run() {
   KeyboardMovementController cameraController{};
 
   auto currentTime = std::chrono::high_resolution_clock::now();
+  float statsTimer = 0.f;
+  float sceneTime = 0.f;
+  bool viewModeKeyDown = false;
+  bool graphKeyDown = false;
+  bool msaaKeyDown = false;
+  // the first frames in flight have no timestamps yet
+  msaaUntimedFrames = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+  bool firstFrame = true;
 
   while (!lveWindow.shouldClose()) {
     glfwPollEvents();
 
-    float aspect = lveRenderer.getAspectRatio();
+    float aspect = lveRenderer->getAspectRatio();
 
     auto time = std::chrono::high_resolution_clock::now();
     float frameTime =
@@ -44,21 +365,247 @@ void FirstApp::run() {
             .count();
     currentTime = time;
 
+    statsTimer += frameTime;
+    if (statsTimer >= 1.f) {
+      statsTimer = 0.f;
+      const auto &queueStats = simpleRenderSystem->getRenderQueueStats();
+      std::cout << "draws: " << queueStats.draws
+                << " pipeline binds: " << queueStats.pipelineBinds << " (+"
+                << queueStats.pipelineBindsSkipped << " skipped)"
+                << " vertex buffer binds: " << queueStats.vertexBufferBinds
+                << " (+" << queueStats.vertexBufferBindsSkipped << " skipped)"
+                << std::endl;
+      const auto arenaStats = frameArena.getStats();
+      std::cout << "frame arena: " << arenaStats.bytesUsed << " / "
+                << arenaStats.capacity << " bytes, heap blocks last frame: "
+                << arenaStats.heapAllocationsLastFrame << std::endl;
+      const auto &descriptors = frameDescriptors.current();
+      std::cout << "descriptor sets: " << descriptors.setsAllocated()
+                << " from " << descriptors.poolCount() << " pools, "
+                << descriptorLayoutCache.size() << " cached set layouts, "
+                << pipelineLayoutCache.size() << " pipeline layouts"
+                << std::endl;
+      const auto textureStats = textureStreamer->getStats();
+      std::cout << "textures: " << textureStats.residentTextures
+                << " resident, " << (textureStats.residentBytes >> 10) << " / "
+                << (textureStats.budgetBytes >> 10) << " KiB, "
+                << textureStats.pendingDecodes << " decoding, "
+                << textureStats.evictions << " evicted ("
+                << textureStats.pressureEvictions << " under memory pressure)"
+                << (textureStats.transferQueueUploads ? ", transfer queue" : "")
+                << std::endl;
+      const auto memoryStats = lveDevice.getMemoryStats();
+      for (size_t i = 0; i < memoryStats.heaps.size(); i++) {
+        const auto &heap = memoryStats.heaps[i];
+        if (heap.usage == 0 && heap.peakUsage == 0) {
+          continue;
+        }
+        std::cout << "memory heap " << i
+                  << (heap.deviceLocal ? " (device local): " : ": ")
+                  << (heap.usage >> 20) << " / " << (heap.budget >> 20)
+                  << " MiB, peak " << (heap.peakUsage >> 20) << " MiB"
+                  << std::endl;
+      }
+      std::cout << "memory by category:";
+      for (size_t i = 0; i < memoryStats.categoryBytes.size(); i++) {
+        if (memoryStats.categoryPeakBytes[i] == 0) {
+          continue;
+        }
+        std::cout << " "
+                  << LveDevice::memoryCategoryName(
+                         static_cast<MemoryCategory>(i))
+                  << " " << (memoryStats.categoryBytes[i] >> 10) << " KiB"
+                  << " (peak " << (memoryStats.categoryPeakBytes[i] >> 10)
+                  << ")";
+      }
+      std::cout << ", " << memoryStats.allocations << " allocations, "
+                << memoryStats.pressureEvents << " pressure events"
+                << (memoryStats.budgetExtension ? "" : ", own accounting")
+                << std::endl;
+      const auto pipelineStats = pipelineLibrary.getStats();
+      std::cout << "pipeline variants: " << pipelineStats.compiled << " / "
+                << pipelineStats.variants << " compiled, "
+                << pipelineStats.pending << " compiling, "
+                << pipelineStats.misses << " fallback lookups" << std::endl;
+      const auto &lightStats = clusteredLights.getStats();
+      std::cout << "point lights: " << lightStats.visibleLights << " / "
+                << lightStats.lights << " visible, "
+                << lightStats.lightIndices << " in froxels, at most "
+                << lightStats.maxClusterLights << " in one, binned in "
+                << lightStats.binMilliseconds << " ms" << std::endl;
+      const auto &shadowStats = shadowCascades.getStats();
+      std::cout << "shadows: " << shadowStats.casterDraws << " caster draws, "
+                << shadowStats.cacheUpdates << " cascades re-cached ("
+                << shadowStats.totalCacheUpdates << " since startup), "
+                << renderGraph->getStats().skippedPasses
+                << " conditional passes skipped" << std::endl;
+      if (lveRenderer->hasPipelineStatistics()) {
+        std::cout << "fragment shader invocations: "
+                  << lveRenderer->getFragmentShaderInvocations()
+                  << (ENABLE_DEPTH_PREPASS ? " (depth pre-pass)" : "")
+                  << std::endl;
+      }
+      if (lveRenderer->hasGpuTimestamps()) {
+        std::cout << "gpu frame time by msaa:";
+        for (const auto &mode : msaaModes) {
+          if (mode.frames > 0) {
+            std::cout << " " << mode.samples << "x "
+                      << mode.gpuMilliseconds / mode.frames << " ms";
+          }
+        }
+        std::cout << " (now " << msaaModes[msaaMode].samples << "x)"
+                  << std::endl;
+      }
+    }
+
     cameraController.moveInPlaneXZ(lveWindow.getWindow(), frameTime,
                                    viewerObject);
+    bool keyDown =
+        glfwGetKey(lveWindow.getWindow(), GLFW_KEY_V) == GLFW_PRESS;
+    if (keyDown && !viewModeKeyDown) {
+      using ViewMode = SimpleRenderSystem::ViewMode;
+      uint32_t next =
+          static_cast<uint32_t>(simpleRenderSystem->getViewMode()) + 1;
+      simpleRenderSystem->setViewMode(static_cast<ViewMode>(
+          next % static_cast<uint32_t>(ViewMode::Count)));
+    }
+    viewModeKeyDown = keyDown;
+    keyDown = glfwGetKey(lveWindow.getWindow(), GLFW_KEY_G) == GLFW_PRESS;
+    if (keyDown && !graphKeyDown) {
+      renderGraph->dump(std::cout);
+    }
+    graphKeyDown = keyDown;
+    keyDown = glfwGetKey(lveWindow.getWindow(), GLFW_KEY_M) == GLFW_PRESS;
+    if (keyDown && !msaaKeyDown && msaaModes.size() > 1) {
+      // pipelines are built for a sample count, so the render system is
+      // made again with the graph; the library keeps the variants of the
+      // counts used before
+      vkDeviceWaitIdle(lveDevice.device());
+      const auto viewMode = simpleRenderSystem->getViewMode();
+      simpleRenderSystem.reset();
+      msaaMode = (msaaMode + 1) % msaaModes.size();
+      buildRenderGraph();
+      createRenderSystem();
+      simpleRenderSystem->setViewMode(viewMode);
+      msaaUntimedFrames = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+      std::cout << "msaa: " << msaaModes[msaaMode].samples << "x"
+                << std::endl;
+    }
+    msaaKeyDown = keyDown;
     camera.setViewYXZ(viewerObject.transform.translation,
                       viewerObject.transform.translation);
 
     camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.0f);
-    if (auto commandBuffer = lveRenderer.beginFrame()) {
-      lveRenderer.beginSwapChainRenderPass(commandBuffer);
-      simpleRenderSystem.renderGameObjects(commandBuffer, gameObjects, camera);
-      lveRenderer.endSwapChainRenderPass(commandBuffer);
-      lveRenderer.endFrame();
+    if (auto commandBuffer = lveRenderer->beginFrame()) {
+      int frameIndex = lveRenderer->getCurrentFrameIndex();
+      auto &swapChain = lveRenderer->getSwapChain();
+      if (renderGraphSwapChain != lveRenderer->getSwapChainGeneration()) {
+        renderGraph->resize(swapChain.getSwapChainExtent());
+        renderGraphSwapChain = lveRenderer->getSwapChainGeneration();
+      }
+      // beginFrame read the timestamps of the frame that used this slot last
+      if (msaaUntimedFrames > 0) {
+        msaaUntimedFrames--;
+      } else {
+        msaaModes[msaaMode].gpuMilliseconds +=
+            lveRenderer->getGpuMilliseconds();
+        msaaModes[msaaMode].frames++;
+      }
+      // the fence wait in beginFrame retired everything this frame allocated
+      frameArena.beginFrame(frameIndex);
+      uniformRing.beginFrame(frameIndex);
+      clusteredLights.beginFrame(frameIndex);
+      frameDescriptors.beginFrame(frameIndex);
+      pipelineLibrary.beginFrame(frameIndex);
+      if (bindlessTable) {
+        bindlessTable->beginFrame(frameIndex);
+      }
+      textureStreamer->beginFrame(frameIndex);
+      if (shaderHotReload) {
+        shaderHotReload->beginFrame(frameIndex);
+      }
+      // after the frees above; streaming evicts here when a heap runs short
+      lveDevice.updateMemoryBudget();
+      // whatever moves is refit in the BVH before anything is culled
+      sceneTime += frameTime;
+      updatePointLights(sceneTime);
+      updateOrbiter(sceneTime);
+
+      glm::mat4 projectionView =
+          camera.getProjectionMatrix() * camera.getViewMatrix();
+
+      visibleObjects.clear();
+      sceneBvh.queryFrustum(LveFrustum::fromMatrix(projectionView),
+                            visibleObjects);
+
+      hiZ->beginFrame(frameIndex);
+      visibleObjects.erase(
+          std::remove_if(visibleObjects.begin(), visibleObjects.end(),
+                         [&](LveGameObject::id_t id) {
+                           return !hiZ->isVisible(
+                               gameObjects.at(id).getWorldBounds());
+                         }),
+          visibleObjects.end());
+
+      // only what is on screen is streamed, at the resolution it covers
+      const float viewportHeight =
+          static_cast<float>(swapChain.getSwapChainExtent().height);
+      for (auto id : visibleObjects) {
+        auto &obj = gameObjects.at(id);
+        if (obj.texture != LveTextureStreamer::INVALID_TEXTURE) {
+          textureStreamer->requestForBounds(
+              obj.texture, obj.getWorldBounds(), camera.getPosition(),
+              camera.getProjectionMatrix()[1][1], viewportHeight);
+        }
+      }
+      textureStreamer->update(commandBuffer, *lveRenderer);
+
+      clusteredLights.update(camera, swapChain.getSwapChainExtent(),
+                             pointLights);
+      shadowCascades.update(camera, sunDirection, sceneBvh, gameObjects);
+
+      FrameInfo frameInfo{frameIndex,
+                          frameTime,
+                          commandBuffer,
+                          camera,
+                          gameObjects,
+                          visibleObjects,
+                          frameArena,
+                          frameDescriptors.current()};
+
+      const uint32_t imageIndex = lveRenderer->getCurrentImageIndex();
+      renderGraph->bindImage(swapChainImage, swapChain.getImage(imageIndex),
+                             swapChain.getImageView(imageIndex));
+      renderGraph->bindImage(sceneDepth, swapChain.getDepthImage(imageIndex),
+                             swapChain.getDepthImageView(imageIndex));
+      for (uint32_t i = 0; i < LveShadowCascades::CASCADE_COUNT; i++) {
+        renderGraph->bindImage(shadowMaps[i], shadowCascades.getImage(i),
+                               shadowCascades.getImageView(i));
+        if (shadowCascades.getCacheImage(i) != VK_NULL_HANDLE) {
+          renderGraph->bindImage(shadowCaches[i],
+                                 shadowCascades.getCacheImage(i),
+                                 shadowCascades.getCacheImageView(i));
+        }
+      }
+      lveRenderer->beginStatisticsQuery(commandBuffer);
+      renderGraph->execute(frameInfo);
+      lveRenderer->endStatisticsQuery(commandBuffer);
+      hiZ->record(commandBuffer, frameIndex, *lveRenderer, projectionView);
+      lveRenderer->endFrame();
+      if (firstFrame) {
+        firstFrame = false;
+        std::cout << "time to first frame: "
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - startTime)
+                         .count()
+                  << " ms" << std::endl;
+      }
     }
   }
 
   vkDeviceWaitIdle(lveDevice.device());
+  // picks up variants and hot-reloads compiled while running, too
+  lveDevice.savePipelineCache(PIPELINE_CACHE_FILE);
 }
 
 std::unique_ptr<LveModel> createFaceModel(LveDevice &device, glm::vec3 offset) {
@@ -174,7 +721,11 @@ std::unique_ptr<LveModel> createFaceModel(LveDevice &device, glm::vec3 offset) {
     v.position = glm::vec3(flipX * p);
   }
 
-  return std::make_unique<LveModel>(device, vertices);
+  LveModel::Builder builder{};
+  builder.vertices = std::move(vertices);
+  builder.computeFlatNormals();
+  builder.weldVertices();
+  return std::make_unique<LveModel>(device, builder);
 }
 
 std::unique_ptr<LveModel> createCubeModel(LveDevice &device, glm::vec3 offset) {
@@ -232,18 +783,62 @@ std::unique_ptr<LveModel> createCubeModel(LveDevice &device, glm::vec3 offset) {
   for (auto &v : vertices) {
     v.position += offset;
   }
-  return std::make_unique<LveModel>(device, vertices);
+  LveModel::Builder builder{};
+  builder.vertices = std::move(vertices);
+  builder.computeFlatNormals();
+  builder.weldVertices();
+  return std::make_unique<LveModel>(device, builder);
 }
 
-void FirstApp::loadGameObjects() {
-  std::shared_ptr<LveModel> lveModel =
-      createFaceModel(lveDevice, {0.0f, 0.0f, 0.0f});
-
-  auto cube = LveGameObject::createGameObject();
-  cube.model = lveModel;
-  cube.transform.translation = {0.0f, 0.0f, 2.5f};
-  cube.transform.scale = {0.5f, 0.5f, 0.5f};
-  gameObjects.push_back(std::move(cube));
+void FirstApp::loadGameObjects(LveTaskGraph &startup,
+                               LveTaskGraph::TaskId textureStreamerTask) {
+  // every model builds on a worker, one task each; objects and the BVH are
+  // filled in on the main thread once all of them and the texture streamer
+  // exist. load() only registers the files, they stream in once visible.
+  auto models = std::make_shared<std::vector<std::shared_ptr<LveModel>>>(2);
+  std::vector<LveTaskGraph::TaskId> sceneDependencies{textureStreamerTask};
+  sceneDependencies.push_back(startup.add("mesh: face", [this, models] {
+    (*models)[0] = createFaceModel(lveDevice, {0.0f, 0.0f, 0.0f});
+  }));
+  sceneDependencies.push_back(startup.add("mesh: cube", [this, models] {
+    (*models)[1] = createCubeModel(lveDevice, {0.0f, 0.0f, 0.0f});
+  }));
+
+  startup.add(
+      "scene",
+      [this, models] {
+        auto cube = LveGameObject::createGameObject();
+        cube.model = (*models)[0];
+        cube.transform.translation = {0.0f, 0.0f, 2.5f};
+        cube.transform.scale = {0.5f, 0.5f, 0.5f};
+        cube.isStatic = true;
+        cube.texture = textureStreamer->load("assets/textures/face.dds");
+        gameObjects.emplace(cube.getId(), std::move(cube));
+
+        // the ground the face and the orbiter cast their shadows on
+        auto floor = LveGameObject::createGameObject();
+        floor.model = (*models)[1];
+        floor.transform.translation = {0.0f, 0.5f, 2.5f};
+        floor.transform.scale = {3.0f, 0.05f, 3.0f};
+        floor.isStatic = true;
+        floor.texture = textureStreamer->load("assets/textures/floor.tga");
+        gameObjects.emplace(floor.getId(), std::move(floor));
+
+        auto orbiter = LveGameObject::createGameObject();
+        orbiter.model = (*models)[1];
+        orbiter.transform.scale = {0.15f, 0.15f, 0.15f};
+        orbiter.texture = textureStreamer->load("assets/textures/orbiter.tga");
+        orbiterId = orbiter.getId();
+        gameObjects.emplace(orbiter.getId(), std::move(orbiter));
+
+        std::vector<std::pair<LveBvh::id_t, LveAabb>> bounds;
+        bounds.reserve(gameObjects.size());
+        for (auto &kv : gameObjects) {
+          bounds.emplace_back(kv.first, kv.second.getWorldBounds());
+        }
+        sceneBvh.insertBatch(bounds);
+      },
+      sceneDependencies, LveTaskGraph::Affinity::Main);
 }
 
 } // namespace lve
@@ -0,0 +1,505 @@
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace lve {
+
+namespace {
+struct MountTable {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<LveArchive>> archives;
+  // normalized
+  std::unordered_set<std::string> loosePaths;
+};
+
+MountTable &mountTable() {
+  static MountTable table;
+  return table;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t chunkCountFor(uint64_t size, uint32_t chunkSize) {
+  return size / chunkSize + (size % chunkSize != 0 ? 1 : 0);
+}
+} // namespace
+
+LveArchive::LveArchive(const std::string &filepath)
+    : file{filepath, LveMappedFile::Access::Sequential} {
+  validate(filepath);
+}
+
+void LveArchive::validate(const std::string &filepath) {
+  static_assert(sizeof(Header) == 32, "archive header layout changed");
+  static_assert(sizeof(Entry) == 40, "archive entry layout changed");
+  auto fail = [&](const char *what) {
+    throw std::runtime_error("invalid asset archive " + filepath + ": " +
+                             what);
+  };
+
+  if (file.size() < sizeof(Header)) {
+    fail("truncated header");
+  }
+  Header header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != MAGIC) {
+    fail("not an asset archive");
+  }
+  if (header.version != VERSION) {
+    fail("unsupported version");
+  }
+  if (header.alignment < sizeof(uint32_t) ||
+      (header.alignment & (header.alignment - 1)) != 0 ||
+      header.chunkSize == 0) {
+    fail("bad alignment or chunk size");
+  }
+  dataAlignment = header.alignment;
+  chunkSize = header.chunkSize;
+
+  uint64_t entriesOffset = sizeof(Header);
+  uint64_t chunksOffset =
+      entriesOffset + uint64_t{header.entryCount} * sizeof(Entry);
+  uint64_t pathsOffset =
+      chunksOffset + uint64_t{header.chunkCount} * sizeof(uint32_t);
+  if (pathsOffset + header.pathBytes > file.size()) {
+    fail("truncated table of contents");
+  }
+  entries.resize(header.entryCount);
+  std::memcpy(entries.data(), file.data() + entriesOffset,
+              entries.size() * sizeof(Entry));
+  chunkStoredSizes.resize(header.chunkCount);
+  std::memcpy(chunkStoredSizes.data(), file.data() + chunksOffset,
+              chunkStoredSizes.size() * sizeof(uint32_t));
+  chunkOffsets.resize(header.chunkCount);
+  paths = file.data() + pathsOffset;
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    const Entry &entry = entries[i];
+    if (uint64_t{entry.pathOffset} + entry.pathLength > header.pathBytes) {
+      fail("path out of range");
+    }
+    if (i > 0) {
+      const Entry &previous = entries[i - 1];
+      if (previous.pathHash > entry.pathHash ||
+          (previous.pathHash == entry.pathHash &&
+           path(static_cast<uint32_t>(i - 1)) >=
+               path(static_cast<uint32_t>(i)))) {
+        fail("table of contents is not sorted");
+      }
+    }
+    if (entry.codec > static_cast<uint32_t>(LveCompression::Codec::Zstd)) {
+      fail("unknown codec");
+    }
+    if (entry.offset % dataAlignment != 0) {
+      fail("misaligned entry");
+    }
+    uint64_t chunks = chunkCountFor(entry.size, chunkSize);
+    if (entry.firstChunk + chunks > header.chunkCount) {
+      fail("chunk out of range");
+    }
+    uint64_t stored = 0;
+    for (uint32_t c = 0; c < chunks; c++) {
+      chunkOffsets[entry.firstChunk + c] = stored;
+      uint32_t chunkStored = chunkStoredSizes[entry.firstChunk + c];
+      if (chunkStored > chunkBytes(entry, c)) {
+        fail("chunk larger than its data");
+      }
+      stored += chunkStored;
+    }
+    if (entry.offset > file.size() || stored > file.size() - entry.offset) {
+      fail("entry data out of range");
+    }
+  }
+}
+
+uint32_t LveArchive::find(const std::string &path) const {
+  std::string normalized = normalizePath(path);
+  uint64_t hash = hashPath(normalized);
+  auto it = std::lower_bound(
+      entries.begin(), entries.end(), hash,
+      [](const Entry &entry, uint64_t h) { return entry.pathHash < h; });
+  for (; it != entries.end() && it->pathHash == hash; ++it) {
+    if (it->pathLength == normalized.size() &&
+        std::memcmp(paths + it->pathOffset, normalized.data(),
+                    normalized.size()) == 0) {
+      return static_cast<uint32_t>(it - entries.begin());
+    }
+  }
+  return NOT_FOUND;
+}
+
+std::string LveArchive::path(uint32_t entry) const {
+  return std::string(paths + entries[entry].pathOffset,
+                     entries[entry].pathLength);
+}
+
+size_t LveArchive::size(uint32_t entry) const {
+  return static_cast<size_t>(entries[entry].size);
+}
+
+size_t LveArchive::storedSize(uint32_t entry) const {
+  const Entry &e = entries[entry];
+  size_t stored = 0;
+  for (uint32_t c = 0; c < chunkCountFor(e.size, chunkSize); c++) {
+    stored += chunkStoredSizes[e.firstChunk + c];
+  }
+  return stored;
+}
+
+size_t LveArchive::chunkBytes(const Entry &entry, uint32_t chunk) const {
+  uint64_t start = uint64_t{chunk} * chunkSize;
+  return static_cast<size_t>(
+      std::min<uint64_t>(chunkSize, entry.size - start));
+}
+
+const char *LveArchive::storedData(uint32_t entry) const {
+  const Entry &e = entries[entry];
+  for (uint32_t c = 0; c < chunkCountFor(e.size, chunkSize); c++) {
+    if (chunkStoredSizes[e.firstChunk + c] != chunkBytes(e, c)) {
+      return nullptr;
+    }
+  }
+  return file.data() + e.offset;
+}
+
+void LveArchive::readChunk(const Entry &entry, uint32_t chunk,
+                           char *dst) const {
+  const char *src =
+      file.data() + entry.offset + chunkOffsets[entry.firstChunk + chunk];
+  size_t stored = chunkStoredSizes[entry.firstChunk + chunk];
+  size_t bytes = chunkBytes(entry, chunk);
+  // chunks that did not shrink were stored as they are
+  auto codec = stored == bytes
+                   ? LveCompression::Codec::None
+                   : static_cast<LveCompression::Codec>(entry.codec);
+  if (!LveCompression::decompress(codec, src, stored,
+                                  dst + uint64_t{chunk} * chunkSize, bytes)) {
+    throw std::runtime_error(
+        "failed to decompress asset " +
+        std::string(paths + entry.pathOffset, entry.pathLength) + " (" +
+        LveCompression::name(codec) + ")");
+  }
+}
+
+void LveArchive::read(uint32_t entry, void *dst, LveThreadPool *pool) const {
+  const Entry &e = entries[entry];
+  char *out = static_cast<char *>(dst);
+  const auto chunks = static_cast<uint32_t>(chunkCountFor(e.size, chunkSize));
+  if (pool == nullptr || chunks < 2) {
+    for (uint32_t c = 0; c < chunks; c++) {
+      readChunk(e, c, out);
+    }
+    return;
+  }
+
+  // Helpers queued behind other jobs may start after the caller has
+  // finished every chunk; they only touch this shared state then
+  struct Shared {
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::string error;
+  };
+  auto shared = std::make_shared<Shared>();
+  auto work = [this, e, out, chunks, shared] {
+    for (uint32_t c = shared->next++; c < chunks; c = shared->next++) {
+      try {
+        readChunk(e, c, out);
+      } catch (const std::exception &ex) {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        shared->error = ex.what();
+      }
+      if (++shared->done == chunks) {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        shared->finished.notify_all();
+      }
+    }
+  };
+  uint32_t helpers = std::min(chunks - 1, pool->threadCount());
+  for (uint32_t i = 0; i < helpers; i++) {
+    pool->submit(work);
+  }
+  work();
+
+  std::unique_lock<std::mutex> lock{shared->mutex};
+  shared->finished.wait(lock, [&] { return shared->done == chunks; });
+  if (!shared->error.empty()) {
+    throw std::runtime_error(shared->error);
+  }
+}
+
+LveMappedFile LveArchive::open(uint32_t entry, LveThreadPool *pool) const {
+  if (const char *stored = storedData(entry)) {
+    return LveMappedFile::view(stored, size(entry));
+  }
+  LveMappedFile buffer = LveMappedFile::allocate(size(entry));
+  read(entry, buffer.writableData(), pool);
+  return buffer;
+}
+
+bool LveArchive::mount(const std::string &filepath) {
+  if (!std::ifstream{filepath, std::ios::binary}.is_open()) {
+    return false;
+  }
+  auto archive = std::make_unique<LveArchive>(filepath);
+  archive->prefetch();
+  MountTable &table = mountTable();
+  std::lock_guard<std::mutex> lock{table.mutex};
+  table.archives.push_back(std::move(archive));
+  return true;
+}
+
+bool LveArchive::isMountedFile(const std::string &path) {
+  MountTable &table = mountTable();
+  std::lock_guard<std::mutex> lock{table.mutex};
+  if (table.loosePaths.count(normalizePath(path)) != 0) {
+    return false;
+  }
+  for (const auto &archive : table.archives) {
+    if (archive->find(path) != NOT_FOUND) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t LveArchive::mountedFileCount() {
+  MountTable &table = mountTable();
+  std::lock_guard<std::mutex> lock{table.mutex};
+  uint32_t count = 0;
+  for (const auto &archive : table.archives) {
+    count += archive->entryCount();
+  }
+  return count;
+}
+
+void LveArchive::readLoose(const std::string &path) {
+  MountTable &table = mountTable();
+  std::lock_guard<std::mutex> lock{table.mutex};
+  table.loosePaths.insert(normalizePath(path));
+}
+
+LveMappedFile LveArchive::openFile(const std::string &path,
+                                   LveMappedFile::Access access,
+                                   LveThreadPool *pool) {
+  const LveArchive *archive = nullptr;
+  uint32_t entry = NOT_FOUND;
+  {
+    MountTable &table = mountTable();
+    std::lock_guard<std::mutex> lock{table.mutex};
+    const bool loose = !table.loosePaths.empty() &&
+                       table.loosePaths.count(normalizePath(path)) != 0;
+    for (auto it = table.archives.rbegin();
+         !loose && it != table.archives.rend(); ++it) {
+      entry = (*it)->find(path);
+      if (entry != NOT_FOUND) {
+        archive = it->get();
+        break;
+      }
+    }
+  }
+  // mounted archives are never removed, so it is read without the lock
+  if (archive != nullptr) {
+    return archive->open(entry, pool);
+  }
+  return LveMappedFile{path, access};
+}
+
+std::string LveArchive::normalizePath(const std::string &path) {
+  std::string normalized = path;
+  std::replace(normalized.begin(), normalized.end(), '\\', '/');
+  size_t start = 0;
+  while (normalized.compare(start, 2, "./") == 0) {
+    start += 2;
+  }
+  return normalized.substr(start);
+}
+
+uint64_t LveArchive::hashPath(const std::string &normalizedPath) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : normalizedPath) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+LveArchiveWriter::LveArchiveWriter(uint32_t alignment, uint32_t chunkSize)
+    : alignment{alignment}, chunkSize{chunkSize} {
+  assert(alignment >= sizeof(uint32_t) && (alignment & (alignment - 1)) == 0 &&
+         "Archive alignment must be a power of two of at least 4");
+  assert(chunkSize > 0 && "Archive chunk size must not be zero");
+}
+
+void LveArchiveWriter::addFile(const std::string &path,
+                               const std::string &sourceFilepath,
+                               LveCompression::Codec codec) {
+  add(path, LveMappedFile{sourceFilepath}, codec);
+}
+
+void LveArchiveWriter::addBytes(const std::string &path, const void *bytes,
+                                size_t size, LveCompression::Codec codec) {
+  add(path, LveMappedFile::fromBytes(bytes, size), codec);
+}
+
+void LveArchiveWriter::add(const std::string &path, LveMappedFile data,
+                           LveCompression::Codec codec) {
+  if (!LveCompression::isAvailable(codec)) {
+    throw std::runtime_error(std::string("compression codec not built in: ") +
+                             LveCompression::name(codec));
+  }
+  std::string normalized = LveArchive::normalizePath(path);
+  for (const auto &source : sources) {
+    if (source.path == normalized) {
+      throw std::runtime_error("duplicate archive path: " + normalized);
+    }
+  }
+  sources.push_back({std::move(normalized), codec, std::move(data)});
+}
+
+size_t LveArchiveWriter::uncompressedBytes() const {
+  size_t bytes = 0;
+  for (const auto &source : sources) {
+    bytes += source.data.size();
+  }
+  return bytes;
+}
+
+void LveArchiveWriter::write(const std::string &filepath, LveThreadPool &pool) {
+  using Entry = LveArchive::Entry;
+
+  // compress every chunk of every source in parallel
+  struct Chunk {
+    const Source *source;
+    size_t offset;
+    size_t size;
+    std::vector<uint8_t> compressed; // empty when stored raw
+  };
+  std::vector<Chunk> chunks;
+  std::vector<Entry> entries;
+  std::string paths;
+  for (const auto &source : sources) {
+    Entry entry{};
+    entry.pathHash = LveArchive::hashPath(source.path);
+    entry.size = source.data.size();
+    entry.pathOffset = static_cast<uint32_t>(paths.size());
+    entry.pathLength = static_cast<uint32_t>(source.path.size());
+    entry.firstChunk = static_cast<uint32_t>(chunks.size());
+    entry.codec = static_cast<uint32_t>(source.codec);
+    entries.push_back(entry);
+    paths += source.path;
+    for (size_t offset = 0; offset < source.data.size(); offset += chunkSize) {
+      size_t size = std::min<size_t>(chunkSize, source.data.size() - offset);
+      chunks.push_back({&source, offset, size, {}});
+    }
+  }
+
+  std::mutex errorMutex;
+  std::string error;
+  for (auto &chunk : chunks) {
+    if (chunk.source->codec == LveCompression::Codec::None) {
+      continue;
+    }
+    pool.submit([&chunk, &errorMutex, &error] {
+      try {
+        LveCompression::compress(chunk.source->codec,
+                                 chunk.source->data.data() + chunk.offset,
+                                 chunk.size, chunk.compressed);
+        if (chunk.compressed.size() >= chunk.size) {
+          chunk.compressed.clear(); // did not shrink: store it raw
+        }
+      } catch (const std::exception &e) {
+        std::lock_guard<std::mutex> lock{errorMutex};
+        error = e.what();
+      }
+    });
+  }
+  pool.waitIdle();
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+
+  // data follows the table of contents in the order sources were added
+  uint64_t offset = sizeof(LveArchive::Header) +
+                    entries.size() * sizeof(Entry) +
+                    chunks.size() * sizeof(uint32_t) + paths.size();
+  std::vector<uint32_t> storedSizes;
+  for (auto &entry : entries) {
+    offset = alignUp(offset, alignment);
+    entry.offset = offset;
+    for (uint32_t c = 0; c < chunkCountFor(entry.size, chunkSize); c++) {
+      const Chunk &chunk = chunks[entry.firstChunk + c];
+      size_t stored =
+          chunk.compressed.empty() ? chunk.size : chunk.compressed.size();
+      storedSizes.push_back(static_cast<uint32_t>(stored));
+      offset += stored;
+    }
+  }
+
+  std::vector<Entry> toc = entries;
+  std::sort(toc.begin(), toc.end(), [&](const Entry &a, const Entry &b) {
+    if (a.pathHash != b.pathHash) {
+      return a.pathHash < b.pathHash;
+    }
+    return paths.compare(a.pathOffset, a.pathLength, paths, b.pathOffset,
+                         b.pathLength) < 0;
+  });
+
+  LveArchive::Header header{};
+  header.magic = LveArchive::MAGIC;
+  header.version = LveArchive::VERSION;
+  header.alignment = alignment;
+  header.chunkSize = chunkSize;
+  header.entryCount = static_cast<uint32_t>(toc.size());
+  header.chunkCount = static_cast<uint32_t>(storedSizes.size());
+  header.pathBytes = static_cast<uint32_t>(paths.size());
+
+  std::ofstream out{filepath, std::ios::binary | std::ios::trunc};
+  if (!out.is_open()) {
+    throw std::runtime_error("failed to open file: " + filepath);
+  }
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(toc.data()),
+            toc.size() * sizeof(Entry));
+  out.write(reinterpret_cast<const char *>(storedSizes.data()),
+            storedSizes.size() * sizeof(uint32_t));
+  out.write(paths.data(), paths.size());
+
+  uint64_t position = static_cast<uint64_t>(out.tellp());
+  const std::vector<char> padding(alignment, 0);
+  for (const auto &entry : entries) {
+    out.write(padding.data(), entry.offset - position);
+    position = entry.offset;
+    for (uint32_t c = 0; c < chunkCountFor(entry.size, chunkSize); c++) {
+      const Chunk &chunk = chunks[entry.firstChunk + c];
+      if (chunk.compressed.empty()) {
+        out.write(chunk.source->data.data() + chunk.offset, chunk.size);
+        position += chunk.size;
+      } else {
+        out.write(reinterpret_cast<const char *>(chunk.compressed.data()),
+                  chunk.compressed.size());
+        position += chunk.compressed.size();
+      }
+    }
+  }
+  if (!out) {
+    throw std::runtime_error("failed to write asset archive: " + filepath);
+  }
+  written = position;
+}
+
+} // namespace lve
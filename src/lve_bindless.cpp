@@ -0,0 +1,191 @@
+#include "../include/lve_bindless.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace lve {
+
+LveBindlessTable::LveBindlessTable(LveDevice &device) : lveDevice{device} {
+  assert(lveDevice.bindlessSupported &&
+         "LveBindlessTable requires descriptor indexing");
+
+  const auto &limits = lveDevice.descriptorIndexingProperties;
+  images.capacity =
+      std::min({MAX_IMAGES, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+  storageBuffers.capacity = std::min(
+      {MAX_STORAGE_BUFFERS, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+       limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+  createSetLayout();
+  createDescriptorSet();
+}
+
+LveBindlessTable::~LveBindlessTable() {
+  vkDestroyDescriptorPool(lveDevice.device(), descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(lveDevice.device(), setLayout, nullptr);
+}
+
+void LveBindlessTable::createSetLayout() {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = IMAGE_BINDING;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = images.capacity;
+  bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+  bindings[1].binding = STORAGE_BUFFER_BINDING;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = storageBuffers.capacity;
+  bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+  // slots that were never written stay legal as long as shaders skip them
+  const VkDescriptorBindingFlags bindingFlags =
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  std::array<VkDescriptorBindingFlags, 2> flags{bindingFlags, bindingFlags};
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+  flagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.bindingCount = static_cast<uint32_t>(flags.size());
+  flagsInfo.pBindingFlags = flags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr,
+                                  &setLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor set layout!");
+  }
+}
+
+void LveBindlessTable::createDescriptorSet() {
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = images.capacity;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = storageBuffers.capacity;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr,
+                             &descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+
+  if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo,
+                               &descriptorSet) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+}
+
+void LveBindlessTable::beginFrame(int frameIndex) {
+  // frameIndex's fence has signalled: nothing in flight still references
+  // the indices released while it was being recorded
+  for (Slots *slots : {&images, &storageBuffers}) {
+    auto &pending = slots->pending[frameIndex];
+    slots->freeList.insert(slots->freeList.end(), pending.begin(),
+                           pending.end());
+    pending.clear();
+  }
+  currentFrame = frameIndex;
+}
+
+uint32_t LveBindlessTable::addImage(VkImageView imageView, VkSampler sampler,
+                                    VkImageLayout layout) {
+  uint32_t index = acquire(images, "images");
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = imageView;
+  imageInfo.imageLayout = layout;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = IMAGE_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(lveDevice.device(), 1, &write, 0, nullptr);
+  return index;
+}
+
+uint32_t LveBindlessTable::addStorageBuffer(VkBuffer buffer,
+                                            VkDeviceSize offset,
+                                            VkDeviceSize range) {
+  uint32_t index = acquire(storageBuffers, "storage buffers");
+
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = offset;
+  bufferInfo.range = range;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = STORAGE_BUFFER_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(lveDevice.device(), 1, &write, 0, nullptr);
+  return index;
+}
+
+void LveBindlessTable::releaseImage(uint32_t index) { release(images, index); }
+
+void LveBindlessTable::releaseStorageBuffer(uint32_t index) {
+  release(storageBuffers, index);
+}
+
+void LveBindlessTable::bind(VkCommandBuffer commandBuffer,
+                            VkPipelineLayout pipelineLayout, uint32_t setIndex,
+                            VkPipelineBindPoint bindPoint) {
+  vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, setIndex, 1,
+                          &descriptorSet, 0, nullptr);
+}
+
+uint32_t LveBindlessTable::acquire(Slots &slots, const char *what) {
+  uint32_t index;
+  if (!slots.freeList.empty()) {
+    index = slots.freeList.back();
+    slots.freeList.pop_back();
+  } else if (slots.next < slots.capacity) {
+    index = slots.next++;
+  } else {
+    throw std::runtime_error(std::string("bindless table is out of ") + what +
+                             "!");
+  }
+  slots.inUse++;
+  return index;
+}
+
+void LveBindlessTable::release(Slots &slots, uint32_t index) {
+  assert(index < slots.next && "Releasing an index that was never acquired");
+  slots.pending[currentFrame].push_back(index);
+  slots.inUse--;
+}
+
+} // namespace lve
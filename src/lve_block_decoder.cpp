@@ -0,0 +1,558 @@
+#include "../include/lve_block_decoder.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+// ***************** BC1-BC5 *********************
+
+void decodeColor565(uint16_t color, uint8_t *rgb) {
+  uint8_t r = (color >> 11) & 0x1f;
+  uint8_t g = (color >> 5) & 0x3f;
+  uint8_t b = color & 0x1f;
+  rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+  rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+  rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+}
+
+// BC1 colour block; BC2 and BC3 always use the four colour mode
+void decodeColorBlock(const uint8_t *block, uint8_t *rgba,
+                      bool allowPunchThrough) {
+  uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+  uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+  uint8_t palette[4][4];
+  decodeColor565(c0, palette[0]);
+  decodeColor565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = 255;
+
+  if (c0 > c1 || !allowPunchThrough) {
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] =
+          static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+      palette[3][c] =
+          static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+    }
+    palette[2][3] = palette[3][3] = 255;
+  } else {
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] =
+          static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+      palette[3][c] = 0;
+    }
+    palette[2][3] = 255;
+    palette[3][3] = 0;
+  }
+
+  uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+                     (static_cast<uint32_t>(block[7]) << 24);
+  for (int i = 0; i < 16; i++) {
+    std::memcpy(rgba + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+  }
+}
+
+// BC3 alpha / BC4 / BC5 channel block, written to every 4th byte of out
+void decodeChannelBlock(const uint8_t *block, uint8_t *out) {
+  uint8_t palette[8];
+  palette[0] = block[0];
+  palette[1] = block[1];
+  if (palette[0] > palette[1]) {
+    for (int i = 1; i < 7; i++) {
+      palette[i + 1] = static_cast<uint8_t>(
+          ((7 - i) * palette[0] + i * palette[1] + 3) / 7);
+    }
+  } else {
+    for (int i = 1; i < 5; i++) {
+      palette[i + 1] = static_cast<uint8_t>(
+          ((5 - i) * palette[0] + i * palette[1] + 2) / 5);
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    out[i * 4] = palette[(indices >> (3 * i)) & 7];
+  }
+}
+
+// ***************** BC7 *********************
+
+struct Bc7Mode {
+  uint8_t subsets;
+  uint8_t partitionBits;
+  uint8_t rotationBits;
+  uint8_t indexSelectionBits;
+  uint8_t colorBits;
+  uint8_t alphaBits;
+  uint8_t endpointPBits;
+  uint8_t sharedPBits;
+  uint8_t indexBits;
+  uint8_t secondaryIndexBits;
+};
+
+constexpr Bc7Mode BC7_MODES[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0}, {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0}, {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3}, {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0}, {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+// subset of each texel for the 64 two- and three-subset partitions
+constexpr uint8_t BC7_PARTITIONS_2[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+    {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1},
+    {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0},
+    {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+    {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+    {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1},
+    {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0},
+    {0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0},
+    {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+    {0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0},
+    {0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1},
+    {0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0},
+    {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0},
+    {0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0},
+    {0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1},
+    {0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1},
+    {0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0},
+    {0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0},
+    {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0},
+    {0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1},
+    {0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1},
+    {0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0},
+    {0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0},
+    {0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+    {0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0},
+    {0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+    {0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1},
+    {0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1},
+    {0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+    {0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0},
+    {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1},
+};
+
+constexpr uint8_t BC7_PARTITIONS_3[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2},
+    {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2},
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+    {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+    {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2},
+    {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+    {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2},
+    {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0},
+    {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0},
+    {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+    {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+    {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+    {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2},
+    {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0},
+    {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+    {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0},
+    {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1},
+    {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1},
+    {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+    {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2},
+    {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2},
+    {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+    {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+    {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1},
+    {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0},
+};
+
+// texel whose index drops its top bit, for subsets after the first
+constexpr uint8_t BC7_ANCHOR_2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2,  8,  2,  2,  8,  8,  15, 2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,
+    6,  2,  6,  8,  15, 15, 2,  2,  15, 15, 15, 15, 15, 2,  2,  15,
+};
+
+constexpr uint8_t BC7_ANCHOR_3_SECOND[64] = {
+    3,  3,  15, 15, 8,  3,  15, 15, 8,  8,  6,  6,  6,  5,  3,  3,
+    3,  3,  8,  15, 3,  3,  6,  10, 5,  8,  8,  6,  8,  5,  15, 15,
+    8,  15, 3,  5,  6,  10, 8,  15, 15, 3,  15, 5,  15, 15, 15, 15,
+    3,  15, 5,  5,  5,  8,  5,  10, 5,  10, 8,  13, 15, 12, 3,  3,
+};
+
+constexpr uint8_t BC7_ANCHOR_3_THIRD[64] = {
+    15, 8,  8,  3,  15, 15, 3,  8,  15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8,  15, 3,  15, 8,  15, 8,  3,  15, 6,  10, 15, 15, 10, 8,
+    15, 3,  15, 10, 10, 8,  9,  10, 6,  15, 8,  15, 3,  6,  6,  8,
+    15, 3,  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3,  15, 15, 8,
+};
+
+constexpr uint8_t BC7_WEIGHTS_2[4] = {0, 21, 43, 64};
+constexpr uint8_t BC7_WEIGHTS_3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+constexpr uint8_t BC7_WEIGHTS_4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                       34, 38, 43, 47, 51, 55, 60, 64};
+
+// LSB-first reader over one 128-bit block
+class BitReader {
+public:
+  explicit BitReader(const uint8_t *block) {
+    std::memcpy(&low, block, 8);
+    std::memcpy(&high, block + 8, 8);
+  }
+
+  uint32_t read(uint32_t count) {
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t value;
+    if (position >= 64) {
+      value = high >> (position - 64);
+    } else if (position + count <= 64) {
+      value = low >> position;
+    } else {
+      value = (low >> position) | (high << (64 - position));
+    }
+    position += count;
+    return static_cast<uint32_t>(value & ((1ull << count) - 1));
+  }
+
+private:
+  // blocks are little-endian; so are the platforms we build for
+  uint64_t low;
+  uint64_t high;
+  uint32_t position = 0;
+};
+
+const uint8_t *bc7Weights(uint32_t indexBits) {
+  return indexBits == 2 ? BC7_WEIGHTS_2
+                        : indexBits == 3 ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4;
+}
+
+uint8_t bc7Interpolate(uint8_t e0, uint8_t e1, uint8_t weight) {
+  return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+uint8_t bc7Expand(uint32_t value, uint32_t bits) {
+  value <<= 8 - bits;
+  return static_cast<uint8_t>(value | (value >> bits));
+}
+
+void decodeBc7Block(const uint8_t *block, uint8_t *rgba) {
+  uint32_t modeIndex = 0;
+  while (modeIndex < 8 && !(block[0] & (1u << modeIndex))) {
+    modeIndex++;
+  }
+  if (modeIndex == 8) {
+    // reserved mode: decoders must return transparent black
+    std::memset(rgba, 0, 16 * 4);
+    return;
+  }
+  const Bc7Mode &mode = BC7_MODES[modeIndex];
+
+  BitReader bits{block};
+  bits.read(modeIndex + 1);
+  uint32_t partition = bits.read(mode.partitionBits);
+  uint32_t rotation = bits.read(mode.rotationBits);
+  uint32_t indexSelection = bits.read(mode.indexSelectionBits);
+
+  // endpoints[subset * 2 + end][channel]
+  const uint32_t endpointCount = mode.subsets * 2u;
+  uint32_t endpoints[6][4] = {};
+  for (uint32_t c = 0; c < 3; c++) {
+    for (uint32_t e = 0; e < endpointCount; e++) {
+      endpoints[e][c] = bits.read(mode.colorBits);
+    }
+  }
+  for (uint32_t e = 0; e < endpointCount; e++) {
+    endpoints[e][3] = mode.alphaBits > 0 ? bits.read(mode.alphaBits) : 255;
+  }
+
+  uint32_t colorBits = mode.colorBits;
+  uint32_t alphaBits = mode.alphaBits;
+  if (mode.endpointPBits || mode.sharedPBits) {
+    uint32_t pBits[6];
+    if (mode.endpointPBits) {
+      for (uint32_t e = 0; e < endpointCount; e++) {
+        pBits[e] = bits.read(1);
+      }
+    } else {
+      for (uint32_t s = 0; s < mode.subsets; s++) {
+        pBits[s * 2] = pBits[s * 2 + 1] = bits.read(1);
+      }
+    }
+    for (uint32_t e = 0; e < endpointCount; e++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+      }
+      if (mode.alphaBits > 0) {
+        endpoints[e][3] = (endpoints[e][3] << 1) | pBits[e];
+      }
+    }
+    colorBits++;
+    if (alphaBits > 0) {
+      alphaBits++;
+    }
+  }
+
+  uint8_t unpacked[6][4];
+  for (uint32_t e = 0; e < endpointCount; e++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      unpacked[e][c] = bc7Expand(endpoints[e][c], colorBits);
+    }
+    unpacked[e][3] =
+        alphaBits > 0 ? bc7Expand(endpoints[e][3], alphaBits) : 255;
+  }
+
+  const uint8_t *subsetOf = nullptr;
+  if (mode.subsets == 2) {
+    subsetOf = BC7_PARTITIONS_2[partition];
+  } else if (mode.subsets == 3) {
+    subsetOf = BC7_PARTITIONS_3[partition];
+  }
+  auto isAnchor = [&](uint32_t texel) {
+    if (texel == 0) {
+      return true;
+    }
+    if (mode.subsets == 2) {
+      return texel == BC7_ANCHOR_2[partition];
+    }
+    if (mode.subsets == 3) {
+      return texel == BC7_ANCHOR_3_SECOND[partition] ||
+             texel == BC7_ANCHOR_3_THIRD[partition];
+    }
+    return false;
+  };
+
+  uint32_t indices[16];
+  for (uint32_t i = 0; i < 16; i++) {
+    indices[i] = bits.read(mode.indexBits - (isAnchor(i) ? 1 : 0));
+  }
+  uint32_t secondaryIndices[16] = {};
+  if (mode.secondaryIndexBits > 0) {
+    for (uint32_t i = 0; i < 16; i++) {
+      secondaryIndices[i] =
+          bits.read(mode.secondaryIndexBits - (i == 0 ? 1 : 0));
+    }
+  }
+
+  const uint8_t *colorWeights = bc7Weights(mode.indexBits);
+  const uint8_t *alphaWeights = colorWeights;
+  const uint32_t *colorIndices = indices;
+  const uint32_t *alphaIndices = indices;
+  if (mode.secondaryIndexBits > 0) {
+    // modes 4 and 5: separate colour and alpha indices, swapped by the
+    // index selection bit
+    alphaIndices = secondaryIndices;
+    alphaWeights = bc7Weights(mode.secondaryIndexBits);
+    if (indexSelection) {
+      std::swap(colorIndices, alphaIndices);
+      std::swap(colorWeights, alphaWeights);
+    }
+  }
+
+  for (uint32_t i = 0; i < 16; i++) {
+    uint32_t subset = subsetOf != nullptr ? subsetOf[i] : 0;
+    const uint8_t *e0 = unpacked[subset * 2];
+    const uint8_t *e1 = unpacked[subset * 2 + 1];
+    uint8_t *texel = rgba + i * 4;
+    for (uint32_t c = 0; c < 3; c++) {
+      texel[c] = bc7Interpolate(e0[c], e1[c], colorWeights[colorIndices[i]]);
+    }
+    texel[3] = bc7Interpolate(e0[3], e1[3], alphaWeights[alphaIndices[i]]);
+    if (rotation > 0) {
+      std::swap(texel[3], texel[rotation - 1]);
+    }
+  }
+}
+
+} // namespace
+
+uint32_t LveBlockDecoder::blockBytes(LveBlockFormat format) {
+  switch (format) {
+  case LveBlockFormat::BC1:
+  case LveBlockFormat::BC4:
+    return 8;
+  default:
+    return 16;
+  }
+}
+
+const char *LveBlockDecoder::name(LveBlockFormat format) {
+  switch (format) {
+  case LveBlockFormat::BC1:
+    return "BC1";
+  case LveBlockFormat::BC2:
+    return "BC2";
+  case LveBlockFormat::BC3:
+    return "BC3";
+  case LveBlockFormat::BC4:
+    return "BC4";
+  case LveBlockFormat::BC5:
+    return "BC5";
+  case LveBlockFormat::BC6H:
+    return "BC6H";
+  case LveBlockFormat::BC7:
+    return "BC7";
+  }
+  return "unknown";
+}
+
+size_t LveBlockDecoder::levelBytes(LveBlockFormat format, uint32_t width,
+                                   uint32_t height) {
+  size_t blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  size_t blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  return blocksX * blocksY * blockBytes(format);
+}
+
+void LveBlockDecoder::decodeBlock(LveBlockFormat format, const uint8_t *block,
+                                  uint8_t *rgba) {
+  switch (format) {
+  case LveBlockFormat::BC1:
+    decodeColorBlock(block, rgba, true);
+    break;
+  case LveBlockFormat::BC2:
+    decodeColorBlock(block + 8, rgba, false);
+    for (int i = 0; i < 16; i++) {
+      uint8_t alpha = (block[i / 2] >> (4 * (i & 1))) & 0xf;
+      rgba[i * 4 + 3] = static_cast<uint8_t>(alpha * 17);
+    }
+    break;
+  case LveBlockFormat::BC3:
+    decodeColorBlock(block + 8, rgba, false);
+    decodeChannelBlock(block, rgba + 3);
+    break;
+  case LveBlockFormat::BC4:
+    for (int i = 0; i < 16; i++) {
+      rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+      rgba[i * 4 + 3] = 255;
+    }
+    decodeChannelBlock(block, rgba);
+    break;
+  case LveBlockFormat::BC5:
+    for (int i = 0; i < 16; i++) {
+      rgba[i * 4 + 2] = 0;
+      rgba[i * 4 + 3] = 255;
+    }
+    decodeChannelBlock(block, rgba);
+    decodeChannelBlock(block + 8, rgba + 1);
+    break;
+  case LveBlockFormat::BC7:
+    decodeBc7Block(block, rgba);
+    break;
+  case LveBlockFormat::BC6H:
+    throw std::runtime_error("BC6H cannot be decoded to RGBA8!");
+  }
+}
+
+LveImageData LveBlockDecoder::decode(LveBlockFormat format,
+                                     const uint8_t *blocks, uint32_t width,
+                                     uint32_t height) {
+  if (!canDecode(format)) {
+    throw std::runtime_error(std::string("no CPU decoder for ") +
+                             name(format) + "!");
+  }
+  LveImageData image{};
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+  const uint32_t blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  const uint32_t blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  const uint32_t stride = blockBytes(format);
+  uint8_t texels[16 * 4];
+  for (uint32_t by = 0; by < blocksY; by++) {
+    for (uint32_t bx = 0; bx < blocksX; bx++) {
+      size_t blockIndex = static_cast<size_t>(by) * blocksX + bx;
+      decodeBlock(format, blocks + blockIndex * stride, texels);
+      // edge blocks of levels that are not a multiple of 4 are cropped
+      uint32_t rows = std::min(BLOCK_SIZE, height - by * BLOCK_SIZE);
+      uint32_t columns = std::min(BLOCK_SIZE, width - bx * BLOCK_SIZE);
+      for (uint32_t y = 0; y < rows; y++) {
+        uint8_t *dst = image.pixels.data() +
+                       ((static_cast<size_t>(by) * BLOCK_SIZE + y) * width +
+                        bx * BLOCK_SIZE) *
+                           4;
+        std::memcpy(dst, texels + y * BLOCK_SIZE * 4, columns * 4);
+      }
+    }
+  }
+  return image;
+}
+
+} // namespace lve
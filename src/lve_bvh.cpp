@@ -0,0 +1,501 @@
+#include "../include/lve_bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+constexpr int SAH_BINS = 16;
+constexpr uint32_t ALL_PLANES = (1u << LveFrustum::PLANE_COUNT) - 1;
+
+bool sameBounds(const LveAabb &a, const LveAabb &b) {
+  return a.min == b.min && a.max == b.max;
+}
+} // namespace
+
+LveBvh::LveBvh(float margin) : margin{margin} {}
+
+LveAabb LveBvh::fatten(const LveAabb &bounds) const {
+  LveAabb fat = bounds;
+  fat.min -= glm::vec3{margin};
+  fat.max += glm::vec3{margin};
+  return fat;
+}
+
+int32_t LveBvh::allocateNode() {
+  if (freeList != NULL_NODE) {
+    int32_t node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node{};
+    return node;
+  }
+  nodes.emplace_back();
+  return static_cast<int32_t>(nodes.size() - 1);
+}
+
+void LveBvh::freeNode(int32_t node) {
+  nodes[node].parent = freeList;
+  nodes[node].child1 = NULL_NODE;
+  nodes[node].child2 = NULL_NODE;
+  freeList = node;
+}
+
+void LveBvh::insert(id_t id, const LveAabb &bounds) {
+  if (leaves.count(id) != 0) {
+    throw std::runtime_error("object is already in the bvh");
+  }
+  int32_t leaf = allocateNode();
+  nodes[leaf].bounds = fatten(bounds);
+  nodes[leaf].id = id;
+  leaves.emplace(id, leaf);
+  insertLeaf(leaf);
+}
+
+void LveBvh::remove(id_t id) {
+  auto it = leaves.find(id);
+  if (it == leaves.end()) {
+    return;
+  }
+  removeLeaf(it->second);
+  freeNode(it->second);
+  leaves.erase(it);
+}
+
+void LveBvh::insertBatch(
+    const std::vector<std::pair<id_t, LveAabb>> &objects) {
+  // small batches into a big tree: incremental insertion is cheaper
+  if (objects.size() < leaves.size()) {
+    for (const auto &object : objects) {
+      insert(object.first, object.second);
+    }
+    return;
+  }
+
+  for (const auto &object : objects) {
+    if (leaves.count(object.first) != 0) {
+      throw std::runtime_error("object is already in the bvh");
+    }
+    int32_t leaf = allocateNode();
+    nodes[leaf].bounds = fatten(object.second);
+    nodes[leaf].id = object.first;
+    leaves.emplace(object.first, leaf);
+  }
+  rebuild();
+}
+
+void LveBvh::removeBatch(const std::vector<id_t> &ids) {
+  if (ids.size() * 2 < leaves.size()) {
+    for (id_t id : ids) {
+      remove(id);
+    }
+    return;
+  }
+
+  // removing most of the tree: drop the leaves and rebuild what is left
+  for (id_t id : ids) {
+    auto it = leaves.find(id);
+    if (it == leaves.end()) {
+      continue;
+    }
+    freeNode(it->second);
+    leaves.erase(it);
+  }
+  rebuild();
+}
+
+bool LveBvh::update(id_t id, const LveAabb &bounds) {
+  auto it = leaves.find(id);
+  assert(it != leaves.end() && "Cannot update an object that is not in bvh");
+  int32_t leaf = it->second;
+  if (nodes[leaf].bounds.contains(bounds)) {
+    return false;
+  }
+
+  nodes[leaf].bounds = fatten(bounds);
+  refitAncestors(nodes[leaf].parent);
+  return true;
+}
+
+void LveBvh::refitAncestors(int32_t node) {
+  while (node != NULL_NODE) {
+    Node &n = nodes[node];
+    LveAabb refit =
+        LveAabb::merge(nodes[n.child1].bounds, nodes[n.child2].bounds);
+    if (sameBounds(refit, n.bounds)) {
+      break;
+    }
+    n.bounds = refit;
+    node = n.parent;
+  }
+}
+
+void LveBvh::insertLeaf(int32_t leaf) {
+  if (root == NULL_NODE) {
+    root = leaf;
+    nodes[root].parent = NULL_NODE;
+    return;
+  }
+
+  // descend towards the sibling that minimises the added surface area
+  const LveAabb leafBounds = nodes[leaf].bounds;
+  int32_t index = root;
+  while (!nodes[index].isLeaf()) {
+    const Node &node = nodes[index];
+    float area = node.bounds.surfaceArea();
+    float combinedArea = LveAabb::merge(node.bounds, leafBounds).surfaceArea();
+
+    float cost = 2.f * combinedArea;
+    float inheritanceCost = 2.f * (combinedArea - area);
+
+    auto descendCost = [&](int32_t child) {
+      float merged =
+          LveAabb::merge(leafBounds, nodes[child].bounds).surfaceArea();
+      if (nodes[child].isLeaf()) {
+        return merged + inheritanceCost;
+      }
+      return merged - nodes[child].bounds.surfaceArea() + inheritanceCost;
+    };
+    float cost1 = descendCost(node.child1);
+    float cost2 = descendCost(node.child2);
+
+    if (cost < cost1 && cost < cost2) {
+      break;
+    }
+    index = cost1 < cost2 ? node.child1 : node.child2;
+  }
+
+  int32_t sibling = index;
+  int32_t oldParent = nodes[sibling].parent;
+  int32_t newParent = allocateNode();
+  nodes[newParent].parent = oldParent;
+  nodes[newParent].bounds =
+      LveAabb::merge(leafBounds, nodes[sibling].bounds);
+  nodes[newParent].child1 = sibling;
+  nodes[newParent].child2 = leaf;
+  nodes[sibling].parent = newParent;
+  nodes[leaf].parent = newParent;
+
+  if (oldParent == NULL_NODE) {
+    root = newParent;
+  } else if (nodes[oldParent].child1 == sibling) {
+    nodes[oldParent].child1 = newParent;
+  } else {
+    nodes[oldParent].child2 = newParent;
+  }
+
+  refitAncestors(oldParent);
+}
+
+void LveBvh::removeLeaf(int32_t leaf) {
+  if (leaf == root) {
+    root = NULL_NODE;
+    return;
+  }
+
+  int32_t parent = nodes[leaf].parent;
+  int32_t grandParent = nodes[parent].parent;
+  int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2
+                                                  : nodes[parent].child1;
+
+  if (grandParent == NULL_NODE) {
+    root = sibling;
+    nodes[sibling].parent = NULL_NODE;
+  } else {
+    if (nodes[grandParent].child1 == parent) {
+      nodes[grandParent].child1 = sibling;
+    } else {
+      nodes[grandParent].child2 = sibling;
+    }
+    nodes[sibling].parent = grandParent;
+    refitAncestors(grandParent);
+  }
+  freeNode(parent);
+}
+
+void LveBvh::rebuild() {
+  // build from a compact copy of the leaf boxes so the partitioning passes
+  // stream through memory instead of chasing node indices
+  std::vector<BuildEntry> entries;
+  entries.reserve(leaves.size());
+  std::vector<bool> isLeafSlot(nodes.size(), false);
+  for (const auto &kv : leaves) {
+    const LveAabb &bounds = nodes[kv.second].bounds;
+    entries.push_back({bounds, bounds.center(), kv.second});
+    isLeafSlot[kv.second] = true;
+  }
+
+  // release every internal node; leaves keep their slots
+  freeList = NULL_NODE;
+  for (int32_t i = static_cast<int32_t>(nodes.size()) - 1; i >= 0; i--) {
+    if (!isLeafSlot[i]) {
+      freeNode(i);
+    }
+  }
+
+  root = NULL_NODE;
+  if (!entries.empty()) {
+    root = buildRange(entries, 0, entries.size());
+    nodes[root].parent = NULL_NODE;
+  }
+}
+
+int32_t LveBvh::buildRange(std::vector<BuildEntry> &entries, size_t begin,
+                           size_t end) {
+  if (end - begin == 1) {
+    return entries[begin].node;
+  }
+
+  LveAabb bounds{};
+  LveAabb centroidBounds{};
+  for (size_t i = begin; i < end; i++) {
+    bounds.expand(entries[i].bounds);
+    centroidBounds.expand(entries[i].centroid);
+  }
+
+  glm::vec3 extent = centroidBounds.extent();
+  int axis = 0;
+  if (extent.y > extent[axis]) axis = 1;
+  if (extent.z > extent[axis]) axis = 2;
+
+  size_t mid = begin + (end - begin) / 2;
+  if (extent[axis] > 0.f) {
+    struct Bin {
+      LveAabb bounds{};
+      size_t count = 0;
+    };
+    Bin bins[SAH_BINS];
+    const float scale = SAH_BINS / extent[axis];
+    auto binOf = [&](const BuildEntry &entry) {
+      int b = static_cast<int>(
+          (entry.centroid[axis] - centroidBounds.min[axis]) * scale);
+      return std::min(b, SAH_BINS - 1);
+    };
+    for (size_t i = begin; i < end; i++) {
+      Bin &bin = bins[binOf(entries[i])];
+      bin.bounds.expand(entries[i].bounds);
+      bin.count++;
+    }
+
+    // sweep from the right to get suffix areas, then pick the cheapest split
+    float rightArea[SAH_BINS];
+    size_t rightCount[SAH_BINS];
+    LveAabb accum{};
+    size_t count = 0;
+    for (int b = SAH_BINS - 1; b > 0; b--) {
+      accum.expand(bins[b].bounds);
+      count += bins[b].count;
+      rightArea[b] = accum.isEmpty() ? 0.f : accum.surfaceArea();
+      rightCount[b] = count;
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestSplit = -1;
+    accum = LveAabb{};
+    count = 0;
+    for (int b = 0; b < SAH_BINS - 1; b++) {
+      accum.expand(bins[b].bounds);
+      count += bins[b].count;
+      if (count == 0 || rightCount[b + 1] == 0) {
+        continue;
+      }
+      float cost = count * accum.surfaceArea() +
+                   rightCount[b + 1] * rightArea[b + 1];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestSplit = b;
+      }
+    }
+
+    if (bestSplit >= 0) {
+      auto it = std::partition(
+          entries.begin() + begin, entries.begin() + end,
+          [&](const BuildEntry &entry) { return binOf(entry) <= bestSplit; });
+      mid = static_cast<size_t>(it - entries.begin());
+    }
+  }
+
+  if (mid == begin || mid == end) {
+    // all centroids coincide along the axis: fall back to a median split
+    mid = begin + (end - begin) / 2;
+    std::nth_element(entries.begin() + begin, entries.begin() + mid,
+                     entries.begin() + end,
+                     [&](const BuildEntry &a, const BuildEntry &b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+  }
+
+  int32_t node = allocateNode();
+  int32_t child1 = buildRange(entries, begin, mid);
+  int32_t child2 = buildRange(entries, mid, end);
+  nodes[node].bounds = bounds;
+  nodes[node].child1 = child1;
+  nodes[node].child2 = child2;
+  nodes[child1].parent = node;
+  nodes[child2].parent = node;
+  return node;
+}
+
+void LveBvh::clear() {
+  nodes.clear();
+  leaves.clear();
+  root = NULL_NODE;
+  freeList = NULL_NODE;
+}
+
+void LveBvh::queryFrustum(const LveFrustum &frustum,
+                          std::vector<id_t> &result) const {
+  if (root == NULL_NODE) {
+    return;
+  }
+
+  // the mask tracks planes the node still straddles; once a node is fully
+  // inside every plane its whole subtree is accepted without further tests
+  std::vector<std::pair<int32_t, uint32_t>> &todo = stack;
+  todo.clear();
+  todo.push_back({root, ALL_PLANES});
+  while (!todo.empty()) {
+    auto [index, mask] = todo.back();
+    todo.pop_back();
+    const Node &node = nodes[index];
+
+    bool outside = false;
+    for (int p = 0; p < LveFrustum::PLANE_COUNT && mask != 0; p++) {
+      if ((mask & (1u << p)) == 0) {
+        continue;
+      }
+      const glm::vec4 &plane = frustum.planes[p];
+      glm::vec3 normal{plane};
+      glm::vec3 positive{normal.x >= 0.f ? node.bounds.max.x
+                                         : node.bounds.min.x,
+                         normal.y >= 0.f ? node.bounds.max.y
+                                         : node.bounds.min.y,
+                         normal.z >= 0.f ? node.bounds.max.z
+                                         : node.bounds.min.z};
+      if (glm::dot(normal, positive) + plane.w < 0.f) {
+        outside = true;
+        break;
+      }
+      glm::vec3 negative{normal.x >= 0.f ? node.bounds.min.x
+                                         : node.bounds.max.x,
+                         normal.y >= 0.f ? node.bounds.min.y
+                                         : node.bounds.max.y,
+                         normal.z >= 0.f ? node.bounds.min.z
+                                         : node.bounds.max.z};
+      if (glm::dot(normal, negative) + plane.w >= 0.f) {
+        mask &= ~(1u << p);
+      }
+    }
+    if (outside) {
+      continue;
+    }
+
+    if (node.isLeaf()) {
+      result.push_back(node.id);
+    } else {
+      todo.push_back({node.child1, mask});
+      todo.push_back({node.child2, mask});
+    }
+  }
+}
+
+void LveBvh::queryAabb(const LveAabb &bounds,
+                       std::vector<id_t> &result) const {
+  if (root == NULL_NODE) {
+    return;
+  }
+  std::vector<std::pair<int32_t, uint32_t>> &todo = stack;
+  todo.clear();
+  todo.push_back({root, 0});
+  while (!todo.empty()) {
+    const Node &node = nodes[todo.back().first];
+    todo.pop_back();
+    if (!node.bounds.overlaps(bounds)) {
+      continue;
+    }
+    if (node.isLeaf()) {
+      result.push_back(node.id);
+    } else {
+      todo.push_back({node.child1, 0});
+      todo.push_back({node.child2, 0});
+    }
+  }
+}
+
+void LveBvh::queryRay(const glm::vec3 &origin, const glm::vec3 &direction,
+                      float maxDistance, std::vector<id_t> &result) const {
+  if (root == NULL_NODE) {
+    return;
+  }
+  const glm::vec3 inverseDirection = glm::vec3{1.f} / direction;
+
+  auto hits = [&](const LveAabb &box) {
+    float tMin = 0.f;
+    float tMax = maxDistance;
+    for (int i = 0; i < 3; i++) {
+      float t1 = (box.min[i] - origin[i]) * inverseDirection[i];
+      float t2 = (box.max[i] - origin[i]) * inverseDirection[i];
+      tMin = std::max(tMin, std::min(t1, t2));
+      tMax = std::min(tMax, std::max(t1, t2));
+    }
+    return tMin <= tMax;
+  };
+
+  std::vector<std::pair<int32_t, uint32_t>> &todo = stack;
+  todo.clear();
+  todo.push_back({root, 0});
+  while (!todo.empty()) {
+    const Node &node = nodes[todo.back().first];
+    todo.pop_back();
+    if (!hits(node.bounds)) {
+      continue;
+    }
+    if (node.isLeaf()) {
+      result.push_back(node.id);
+    } else {
+      todo.push_back({node.child1, 0});
+      todo.push_back({node.child2, 0});
+    }
+  }
+}
+
+int LveBvh::height() const {
+  if (root == NULL_NODE) {
+    return 0;
+  }
+  int maxDepth = 0;
+  std::vector<std::pair<int32_t, int>> todo{{root, 1}};
+  while (!todo.empty()) {
+    auto [index, depth] = todo.back();
+    todo.pop_back();
+    maxDepth = std::max(maxDepth, depth);
+    if (!nodes[index].isLeaf()) {
+      todo.push_back({nodes[index].child1, depth + 1});
+      todo.push_back({nodes[index].child2, depth + 1});
+    }
+  }
+  return maxDepth;
+}
+
+float LveBvh::getCost() const {
+  if (root == NULL_NODE || nodes[root].isLeaf()) {
+    return 0.f;
+  }
+  float internalArea = 0.f;
+  std::vector<int32_t> todo{root};
+  while (!todo.empty()) {
+    const Node &node = nodes[todo.back()];
+    todo.pop_back();
+    if (!node.isLeaf()) {
+      internalArea += node.bounds.surfaceArea();
+      todo.push_back(node.child1);
+      todo.push_back(node.child2);
+    }
+  }
+  return internalArea / nodes[root].bounds.surfaceArea();
+}
+
+} // namespace lve
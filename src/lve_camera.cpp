@@ -48,6 +48,20 @@ void LveCamera::setViewDirection(glm::vec3 position, glm::vec3 direction,
   viewMatrix[3][0] = -glm::dot(u, position);
   viewMatrix[3][1] = -glm::dot(v, position);
   viewMatrix[3][2] = -glm::dot(w, position);
+
+  inverseViewMatrix = glm::mat4{1.f};
+  inverseViewMatrix[0][0] = u.x;
+  inverseViewMatrix[0][1] = u.y;
+  inverseViewMatrix[0][2] = u.z;
+  inverseViewMatrix[1][0] = v.x;
+  inverseViewMatrix[1][1] = v.y;
+  inverseViewMatrix[1][2] = v.z;
+  inverseViewMatrix[2][0] = w.x;
+  inverseViewMatrix[2][1] = w.y;
+  inverseViewMatrix[2][2] = w.z;
+  inverseViewMatrix[3][0] = position.x;
+  inverseViewMatrix[3][1] = position.y;
+  inverseViewMatrix[3][2] = position.z;
 }
 
 void LveCamera::setViewTarget(glm::vec3 position, glm::vec3 target,
@@ -80,6 +94,20 @@ void LveCamera::setViewYXZ(glm::vec3 position, glm::vec3 rotation) {
   viewMatrix[3][0] = -glm::dot(u, position);
   viewMatrix[3][1] = -glm::dot(v, position);
   viewMatrix[3][2] = -glm::dot(w, position);
+
+  inverseViewMatrix = glm::mat4{1.f};
+  inverseViewMatrix[0][0] = u.x;
+  inverseViewMatrix[0][1] = u.y;
+  inverseViewMatrix[0][2] = u.z;
+  inverseViewMatrix[1][0] = v.x;
+  inverseViewMatrix[1][1] = v.y;
+  inverseViewMatrix[1][2] = v.z;
+  inverseViewMatrix[2][0] = w.x;
+  inverseViewMatrix[2][1] = w.y;
+  inverseViewMatrix[2][2] = w.z;
+  inverseViewMatrix[3][0] = position.x;
+  inverseViewMatrix[3][1] = position.y;
+  inverseViewMatrix[3][2] = position.z;
 }
 
 } // namespace lve
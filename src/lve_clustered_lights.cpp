@@ -0,0 +1,206 @@
+#include "../include/lve_clustered_lights.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace lve {
+
+namespace {
+// enough for a few thousand visible lights; the ring doubles when a frame
+// needs more
+constexpr VkDeviceSize INITIAL_RING_SIZE = 512 * 1024;
+
+// The tiles along one screen axis that a view space box covers, projected
+// with ndc = scale * v / z. z0 is at least the near plane, and v / z over
+// the box is extreme at its corners.
+bool tileRange(float low, float high, float z0, float z1, float scale,
+               uint32_t tiles, uint32_t &first, uint32_t &last) {
+  const float corners[] = {low / z0, low / z1, high / z0, high / z1};
+  const float ndcMin = scale * *std::min_element(corners, corners + 4);
+  const float ndcMax = scale * *std::max_element(corners, corners + 4);
+  if (ndcMax < -1.f || ndcMin > 1.f) {
+    return false;
+  }
+  auto tile = [&](float ndc) {
+    int index = static_cast<int>((ndc * 0.5f + 0.5f) * tiles);
+    return static_cast<uint32_t>(
+        std::clamp(index, 0, static_cast<int>(tiles) - 1));
+  };
+  first = tile(ndcMin);
+  last = tile(ndcMax);
+  return true;
+}
+} // namespace
+
+LveClusteredLights::LveClusteredLights(LveDevice &device)
+    : ring{device, INITIAL_RING_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT} {
+  sliceDepths.resize(GRID_Z + 1);
+  clusterOffsets.resize(CLUSTER_COUNT + 1);
+}
+
+void LveClusteredLights::beginFrame(int index) {
+  frameIndex = index;
+  ring.beginFrame(index);
+}
+
+void LveClusteredLights::update(const LveCamera &camera, VkExtent2D extent,
+                                const std::vector<PointLight> &lights) {
+  const auto start = std::chrono::steady_clock::now();
+  const glm::mat4 &projection = camera.getProjectionMatrix();
+  assert(projection[2][3] == 1.f && projection[3][3] == 0.f &&
+         "clustered lighting needs a perspective projection");
+
+  // setPerspectiveProjection's depth terms give back its planes
+  params.nearPlane = -projection[3][2] / projection[2][2];
+  params.farPlane = projection[3][2] / (1.f - projection[2][2]);
+  params.tileScale = {static_cast<float>(GRID_X) / extent.width,
+                      static_cast<float>(GRID_Y) / extent.height};
+  const float depthRatio = params.farPlane / params.nearPlane;
+  params.sliceScale = GRID_Z / std::log(depthRatio);
+  params.sliceBias = -std::log(params.nearPlane) * params.sliceScale;
+  for (uint32_t slice = 0; slice <= GRID_Z; slice++) {
+    sliceDepths[slice] =
+        params.nearPlane *
+        std::pow(depthRatio, static_cast<float>(slice) / GRID_Z);
+  }
+  xScale = projection[0][0];
+  yScale = projection[1][1];
+
+  stats = {};
+  stats.lights = static_cast<uint32_t>(lights.size());
+  spans.clear();
+  spanEnds.clear();
+  visibleLights.clear();
+  const glm::mat4 &view = camera.getViewMatrix();
+  for (uint32_t index = 0; index < lights.size(); index++) {
+    const PointLight &light = lights[index];
+    glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.f));
+    if (findSpans(center, light.radius)) {
+      visibleLights.push_back(index);
+      spanEnds.push_back(static_cast<uint32_t>(spans.size()));
+    }
+  }
+  stats.visibleLights = static_cast<uint32_t>(visibleLights.size());
+
+  // count each froxel's lights; offsets[c + 1] becomes c's end
+  std::fill(clusterOffsets.begin(), clusterOffsets.end(), 0);
+  for (const Span &span : spans) {
+    for (uint32_t y = span.minY; y <= span.maxY; y++) {
+      uint32_t row = (span.slice * GRID_Y + y) * GRID_X;
+      for (uint32_t x = span.minX; x <= span.maxX; x++) {
+        clusterOffsets[row + x + 1]++;
+      }
+    }
+  }
+  for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+    stats.maxClusterLights =
+        std::max(stats.maxClusterLights, clusterOffsets[cluster + 1]);
+    clusterOffsets[cluster + 1] += clusterOffsets[cluster];
+  }
+  stats.lightIndices = clusterOffsets[CLUSTER_COUNT];
+
+  // the grid comes first, so an empty one always fits
+  void *clusterData = nullptr;
+  void *lightData = nullptr;
+  void *indexData = nullptr;
+  if (!allocate(CLUSTER_COUNT * 2 * sizeof(uint32_t), clusterBuffer,
+                clusterData)) {
+    return;
+  }
+  if (!allocate(visibleLights.size() * sizeof(PointLight), lightBuffer,
+                lightData) ||
+      !allocate(stats.lightIndices * sizeof(uint32_t), indexBuffer,
+                indexData)) {
+    std::memset(clusterData, 0, CLUSTER_COUNT * 2 * sizeof(uint32_t));
+    lightBuffer = clusterBuffer;
+    indexBuffer = clusterBuffer;
+    stats.visibleLights = 0;
+    stats.lightIndices = 0;
+    return;
+  }
+
+  auto *grid = static_cast<uint32_t *>(clusterData);
+  for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+    grid[cluster * 2] = clusterOffsets[cluster];
+    grid[cluster * 2 + 1] =
+        clusterOffsets[cluster + 1] - clusterOffsets[cluster];
+  }
+  auto *shaderLights = static_cast<PointLight *>(lightData);
+  auto *indices = static_cast<uint32_t *>(indexData);
+  // offsets now serve as each froxel's write cursor
+  uint32_t firstSpan = 0;
+  for (uint32_t visible = 0; visible < visibleLights.size(); visible++) {
+    shaderLights[visible] = lights[visibleLights[visible]];
+    for (uint32_t s = firstSpan; s < spanEnds[visible]; s++) {
+      const Span &span = spans[s];
+      for (uint32_t y = span.minY; y <= span.maxY; y++) {
+        uint32_t row = (span.slice * GRID_Y + y) * GRID_X;
+        for (uint32_t x = span.minX; x <= span.maxX; x++) {
+          indices[clusterOffsets[row + x]++] = visible;
+        }
+      }
+    }
+    firstSpan = spanEnds[visible];
+  }
+
+  stats.binMilliseconds = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+}
+
+bool LveClusteredLights::findSpans(const glm::vec3 &center, float radius) {
+  const float zMin = std::max(center.z - radius, params.nearPlane);
+  const float zMax = std::min(center.z + radius, params.farPlane);
+  if (zMin > zMax) {
+    return false;
+  }
+  auto sliceOf = [&](float depth) {
+    int slice = static_cast<int>(std::log(depth) * params.sliceScale +
+                                 params.sliceBias);
+    return static_cast<uint32_t>(
+        std::clamp(slice, 0, static_cast<int>(GRID_Z) - 1));
+  };
+
+  const size_t before = spans.size();
+  const uint32_t lastSlice = sliceOf(zMax);
+  for (uint32_t slice = sliceOf(zMin); slice <= lastSlice; slice++) {
+    // the sphere within this slice fits in a square as wide as its
+    // cross-section nearest the centre
+    const float z0 = std::max(sliceDepths[slice], zMin);
+    const float z1 = std::min(sliceDepths[slice + 1], zMax);
+    const float dz = center.z < z0   ? z0 - center.z
+                     : center.z > z1 ? center.z - z1
+                                     : 0.f;
+    const float halfWidth =
+        std::sqrt(std::max(radius * radius - dz * dz, 0.f));
+
+    Span span{};
+    span.slice = slice;
+    if (tileRange(center.x - halfWidth, center.x + halfWidth, z0, z1, xScale,
+                  GRID_X, span.minX, span.maxX) &&
+        tileRange(center.y - halfWidth, center.y + halfWidth, z0, z1, yScale,
+                  GRID_Y, span.minY, span.maxY)) {
+      spans.push_back(span);
+    }
+  }
+  return spans.size() > before;
+}
+
+bool LveClusteredLights::allocate(VkDeviceSize size,
+                                  VkDescriptorBufferInfo &info, void *&data) {
+  // descriptors cannot have an empty range
+  size = std::max<VkDeviceSize>(size, sizeof(glm::vec4));
+  LveRingBuffer::Allocation allocation{};
+  if (!ring.allocate(size, allocation)) {
+    return false;
+  }
+  info = {ring.getBuffer(frameIndex), allocation.offset, size};
+  data = allocation.data;
+  return true;
+}
+
+} // namespace lve
@@ -0,0 +1,321 @@
+#include "../include/lve_compressed_image.hpp"
+
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+bool hasExtension(const std::string &filepath, const char *extension) {
+  size_t dot = filepath.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string ext = filepath.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return ext == extension;
+}
+
+uint32_t readU32(const LveMappedFile &bytes, size_t offset) {
+  uint32_t value;
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+uint64_t readU64(const LveMappedFile &bytes, size_t offset) {
+  uint64_t value;
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+constexpr uint32_t fourCC(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+         (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+struct FormatInfo {
+  VkFormat format;
+  LveBlockFormat blockFormat;
+  bool srgb;
+};
+
+bool fromVkFormat(VkFormat format, FormatInfo &info) {
+  switch (format) {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC1, false};
+    return true;
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    info = {format, LveBlockFormat::BC1, true};
+    return true;
+  case VK_FORMAT_BC2_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC2, false};
+    return true;
+  case VK_FORMAT_BC2_SRGB_BLOCK:
+    info = {format, LveBlockFormat::BC2, true};
+    return true;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC3, false};
+    return true;
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    info = {format, LveBlockFormat::BC3, true};
+    return true;
+  case VK_FORMAT_BC4_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC4, false};
+    return true;
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC5, false};
+    return true;
+  case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+  case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    info = {format, LveBlockFormat::BC6H, false};
+    return true;
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+    info = {format, LveBlockFormat::BC7, false};
+    return true;
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    info = {format, LveBlockFormat::BC7, true};
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool fromDxgiFormat(uint32_t dxgiFormat, FormatInfo &info) {
+  switch (dxgiFormat) {
+  case 71: // DXGI_FORMAT_BC1_UNORM
+    return fromVkFormat(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, info);
+  case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+    return fromVkFormat(VK_FORMAT_BC1_RGBA_SRGB_BLOCK, info);
+  case 74:
+    return fromVkFormat(VK_FORMAT_BC2_UNORM_BLOCK, info);
+  case 75:
+    return fromVkFormat(VK_FORMAT_BC2_SRGB_BLOCK, info);
+  case 77:
+    return fromVkFormat(VK_FORMAT_BC3_UNORM_BLOCK, info);
+  case 78:
+    return fromVkFormat(VK_FORMAT_BC3_SRGB_BLOCK, info);
+  case 80:
+    return fromVkFormat(VK_FORMAT_BC4_UNORM_BLOCK, info);
+  case 83:
+    return fromVkFormat(VK_FORMAT_BC5_UNORM_BLOCK, info);
+  case 95:
+    return fromVkFormat(VK_FORMAT_BC6H_UFLOAT_BLOCK, info);
+  case 96:
+    return fromVkFormat(VK_FORMAT_BC6H_SFLOAT_BLOCK, info);
+  case 98:
+    return fromVkFormat(VK_FORMAT_BC7_UNORM_BLOCK, info);
+  case 99:
+    return fromVkFormat(VK_FORMAT_BC7_SRGB_BLOCK, info);
+  default:
+    return false;
+  }
+}
+
+// legacy DDS files carry no colour space; colour formats are treated as
+// sRGB like our other texture sources, BC4/BC5 (usually data) as linear
+bool fromDdsFourCC(uint32_t code, FormatInfo &info) {
+  if (code == fourCC('D', 'X', 'T', '1')) {
+    return fromVkFormat(VK_FORMAT_BC1_RGBA_SRGB_BLOCK, info);
+  }
+  if (code == fourCC('D', 'X', 'T', '2') ||
+      code == fourCC('D', 'X', 'T', '3')) {
+    return fromVkFormat(VK_FORMAT_BC2_SRGB_BLOCK, info);
+  }
+  if (code == fourCC('D', 'X', 'T', '4') ||
+      code == fourCC('D', 'X', 'T', '5')) {
+    return fromVkFormat(VK_FORMAT_BC3_SRGB_BLOCK, info);
+  }
+  if (code == fourCC('A', 'T', 'I', '1') ||
+      code == fourCC('B', 'C', '4', 'U')) {
+    return fromVkFormat(VK_FORMAT_BC4_UNORM_BLOCK, info);
+  }
+  if (code == fourCC('A', 'T', 'I', '2') ||
+      code == fourCC('B', 'C', '5', 'U')) {
+    return fromVkFormat(VK_FORMAT_BC5_UNORM_BLOCK, info);
+  }
+  return false;
+}
+
+void applyFormat(LveCompressedImage &image, const FormatInfo &info) {
+  image.format = info.format;
+  image.blockFormat = info.blockFormat;
+  image.srgb = info.srgb;
+}
+
+// mips are tightly packed one after another, finest first
+void addPackedLevels(LveCompressedImage &image, size_t offset,
+                     uint32_t levelCount, const std::string &filepath) {
+  uint32_t width = image.width;
+  uint32_t height = image.height;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    size_t size = LveBlockDecoder::levelBytes(image.blockFormat, width, height);
+    if (offset + size > image.data.size()) {
+      throw std::runtime_error("truncated mip data: " + filepath);
+    }
+    image.levels.push_back({width, height, offset, size});
+    if (width == 1 && height == 1) {
+      break; // some exporters overstate the mip count
+    }
+    offset += size;
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+}
+
+constexpr size_t DDS_HEADER_BYTES = 4 + 124;
+constexpr size_t DDS_DX10_HEADER_BYTES = 20;
+constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+constexpr uint32_t DDPF_FOURCC = 0x4;
+constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+constexpr uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+LveCompressedImage parseDds(LveMappedFile bytes,
+                            const std::string &filepath) {
+  if (bytes.size() < DDS_HEADER_BYTES || readU32(bytes, 4) != 124) {
+    throw std::runtime_error("truncated DDS header: " + filepath);
+  }
+  LveCompressedImage image{};
+  uint32_t flags = readU32(bytes, 8);
+  image.height = readU32(bytes, 12);
+  image.width = readU32(bytes, 16);
+  uint32_t mipCount = (flags & DDSD_MIPMAPCOUNT) ? readU32(bytes, 28) : 1;
+  uint32_t pixelFormatFlags = readU32(bytes, 80);
+  uint32_t code = readU32(bytes, 84);
+  uint32_t caps2 = readU32(bytes, 112);
+  if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) {
+    throw std::runtime_error("DDS cubemaps and volumes are not supported: " +
+                             filepath);
+  }
+  if (!(pixelFormatFlags & DDPF_FOURCC)) {
+    throw std::runtime_error("uncompressed DDS is not supported: " + filepath);
+  }
+
+  FormatInfo info{};
+  size_t dataOffset = DDS_HEADER_BYTES;
+  if (code == fourCC('D', 'X', '1', '0')) {
+    if (bytes.size() < DDS_HEADER_BYTES + DDS_DX10_HEADER_BYTES) {
+      throw std::runtime_error("truncated DDS DX10 header: " + filepath);
+    }
+    uint32_t dxgiFormat = readU32(bytes, DDS_HEADER_BYTES);
+    uint32_t dimension = readU32(bytes, DDS_HEADER_BYTES + 4);
+    uint32_t arraySize = readU32(bytes, DDS_HEADER_BYTES + 12);
+    if (dimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || arraySize > 1) {
+      throw std::runtime_error("only single 2D DDS textures are supported: " +
+                               filepath);
+    }
+    if (!fromDxgiFormat(dxgiFormat, info)) {
+      throw std::runtime_error("unsupported DXGI format " +
+                               std::to_string(dxgiFormat) + ": " + filepath);
+    }
+    dataOffset += DDS_DX10_HEADER_BYTES;
+  } else if (!fromDdsFourCC(code, info)) {
+    throw std::runtime_error("unsupported DDS FourCC: " + filepath);
+  }
+
+  applyFormat(image, info);
+  image.data = std::move(bytes);
+  addPackedLevels(image, dataOffset, std::max(1u, mipCount), filepath);
+  return image;
+}
+
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K',  'T',  'X', ' ',  '2',
+                                         '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+constexpr size_t KTX2_HEADER_BYTES = 80;
+constexpr size_t KTX2_LEVEL_INDEX_ENTRY_BYTES = 24;
+
+LveCompressedImage parseKtx2(LveMappedFile bytes,
+                             const std::string &filepath) {
+  if (bytes.size() < KTX2_HEADER_BYTES) {
+    throw std::runtime_error("truncated KTX2 header: " + filepath);
+  }
+  VkFormat format = static_cast<VkFormat>(readU32(bytes, 12));
+  LveCompressedImage image{};
+  image.width = readU32(bytes, 20);
+  image.height = readU32(bytes, 24);
+  uint32_t depth = readU32(bytes, 28);
+  uint32_t layerCount = readU32(bytes, 32);
+  uint32_t faceCount = readU32(bytes, 36);
+  uint32_t levelCount = std::max(1u, readU32(bytes, 40));
+  uint32_t supercompression = readU32(bytes, 44);
+
+  if (depth > 0 || layerCount > 1 || faceCount != 1) {
+    throw std::runtime_error("only single 2D KTX2 textures are supported: " +
+                             filepath);
+  }
+  if (supercompression != 0) {
+    throw std::runtime_error("KTX2 supercompression is not supported: " +
+                             filepath);
+  }
+  FormatInfo info{};
+  if (!fromVkFormat(format, info)) {
+    throw std::runtime_error("unsupported KTX2 vkFormat " +
+                             std::to_string(format) + ": " + filepath);
+  }
+  applyFormat(image, info);
+
+  size_t indexEnd =
+      KTX2_HEADER_BYTES + levelCount * KTX2_LEVEL_INDEX_ENTRY_BYTES;
+  if (bytes.size() < indexEnd) {
+    throw std::runtime_error("truncated KTX2 level index: " + filepath);
+  }
+  image.data = std::move(bytes);
+
+  // the level index lists mip 0 first even though the data is stored
+  // coarsest first
+  uint32_t width = image.width;
+  uint32_t height = image.height;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    size_t entry = KTX2_HEADER_BYTES + i * KTX2_LEVEL_INDEX_ENTRY_BYTES;
+    uint64_t offset = readU64(image.data, entry);
+    uint64_t length = readU64(image.data, entry + 8);
+    size_t expected =
+        LveBlockDecoder::levelBytes(image.blockFormat, width, height);
+    if (length < expected || offset > image.data.size() ||
+        expected > image.data.size() - offset) {
+      throw std::runtime_error("truncated mip data: " + filepath);
+    }
+    image.levels.push_back(
+        {width, height, static_cast<size_t>(offset), expected});
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+  return image;
+}
+} // namespace
+
+LveCompressedImage LveCompressedImage::load(const std::string &filepath) {
+  return parse(LveArchive::openFile(filepath), filepath);
+}
+
+LveCompressedImage LveCompressedImage::parse(LveMappedFile bytes,
+                                             const std::string &filepath) {
+  LveCompressedImage image{};
+  if (bytes.size() >= 4 && readU32(bytes, 0) == fourCC('D', 'D', 'S', ' ')) {
+    image = parseDds(std::move(bytes), filepath);
+  } else if (bytes.size() >= sizeof(KTX2_IDENTIFIER) &&
+             std::memcmp(bytes.data(), KTX2_IDENTIFIER,
+                         sizeof(KTX2_IDENTIFIER)) == 0) {
+    image = parseKtx2(std::move(bytes), filepath);
+  } else {
+    throw std::runtime_error("not a DDS or KTX2 file: " + filepath);
+  }
+  if (image.width == 0 || image.height == 0) {
+    throw std::runtime_error("empty image: " + filepath);
+  }
+  return image;
+}
+
+bool LveCompressedImage::isCompressedFile(const std::string &filepath) {
+  return hasExtension(filepath, "dds") || hasExtension(filepath, "ktx2");
+}
+
+} // namespace lve
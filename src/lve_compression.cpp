@@ -0,0 +1,251 @@
+#include "../include/lve_compression.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef LVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace lve {
+
+namespace {
+// LZ4 block format: sequences of a token (literal length, match length),
+// the literals, and a 16-bit back reference. The format requires the last
+// 5 bytes to be literals and the last match to start 12 bytes from the end.
+constexpr size_t LZ4_MIN_MATCH = 4;
+constexpr size_t LZ4_LAST_LITERALS = 5;
+constexpr size_t LZ4_MATCH_LIMIT = 12;
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+constexpr uint32_t LZ4_HASH_BITS = 16;
+
+#ifdef LVE_ZSTD
+constexpr int ZSTD_LEVEL = 19; // packing is offline; decode speed is flat
+#endif
+
+uint32_t read32(const uint8_t *bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint32_t lz4Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+void writeLength(std::vector<uint8_t> &dst, size_t length) {
+  while (length >= 255) {
+    dst.push_back(255);
+    length -= 255;
+  }
+  dst.push_back(static_cast<uint8_t>(length));
+}
+
+void writeSequence(std::vector<uint8_t> &dst, const uint8_t *literals,
+                   size_t literalLength, size_t offset, size_t matchLength) {
+  // matchLength 0 marks the final, literals only sequence
+  size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+  uint8_t token = static_cast<uint8_t>(
+      (literalLength < 15 ? literalLength : 15) << 4);
+  token |= static_cast<uint8_t>(matchCode < 15 ? matchCode : 15);
+  dst.push_back(token);
+  if (literalLength >= 15) {
+    writeLength(dst, literalLength - 15);
+  }
+  dst.insert(dst.end(), literals, literals + literalLength);
+  if (matchLength == 0) {
+    return;
+  }
+  dst.push_back(static_cast<uint8_t>(offset & 0xff));
+  dst.push_back(static_cast<uint8_t>(offset >> 8));
+  if (matchCode >= 15) {
+    writeLength(dst, matchCode - 15);
+  }
+}
+
+// greedy single-probe matcher; fast to pack and the output decodes the
+// same as a slower search would
+void lz4Compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst) {
+  dst.clear();
+  dst.reserve(size + size / 255 + 16);
+  size_t anchor = 0;
+  if (size > LZ4_MATCH_LIMIT) {
+    // position + 1 of the last sequence with each hash; 0 is empty
+    std::vector<uint32_t> table(size_t{1} << LZ4_HASH_BITS, 0);
+    const size_t matchEnd = size - LZ4_LAST_LITERALS;
+    size_t position = 0;
+    while (position < size - LZ4_MATCH_LIMIT) {
+      uint32_t sequence = read32(src + position);
+      uint32_t &slot = table[lz4Hash(sequence)];
+      size_t candidate = slot;
+      slot = static_cast<uint32_t>(position + 1);
+      if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET ||
+          read32(src + candidate - 1) != sequence) {
+        position++;
+        continue;
+      }
+      size_t match = candidate - 1;
+      size_t length = LZ4_MIN_MATCH;
+      while (position + length < matchEnd &&
+             src[match + length] == src[position + length]) {
+        length++;
+      }
+      writeSequence(dst, src + anchor, position - anchor, position - match,
+                    length);
+      position += length;
+      anchor = position;
+    }
+  }
+  writeSequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+bool readLength(const uint8_t *&in, const uint8_t *end, size_t &length) {
+  uint8_t byte;
+  do {
+    if (in == end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool lz4Decompress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                   size_t dstSize) {
+  const uint8_t *in = src;
+  const uint8_t *inEnd = src + srcSize;
+  uint8_t *out = dst;
+  uint8_t *outEnd = dst + dstSize;
+  while (in < inEnd) {
+    uint8_t token = *in++;
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(in, inEnd, literalLength)) {
+      return false;
+    }
+    if (literalLength > static_cast<size_t>(inEnd - in) ||
+        literalLength > static_cast<size_t>(outEnd - out)) {
+      return false;
+    }
+    if (literalLength > 0) {
+      std::memcpy(out, in, literalLength);
+    }
+    in += literalLength;
+    out += literalLength;
+    if (in == inEnd) {
+      break; // the last sequence has no match
+    }
+
+    if (inEnd - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+    in += 2;
+    size_t matchLength = token & 15;
+    if (matchLength == 15 && !readLength(in, inEnd, matchLength)) {
+      return false;
+    }
+    matchLength += LZ4_MIN_MATCH;
+    if (offset == 0 || offset > static_cast<size_t>(out - dst) ||
+        matchLength > static_cast<size_t>(outEnd - out)) {
+      return false;
+    }
+    // byte by byte: the match may overlap the bytes it produces
+    const uint8_t *match = out - offset;
+    for (size_t i = 0; i < matchLength; i++) {
+      out[i] = match[i];
+    }
+    out += matchLength;
+  }
+  return out == outEnd;
+}
+} // namespace
+
+bool LveCompression::isAvailable(Codec codec) {
+  switch (codec) {
+  case Codec::None:
+  case Codec::Lz4:
+    return true;
+  case Codec::Zstd:
+#ifdef LVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  }
+  return false;
+}
+
+const char *LveCompression::name(Codec codec) {
+  switch (codec) {
+  case Codec::None:
+    return "none";
+  case Codec::Lz4:
+    return "lz4";
+  case Codec::Zstd:
+    return "zstd";
+  }
+  return "unknown";
+}
+
+void LveCompression::compress(Codec codec, const void *src, size_t size,
+                              std::vector<uint8_t> &dst) {
+  const auto *bytes = static_cast<const uint8_t *>(src);
+  switch (codec) {
+  case Codec::None:
+    dst.assign(bytes, bytes + size);
+    return;
+  case Codec::Lz4:
+    lz4Compress(bytes, size, dst);
+    return;
+  case Codec::Zstd:
+#ifdef LVE_ZSTD
+  {
+    dst.resize(ZSTD_compressBound(size));
+    size_t written =
+        ZSTD_compress(dst.data(), dst.size(), src, size, ZSTD_LEVEL);
+    if (ZSTD_isError(written)) {
+      throw std::runtime_error(std::string("failed to compress with zstd: ") +
+                               ZSTD_getErrorName(written));
+    }
+    dst.resize(written);
+    return;
+  }
+#else
+    break;
+#endif
+  }
+  throw std::runtime_error(std::string("compression codec not built in: ") +
+                           name(codec));
+}
+
+bool LveCompression::decompress(Codec codec, const void *src, size_t srcSize,
+                                void *dst, size_t dstSize) {
+  switch (codec) {
+  case Codec::None:
+    if (srcSize != dstSize) {
+      return false;
+    }
+    if (dstSize > 0) {
+      std::memcpy(dst, src, dstSize);
+    }
+    return true;
+  case Codec::Lz4:
+    return lz4Decompress(static_cast<const uint8_t *>(src), srcSize,
+                         static_cast<uint8_t *>(dst), dstSize);
+  case Codec::Zstd:
+#ifdef LVE_ZSTD
+  {
+    size_t written = ZSTD_decompress(dst, dstSize, src, srcSize);
+    return !ZSTD_isError(written) && written == dstSize;
+  }
+#else
+    return false;
+#endif
+  }
+  return false;
+}
+
+} // namespace lve
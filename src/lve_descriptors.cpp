@@ -0,0 +1,324 @@
+#include "../include/lve_descriptors.hpp"
+#include "../include/lve_hash.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+// rough descriptor mix of the sets the engine allocates; a pool sized for
+// N sets holds ceil(perSet * N) descriptors of each type
+constexpr std::array<LveDescriptorAllocator::PoolRatio, 8> POOL_RATIOS = {{
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+}};
+} // namespace
+
+// *************** Descriptor Set Layout Cache *********************
+
+LveDescriptorLayoutCache::LveDescriptorLayoutCache(LveDevice &device)
+    : lveDevice{device} {}
+
+LveDescriptorLayoutCache::~LveDescriptorLayoutCache() {
+  for (auto &kv : layouts) {
+    vkDestroyDescriptorSetLayout(lveDevice.device(), kv.second, nullptr);
+  }
+}
+
+VkDescriptorSetLayout LveDescriptorLayoutCache::getLayout(
+    std::vector<VkDescriptorSetLayoutBinding> bindings,
+    VkDescriptorSetLayoutCreateFlags flags) {
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding &a,
+               const VkDescriptorSetLayoutBinding &b) {
+              return a.binding < b.binding;
+            });
+  for (const auto &binding : bindings) {
+    assert(binding.pImmutableSamplers == nullptr &&
+           "Immutable samplers are not part of the layout cache key");
+  }
+
+  LayoutKey key{std::move(bindings), flags};
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = layouts.find(key);
+  if (it != layouts.end()) {
+    return it->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.flags = flags;
+  layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+  layoutInfo.pBindings = key.bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr,
+                                  &layout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+  layouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+size_t LveDescriptorLayoutCache::size() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return layouts.size();
+}
+
+bool LveDescriptorLayoutCache::LayoutKey::operator==(
+    const LayoutKey &other) const {
+  if (flags != other.flags || bindings.size() != other.bindings.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const auto &a = bindings[i];
+    const auto &b = other.bindings[i];
+    if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+        a.descriptorCount != b.descriptorCount ||
+        a.stageFlags != b.stageFlags) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t LveDescriptorLayoutCache::LayoutKeyHash::operator()(
+    const LayoutKey &key) const {
+  size_t seed = 0;
+  hashCombine(seed, key.flags);
+  for (const auto &binding : key.bindings) {
+    hashCombine(seed, binding.binding);
+    hashCombine(seed, static_cast<uint32_t>(binding.descriptorType));
+    hashCombine(seed, binding.descriptorCount);
+    hashCombine(seed, binding.stageFlags);
+  }
+  return seed;
+}
+
+// *************** Pipeline Layout Cache *********************
+
+LvePipelineLayoutCache::LvePipelineLayoutCache(
+    LveDevice &device, LveDescriptorLayoutCache &setLayoutCache)
+    : lveDevice{device}, setLayoutCache{setLayoutCache} {}
+
+LvePipelineLayoutCache::~LvePipelineLayoutCache() {
+  for (auto &kv : layouts) {
+    vkDestroyPipelineLayout(lveDevice.device(), kv.second, nullptr);
+  }
+}
+
+VkPipelineLayout LvePipelineLayoutCache::getLayout(
+    const std::vector<VkDescriptorSetLayout> &setLayouts,
+    const std::vector<VkPushConstantRange> &pushConstantRanges) {
+  LayoutKey key{setLayouts, pushConstantRanges};
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = layouts.find(key);
+  if (it != layouts.end()) {
+    return it->second;
+  }
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+  layoutInfo.pSetLayouts = key.setLayouts.data();
+  layoutInfo.pushConstantRangeCount =
+      static_cast<uint32_t>(key.pushConstantRanges.size());
+  layoutInfo.pPushConstantRanges = key.pushConstantRanges.data();
+
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(lveDevice.device(), &layoutInfo, nullptr,
+                             &layout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+  layouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+size_t LvePipelineLayoutCache::size() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return layouts.size();
+}
+
+bool LvePipelineLayoutCache::LayoutKey::operator==(
+    const LayoutKey &other) const {
+  if (setLayouts != other.setLayouts ||
+      pushConstantRanges.size() != other.pushConstantRanges.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < pushConstantRanges.size(); i++) {
+    const auto &a = pushConstantRanges[i];
+    const auto &b = other.pushConstantRanges[i];
+    if (a.stageFlags != b.stageFlags || a.offset != b.offset ||
+        a.size != b.size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t LvePipelineLayoutCache::LayoutKeyHash::operator()(
+    const LayoutKey &key) const {
+  size_t seed = 0;
+  for (auto setLayout : key.setLayouts) {
+    hashCombine(seed, setLayout);
+  }
+  for (const auto &range : key.pushConstantRanges) {
+    hashCombine(seed, range.stageFlags);
+    hashCombine(seed, range.offset);
+    hashCombine(seed, range.size);
+  }
+  return seed;
+}
+
+// *************** Descriptor Allocator *********************
+
+LveDescriptorAllocator::LveDescriptorAllocator(LveDevice &device)
+    : lveDevice{device} {}
+
+LveDescriptorAllocator::~LveDescriptorAllocator() {
+  for (auto pool : usedPools) {
+    vkDestroyDescriptorPool(lveDevice.device(), pool, nullptr);
+  }
+  for (auto pool : freePools) {
+    vkDestroyDescriptorPool(lveDevice.device(), pool, nullptr);
+  }
+}
+
+VkDescriptorSet LveDescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  if (currentPool == VK_NULL_HANDLE) {
+    currentPool = grabPool();
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = currentPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet set;
+  VkResult result =
+      vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &set);
+  if (result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+      result == VK_ERROR_FRAGMENTED_POOL) {
+    // current pool is exhausted, retry once with a fresh one
+    currentPool = grabPool();
+    allocInfo.descriptorPool = currentPool;
+    result = vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &set);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor set!");
+  }
+  allocatedSets++;
+  return set;
+}
+
+void LveDescriptorAllocator::reset() {
+  for (auto pool : usedPools) {
+    vkResetDescriptorPool(lveDevice.device(), pool, 0);
+    freePools.push_back(pool);
+  }
+  usedPools.clear();
+  currentPool = VK_NULL_HANDLE;
+  allocatedSets = 0;
+}
+
+VkDescriptorPool LveDescriptorAllocator::grabPool() {
+  VkDescriptorPool pool;
+  if (!freePools.empty()) {
+    pool = freePools.back();
+    freePools.pop_back();
+  } else {
+    pool = createPool(setsPerPool);
+    setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+  }
+  usedPools.push_back(pool);
+  return pool;
+}
+
+VkDescriptorPool LveDescriptorAllocator::createPool(uint32_t setCount) {
+  std::array<VkDescriptorPoolSize, POOL_RATIOS.size()> poolSizes{};
+  for (size_t i = 0; i < POOL_RATIOS.size(); i++) {
+    poolSizes[i].type = POOL_RATIOS[i].type;
+    poolSizes[i].descriptorCount = std::max(
+        1u, static_cast<uint32_t>(POOL_RATIOS[i].perSet * setCount + 0.5f));
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = 0;
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr, &pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+  return pool;
+}
+
+// *************** Frame Descriptor Allocator *********************
+
+LveFrameDescriptorAllocator::LveFrameDescriptorAllocator(LveDevice &device) {
+  for (auto &allocator : allocators) {
+    allocator = std::make_unique<LveDescriptorAllocator>(device);
+  }
+}
+
+void LveFrameDescriptorAllocator::beginFrame(int frameIndex) {
+  allocators[frameIndex]->reset();
+  currentFrame = frameIndex;
+}
+
+// *************** Descriptor Writer *********************
+
+LveDescriptorWriter &
+LveDescriptorWriter::writeBuffer(uint32_t binding, VkDescriptorType type,
+                                 const VkDescriptorBufferInfo &bufferInfo) {
+  assert(writeCount < MAX_WRITES && "Too many descriptor writes");
+  writes[writeCount++] = {binding, type, bufferInfo, {}, false, 0};
+  return *this;
+}
+
+LveDescriptorWriter &
+LveDescriptorWriter::writeImage(uint32_t binding, VkDescriptorType type,
+                                const VkDescriptorImageInfo &imageInfo,
+                                uint32_t arrayElement) {
+  assert(writeCount < MAX_WRITES && "Too many descriptor writes");
+  writes[writeCount++] = {binding, type, {}, imageInfo, true, arrayElement};
+  return *this;
+}
+
+void LveDescriptorWriter::update(LveDevice &device, VkDescriptorSet set) {
+  std::array<VkWriteDescriptorSet, MAX_WRITES> vkWrites{};
+  for (uint32_t i = 0; i < writeCount; i++) {
+    auto &write = vkWrites[i];
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = writes[i].binding;
+    write.dstArrayElement = writes[i].arrayElement;
+    write.descriptorCount = 1;
+    write.descriptorType = writes[i].type;
+    if (writes[i].isImage) {
+      write.pImageInfo = &writes[i].imageInfo;
+    } else {
+      write.pBufferInfo = &writes[i].bufferInfo;
+    }
+  }
+  vkUpdateDescriptorSets(device.device(), writeCount, vkWrites.data(), 0,
+                         nullptr);
+}
+
+} // namespace lve
@@ -1,7 +1,13 @@
 #include "../include/lve_device.hpp"
 
 // std headers
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -43,16 +49,22 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 }
 
 // class member functions
-LveDevice::LveDevice(LveWindow &window) : window{window} {
+LveDevice::LveDevice(LveWindow &window, const std::string &preferredDevice)
+    : window{window}, preferredDevice{preferredDevice} {
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  createPipelineCache();
+  createMemoryTracking();
 }
 
 LveDevice::~LveDevice() {
+  vkDestroyPipelineCache(device_, pipelineCache, nullptr);
+  vkDestroyCommandPool(device_, computeCommandPool, nullptr);
+  vkDestroyCommandPool(device_, transferCommandPool, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -117,13 +129,44 @@ void LveDevice::pickPhysicalDevice() {
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-  for (const auto &device : devices) {
-    if (isDeviceSuitable(device)) {
-      physicalDevice = device;
-      break;
+  std::string preference = preferredDevice;
+  const char *environment = std::getenv(DEVICE_ENV_VAR);
+  if (environment != nullptr && environment[0] != '\0') {
+    preference = environment;
+  }
+
+  // highest score wins; ties go to the lower index, so the pick is stable
+  uint64_t bestScore = 0;
+  bool anyMatched = false;
+  for (uint32_t i = 0; i < deviceCount; i++) {
+    VkPhysicalDeviceProperties candidate;
+    vkGetPhysicalDeviceProperties(devices[i], &candidate);
+    std::string uuid = deviceUuid(devices[i]);
+    bool matches = preference.empty() ||
+                   matchesPreference(preference, i, candidate, uuid);
+    anyMatched = anyMatched || matches;
+
+    std::cout << "\t" << i << ": " << candidate.deviceName << " (" << uuid
+              << ") ";
+    if (!isDeviceSuitable(devices[i])) {
+      std::cout << "unsuitable" << std::endl;
+      continue;
+    }
+    uint64_t score = scoreDevice(devices[i]);
+    std::cout << "score " << score << (matches ? "" : ", not requested")
+              << std::endl;
+    if (matches && (physicalDevice == VK_NULL_HANDLE || score > bestScore)) {
+      physicalDevice = devices[i];
+      bestScore = score;
     }
   }
 
+  if (!preference.empty() && physicalDevice == VK_NULL_HANDLE) {
+    throw std::runtime_error(
+        (anyMatched ? "requested GPU is not suitable: "
+                    : "failed to find requested GPU: ") +
+        preference);
+  }
   if (physicalDevice == VK_NULL_HANDLE) {
     throw std::runtime_error("failed to find a suitable GPU!");
   }
@@ -138,6 +181,12 @@ void LveDevice::createLogicalDevice() {
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily,
                                             indices.presentFamily};
+  if (indices.transferFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
+  if (indices.computeFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.computeFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,11 +198,129 @@ void LveDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional: rg32f storage images for the Hi-Z pyramid
+  deviceFeatures.shaderStorageImageExtendedFormats =
+      supportedFeatures.shaderStorageImageExtendedFormats;
+  // optional: fragment invocation counts for the depth pre-pass
+  deviceFeatures.pipelineStatisticsQuery =
+      supportedFeatures.pipelineStatisticsQuery;
+  // optional: BC textures are uploaded as is; without it they are
+  // decompressed on the CPU
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+  std::vector<const char *> enabledExtensions(deviceExtensions.begin(),
+                                              deviceExtensions.end());
+
+  // optional: descriptor indexing for the bindless resource table
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  bool indexingCore = properties.apiVersion >= VK_API_VERSION_1_2;
+  bool indexingExtension =
+      !indexingCore &&
+      isDeviceExtensionSupported(physicalDevice,
+                                 VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  if (indexingCore || indexingExtension) {
+    VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+    supportedIndexing.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedIndexing;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+    bindlessSupported =
+        supportedIndexing.runtimeDescriptorArray &&
+        supportedIndexing.descriptorBindingPartiallyBound &&
+        supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+        supportedIndexing.descriptorBindingSampledImageUpdateAfterBind &&
+        supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind &&
+        supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+  }
+  if (bindlessSupported) {
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    if (indexingExtension) {
+      enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
+    descriptorIndexingProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+  }
+
+  // optional: dynamic rendering. The extension needs the 1.2 render pass
+  // features it builds on.
+  VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+  bool dynamicRenderingCore = properties.apiVersion >= VK_API_VERSION_1_3;
+  bool dynamicRenderingExtension =
+      !dynamicRenderingCore &&
+      properties.apiVersion >= VK_API_VERSION_1_2 &&
+      isDeviceExtensionSupported(physicalDevice,
+                                 VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  if (dynamicRenderingCore || dynamicRenderingExtension) {
+    VkPhysicalDeviceDynamicRenderingFeatures supportedDynamicRendering{};
+    supportedDynamicRendering.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedDynamicRendering;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+    dynamicRenderingSupported = supportedDynamicRendering.dynamicRendering;
+  }
+  if (dynamicRenderingSupported) {
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    if (dynamicRenderingExtension) {
+      enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+  }
+
+  if (properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceDepthStencilResolveProperties resolveProperties{};
+    resolveProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &resolveProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+    depthResolveModes = resolveProperties.supportedDepthResolveModes;
+  }
+
+  // optional: the driver's per-heap budget and usage
+  memoryBudgetSupported =
+      properties.apiVersion >= VK_API_VERSION_1_1 &&
+      isDeviceExtensionSupported(physicalDevice,
+                                 VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (memoryBudgetSupported) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  void *featureChain = nullptr;
+  if (bindlessSupported) {
+    indexingFeatures.pNext = featureChain;
+    featureChain = &indexingFeatures;
+  }
+  if (dynamicRenderingSupported) {
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
+  createInfo.pNext = featureChain;
 
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
@@ -161,8 +328,8 @@ void LveDevice::createLogicalDevice() {
 
   createInfo.pEnabledFeatures = &deviceFeatures;
   createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation
   // layers have been deprecated
@@ -179,23 +346,155 @@ void LveDevice::createLogicalDevice() {
     throw std::runtime_error("failed to create logical device!");
   }
 
+  enabledFeatures = deviceFeatures;
+  if (dynamicRenderingSupported) {
+    std::string suffix = dynamicRenderingExtension ? "KHR" : "";
+    beginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(
+        vkGetDeviceProcAddr(device_, ("vkCmdBeginRendering" + suffix).c_str()));
+    endRendering = reinterpret_cast<PFN_vkCmdEndRendering>(
+        vkGetDeviceProcAddr(device_, ("vkCmdEndRendering" + suffix).c_str()));
+  }
+
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  queueFamilyIndices = indices;
+  vkGetDeviceQueue(device_, transferQueueFamily(), 0, &transferQueue_);
+  vkGetDeviceQueue(device_, computeQueueFamily(), 0, &computeQueue_);
+
+  std::cout << "queue families: graphics " << indices.graphicsFamily
+            << ", transfer " << transferQueueFamily()
+            << (hasDedicatedTransferQueue() ? " (dedicated)" : " (shared)")
+            << ", compute " << computeQueueFamily()
+            << (hasAsyncComputeQueue() ? " (async)" : " (shared)")
+            << std::endl;
+}
+
+uint32_t LveDevice::transferQueueFamily() const {
+  return queueFamilyIndices.transferFamilyHasValue
+             ? queueFamilyIndices.transferFamily
+             : queueFamilyIndices.graphicsFamily;
+}
+
+uint32_t LveDevice::computeQueueFamily() const {
+  return queueFamilyIndices.computeFamilyHasValue
+             ? queueFamilyIndices.computeFamily
+             : queueFamilyIndices.graphicsFamily;
 }
 
 void LveDevice::createCommandPool() {
-  QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
+  // transfer and compute get their own pools even when they share the
+  // graphics family, so each queue's command buffers are managed apart
+  auto createPool = [&](uint32_t queueFamily, VkCommandPool &pool) {
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
+  };
+  createPool(graphicsQueueFamily(), commandPool);
+  createPool(transferQueueFamily(), transferCommandPool);
+  createPool(computeQueueFamily(), computeCommandPool);
+}
+
+void LveDevice::createPipelineCache() {
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+bool LveDevice::loadPipelineCache(const std::string &filepath) {
+  std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+  if (!file.is_open()) {
+    return false;
+  }
+  std::vector<char> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+  if (!file) {
+    return false;
+  }
 
-  VkCommandPoolCreateInfo poolInfo = {};
-  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
-                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  // drivers are meant to reject foreign data themselves, but not all do so
+  // safely; check the header the spec requires first
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.headerSize < sizeof(header) ||
+      header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      header.vendorID != properties.vendorID ||
+      header.deviceID != properties.deviceID ||
+      std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                  VK_UUID_SIZE) != 0) {
+    std::cout << "pipeline cache: " << filepath
+              << " is from another GPU or driver, ignored" << std::endl;
+    return false;
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.data();
+  VkPipelineCache loaded;
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &loaded) !=
+      VK_SUCCESS) {
+    return false;
+  }
+  VkResult result = vkMergePipelineCaches(device_, pipelineCache, 1, &loaded);
+  vkDestroyPipelineCache(device_, loaded, nullptr);
+  if (result != VK_SUCCESS) {
+    return false;
+  }
+  std::cout << "pipeline cache: loaded " << data.size() / 1024 << " KiB from "
+            << filepath << std::endl;
+  return true;
+}
 
-  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) !=
+bool LveDevice::savePipelineCache(const std::string &filepath) {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache, &size, nullptr) !=
       VK_SUCCESS) {
-    throw std::runtime_error("failed to create command pool!");
+    return false;
   }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache, &size, data.data()) !=
+      VK_SUCCESS) {
+    return false;
+  }
+
+  // written beside the old file and renamed over it, so a run that dies
+  // halfway leaves the previous cache intact
+  std::string tempFilepath = filepath + ".tmp";
+  {
+    std::ofstream file{tempFilepath, std::ios::binary | std::ios::trunc};
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    if (!file) {
+      std::cerr << "failed to write pipeline cache: " << tempFilepath
+                << std::endl;
+      return false;
+    }
+  }
+#ifdef _WIN32
+  // rename does not replace there; POSIX renames over the old file
+  // atomically, so elsewhere the old cache survives until the new one lands
+  std::remove(filepath.c_str());
+#endif
+  if (std::rename(tempFilepath.c_str(), filepath.c_str()) != 0) {
+    std::cerr << "failed to write pipeline cache: " << filepath << std::endl;
+    std::remove(tempFilepath.c_str());
+    return false;
+  }
+  return true;
 }
 
 void LveDevice::createSurface() {
@@ -221,6 +520,122 @@ bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
          supportedFeatures.samplerAnisotropy;
 }
 
+uint64_t LveDevice::scoreDevice(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+  // the type dominates: a discrete GPU beats an integrated one however
+  // much system memory the latter reports as its heap
+  uint64_t score = 0;
+  switch (deviceProperties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    score += 1000000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    score += 100000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    score += 50000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+    score += 10000;
+    break;
+  default: // CPU implementations such as llvmpipe
+    break;
+  }
+
+  // largest device local heap, one point per MiB up to 64 GiB; heaps are
+  // not summed because resizable BAR exposes the same memory twice
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+  VkDeviceSize largestHeap = 0;
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    const VkMemoryHeap &heap = memoryProperties.memoryHeaps[i];
+    if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      largestHeap = std::max(largestHeap, heap.size);
+    }
+  }
+  score += std::min<uint64_t>(largestHeap >> 20, 64 * 1024);
+
+  // queues and optional features the renderer makes use of
+  QueueFamilyIndices indices = findQueueFamilies(device);
+  if (indices.transferFamilyHasValue) {
+    score += 2000;
+  }
+  if (indices.computeFamilyHasValue) {
+    score += 2000;
+  }
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+  for (VkBool32 feature : {supportedFeatures.shaderStorageImageExtendedFormats,
+                           supportedFeatures.pipelineStatisticsQuery,
+                           supportedFeatures.textureCompressionBC}) {
+    if (feature) {
+      score += 1000;
+    }
+  }
+  if (deviceProperties.apiVersion >= VK_API_VERSION_1_2 ||
+      isDeviceExtensionSupported(device,
+                                 VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    score += 1000;
+  }
+  if (deviceProperties.apiVersion >= VK_API_VERSION_1_3 ||
+      isDeviceExtensionSupported(device,
+                                 VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+    score += 1000;
+  }
+  return score;
+}
+
+std::string LveDevice::deviceUuid(VkPhysicalDevice device) {
+  VkPhysicalDeviceIDProperties idProperties{};
+  idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &idProperties;
+  vkGetPhysicalDeviceProperties2(device, &properties2);
+
+  // 8-4-4-4-12 hex digits
+  std::string uuid;
+  for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+    if (i == 4 || i == 6 || i == 8 || i == 10) {
+      uuid += '-';
+    }
+    char digits[3];
+    std::snprintf(digits, sizeof(digits), "%02x", idProperties.deviceUUID[i]);
+    uuid += digits;
+  }
+  return uuid;
+}
+
+bool LveDevice::matchesPreference(const std::string &preference,
+                                  uint32_t index,
+                                  const VkPhysicalDeviceProperties &properties,
+                                  const std::string &uuid) {
+  auto lower = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+      return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return text;
+  };
+  auto stripDashes = [](std::string text) {
+    text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+    return text;
+  };
+
+  bool isIndex = std::all_of(preference.begin(), preference.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  });
+  if (isIndex) {
+    return std::strtoul(preference.c_str(), nullptr, 10) == index;
+  }
+  std::string wanted = lower(preference);
+  if (stripDashes(wanted) == stripDashes(uuid)) {
+    return true;
+  }
+  return lower(properties.deviceName).find(wanted) != std::string::npos;
+}
+
 void LveDevice::populateDebugMessengerCreateInfo(
     VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
   createInfo = {};
@@ -330,6 +745,24 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool LveDevice::isDeviceExtensionSupported(VkPhysicalDevice device,
+                                           const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -360,6 +793,27 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // Queues that run beside graphics: a transfer only family is usually a
+  // copy engine, and a compute family without graphics is async compute.
+  // Families that can do graphics would only give another graphics queue.
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if (queueFamilies[family].queueCount == 0 ||
+        flags & VK_QUEUE_GRAPHICS_BIT) {
+      continue;
+    }
+    if (flags & VK_QUEUE_COMPUTE_BIT) {
+      if (!indices.computeFamilyHasValue) {
+        indices.computeFamily = family;
+        indices.computeFamilyHasValue = true;
+      }
+    } else if (flags & VK_QUEUE_TRANSFER_BIT &&
+               !indices.transferFamilyHasValue) {
+      indices.transferFamily = family;
+      indices.transferFamilyHasValue = true;
+    }
+  }
+
   return indices;
 }
 
@@ -410,11 +864,10 @@ VkFormat LveDevice::findSupportedFormat(const std::vector<VkFormat> &candidates,
 
 uint32_t LveDevice::findMemoryType(uint32_t typeFilter,
                                    VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
-                                    properties) == properties) {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
       return i;
     }
   }
@@ -422,9 +875,35 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter,
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool LveDevice::hasMemoryType(uint32_t typeFilter,
+                              VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
+VkSampleCountFlagBits
+LveDevice::maxUsableSampleCount(VkSampleCountFlagBits limit) const {
+  VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+                              properties.limits.framebufferDepthSampleCounts;
+  for (VkSampleCountFlags count = limit; count > VK_SAMPLE_COUNT_1_BIT;
+       count >>= 1) {
+    if (counts & count) {
+      return static_cast<VkSampleCountFlagBits>(count);
+    }
+  }
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+
 void LveDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                              VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                             VkDeviceMemory &bufferMemory) {
+                             VkDeviceMemory &bufferMemory,
+                             MemoryCategory category) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -437,16 +916,12 @@ void LveDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex =
-      findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  try {
+    bufferMemory = allocateMemory(memRequirements, properties, category);
+  } catch (...) {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+    throw;
   }
 
   vkBindBufferMemory(device_, buffer, bufferMemory, 0);
@@ -520,31 +995,308 @@ void LveDevice::copyBufferToImage(VkBuffer buffer, VkImage image,
   endSingleTimeCommands(commandBuffer);
 }
 
+void LveDevice::releaseImageOwnership(
+    VkCommandBuffer commandBuffer, VkImage image,
+    const VkImageSubresourceRange &range, VkImageLayout oldLayout,
+    VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) {
+  if (srcFamily == dstFamily) {
+    return;
+  }
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = 0; // ignored for a release
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  vkCmdPipelineBarrier(commandBuffer, srcStage,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void LveDevice::acquireImageOwnership(
+    VkCommandBuffer commandBuffer, VkImage image,
+    const VkImageSubresourceRange &range, VkImageLayout oldLayout,
+    VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+  if (srcFamily == dstFamily) {
+    return;
+  }
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0; // ignored for an acquire
+  barrier.dstAccessMask = dstAccess;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  // the batch waits on the releasing queue's semaphore at dstStage; the
+  // barrier starts there too so the wait chains into it
+  vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void LveDevice::cmdBeginRendering(VkCommandBuffer commandBuffer,
+                                  const VkRenderingInfo &renderingInfo) {
+  assert(beginRendering != nullptr && "dynamic rendering is not enabled");
+  beginRendering(commandBuffer, &renderingInfo);
+}
+
+void LveDevice::cmdEndRendering(VkCommandBuffer commandBuffer) {
+  assert(endRendering != nullptr && "dynamic rendering is not enabled");
+  endRendering(commandBuffer);
+}
+
 void LveDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                     VkMemoryPropertyFlags properties,
-                                    VkImage &image,
-                                    VkDeviceMemory &imageMemory) {
+                                    VkImage &image, VkDeviceMemory &imageMemory,
+                                    MemoryCategory category) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
+  try {
+    imageMemory = allocateMemory(memRequirements, properties, category);
+  } catch (...) {
+    vkDestroyImage(device_, image, nullptr);
+    image = VK_NULL_HANDLE;
+    throw;
+  }
 
+  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+    vkDestroyImage(device_, image, nullptr);
+    image = VK_NULL_HANDLE;
+    freeMemory(imageMemory);
+    imageMemory = VK_NULL_HANDLE;
+    throw std::runtime_error("failed to bind image memory!");
+  }
+}
+
+void LveDevice::createMemoryTracking() {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  memoryHeaps.resize(memoryProperties.memoryHeapCount);
+  updateMemoryBudget();
+  std::cout << "memory budget: "
+            << (memoryBudgetSupported ? "VK_EXT_memory_budget"
+                                      : "own accounting")
+            << std::endl;
+}
+
+VkDeviceMemory LveDevice::allocateMemory(
+    const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+    MemoryCategory category) {
   VkMemoryAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.allocationSize = requirements.size;
   allocInfo.memoryTypeIndex =
-      findMemoryType(memRequirements.memoryTypeBits, properties);
+      findMemoryType(requirements.memoryTypeBits, properties);
+  const uint32_t heapIndex =
+      memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+  VkDeviceMemory memory;
+  VkResult result = vkAllocateMemory(device_, &allocInfo, nullptr, &memory);
+  bool relieved = false;
+  if (result != VK_SUCCESS) {
+    // give streamed data back before failing; the callbacks free it now
+    // rather than after the frames in flight, so one retry is enough
+    const bool deviceLocal = (memoryProperties.memoryHeaps[heapIndex].flags &
+                              VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    relieved = runPressureCallbacks(
+                   {heapIndex, deviceLocal, requirements.size, true}) > 0;
+    if (relieved) {
+      result = vkAllocateMemory(device_, &allocInfo, nullptr, &memory);
+    }
+  }
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  std::lock_guard<std::mutex> lock{memoryMutex};
+  if (relieved) {
+    pressureEvents++;
+  }
+  MemoryHeapState &heap = memoryHeaps[heapIndex];
+  VkDeviceSize usage = heapUsage(heapIndex) + requirements.size;
+  VkDeviceSize threshold = static_cast<VkDeviceSize>(
+      static_cast<double>(heapBudget(heapIndex)) *
+      MEMORY_PRESSURE_THRESHOLD);
+  if (usage > threshold) {
+    // the next updateMemoryBudget() asks for room before the heap fills up
+    heap.pressureBytes += requirements.size;
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error(
+        std::string("failed to allocate ") + memoryCategoryName(category) +
+        " memory: " + std::to_string(requirements.size >> 10) +
+        " KiB on heap " + std::to_string(heapIndex) + " (" +
+        std::to_string(heapUsage(heapIndex) >> 20) + " MiB used)!");
   }
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+  memoryAllocations.emplace(memory,
+                            MemoryAllocation{requirements.size, heapIndex,
+                                             category});
+  heap.allocated += requirements.size;
+  heap.peakUsage = std::max(heap.peakUsage, heapUsage(heapIndex));
+  const size_t categoryIndex = static_cast<size_t>(category);
+  categoryBytes[categoryIndex] += requirements.size;
+  categoryPeakBytes[categoryIndex] =
+      std::max(categoryPeakBytes[categoryIndex], categoryBytes[categoryIndex]);
+  return memory;
+}
+
+void LveDevice::freeMemory(VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  vkFreeMemory(device_, memory, nullptr);
+
+  std::lock_guard<std::mutex> lock{memoryMutex};
+  auto it = memoryAllocations.find(memory);
+  assert(it != memoryAllocations.end() &&
+         "memory was not allocated through LveDevice");
+  if (it == memoryAllocations.end()) {
+    return;
+  }
+  memoryHeaps[it->second.heapIndex].allocated -= it->second.size;
+  categoryBytes[static_cast<size_t>(it->second.category)] -= it->second.size;
+  memoryAllocations.erase(it);
+}
+
+VkDeviceSize LveDevice::heapUsage(uint32_t heapIndex) const {
+  const MemoryHeapState &heap = memoryHeaps[heapIndex];
+  if (!memoryBudgetSupported) {
+    return heap.allocated;
+  }
+  // the driver's figure only changes when it is read again
+  if (heap.allocated >= heap.allocatedAtUpdate) {
+    return heap.driverUsage + (heap.allocated - heap.allocatedAtUpdate);
+  }
+  VkDeviceSize freed = heap.allocatedAtUpdate - heap.allocated;
+  return heap.driverUsage > freed ? heap.driverUsage - freed : 0;
+}
+
+VkDeviceSize LveDevice::heapBudget(uint32_t heapIndex) const {
+  if (memoryBudgetSupported) {
+    return memoryHeaps[heapIndex].driverBudget;
+  }
+  return static_cast<VkDeviceSize>(
+      static_cast<double>(memoryProperties.memoryHeaps[heapIndex].size) *
+      MEMORY_BUDGET_FALLBACK);
+}
+
+void LveDevice::updateMemoryBudget() {
+  std::vector<MemoryPressure> pressures;
+  {
+    std::lock_guard<std::mutex> lock{memoryMutex};
+    if (memoryBudgetSupported) {
+      VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+      budget.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+      VkPhysicalDeviceMemoryProperties2 properties2{};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+      properties2.pNext = &budget;
+      vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+      for (uint32_t i = 0; i < memoryHeaps.size(); i++) {
+        memoryHeaps[i].driverUsage = budget.heapUsage[i];
+        memoryHeaps[i].driverBudget = budget.heapBudget[i];
+        memoryHeaps[i].allocatedAtUpdate = memoryHeaps[i].allocated;
+      }
+    }
+
+    for (uint32_t i = 0; i < memoryHeaps.size(); i++) {
+      MemoryHeapState &heap = memoryHeaps[i];
+      VkDeviceSize usage = heapUsage(i);
+      heap.peakUsage = std::max(heap.peakUsage, usage);
+      VkDeviceSize threshold = static_cast<VkDeviceSize>(
+          static_cast<double>(heapBudget(i)) * MEMORY_PRESSURE_THRESHOLD);
+      VkDeviceSize wanted = usage + heap.pressureBytes;
+      heap.pressureBytes = 0;
+      if (wanted > threshold) {
+        bool deviceLocal = (memoryProperties.memoryHeaps[i].flags &
+                            VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        pressures.push_back({i, deviceLocal, wanted - threshold});
+      }
+    }
+    pressureEvents += pressures.size();
+  }
+
+  for (const MemoryPressure &pressure : pressures) {
+    runPressureCallbacks(pressure);
+  }
+}
+
+VkDeviceSize LveDevice::runPressureCallbacks(const MemoryPressure &pressure) {
+  VkDeviceSize released = 0;
+  for (auto &callback : pressureCallbacks) {
+    if (released >= pressure.bytesToFree) {
+      break;
+    }
+    MemoryPressure remaining = pressure;
+    remaining.bytesToFree = pressure.bytesToFree - released;
+    released += callback.second(remaining);
+  }
+  return released;
+}
+
+uint32_t LveDevice::addMemoryPressureCallback(
+    MemoryPressureCallback callback) {
+  uint32_t id = nextPressureCallbackId++;
+  pressureCallbacks.emplace_back(id, std::move(callback));
+  return id;
+}
+
+void LveDevice::removeMemoryPressureCallback(uint32_t id) {
+  pressureCallbacks.erase(
+      std::remove_if(pressureCallbacks.begin(), pressureCallbacks.end(),
+                     [&](const auto &entry) { return entry.first == id; }),
+      pressureCallbacks.end());
+}
+
+LveDevice::MemoryStats LveDevice::getMemoryStats() const {
+  std::lock_guard<std::mutex> lock{memoryMutex};
+  MemoryStats stats{};
+  stats.heaps.resize(memoryHeaps.size());
+  for (uint32_t i = 0; i < memoryHeaps.size(); i++) {
+    MemoryHeapStats &heap = stats.heaps[i];
+    heap.size = memoryProperties.memoryHeaps[i].size;
+    heap.budget = heapBudget(i);
+    heap.usage = heapUsage(i);
+    heap.peakUsage = std::max(memoryHeaps[i].peakUsage, heap.usage);
+    heap.deviceLocal = (memoryProperties.memoryHeaps[i].flags &
+                        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+  }
+  stats.categoryBytes = categoryBytes;
+  stats.categoryPeakBytes = categoryPeakBytes;
+  stats.allocations = static_cast<uint32_t>(memoryAllocations.size());
+  stats.pressureEvents = pressureEvents;
+  stats.budgetExtension = memoryBudgetSupported;
+  return stats;
+}
+
+const char *LveDevice::memoryCategoryName(MemoryCategory category) {
+  switch (category) {
+  case MemoryCategory::Geometry:
+    return "geometry";
+  case MemoryCategory::Texture:
+    return "texture";
+  case MemoryCategory::RenderTarget:
+    return "render target";
+  case MemoryCategory::Uniform:
+    return "uniform";
+  case MemoryCategory::Staging:
+    return "staging";
+  case MemoryCategory::Readback:
+    return "readback";
+  case MemoryCategory::Other:
+  case MemoryCategory::Count:
+    break;
   }
+  return "other";
 }
 
 } // namespace lve
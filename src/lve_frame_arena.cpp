@@ -0,0 +1,110 @@
+#include "../include/lve_frame_arena.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+std::atomic<uint64_t> nextArenaId{1};
+
+struct WorkerSlotCache {
+  uint64_t arenaId = 0;
+  uint32_t slot = 0;
+};
+thread_local WorkerSlotCache workerSlotCache{};
+} // namespace
+
+LveFrameArena::LveFrameArena(size_t initialCapacity)
+    : arenaId{nextArenaId++}, workerCapacity{initialCapacity / 4} {
+  for (auto &frame : frames) {
+    frame = std::make_unique<Frame>(initialCapacity);
+  }
+  heapAllocationsAtFrameStart = countHeapAllocations();
+}
+
+void LveFrameArena::beginFrame(int frameIndex) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT &&
+         "Frame index out of range");
+
+  uint64_t heapAllocations = countHeapAllocations();
+  heapAllocationsLastFrame = heapAllocations - heapAllocationsAtFrameStart;
+  heapAllocationsAtFrameStart = heapAllocations;
+
+  Frame &frame = *frames[frameIndex];
+  frame.allocator.reset();
+  const uint32_t workers = workerCount.load(std::memory_order_acquire);
+  for (uint32_t slot = 0; slot < workers; slot++) {
+    frame.workers[slot]->reset();
+  }
+  // resets that merged overflow blocks may have allocated
+  heapAllocationsAtFrameStart = countHeapAllocations();
+
+  currentFrame = frameIndex;
+}
+
+LveLinearAllocator &LveFrameArena::workerAllocator() {
+  if (workerSlotCache.arenaId != arenaId) {
+    workerSlotCache.slot = claimWorkerSlot();
+    workerSlotCache.arenaId = arenaId;
+  }
+  return *frames[currentFrame]->workers[workerSlotCache.slot];
+}
+
+uint32_t LveFrameArena::claimWorkerSlot() {
+  std::lock_guard<std::mutex> lock{workerMutex};
+  const std::thread::id thread = std::this_thread::get_id();
+  for (const auto &entry : workerSlots) {
+    if (entry.first == thread) {
+      return entry.second;
+    }
+  }
+
+  if (workerSlots.size() >= MAX_WORKER_ARENAS) {
+    throw std::runtime_error("too many threads using the frame arena!");
+  }
+  uint32_t slot = static_cast<uint32_t>(workerSlots.size());
+  // created for every frame before the slot is published, so readers that
+  // stop at workerCount never see it half built
+  for (auto &frame : frames) {
+    frame->workers[slot] = std::make_unique<LveLinearAllocator>(workerCapacity);
+  }
+  workerSlots.emplace_back(thread, slot);
+  workerCount.store(slot + 1, std::memory_order_release);
+  return slot;
+}
+
+uint64_t LveFrameArena::countHeapAllocations() const {
+  uint64_t total = 0;
+  const uint32_t workers = workerCount.load(std::memory_order_acquire);
+  for (const auto &frame : frames) {
+    total += frame->allocator.heapAllocations();
+    for (uint32_t slot = 0; slot < workers; slot++) {
+      total += frame->workers[slot]->heapAllocations();
+    }
+  }
+  return total;
+}
+
+LveFrameArena::Stats LveFrameArena::getStats() const {
+  Stats stats{};
+  const uint32_t workers = workerCount.load(std::memory_order_acquire);
+  const Frame &frame = *frames[currentFrame];
+  stats.bytesUsed = frame.allocator.bytesUsed();
+  for (uint32_t slot = 0; slot < workers; slot++) {
+    stats.bytesUsed += frame.workers[slot]->bytesUsed();
+  }
+  stats.workerArenas = workers;
+  for (const auto &f : frames) {
+    stats.capacity += f->allocator.capacity();
+    for (uint32_t slot = 0; slot < workers; slot++) {
+      stats.capacity += f->workers[slot]->capacity();
+    }
+  }
+  stats.heapAllocationsLastFrame = heapAllocationsLastFrame;
+  stats.heapAllocationsTotal = countHeapAllocations();
+  return stats;
+}
+
+} // namespace lve
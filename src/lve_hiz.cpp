@@ -0,0 +1,630 @@
+#include "../include/lve_hiz.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+struct HiZPushConstants {
+  int32_t srcWidth;
+  int32_t srcHeight;
+  int32_t dstWidth;
+  int32_t dstHeight;
+  int32_t srcIsDepth;
+};
+
+VkExtent2D halfExtent(VkExtent2D extent) {
+  return {std::max(1u, extent.width / 2), std::max(1u, extent.height / 2)};
+}
+} // namespace
+
+LveHiZ::LveHiZ(LveDevice &device) : lveDevice{device} {
+  createPipeline();
+  if (supported && lveDevice.hasAsyncComputeQueue()) {
+    createAsyncCompute();
+  }
+}
+
+LveHiZ::~LveHiZ() {
+  destroyPyramid();
+  reducePipeline.reset();
+  if (asyncCompute) {
+    for (auto &frame : computeFrames) {
+      vkFreeCommandBuffers(lveDevice.device(),
+                           lveDevice.getComputeCommandPool(), 1,
+                           &frame.commandBuffer);
+      vkDestroySemaphore(lveDevice.device(), frame.depthReady, nullptr);
+      vkDestroySemaphore(lveDevice.device(), frame.reduceDone, nullptr);
+      vkDestroyFence(lveDevice.device(), frame.fence, nullptr);
+    }
+  }
+  if (supported) {
+    vkDestroySampler(lveDevice.device(), sampler, nullptr);
+    vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(lveDevice.device(), descriptorSetLayout,
+                                 nullptr);
+  }
+}
+
+void LveHiZ::createPipeline() {
+  if (!lveDevice.enabledFeatures.shaderStorageImageExtendedFormats) {
+    return;
+  }
+  try {
+    lveDevice.findSupportedFormat({VK_FORMAT_R32G32_SFLOAT},
+                                  VK_IMAGE_TILING_OPTIMAL,
+                                  VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+  } catch (const std::runtime_error &) {
+    return;
+  }
+
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+  if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr,
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z descriptor set layout!");
+  }
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(HiZPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z pipeline layout!");
+  }
+
+  reducePipeline = std::make_unique<LveComputePipeline>(
+      lveDevice, "shaders/hiz_reduce.comp.spv", pipelineLayout);
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = 0.0f;
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z sampler!");
+  }
+
+  supported = true;
+}
+
+void LveHiZ::createAsyncCompute() {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = lveDevice.getComputeCommandPool();
+  allocInfo.commandBufferCount = 1;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (auto &frame : computeFrames) {
+    if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo,
+                                 &frame.commandBuffer) != VK_SUCCESS ||
+        vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr,
+                          &frame.depthReady) != VK_SUCCESS ||
+        vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr,
+                          &frame.reduceDone) != VK_SUCCESS ||
+        vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &frame.fence) !=
+            VK_SUCCESS) {
+      throw std::runtime_error("failed to create hi-z compute objects!");
+    }
+  }
+  asyncCompute = true;
+}
+
+void LveHiZ::resize(LveSwapChain &swapChain) {
+  // frames still in flight may be reading the old pyramid
+  vkDeviceWaitIdle(lveDevice.device());
+  destroyPyramid();
+
+  currentSwapChain = &swapChain;
+  firstDepthView = swapChain.getDepthImageView(0);
+  depthExtent = swapChain.getSwapChainExtent();
+  // ownership transfers cover every aspect of a depth/stencil format
+  depthAspect = swapChain.findDepthFormat() == VK_FORMAT_D32_SFLOAT
+                    ? VK_IMAGE_ASPECT_DEPTH_BIT
+                    : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+  levelExtents.clear();
+  VkExtent2D extent = halfExtent(depthExtent);
+  levelExtents.push_back(extent);
+  while (extent.width > 1 || extent.height > 1) {
+    extent = halfExtent(extent);
+    levelExtents.push_back(extent);
+  }
+  const uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = levelExtents[0].width;
+  imageInfo.extent.height = levelExtents[0].height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32G32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                pyramidImage, pyramidMemory,
+                                MemoryCategory::RenderTarget);
+
+  levelViews.resize(levelCount);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramidImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32G32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr,
+                          &levelViews[level]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create hi-z image view!");
+    }
+  }
+
+  const uint32_t imageCount = static_cast<uint32_t>(swapChain.imageCount());
+  const uint32_t setCount = imageCount + levelCount - 1;
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = setCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = setCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr,
+                             &descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z descriptor pool!");
+  }
+
+  std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+  std::vector<VkDescriptorSet> sets(setCount);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = setCount;
+  allocInfo.pSetLayouts = layouts.data();
+  if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, sets.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+  }
+  depthSets.assign(sets.begin(), sets.begin() + imageCount);
+  levelSets.assign(sets.begin() + imageCount, sets.end());
+
+  auto writeSet = [&](VkDescriptorSet set, VkImageView srcView,
+                      VkImageLayout srcLayout, VkImageView dstView) {
+    VkDescriptorImageInfo srcInfo{sampler, srcView, srcLayout};
+    VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, dstView,
+                                  VK_IMAGE_LAYOUT_GENERAL};
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = set;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &srcInfo;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = set;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = &dstInfo;
+    vkUpdateDescriptorSets(lveDevice.device(),
+                           static_cast<uint32_t>(writes.size()), writes.data(),
+                           0, nullptr);
+  };
+  for (uint32_t i = 0; i < imageCount; i++) {
+    writeSet(depthSets[i], swapChain.getDepthImageView(i),
+             VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, levelViews[0]);
+  }
+  for (uint32_t level = 1; level < levelCount; level++) {
+    writeSet(levelSets[level - 1], levelViews[level - 1],
+             VK_IMAGE_LAYOUT_GENERAL, levelViews[level]);
+  }
+
+  readbackLevel = levelCount - 1;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    if (levelExtents[level].width <= READBACK_MAX_SIZE &&
+        levelExtents[level].height <= READBACK_MAX_SIZE) {
+      readbackLevel = level;
+      break;
+    }
+  }
+
+  const VkExtent2D readbackExtent = levelExtents[readbackLevel];
+  const VkDeviceSize readbackSize = static_cast<VkDeviceSize>(
+      readbackExtent.width * readbackExtent.height * sizeof(float) * 2);
+  for (auto &readback : readbacks) {
+    lveDevice.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           readback.buffer, readback.memory,
+                           MemoryCategory::Readback);
+    vkMapMemory(lveDevice.device(), readback.memory, 0, readbackSize, 0,
+                &readback.mapped);
+    readback.pending = false;
+  }
+
+  cpuLevels.clear();
+  extent = readbackExtent;
+  while (true) {
+    cpuLevels.push_back(
+        {extent.width, extent.height,
+         std::vector<float>(extent.width * extent.height, 1.f)});
+    if (extent.width == 1 && extent.height == 1) {
+      break;
+    }
+    extent = halfExtent(extent);
+  }
+  cpuValid = false;
+}
+
+void LveHiZ::destroyPyramid() {
+  for (auto &readback : readbacks) {
+    if (readback.buffer != VK_NULL_HANDLE) {
+      vkUnmapMemory(lveDevice.device(), readback.memory);
+      vkDestroyBuffer(lveDevice.device(), readback.buffer, nullptr);
+      lveDevice.freeMemory(readback.memory);
+    }
+    readback = Readback{};
+  }
+
+  if (descriptorPool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(lveDevice.device(), descriptorPool, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+  }
+  depthSets.clear();
+  levelSets.clear();
+
+  for (auto view : levelViews) {
+    vkDestroyImageView(lveDevice.device(), view, nullptr);
+  }
+  levelViews.clear();
+
+  if (pyramidImage != VK_NULL_HANDLE) {
+    vkDestroyImage(lveDevice.device(), pyramidImage, nullptr);
+    lveDevice.freeMemory(pyramidMemory);
+    pyramidImage = VK_NULL_HANDLE;
+    pyramidMemory = VK_NULL_HANDLE;
+  }
+  currentSwapChain = nullptr;
+  firstDepthView = VK_NULL_HANDLE;
+  cpuValid = false;
+}
+
+void LveHiZ::beginFrame(int frameIndex) {
+  if (!supported) {
+    return;
+  }
+  if (asyncCompute) {
+    // normally long done: the frame after it waited for the build
+    vkWaitForFences(lveDevice.device(), 1, &computeFrames[frameIndex].fence,
+                    VK_TRUE, UINT64_MAX);
+  }
+  Readback &readback = readbacks[frameIndex];
+  if (!readback.pending) {
+    return;
+  }
+  readback.pending = false;
+
+  // the readback holds (min, max) pairs; occlusion only needs max
+  CpuLevel &base = cpuLevels[0];
+  const float *texels = static_cast<const float *>(readback.mapped);
+  for (size_t i = 0; i < base.maxDepth.size(); i++) {
+    base.maxDepth[i] = texels[i * 2 + 1];
+  }
+
+  for (size_t level = 1; level < cpuLevels.size(); level++) {
+    const CpuLevel &src = cpuLevels[level - 1];
+    CpuLevel &dst = cpuLevels[level];
+    for (uint32_t y = 0; y < dst.height; y++) {
+      uint32_t lastY = y == dst.height - 1 ? src.height - 1
+                                           : std::min(y * 2 + 1, src.height - 1);
+      for (uint32_t x = 0; x < dst.width; x++) {
+        uint32_t lastX = x == dst.width - 1
+                             ? src.width - 1
+                             : std::min(x * 2 + 1, src.width - 1);
+        float depth = 0.f;
+        for (uint32_t sy = y * 2; sy <= lastY; sy++) {
+          for (uint32_t sx = x * 2; sx <= lastX; sx++) {
+            depth = std::max(depth, src.maxDepth[sy * src.width + sx]);
+          }
+        }
+        dst.maxDepth[y * dst.width + x] = depth;
+      }
+    }
+  }
+
+  cpuProjectionView = readback.projectionView;
+  cpuValid = true;
+}
+
+void LveHiZ::record(VkCommandBuffer commandBuffer, int frameIndex,
+                    LveRenderer &renderer, const glm::mat4 &projectionView) {
+  if (!supported) {
+    return;
+  }
+  LveSwapChain &swapChain = renderer.getSwapChain();
+  VkExtent2D extent = swapChain.getSwapChainExtent();
+  // a recreated swap chain can reuse the old address, so compare views too
+  if (&swapChain != currentSwapChain ||
+      swapChain.getDepthImageView(0) != firstDepthView ||
+      extent.width != depthExtent.width ||
+      extent.height != depthExtent.height) {
+    resize(swapChain);
+  }
+
+  if (asyncCompute) {
+    recordAsync(commandBuffer, frameIndex, renderer);
+  } else {
+    recordReduce(commandBuffer, frameIndex, renderer.getCurrentImageIndex());
+  }
+
+  Readback &readback = readbacks[frameIndex];
+  readback.projectionView = projectionView;
+  readback.pending = true;
+}
+
+void LveHiZ::recordAsync(VkCommandBuffer commandBuffer, int frameIndex,
+                         LveRenderer &renderer) {
+  ComputeFrame &frame = computeFrames[frameIndex];
+  const uint32_t imageIndex = renderer.getCurrentImageIndex();
+  const VkImage depthImage = renderer.getSwapChain().getDepthImage(imageIndex);
+  const VkImageSubresourceRange depthRange{depthAspect, 0, 1, 0, 1};
+  const uint32_t graphicsFamily = lveDevice.graphicsQueueFamily();
+  const uint32_t computeFamily = lveDevice.computeQueueFamily();
+
+  // the last build read a depth image this frame may clear. The render
+  // graph's first barrier on depth starts at the compute stage, so waiting
+  // there holds back only the clear.
+  if (unwaitedReduce >= 0) {
+    renderer.addWaitSemaphore(computeFrames[unwaitedReduce].reduceDone,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    unwaitedReduce = -1;
+  }
+
+  lveDevice.releaseImageOwnership(
+      commandBuffer, depthImage, depthRange,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, graphicsFamily,
+      computeFamily,
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin hi-z command buffer!");
+  }
+  lveDevice.acquireImageOwnership(
+      frame.commandBuffer, depthImage, depthRange,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, graphicsFamily,
+      computeFamily, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT);
+  recordReduce(frame.commandBuffer, frameIndex, imageIndex);
+  // no transfer back: the next frame clears depth from UNDEFINED, so
+  // its contents need not survive the move
+  if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record hi-z command buffer!");
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.pWaitSemaphores = &frame.depthReady;
+  submitInfo.pWaitDstStageMask = &frame.waitStage;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &frame.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &frame.reduceDone;
+
+  // beginFrame() waited for this fence
+  vkResetFences(lveDevice.device(), 1, &frame.fence);
+  renderer.addSignalSemaphore(frame.depthReady);
+  renderer.addFollowUpSubmit(lveDevice.computeQueue(), submitInfo,
+                             frame.fence);
+  unwaitedReduce = frameIndex;
+}
+
+void LveHiZ::recordReduce(VkCommandBuffer commandBuffer, int frameIndex,
+                          uint32_t imageIndex) {
+  const uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  // previous contents are not needed; wait only for last frame's readback
+  VkImageMemoryBarrier toGeneral{};
+  toGeneral.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toGeneral.srcAccessMask = 0;
+  toGeneral.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  toGeneral.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  toGeneral.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  toGeneral.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toGeneral.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toGeneral.image = pyramidImage;
+  toGeneral.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0,
+                                1};
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toGeneral);
+
+  reducePipeline->bind(commandBuffer);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    VkDescriptorSet set =
+        level == 0 ? depthSets[imageIndex] : levelSets[level - 1];
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &set, 0, nullptr);
+
+    VkExtent2D src = level == 0 ? depthExtent : levelExtents[level - 1];
+    VkExtent2D dst = levelExtents[level];
+    HiZPushConstants push{};
+    push.srcWidth = static_cast<int32_t>(src.width);
+    push.srcHeight = static_cast<int32_t>(src.height);
+    push.dstWidth = static_cast<int32_t>(dst.width);
+    push.dstHeight = static_cast<int32_t>(dst.height);
+    push.srcIsDepth = level == 0 ? 1 : 0;
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+    vkCmdDispatch(commandBuffer, (dst.width + 7) / 8, (dst.height + 7) / 8, 1);
+
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+  }
+
+  VkImageMemoryBarrier toTransfer = toGeneral;
+  toTransfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  toTransfer.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, readbackLevel, 1, 0,
+                                 1};
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toTransfer);
+
+  Readback &readback = readbacks[frameIndex];
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, readbackLevel, 0, 1};
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {levelExtents[readbackLevel].width,
+                        levelExtents[readbackLevel].height, 1};
+  vkCmdCopyImageToBuffer(commandBuffer, pyramidImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer,
+                         1, &region);
+
+  VkBufferMemoryBarrier toHost{};
+  toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = readback.buffer;
+  toHost.offset = 0;
+  toHost.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost,
+                       0, nullptr);
+}
+
+bool LveHiZ::isVisible(const LveAabb &worldBounds) const {
+  if (!cpuValid || worldBounds.isEmpty()) {
+    return true;
+  }
+
+  glm::vec2 minUv{1.f, 1.f};
+  glm::vec2 maxUv{0.f, 0.f};
+  float nearestDepth = 1.f;
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec4 position{corner & 1 ? worldBounds.max.x : worldBounds.min.x,
+                       corner & 2 ? worldBounds.max.y : worldBounds.min.y,
+                       corner & 4 ? worldBounds.max.z : worldBounds.min.z,
+                       1.f};
+    glm::vec4 clip = cpuProjectionView * position;
+    if (clip.w <= 1e-5f) {
+      return true; // straddles the camera plane
+    }
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    glm::vec2 uv{ndc.x * 0.5f + 0.5f, ndc.y * 0.5f + 0.5f};
+    minUv = glm::min(minUv, uv);
+    maxUv = glm::max(maxUv, uv);
+    nearestDepth = std::min(nearestDepth, ndc.z);
+  }
+
+  // frustum culling owns objects outside the screen or clipping the near plane
+  if (nearestDepth <= 0.f || maxUv.x < 0.f || maxUv.y < 0.f ||
+      minUv.x > 1.f || minUv.y > 1.f) {
+    return true;
+  }
+  minUv = glm::clamp(minUv, glm::vec2{0.f, 0.f}, glm::vec2{1.f, 1.f});
+  maxUv = glm::clamp(maxUv, glm::vec2{0.f, 0.f}, glm::vec2{1.f, 1.f});
+
+  // pick the level where the rect covers about two texels per axis
+  const CpuLevel &base = cpuLevels[0];
+  float texels = std::max((maxUv.x - minUv.x) * base.width,
+                          (maxUv.y - minUv.y) * base.height);
+  int level = texels > 2.f ? static_cast<int>(std::ceil(std::log2(texels / 2.f)))
+                           : 0;
+  level = std::min(level, static_cast<int>(cpuLevels.size()) - 1);
+  const CpuLevel &hiz = cpuLevels[level];
+
+  // grow by a texel to stay conservative where odd sizes were folded
+  auto texel = [](float uv, uint32_t size) {
+    return static_cast<int>(uv * static_cast<float>(size));
+  };
+  int x0 = std::max(0, texel(minUv.x, hiz.width) - 1);
+  int y0 = std::max(0, texel(minUv.y, hiz.height) - 1);
+  int x1 = std::min(static_cast<int>(hiz.width) - 1,
+                    texel(maxUv.x, hiz.width) + 1);
+  int y1 = std::min(static_cast<int>(hiz.height) - 1,
+                    texel(maxUv.y, hiz.height) + 1);
+
+  float occluderDepth = 0.f;
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      occluderDepth = std::max(occluderDepth, hiz.maxDepth[y * hiz.width + x]);
+    }
+  }
+  return nearestDepth <= occluderDepth;
+}
+
+} // namespace lve
@@ -0,0 +1,222 @@
+#include "../include/lve_image.hpp"
+
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+bool hasExtension(const std::string &filepath, const char *extension) {
+  size_t dot = filepath.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string ext = filepath.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return ext == extension;
+}
+
+LveImageData decodeTga(const LveMappedFile &bytes,
+                       const std::string &filepath) {
+  const auto *data = reinterpret_cast<const uint8_t *>(bytes.data());
+  if (bytes.size() < 18) {
+    throw std::runtime_error("truncated TGA header: " + filepath);
+  }
+  uint8_t idLength = data[0];
+  uint8_t colorMapType = data[1];
+  uint8_t imageType = data[2];
+  uint32_t width = data[12] | (data[13] << 8);
+  uint32_t height = data[14] | (data[15] << 8);
+  uint8_t bitsPerPixel = data[16];
+  bool topToBottom = (data[17] & 0x20) != 0;
+
+  bool rle = imageType == 10 || imageType == 11;
+  bool grayscale = imageType == 3 || imageType == 11;
+  if (colorMapType != 0 || !(imageType == 2 || imageType == 3 || rle)) {
+    throw std::runtime_error("unsupported TGA type: " + filepath);
+  }
+  uint32_t bytesPerPixel = bitsPerPixel / 8;
+  if ((grayscale && bytesPerPixel != 1) ||
+      (!grayscale && bytesPerPixel != 3 && bytesPerPixel != 4) || width == 0 ||
+      height == 0) {
+    throw std::runtime_error("unsupported TGA pixel format: " + filepath);
+  }
+
+  LveImageData image{};
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+  size_t pos = 18 + idLength;
+  const size_t end = bytes.size();
+  auto readPixel = [&](uint8_t *out) {
+    if (pos + bytesPerPixel > end) {
+      throw std::runtime_error("truncated TGA pixel data: " + filepath);
+    }
+    const uint8_t *p = data + pos;
+    if (grayscale) {
+      out[0] = out[1] = out[2] = p[0];
+      out[3] = 255;
+    } else {
+      out[0] = p[2];
+      out[1] = p[1];
+      out[2] = p[0];
+      out[3] = bytesPerPixel == 4 ? p[3] : 255;
+    }
+    pos += bytesPerPixel;
+  };
+
+  // decode in file order, then flip bottom-up images
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+  uint8_t *out = image.pixels.data();
+  size_t written = 0;
+  while (written < pixelCount) {
+    if (!rle) {
+      readPixel(out + written * 4);
+      written++;
+      continue;
+    }
+    if (pos >= end) {
+      throw std::runtime_error("truncated TGA packet: " + filepath);
+    }
+    uint8_t header = data[pos++];
+    size_t run = std::min<size_t>((header & 0x7f) + 1, pixelCount - written);
+    if (header & 0x80) {
+      uint8_t pixel[4];
+      readPixel(pixel);
+      for (size_t i = 0; i < run; i++) {
+        std::copy(pixel, pixel + 4, out + (written + i) * 4);
+      }
+    } else {
+      for (size_t i = 0; i < run; i++) {
+        readPixel(out + (written + i) * 4);
+      }
+    }
+    written += run;
+  }
+
+  if (!topToBottom) {
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    for (uint32_t y = 0; y < height / 2; y++) {
+      std::swap_ranges(out + y * rowBytes, out + (y + 1) * rowBytes,
+                       out + (height - 1 - y) * rowBytes);
+    }
+  }
+  return image;
+}
+
+LveImageData decodePpm(const LveMappedFile &bytes,
+                       const std::string &filepath) {
+  size_t pos = 2; // past "P6"
+  auto readNumber = [&]() {
+    // whitespace and comments may separate header fields
+    while (pos < bytes.size()) {
+      if (bytes[pos] == '#') {
+        while (pos < bytes.size() && bytes[pos] != '\n') {
+          pos++;
+        }
+      } else if (std::isspace(static_cast<unsigned char>(bytes[pos]))) {
+        pos++;
+      } else {
+        break;
+      }
+    }
+    uint32_t value = 0;
+    bool any = false;
+    while (pos < bytes.size() &&
+           std::isdigit(static_cast<unsigned char>(bytes[pos]))) {
+      value = value * 10 + static_cast<uint32_t>(bytes[pos++] - '0');
+      any = true;
+    }
+    if (!any) {
+      throw std::runtime_error("malformed PPM header: " + filepath);
+    }
+    return value;
+  };
+
+  uint32_t width = readNumber();
+  uint32_t height = readNumber();
+  uint32_t maxValue = readNumber();
+  pos++; // single whitespace before the raster
+  if (width == 0 || height == 0 || maxValue == 0 || maxValue > 255) {
+    throw std::runtime_error("unsupported PPM format: " + filepath);
+  }
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+  if (pos + pixelCount * 3 > bytes.size()) {
+    throw std::runtime_error("truncated PPM pixel data: " + filepath);
+  }
+
+  LveImageData image{};
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(pixelCount * 4);
+  const auto *src = reinterpret_cast<const uint8_t *>(bytes.data() + pos);
+  for (size_t i = 0; i < pixelCount; i++) {
+    for (int c = 0; c < 3; c++) {
+      image.pixels[i * 4 + c] =
+          static_cast<uint8_t>(src[i * 3 + c] * 255u / maxValue);
+    }
+    image.pixels[i * 4 + 3] = 255;
+  }
+  return image;
+}
+} // namespace
+
+LveImageData LveImageLoader::loadRgba8(const std::string &filepath) {
+  return decodeRgba8(LveArchive::openFile(filepath), filepath);
+}
+
+LveImageData LveImageLoader::decodeRgba8(const LveMappedFile &bytes,
+                                         const std::string &filepath) {
+  if (bytes.size() >= 2 && bytes[0] == 'P' && bytes[1] == '6') {
+    return decodePpm(bytes, filepath);
+  }
+  if (hasExtension(filepath, "tga")) {
+    return decodeTga(bytes, filepath);
+  }
+  throw std::runtime_error("unsupported image format: " + filepath);
+}
+
+LveImageData LveImageLoader::downsample(const LveImageData &source) {
+  LveImageData result{};
+  result.width = std::max(1u, source.width / 2);
+  result.height = std::max(1u, source.height / 2);
+  result.pixels.resize(static_cast<size_t>(result.width) * result.height * 4);
+
+  const uint8_t *src = source.pixels.data();
+  for (uint32_t y = 0; y < result.height; y++) {
+    uint32_t y0 = std::min(y * 2, source.height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+    for (uint32_t x = 0; x < result.width; x++) {
+      uint32_t x0 = std::min(x * 2, source.width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+      const uint8_t *p00 = src + (static_cast<size_t>(y0) * source.width + x0) * 4;
+      const uint8_t *p01 = src + (static_cast<size_t>(y0) * source.width + x1) * 4;
+      const uint8_t *p10 = src + (static_cast<size_t>(y1) * source.width + x0) * 4;
+      const uint8_t *p11 = src + (static_cast<size_t>(y1) * source.width + x1) * 4;
+      uint8_t *dst =
+          result.pixels.data() + (static_cast<size_t>(y) * result.width + x) * 4;
+      for (int c = 0; c < 4; c++) {
+        dst[c] = static_cast<uint8_t>((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+      }
+    }
+  }
+  return result;
+}
+
+uint32_t LveImageLoader::mipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  uint32_t size = std::max(width, height);
+  while (size > 1) {
+    size /= 2;
+    levels++;
+  }
+  return levels;
+}
+
+} // namespace lve
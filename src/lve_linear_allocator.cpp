@@ -0,0 +1,60 @@
+#include "../include/lve_linear_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace lve {
+
+LveLinearAllocator::LveLinearAllocator(size_t initialCapacity) {
+  addBlock(initialCapacity);
+}
+
+void *LveLinearAllocator::allocate(size_t size, size_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0 &&
+         "Alignment must be a power of two");
+
+  Block *block = &blocks.back();
+  uintptr_t base = reinterpret_cast<uintptr_t>(block->data.get());
+  size_t aligned = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+  if (aligned + size > block->size) {
+    // overflow: chain a block at least as big as everything used so far
+    addBlock(std::max(size + alignment, block->size * 2));
+    block = &blocks.back();
+    base = reinterpret_cast<uintptr_t>(block->data.get());
+    aligned = ((base + alignment - 1) & ~(alignment - 1)) - base;
+  }
+
+  used += aligned - offset + size;
+  offset = aligned + size;
+  peak = std::max(peak, used);
+  return block->data.get() + aligned;
+}
+
+void LveLinearAllocator::reset() {
+  if (blocks.size() > 1) {
+    // fold the chain into one block covering the high-water mark
+    size_t total = capacity();
+    blocks.clear();
+    addBlock(total);
+  }
+  offset = 0;
+  used = 0;
+}
+
+size_t LveLinearAllocator::capacity() const {
+  size_t total = 0;
+  for (const auto &block : blocks) {
+    total += block.size;
+  }
+  return total;
+}
+
+void LveLinearAllocator::addBlock(size_t minSize) {
+  blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[minSize]),
+                    minSize});
+  blockAllocations++;
+  offset = 0;
+}
+
+} // namespace lve
@@ -0,0 +1,207 @@
+#include "../include/lve_mapped_file.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+namespace {
+#ifdef LVE_MMAP
+size_t pageSize() {
+  static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+int adviceFor(LveMappedFile::Access access) {
+  switch (access) {
+  case LveMappedFile::Access::Sequential:
+    return MADV_SEQUENTIAL;
+  case LveMappedFile::Access::Random:
+    return MADV_RANDOM;
+  default:
+    return MADV_NORMAL;
+  }
+}
+#endif
+} // namespace
+
+LveMappedFile::LveMappedFile(const std::string &filepath, Access access) {
+#ifdef LVE_MMAP
+  int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open file: " + filepath);
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("failed to open file: " + filepath);
+  }
+  byteCount = static_cast<size_t>(info.st_size);
+  if (byteCount > 0) {
+    void *address =
+        mmap(nullptr, byteCount, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("failed to map file: " + filepath);
+    }
+    mapping = address;
+    mappingSize = byteCount;
+    bytes = static_cast<const char *>(address);
+    madvise(mapping, mappingSize, adviceFor(access));
+  }
+  // the mapping keeps the file referenced
+  close(fd);
+#else
+  (void)access;
+  std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file: " + filepath);
+  }
+  byteCount = static_cast<size_t>(file.tellg());
+  buffer.reset(new uint32_t[(byteCount + 3) / 4]);
+  bytes = reinterpret_cast<const char *>(buffer.get());
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(buffer.get()), byteCount);
+#endif
+}
+
+LveMappedFile::~LveMappedFile() { release(); }
+
+LveMappedFile LveMappedFile::fromBytes(const void *source, size_t size) {
+  LveMappedFile file = allocate(size);
+  if (size > 0) {
+    std::memcpy(file.writableData(), source, size);
+  }
+  return file;
+}
+
+LveMappedFile LveMappedFile::allocate(size_t size) {
+  LveMappedFile file{};
+  file.buffer.reset(new uint32_t[(size + 3) / 4]);
+  file.bytes = reinterpret_cast<const char *>(file.buffer.get());
+  file.byteCount = size;
+  return file;
+}
+
+LveMappedFile LveMappedFile::view(const char *source, size_t size) {
+  assert(reinterpret_cast<uintptr_t>(source) % sizeof(uint32_t) == 0 &&
+         "Mapped file views must be 4-byte aligned");
+  LveMappedFile file{};
+  file.bytes = source;
+  file.byteCount = size;
+  return file;
+}
+
+char *LveMappedFile::writableData() {
+  assert(buffer && "Only allocated buffers are writable");
+  return reinterpret_cast<char *>(buffer.get());
+}
+
+LveMappedFile::LveMappedFile(LveMappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+LveMappedFile &LveMappedFile::operator=(LveMappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    mapping = std::exchange(other.mapping, nullptr);
+    mappingSize = std::exchange(other.mappingSize, 0);
+    buffer = std::move(other.buffer);
+    bytes = std::exchange(other.bytes, nullptr);
+    byteCount = std::exchange(other.byteCount, 0);
+  }
+  return *this;
+}
+
+void LveMappedFile::release() {
+#ifdef LVE_MMAP
+  if (mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+#endif
+  mapping = nullptr;
+  mappingSize = 0;
+  buffer.reset();
+  bytes = nullptr;
+  byteCount = 0;
+}
+
+void LveMappedFile::willNeed(size_t offset, size_t length) const {
+#ifdef LVE_MMAP
+  if (mapping == nullptr || offset >= mappingSize) {
+    return;
+  }
+  // madvise wants a page aligned start
+  size_t start = offset - offset % pageSize();
+  size_t end = length > mappingSize - offset ? mappingSize : offset + length;
+  madvise(static_cast<char *>(mapping) + start, end - start, MADV_WILLNEED);
+#else
+  (void)offset;
+  (void)length;
+#endif
+}
+
+void LveMappedFile::prefetch() const {
+#ifdef LVE_MMAP
+  if (mapping == nullptr) {
+    return;
+  }
+  willNeed();
+  // one read per page faults it in if readahead has not got there yet
+  const volatile char *page = static_cast<const char *>(mapping);
+  char sink = 0;
+  for (size_t offset = 0; offset < mappingSize; offset += pageSize()) {
+    sink ^= page[offset];
+  }
+  (void)sink;
+#endif
+}
+
+void LveMappedFile::dontNeed() const {
+#ifdef LVE_MMAP
+  if (mapping != nullptr) {
+    madvise(mapping, mappingSize, MADV_DONTNEED);
+  }
+#endif
+}
+
+LveFilePrefetcher::LveFilePrefetcher(uint32_t threadCount) {
+  // reads are I/O bound; one thread keeps them from competing for the disk
+  worker = std::make_unique<LveThreadPool>(std::max(1u, threadCount));
+}
+
+LveFilePrefetcher::~LveFilePrefetcher() {
+  shuttingDown = true;
+  worker.reset();
+}
+
+void LveFilePrefetcher::prefetch(const std::string &filepath) {
+  pending++;
+  worker->submit([this, filepath] {
+    if (!shuttingDown) {
+      try {
+        LveMappedFile file{filepath};
+        file.prefetch();
+        bytesRead += file.size();
+      } catch (const std::exception &) {
+        // reported by whoever opens the file for real
+      }
+    }
+    pending--;
+  });
+}
+
+} // namespace lve
@@ -0,0 +1,252 @@
+#include "../include/lve_meshlet.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace lve {
+
+namespace {
+
+struct MeshletInProgress {
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> vertices;
+};
+
+// Ritter's bounding sphere: cheap and within ~5% of optimal
+void computeBoundingSphere(const std::vector<glm::vec3> &positions,
+                           const std::vector<uint32_t> &vertices,
+                           glm::vec3 &center, float &radius) {
+  glm::vec3 a = positions[vertices[0]];
+  glm::vec3 b = a;
+  float best = -1.f;
+  for (uint32_t v : vertices) {
+    glm::vec3 d = positions[v] - a;
+    if (glm::dot(d, d) > best) {
+      best = glm::dot(d, d);
+      b = positions[v];
+    }
+  }
+  glm::vec3 c = b;
+  best = -1.f;
+  for (uint32_t v : vertices) {
+    glm::vec3 d = positions[v] - b;
+    if (glm::dot(d, d) > best) {
+      best = glm::dot(d, d);
+      c = positions[v];
+    }
+  }
+
+  center = (b + c) * 0.5f;
+  radius = glm::length(c - b) * 0.5f;
+  for (uint32_t v : vertices) {
+    float distance = glm::length(positions[v] - center);
+    if (distance > radius) {
+      float newRadius = (radius + distance) * 0.5f;
+      center += (positions[v] - center) * ((newRadius - radius) / distance);
+      radius = newRadius;
+    }
+  }
+}
+
+void computeNormalCone(const std::vector<glm::vec3> &positions,
+                       const std::vector<uint32_t> &indices,
+                       const std::vector<uint32_t> &triangles,
+                       glm::vec3 &axis, float &cutoff) {
+  std::vector<glm::vec3> normals;
+  normals.reserve(triangles.size());
+  glm::vec3 sum{0.f};
+  for (uint32_t t : triangles) {
+    const glm::vec3 &p0 = positions[indices[t * 3 + 0]];
+    const glm::vec3 &p1 = positions[indices[t * 3 + 1]];
+    const glm::vec3 &p2 = positions[indices[t * 3 + 2]];
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(n);
+    if (length <= std::numeric_limits<float>::epsilon()) {
+      continue; // degenerate triangle, never visible
+    }
+    n /= length;
+    normals.push_back(n);
+    sum += n;
+  }
+
+  axis = glm::vec3{0.f, 0.f, 1.f};
+  cutoff = 1.f;
+  float sumLength = glm::length(sum);
+  if (normals.empty() || sumLength <= std::numeric_limits<float>::epsilon()) {
+    return;
+  }
+  axis = sum / sumLength;
+
+  float minDot = 1.f;
+  for (const auto &n : normals) {
+    minDot = std::min(minDot, glm::dot(axis, n));
+  }
+  // a cone wider than a hemisphere can never be fully back-facing
+  if (minDot <= 0.f) {
+    return;
+  }
+  cutoff = std::sqrt(1.f - minDot * minDot);
+}
+
+} // namespace
+
+std::vector<LveMeshlet>
+LveMeshletBuilder::build(const std::vector<glm::vec3> &positions,
+                         std::vector<uint32_t> &indices) {
+  assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+  const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+  // vertex -> triangles adjacency, flattened
+  std::vector<uint32_t> adjacencyOffsets(positions.size() + 1, 0);
+  for (uint32_t index : indices) {
+    adjacencyOffsets[index + 1]++;
+  }
+  for (size_t i = 1; i < adjacencyOffsets.size(); i++) {
+    adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                               adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      for (int k = 0; k < 3; k++) {
+        adjacency[fill[indices[t * 3 + k]]++] = t;
+      }
+    }
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  // last meshlet that referenced each vertex, to count shared vertices
+  std::vector<uint32_t> vertexOwner(positions.size(),
+                                    std::numeric_limits<uint32_t>::max());
+
+  std::vector<LveMeshlet> meshlets;
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indices.size());
+
+  MeshletInProgress current;
+  uint32_t meshletId = 0;
+  uint32_t nextSeed = 0;
+
+  auto newVertexCount = [&](uint32_t t) {
+    uint32_t count = 0;
+    for (int k = 0; k < 3; k++) {
+      if (vertexOwner[indices[t * 3 + k]] != meshletId) {
+        count++;
+      }
+    }
+    return count;
+  };
+
+  auto flush = [&]() {
+    if (current.triangles.empty()) {
+      return;
+    }
+    LveMeshlet meshlet{};
+    meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+    meshlet.indexCount = static_cast<uint32_t>(current.triangles.size() * 3);
+    meshlet.vertexCount = static_cast<uint32_t>(current.vertices.size());
+    computeBoundingSphere(positions, current.vertices, meshlet.center,
+                          meshlet.radius);
+    computeNormalCone(positions, indices, current.triangles, meshlet.coneAxis,
+                      meshlet.coneCutoff);
+    for (uint32_t t : current.triangles) {
+      reordered.insert(reordered.end(), indices.begin() + t * 3,
+                       indices.begin() + t * 3 + 3);
+    }
+    meshlets.push_back(meshlet);
+    current.triangles.clear();
+    current.vertices.clear();
+    meshletId++;
+  };
+
+  for (uint32_t emittedCount = 0; emittedCount < triangleCount;
+       emittedCount++) {
+    // prefer the unemitted neighbour that adds the fewest new vertices, so
+    // clusters grow as connected patches with tight bounds and cones
+    uint32_t best = std::numeric_limits<uint32_t>::max();
+    uint32_t bestCost = 4;
+    for (uint32_t v : current.vertices) {
+      for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1];
+           a++) {
+        uint32_t t = adjacency[a];
+        if (emitted[t]) {
+          continue;
+        }
+        uint32_t cost = newVertexCount(t);
+        if (cost < bestCost) {
+          best = t;
+          bestCost = cost;
+        }
+      }
+      if (bestCost == 0) {
+        break;
+      }
+    }
+
+    if (best == std::numeric_limits<uint32_t>::max()) {
+      while (emitted[nextSeed]) {
+        nextSeed++;
+      }
+      best = nextSeed;
+      bestCost = newVertexCount(best);
+    }
+
+    if (current.vertices.size() + bestCost > MAX_VERTICES ||
+        current.triangles.size() + 1 > MAX_TRIANGLES) {
+      flush();
+      bestCost = 3;
+    }
+
+    emitted[best] = true;
+    current.triangles.push_back(best);
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[best * 3 + k];
+      if (vertexOwner[v] != meshletId) {
+        vertexOwner[v] = meshletId;
+        current.vertices.push_back(v);
+      }
+    }
+  }
+  flush();
+
+  indices.swap(reordered);
+  return meshlets;
+}
+
+void cullMeshlets(const std::vector<LveMeshlet> &meshlets,
+                  const LveFrustum &frustum, const glm::vec3 &cameraPosition,
+                  bool coneCulling,
+                  std::vector<LveMeshletDrawRange> &drawRanges,
+                  LveMeshletCullStats &stats) {
+  // ranges before this belong to other draws and must not grow
+  const size_t firstRange = drawRanges.size();
+  for (const auto &meshlet : meshlets) {
+    stats.total++;
+    if (!frustum.intersectsSphere(meshlet.center, meshlet.radius)) {
+      stats.frustumCulled++;
+      continue;
+    }
+    if (coneCulling) {
+      glm::vec3 toCluster = meshlet.center - cameraPosition;
+      if (glm::dot(toCluster, meshlet.coneAxis) >=
+          meshlet.coneCutoff * glm::length(toCluster) + meshlet.radius) {
+        stats.coneCulled++;
+        continue;
+      }
+    }
+
+    if (drawRanges.size() > firstRange &&
+        drawRanges.back().firstIndex + drawRanges.back().indexCount ==
+            meshlet.firstIndex) {
+      drawRanges.back().indexCount += meshlet.indexCount;
+    } else {
+      drawRanges.push_back({meshlet.firstIndex, meshlet.indexCount});
+    }
+  }
+}
+
+} // namespace lve
@@ -1,43 +1,169 @@
 #include "../include/lve_model.hpp"
 #include "../include/lve_device.hpp"
+#include "../include/lve_hash.hpp"
 #include "vulkan/vulkan_core.h"
 
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+std::atomic<uint32_t> nextModelId{0};
+
+struct VertexHash {
+  std::size_t operator()(const lve::LveModel::Vertex &vertex) const {
+    std::size_t seed = 0;
+    for (int i = 0; i < 3; i++) {
+      lve::hashCombine(seed, vertex.position[i]);
+      lve::hashCombine(seed, vertex.color[i]);
+      lve::hashCombine(seed, vertex.normal[i]);
+    }
+    return seed;
+  }
+};
+} // namespace
 
 namespace lve {
-LveModel::LveModel(LveDevice &device, const std::vector<Vertex> &vertices)
-    : lveDevice(device) {
-  createVertexBuffer(vertices);
+LveModel::LveModel(LveDevice &device, const Builder &builder)
+    : lveDevice(device), id(nextModelId++) {
+  createVertexBuffers(builder.vertices);
+  for (const auto &vertex : builder.vertices) {
+    boundingBox.expand(vertex.position);
+  }
+
+  if (!builder.indices.empty()) {
+    std::vector<glm::vec3> positions(builder.vertices.size());
+    for (size_t i = 0; i < builder.vertices.size(); i++) {
+      positions[i] = builder.vertices[i].position;
+    }
+    // meshlet building reorders the indices so each cluster is one range
+    std::vector<uint32_t> indices = builder.indices;
+    meshlets = LveMeshletBuilder::build(positions, indices);
+    createIndexBuffers(indices);
+  }
 }
 LveModel::~LveModel() {
   vkDestroyBuffer(lveDevice.device(), vertexBuffer, nullptr);
-  vkFreeMemory(lveDevice.device(), vertexBufferMemory, nullptr);
+  lveDevice.freeMemory(vertexBufferMemory);
+
+  if (hasIndexBuffer_) {
+    vkDestroyBuffer(lveDevice.device(), indexBuffer, nullptr);
+    lveDevice.freeMemory(indexBufferMemory);
+  }
 }
 
-void LveModel::createVertexBuffer(const std::vector<Vertex> &vertices) {
+void LveModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
   vertexCount = static_cast<uint32_t>(vertices.size());
   assert(vertexCount >= 3 && "Vertex count must be at least 3");
   VkDeviceSize bufferSize = vertexCount * sizeof(Vertex);
   lveDevice.createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         vertexBuffer, vertexBufferMemory);
+                         vertexBuffer, vertexBufferMemory,
+                         MemoryCategory::Geometry);
   void *data;
   vkMapMemory(lveDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
   memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
   vkUnmapMemory(lveDevice.device(), vertexBufferMemory);
 }
 
+void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
+  indexCount = static_cast<uint32_t>(indices.size());
+  hasIndexBuffer_ = indexCount > 0;
+  if (!hasIndexBuffer_) {
+    return;
+  }
+
+  VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
+  lveDevice.createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         indexBuffer, indexBufferMemory,
+                         MemoryCategory::Geometry);
+  void *data;
+  vkMapMemory(lveDevice.device(), indexBufferMemory, 0, bufferSize, 0, &data);
+  memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
+  vkUnmapMemory(lveDevice.device(), indexBufferMemory);
+}
+
 // Binds the vertex buffer
 void LveModel::bind(VkCommandBuffer commandBuffer) {
   VkBuffer vertexBuffers[] = {vertexBuffer};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+  if (hasIndexBuffer_) {
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  }
 }
 
 // Issues the draw command
 void LveModel::draw(VkCommandBuffer commandBuffer) {
-  vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+  if (hasIndexBuffer_) {
+    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+  } else {
+    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+  }
+}
+
+// Draws a sub-range of the index buffer, e.g. a run of visible meshlets
+void LveModel::drawRange(VkCommandBuffer commandBuffer, uint32_t firstIndex,
+                         uint32_t rangeIndexCount) {
+  assert(hasIndexBuffer_ && "Range draws require an index buffer");
+  vkCmdDrawIndexed(commandBuffer, rangeIndexCount, 1, firstIndex, 0, 0);
+}
+
+void LveModel::Builder::computeFlatNormals() {
+  if (!indices.empty()) {
+    // a vertex cannot carry two faces' normals; unweld first
+    std::vector<Vertex> corners;
+    corners.reserve(indices.size());
+    for (uint32_t index : indices) {
+      corners.push_back(vertices[index]);
+    }
+    vertices.swap(corners);
+    indices.clear();
+  }
+  assert(vertices.size() % 3 == 0 && "Flat normals need a triangle list");
+
+  for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+    glm::vec3 normal =
+        glm::cross(vertices[i + 1].position - vertices[i].position,
+                   vertices[i + 2].position - vertices[i].position);
+    float length = glm::length(normal);
+    // degenerate triangles cover no pixels; any unit vector will do
+    normal = length > 0.f ? normal / length : glm::vec3{0.f, -1.f, 0.f};
+    for (size_t corner = 0; corner < 3; corner++) {
+      vertices[i + corner].normal = normal;
+    }
+  }
+}
+
+void LveModel::Builder::weldVertices() {
+  std::vector<Vertex> source;
+  if (indices.empty()) {
+    source.swap(vertices);
+  } else {
+    for (uint32_t index : indices) {
+      source.push_back(vertices[index]);
+    }
+    vertices.clear();
+    indices.clear();
+  }
+
+  std::unordered_map<Vertex, uint32_t, VertexHash> uniqueVertices{};
+  indices.reserve(source.size());
+  for (const auto &vertex : source) {
+    auto it = uniqueVertices.find(vertex);
+    if (it == uniqueVertices.end()) {
+      it = uniqueVertices
+               .emplace(vertex, static_cast<uint32_t>(vertices.size()))
+               .first;
+      vertices.push_back(vertex);
+    }
+    indices.push_back(it->second);
+  }
 }
 
 std::vector<VkVertexInputBindingDescription>
@@ -51,7 +177,7 @@ LveModel::Vertex::getBindingDescriptions() {
 
 std::vector<VkVertexInputAttributeDescription>
 LveModel::Vertex::getAttributeDescriptions() {
-  std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
   attributeDescriptions[0].binding = 0;
   attributeDescriptions[0].location = 0;
   attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -62,6 +188,11 @@ LveModel::Vertex::getAttributeDescriptions() {
   attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
   attributeDescriptions[1].offset = offsetof(Vertex, color);
 
+  attributeDescriptions[2].binding = 0;
+  attributeDescriptions[2].location = 2;
+  attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributeDescriptions[2].offset = offsetof(Vertex, normal);
+
   return attributeDescriptions;
 }
 
@@ -1,19 +1,39 @@
 #include "../include/lve_pipeline.hpp"
 
+#include "../include/lve_archive.hpp"
 #include "../include/lve_model.hpp"
 
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 
 namespace lve {
 
+namespace {
+std::atomic<uint32_t> nextPipelineId{0};
+} // namespace
+
+void PipelineConfigInfo::setSpecializationConstant(uint32_t constantId,
+                                                   uint32_t value) {
+  auto it = std::lower_bound(
+      specializationConstants.begin(), specializationConstants.end(),
+      constantId, [](const SpecializationConstant &constant, uint32_t id) {
+        return constant.constantId < id;
+      });
+  if (it != specializationConstants.end() && it->constantId == constantId) {
+    it->value = value;
+  } else {
+    specializationConstants.insert(it, {constantId, value});
+  }
+}
+
 LvePipeline::LvePipeline(LveDevice &device, const std::string &vertFilepath,
                          const std::string &fragFilepath,
                          const PipelineConfigInfo &configInfo)
-    : lveDevice{device} {
+    : lveDevice{device}, id{nextPipelineId++} {
   createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
 }
 
@@ -24,20 +44,8 @@ LvePipeline::~LvePipeline() {
 }
 
 std::vector<char> LvePipeline::readFile(const std::string &filepath) {
-  std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-  if (!file.is_open()) {
-    throw std::runtime_error("failed to open file: " + filepath);
-  }
-
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
-
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-
-  file.close();
-  return buffer;
+  LveMappedFile file = LveArchive::openFile(filepath);
+  return std::vector<char>(file.data(), file.data() + file.size());
 }
 
 void LvePipeline::createGraphicsPipeline(const std::string &vertFilepath,
@@ -46,15 +54,38 @@ void LvePipeline::createGraphicsPipeline(const std::string &vertFilepath,
   assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
          "Cannot create graphics pipeline: no pipelineLayout provided in "
          "configInfo");
-  assert(
-      configInfo.renderPass != VK_NULL_HANDLE &&
-      "Cannot create graphics pipeline: no renderPass provided in configInfo");
-
-  auto vertCode = readFile(vertFilepath);
-  auto fragCode = readFile(fragFilepath);
+  assert(!configInfo.renderTarget.empty() &&
+         "Cannot create graphics pipeline: no renderTarget provided in "
+         "configInfo");
 
+  // modules are created straight from the mapped files or archive entries
+  LveMappedFile vertCode = LveArchive::openFile(vertFilepath);
   createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
+  const bool hasFragment = !fragFilepath.empty();
+  if (hasFragment) {
+    LveMappedFile fragCode = LveArchive::openFile(fragFilepath);
+    createShaderModule(fragCode, &fragShaderModule);
+  }
+
+  std::vector<VkSpecializationMapEntry> specializationEntries;
+  std::vector<uint32_t> specializationData;
+  for (const auto &constant : configInfo.specializationConstants) {
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constant.constantId;
+    entry.offset =
+        static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    specializationEntries.push_back(entry);
+    specializationData.push_back(constant.value);
+  }
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount =
+      static_cast<uint32_t>(specializationEntries.size());
+  specializationInfo.pMapEntries = specializationEntries.data();
+  specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+  specializationInfo.pData = specializationData.data();
+  const VkSpecializationInfo *pSpecializationInfo =
+      specializationEntries.empty() ? nullptr : &specializationInfo;
 
   VkPipelineShaderStageCreateInfo shaderStages[2];
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -63,17 +94,19 @@ void LvePipeline::createGraphicsPipeline(const std::string &vertFilepath,
   shaderStages[0].pName = "main";
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
-  shaderStages[0].pSpecializationInfo = nullptr;
+  shaderStages[0].pSpecializationInfo = pSpecializationInfo;
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = fragShaderModule;
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
+  shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
   auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
-  auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
+  auto attributeDescriptions =
+      vertexAttributesFor(LveShaderReflection::reflect(vertCode.words(),
+                                                       vertCode.size()));
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -86,37 +119,76 @@ void LvePipeline::createGraphicsPipeline(const std::string &vertFilepath,
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
+  pipelineInfo.stageCount = hasFragment ? 2 : 1;
   pipelineInfo.pStages = shaderStages;
   pipelineInfo.pVertexInputState = &vertexInputInfo;
   pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
   pipelineInfo.pViewportState = &configInfo.viewportInfo;
   pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-  pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+  VkPipelineMultisampleStateCreateInfo multisampleInfo =
+      configInfo.multisampleInfo;
+  multisampleInfo.rasterizationSamples = configInfo.renderTarget.samples;
+  pipelineInfo.pMultisampleState = &multisampleInfo;
   pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
   pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
   pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
   pipelineInfo.layout = configInfo.pipelineLayout;
-  pipelineInfo.renderPass = configInfo.renderPass;
-  pipelineInfo.subpass = configInfo.subpass;
+  const PipelineRenderTarget &target = configInfo.renderTarget;
+  // without a render pass the attachment formats are all the pipeline
+  // needs, so it works with any images of those formats
+  VkPipelineRenderingCreateInfo renderingInfo{};
+  if (target.renderPass == VK_NULL_HANDLE) {
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount =
+        static_cast<uint32_t>(target.colorFormats.size());
+    renderingInfo.pColorAttachmentFormats = target.colorFormats.data();
+    renderingInfo.depthAttachmentFormat = target.depthFormat;
+    pipelineInfo.pNext = &renderingInfo;
+  }
+  pipelineInfo.renderPass = target.renderPass;
+  pipelineInfo.subpass = target.subpass;
 
   pipelineInfo.basePipelineIndex = -1;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  if (vkCreateGraphicsPipelines(lveDevice.device(), VK_NULL_HANDLE, 1,
-                                &pipelineInfo, nullptr,
-                                &graphicsPipeline) != VK_SUCCESS) {
+  if (vkCreateGraphicsPipelines(lveDevice.device(),
+                                lveDevice.getPipelineCache(), 1, &pipelineInfo,
+                                nullptr, &graphicsPipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline");
   }
 }
 
-void LvePipeline::createShaderModule(const std::vector<char> &code,
+std::vector<VkVertexInputAttributeDescription> LvePipeline::vertexAttributesFor(
+    const LveShaderReflection &vertexReflection) {
+  auto modelAttributes = LveModel::Vertex::getAttributeDescriptions();
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  for (const auto &input : vertexReflection.vertexInputs) {
+    auto it = std::find_if(modelAttributes.begin(), modelAttributes.end(),
+                           [&](const VkVertexInputAttributeDescription &a) {
+                             return a.location == input.location;
+                           });
+    if (it == modelAttributes.end()) {
+      throw std::runtime_error("vertex shader reads location " +
+                               std::to_string(input.location) +
+                               ", which LveModel::Vertex does not provide");
+    }
+    if (it->format != input.format) {
+      throw std::runtime_error("vertex shader reads location " +
+                               std::to_string(input.location) +
+                               " in a different format than LveModel::Vertex");
+    }
+    attributes.push_back(*it);
+  }
+  return attributes;
+}
+
+void LvePipeline::createShaderModule(const LveMappedFile &code,
                                      VkShaderModule *shaderModule) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+  createInfo.pCode = code.words();
 
   if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr,
                            shaderModule) != VK_SUCCESS) {
@@ -129,6 +201,72 @@ void LvePipeline::bind(VkCommandBuffer commandBuffer) {
                     graphicsPipeline);
 }
 
+LveComputePipeline::LveComputePipeline(LveDevice &device,
+                                       const std::string &compFilepath,
+                                       VkPipelineLayout pipelineLayout)
+    : lveDevice{device} {
+  assert(pipelineLayout != VK_NULL_HANDLE &&
+         "Cannot create compute pipeline: no pipelineLayout provided");
+
+  LveMappedFile compCode = LveArchive::openFile(compFilepath);
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = compCode.size();
+  moduleInfo.pCode = compCode.words();
+  if (vkCreateShaderModule(lveDevice.device(), &moduleInfo, nullptr,
+                           &compShaderModule) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compShaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (vkCreateComputePipelines(lveDevice.device(),
+                               lveDevice.getPipelineCache(), 1, &pipelineInfo,
+                               nullptr, &computePipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline");
+  }
+}
+
+LveComputePipeline::~LveComputePipeline() {
+  vkDestroyShaderModule(lveDevice.device(), compShaderModule, nullptr);
+  vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+}
+
+void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    computePipeline);
+}
+
+void LvePipeline::depthPrepassPipelineConfigInfo(
+    PipelineConfigInfo &configInfo) {
+  defaultPipelineConfigInfo(configInfo);
+  configInfo.colorBlendInfo.attachmentCount = 0;
+  configInfo.colorBlendInfo.pAttachments = nullptr;
+}
+
+void LvePipeline::depthEqualPipelineConfigInfo(PipelineConfigInfo &configInfo) {
+  defaultPipelineConfigInfo(configInfo);
+  configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  configInfo.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+}
+
+void LvePipeline::shadowPipelineConfigInfo(PipelineConfigInfo &configInfo) {
+  depthPrepassPipelineConfigInfo(configInfo);
+  configInfo.rasterizationInfo.depthBiasEnable = VK_TRUE;
+  configInfo.rasterizationInfo.depthBiasConstantFactor = 1.25f;
+  configInfo.rasterizationInfo.depthBiasSlopeFactor = 1.75f;
+}
+
 void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo &configInfo) {
   configInfo.inputAssemblyInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -158,6 +296,7 @@ void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo &configInfo) {
   configInfo.multisampleInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   configInfo.multisampleInfo.sampleShadingEnable = VK_FALSE;
+  // replaced by renderTarget.samples when the pipeline is created
   configInfo.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
   configInfo.multisampleInfo.minSampleShading = 1.0f;          // Optional
   configInfo.multisampleInfo.pSampleMask = nullptr;            // Optional
@@ -0,0 +1,342 @@
+#include "../include/lve_pipeline_library.hpp"
+#include "../include/lve_hash.hpp"
+
+// std
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace lve {
+
+namespace {
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+} // namespace
+
+LvePipelineLibrary::LvePipelineLibrary(LveDevice &device, Mode mode,
+                                       uint32_t workerThreads)
+    : lveDevice{device}, mode{mode} {
+  workers = std::make_unique<LveThreadPool>(workerThreads);
+}
+
+LvePipelineLibrary::~LvePipelineLibrary() {
+  // queued compiles are skipped; the one running finishes
+  shuttingDown = true;
+  workers.reset();
+}
+
+LvePipelineLibrary::Key
+LvePipelineLibrary::makeKey(const std::string &vertFilepath,
+                            const std::string &fragFilepath,
+                            const PipelineConfigInfo &configInfo) {
+  std::size_t seed = 0;
+  hashCombine(seed, vertFilepath);
+  hashCombine(seed, fragFilepath);
+
+  hashCombine(seed, configInfo.viewportInfo.viewportCount);
+  hashCombine(seed, configInfo.viewportInfo.scissorCount);
+
+  const auto &inputAssembly = configInfo.inputAssemblyInfo;
+  hashCombine(seed, inputAssembly.topology);
+  hashCombine(seed, inputAssembly.primitiveRestartEnable);
+
+  const auto &raster = configInfo.rasterizationInfo;
+  hashCombine(seed, raster.depthClampEnable);
+  hashCombine(seed, raster.rasterizerDiscardEnable);
+  hashCombine(seed, raster.polygonMode);
+  hashCombine(seed, raster.cullMode);
+  hashCombine(seed, raster.frontFace);
+  hashCombine(seed, raster.depthBiasEnable);
+  hashCombine(seed, raster.depthBiasConstantFactor);
+  hashCombine(seed, raster.depthBiasClamp);
+  hashCombine(seed, raster.depthBiasSlopeFactor);
+  hashCombine(seed, raster.lineWidth);
+
+  const auto &multisample = configInfo.multisampleInfo;
+  hashCombine(seed, multisample.rasterizationSamples);
+  hashCombine(seed, multisample.sampleShadingEnable);
+  hashCombine(seed, multisample.minSampleShading);
+  hashCombine(seed, multisample.alphaToCoverageEnable);
+  hashCombine(seed, multisample.alphaToOneEnable);
+
+  const auto &blend = configInfo.colorBlendInfo;
+  hashCombine(seed, blend.logicOpEnable);
+  hashCombine(seed, blend.logicOp);
+  hashCombine(seed, blend.attachmentCount);
+  for (uint32_t i = 0; i < blend.attachmentCount; i++) {
+    const auto &attachment = blend.pAttachments[i];
+    hashCombine(seed, attachment.blendEnable);
+    hashCombine(seed, attachment.srcColorBlendFactor);
+    hashCombine(seed, attachment.dstColorBlendFactor);
+    hashCombine(seed, attachment.colorBlendOp);
+    hashCombine(seed, attachment.srcAlphaBlendFactor);
+    hashCombine(seed, attachment.dstAlphaBlendFactor);
+    hashCombine(seed, attachment.alphaBlendOp);
+    hashCombine(seed, attachment.colorWriteMask);
+  }
+  for (float constant : blend.blendConstants) {
+    hashCombine(seed, constant);
+  }
+
+  const auto &depth = configInfo.depthStencilInfo;
+  hashCombine(seed, depth.depthTestEnable);
+  hashCombine(seed, depth.depthWriteEnable);
+  hashCombine(seed, depth.depthCompareOp);
+  hashCombine(seed, depth.depthBoundsTestEnable);
+  hashCombine(seed, depth.stencilTestEnable);
+  for (const auto &face : {depth.front, depth.back}) {
+    hashCombine(seed, face.failOp);
+    hashCombine(seed, face.passOp);
+    hashCombine(seed, face.depthFailOp);
+    hashCombine(seed, face.compareOp);
+    hashCombine(seed, face.compareMask);
+    hashCombine(seed, face.writeMask);
+    hashCombine(seed, face.reference);
+  }
+  hashCombine(seed, depth.minDepthBounds);
+  hashCombine(seed, depth.maxDepthBounds);
+
+  for (VkDynamicState state : configInfo.dynamicStateEnables) {
+    hashCombine(seed, state);
+  }
+
+  hashCombine(seed, configInfo.pipelineLayout);
+  const PipelineRenderTarget &target = configInfo.renderTarget;
+  hashCombine(seed, target.renderPass);
+  hashCombine(seed, target.subpass);
+  for (VkFormat format : target.colorFormats) {
+    hashCombine(seed, format);
+  }
+  hashCombine(seed, target.depthFormat);
+  hashCombine(seed, target.samples);
+
+  for (const auto &constant : configInfo.specializationConstants) {
+    hashCombine(seed, constant.constantId);
+    hashCombine(seed, constant.value);
+  }
+
+  Key key = static_cast<Key>(seed);
+  return key == INVALID_KEY ? 1 : key;
+}
+
+LvePipelineLibrary::Key
+LvePipelineLibrary::add(const std::string &vertFilepath,
+                        const std::string &fragFilepath,
+                        ConfigFunction configure) {
+  PipelineConfigInfo configInfo{};
+  configure(configInfo);
+  Key key = makeKey(vertFilepath, fragFilepath, configInfo);
+
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    Variant &variant = variants[(key + i) % CAPACITY];
+    Key slotKey = variant.key.load(std::memory_order_acquire);
+    if (slotKey == key) {
+      return key;
+    }
+    if (slotKey != INVALID_KEY) {
+      continue;
+    }
+
+    if (variantCount >= MAX_VARIANTS) {
+      throw std::runtime_error("pipeline library is full!");
+    }
+    variant.vertFilepath = vertFilepath;
+    variant.fragFilepath = fragFilepath;
+    variant.configure = std::move(configure);
+    variant.key.store(key, std::memory_order_release);
+    variantCount++;
+
+    // startup mode gets the workers going while the rest are registered
+    if (mode == Mode::Startup) {
+      variant.state = QUEUED;
+      submit(variant);
+    }
+    return key;
+  }
+  throw std::runtime_error("pipeline library is full!");
+}
+
+LvePipelineLibrary::Variant *LvePipelineLibrary::find(Key key) {
+  if (key == INVALID_KEY) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    Variant &variant = variants[(key + i) % CAPACITY];
+    Key slotKey = variant.key.load(std::memory_order_acquire);
+    if (slotKey == key) {
+      return &variant;
+    }
+    if (slotKey == INVALID_KEY) {
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+void LvePipelineLibrary::compileAll() {
+  auto start = std::chrono::steady_clock::now();
+  for (Variant &variant : variants) {
+    if (variant.key.load(std::memory_order_acquire) == INVALID_KEY) {
+      continue;
+    }
+    uint32_t state = variant.state.load();
+    while ((state == REGISTERED || state == REQUESTED) &&
+           !variant.state.compare_exchange_weak(state, QUEUED)) {
+    }
+    if (state == REGISTERED || state == REQUESTED) {
+      submit(variant);
+    }
+  }
+  workers->waitIdle();
+
+  Stats stats = getStats();
+  std::cout << "compiled " << stats.compiled << " pipeline variants in "
+            << millisecondsSince(start) << " ms on " << workers->threadCount()
+            << " threads (" << stats.compileMilliseconds
+            << " ms of compile time, " << stats.failed << " failed)"
+            << std::endl;
+}
+
+void LvePipelineLibrary::prefetch(Key key) {
+  Variant *variant = find(key);
+  if (variant == nullptr) {
+    return;
+  }
+  uint32_t expected = REGISTERED;
+  if (variant->state.compare_exchange_strong(expected, REQUESTED)) {
+    requestedCount++;
+  }
+}
+
+LvePipeline *LvePipelineLibrary::get(Key key) {
+  Variant *variant = find(key);
+  if (variant == nullptr) {
+    return nullptr;
+  }
+  LvePipeline *pipeline = variant->pipeline.load(std::memory_order_acquire);
+  if (pipeline != nullptr) {
+    return pipeline;
+  }
+  missCount.fetch_add(1, std::memory_order_relaxed);
+  uint32_t expected = REGISTERED;
+  if (variant->state.compare_exchange_strong(expected, REQUESTED)) {
+    requestedCount++;
+  }
+  return nullptr;
+}
+
+void LvePipelineLibrary::rebuild(Key key) {
+  Variant *variant = find(key);
+  if (variant == nullptr) {
+    return;
+  }
+  // one not built yet reads the new files anyway, and a compile in flight
+  // requeues it when it is done
+  variant->stale = true;
+  requeue(*variant);
+}
+
+void LvePipelineLibrary::requeue(Variant &variant) {
+  uint32_t state = variant.state.load();
+  if ((state != READY && state != FAILED) ||
+      !variant.state.compare_exchange_strong(state, QUEUED)) {
+    return;
+  }
+  // whoever moved it to QUEUED owns the variant until it is built again
+  if (state == READY) {
+    compiledCount--;
+    variant.pipeline.store(nullptr, std::memory_order_release);
+    // a frame recording or in flight may have bound it
+    std::lock_guard<std::mutex> lock{retiringMutex};
+    retiring.push_back(std::move(variant.owned));
+  } else {
+    failedCount--;
+  }
+  submit(variant);
+}
+
+void LvePipelineLibrary::beginFrame(int frameIndex) {
+  // frameIndex's fence has signalled: no frame in flight still uses these
+  retired[frameIndex].clear();
+  {
+    std::lock_guard<std::mutex> lock{retiringMutex};
+    for (auto &pipeline : retiring) {
+      retired[frameIndex].push_back(std::move(pipeline));
+    }
+    retiring.clear();
+  }
+
+  if (requestedCount.exchange(0) == 0) {
+    return;
+  }
+  for (Variant &variant : variants) {
+    uint32_t expected = REQUESTED;
+    if (variant.state.compare_exchange_strong(expected, QUEUED)) {
+      submit(variant);
+    }
+  }
+}
+
+void LvePipelineLibrary::waitIdle() { workers->waitIdle(); }
+
+void LvePipelineLibrary::submit(Variant &variant) {
+  pendingCount++;
+  workers->submit([this, &variant] {
+    compile(variant);
+    // rebuilt while compiling: the files read may already be old
+    if (variant.stale) {
+      requeue(variant);
+    }
+    pendingCount--;
+  });
+}
+
+void LvePipelineLibrary::compile(Variant &variant) {
+  if (shuttingDown) {
+    return;
+  }
+  variant.stale = false;
+  auto start = std::chrono::steady_clock::now();
+  try {
+    PipelineConfigInfo configInfo{};
+    variant.configure(configInfo);
+    variant.owned = std::make_unique<LvePipeline>(
+        lveDevice, variant.vertFilepath, variant.fragFilepath, configInfo);
+  } catch (const std::exception &e) {
+    // counted before it is published, since requeue() uncounts it
+    failedCount++;
+    variant.state = FAILED;
+    std::cerr << "failed to compile pipeline variant " << variant.vertFilepath
+              << " " << variant.fragFilepath << ": " << e.what() << std::endl;
+    return;
+  }
+
+  double milliseconds = millisecondsSince(start);
+  compileMicroseconds += static_cast<uint64_t>(milliseconds * 1000.0);
+  compiledCount++;
+  variant.pipeline.store(variant.owned.get(), std::memory_order_release);
+  variant.state = READY;
+  if (mode == Mode::OnDemand) {
+    // startup compiles are summed up by compileAll()
+    std::cout << "compiled pipeline variant " << variant.vertFilepath << " "
+              << variant.fragFilepath << " on demand in " << milliseconds
+              << " ms" << std::endl;
+  }
+}
+
+LvePipelineLibrary::Stats LvePipelineLibrary::getStats() const {
+  Stats stats{};
+  stats.variants = variantCount;
+  stats.compiled = compiledCount;
+  stats.pending = pendingCount;
+  stats.failed = failedCount;
+  stats.misses = missCount.load(std::memory_order_relaxed);
+  stats.compileMilliseconds = compileMicroseconds / 1000.0;
+  return stats;
+}
+
+} // namespace lve
@@ -0,0 +1,1338 @@
+#include "../include/lve_render_graph.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace lve {
+
+namespace {
+constexpr VkAccessFlags WRITE_ACCESS =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+constexpr size_t NO_ATTACHMENT = ~size_t{0};
+
+using Usage = LveRenderGraph::Usage;
+
+bool isDepthFormat(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT:
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// barriers on a depth/stencil image move both aspects' layouts together
+VkImageAspectFlags barrierAspect(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  default:
+    return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                 : VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+bool isAttachment(Usage usage) {
+  return usage == Usage::ColorAttachment || usage == Usage::DepthAttachment ||
+         usage == Usage::DepthReadOnly;
+}
+
+bool isResolve(Usage usage) {
+  return usage == Usage::ColorResolve || usage == Usage::DepthResolve;
+}
+
+bool isWrite(Usage usage) {
+  return usage == Usage::ColorAttachment || usage == Usage::DepthAttachment ||
+         usage == Usage::StorageWrite || usage == Usage::TransferDst ||
+         isResolve(usage);
+}
+
+// the layout, stages and accesses a use puts the resource in
+struct Access {
+  VkImageLayout layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+Access accessFor(Usage usage, VkPipelineStageFlags stages, VkFormat format,
+                 bool load) {
+  constexpr VkPipelineStageFlags FRAGMENT_TESTS =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  switch (usage) {
+  case Usage::ColorAttachment: {
+    VkAccessFlags access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    if (load) {
+      access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    }
+    return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, access};
+  }
+  // stages has colour output when the attachment is resolved
+  case Usage::DepthAttachment:
+    return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            FRAGMENT_TESTS | stages,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+  case Usage::DepthReadOnly:
+    return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            FRAGMENT_TESTS | stages,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT};
+  case Usage::Sampled:
+    // depth stays in the layout it can also be tested against in
+    return {isDepthFormat(format)
+                ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            stages, VK_ACCESS_SHADER_READ_BIT};
+  case Usage::StorageRead:
+    return {VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT};
+  case Usage::StorageWrite:
+    return {VK_IMAGE_LAYOUT_GENERAL, stages,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+  case Usage::UniformRead:
+    return {VK_IMAGE_LAYOUT_UNDEFINED, stages, VK_ACCESS_UNIFORM_READ_BIT};
+  case Usage::TransferSrc:
+    return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+  case Usage::TransferDst:
+    return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+  // resolves are colour attachment writes, depth ones included
+  case Usage::ColorResolve:
+    return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+  case Usage::DepthResolve:
+    return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+  }
+  return {VK_IMAGE_LAYOUT_UNDEFINED, stages, 0};
+}
+
+VkImageUsageFlags imageUsageFor(Usage usage) {
+  switch (usage) {
+  case Usage::ColorAttachment:
+  case Usage::ColorResolve:
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  case Usage::DepthAttachment:
+  case Usage::DepthReadOnly:
+  case Usage::DepthResolve:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  case Usage::Sampled:
+    return VK_IMAGE_USAGE_SAMPLED_BIT;
+  case Usage::StorageRead:
+  case Usage::StorageWrite:
+    return VK_IMAGE_USAGE_STORAGE_BIT;
+  case Usage::TransferSrc:
+    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  case Usage::TransferDst:
+    return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  case Usage::UniformRead:
+    break;
+  }
+  return 0;
+}
+
+const char *usageName(Usage usage) {
+  switch (usage) {
+  case Usage::ColorAttachment:
+    return "color";
+  case Usage::DepthAttachment:
+    return "depth";
+  case Usage::DepthReadOnly:
+    return "depth read-only";
+  case Usage::Sampled:
+    return "sampled";
+  case Usage::StorageRead:
+    return "storage read";
+  case Usage::StorageWrite:
+    return "storage write";
+  case Usage::UniformRead:
+    return "uniform";
+  case Usage::TransferSrc:
+    return "transfer src";
+  case Usage::TransferDst:
+    return "transfer dst";
+  case Usage::ColorResolve:
+    return "color resolve";
+  case Usage::DepthResolve:
+    return "depth resolve";
+  }
+  return "?";
+}
+
+const char *layoutName(VkImageLayout layout) {
+  switch (layout) {
+  case VK_IMAGE_LAYOUT_UNDEFINED:
+    return "UNDEFINED";
+  case VK_IMAGE_LAYOUT_GENERAL:
+    return "GENERAL";
+  case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+    return "COLOR_ATTACHMENT";
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+    return "DEPTH_ATTACHMENT";
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+    return "DEPTH_READ_ONLY";
+  case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    return "SHADER_READ_ONLY";
+  case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+    return "TRANSFER_SRC";
+  case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+    return "TRANSFER_DST";
+  case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+    return "PRESENT_SRC";
+  default:
+    return "other";
+  }
+}
+
+struct FlagName {
+  uint32_t bit;
+  const char *name;
+};
+
+constexpr FlagName STAGE_NAMES[] = {
+    {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "TOP"},
+    {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "INDIRECT"},
+    {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, "VERTEX_INPUT"},
+    {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, "VERTEX"},
+    {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "FRAGMENT"},
+    {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "EARLY_TESTS"},
+    {VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "LATE_TESTS"},
+    {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "COLOR_OUTPUT"},
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "COMPUTE"},
+    {VK_PIPELINE_STAGE_TRANSFER_BIT, "TRANSFER"},
+    {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, "BOTTOM"},
+    {VK_PIPELINE_STAGE_HOST_BIT, "HOST"},
+};
+
+constexpr FlagName ACCESS_NAMES[] = {
+    {VK_ACCESS_INDIRECT_COMMAND_READ_BIT, "INDIRECT_READ"},
+    {VK_ACCESS_UNIFORM_READ_BIT, "UNIFORM_READ"},
+    {VK_ACCESS_SHADER_READ_BIT, "SHADER_READ"},
+    {VK_ACCESS_SHADER_WRITE_BIT, "SHADER_WRITE"},
+    {VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, "COLOR_READ"},
+    {VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, "COLOR_WRITE"},
+    {VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, "DEPTH_READ"},
+    {VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, "DEPTH_WRITE"},
+    {VK_ACCESS_TRANSFER_READ_BIT, "TRANSFER_READ"},
+    {VK_ACCESS_TRANSFER_WRITE_BIT, "TRANSFER_WRITE"},
+    {VK_ACCESS_HOST_WRITE_BIT, "HOST_WRITE"},
+    {VK_ACCESS_MEMORY_WRITE_BIT, "MEMORY_WRITE"},
+};
+
+template <size_t N>
+std::string flagNames(uint32_t flags, const FlagName (&names)[N]) {
+  if (flags == 0) {
+    return "none";
+  }
+  std::string text;
+  for (const FlagName &name : names) {
+    if ((flags & name.bit) != 0) {
+      text += (text.empty() ? "" : "|");
+      text += name.name;
+      flags &= ~name.bit;
+    }
+  }
+  return flags == 0 ? text : text + (text.empty() ? "other" : "|other");
+}
+} // namespace
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::use(ResourceId resource, Usage usage,
+                                 VkPipelineStageFlags stages,
+                                 const VkClearValue *clear) {
+  assert(!graph.compiled && "passes cannot change once the graph is compiled");
+  assert(resource < graph.resources.size() && "unknown render graph resource");
+  assert((graph.resources[resource].isImage ||
+          (!isAttachment(usage) && usage != Usage::Sampled)) &&
+         "attachments and sampled resources must be images");
+  assert((!graph.resources[resource].isImage || usage != Usage::UniformRead) &&
+         "uniform reads must be of buffers");
+  Pass &target = graph.passes[pass];
+  assert(std::none_of(target.uses.begin(), target.uses.end(),
+                      [&](const Use &other) {
+                        return other.resource == resource;
+                      }) &&
+         "a pass can use each resource only once");
+  Use newUse{};
+  newUse.resource = resource;
+  newUse.usage = usage;
+  newUse.stages = stages;
+  if (clear != nullptr) {
+    newUse.clear = true;
+    newUse.clearValue = *clear;
+  }
+  target.uses.push_back(newUse);
+  return *this;
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::color(ResourceId image) {
+  return use(image, Usage::ColorAttachment, 0, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::clearColor(ResourceId image,
+                                        VkClearColorValue value) {
+  VkClearValue clear{};
+  clear.color = value;
+  return use(image, Usage::ColorAttachment, 0, &clear);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::depth(ResourceId image) {
+  return use(image, Usage::DepthAttachment, 0, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::clearDepth(ResourceId image, float depth) {
+  VkClearValue clear{};
+  clear.depthStencil = {depth, 0};
+  return use(image, Usage::DepthAttachment, 0, &clear);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::depthReadOnly(ResourceId image) {
+  return use(image, Usage::DepthReadOnly, 0, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::resolve(ResourceId source, ResourceId target,
+                                     VkResolveModeFlagBits depthMode) {
+  std::vector<Use> &uses = graph.passes[pass].uses;
+  auto sourceUse =
+      std::find_if(uses.begin(), uses.end(), [&](const Use &other) {
+        return other.resource == source && isAttachment(other.usage);
+      });
+  assert(sourceUse != uses.end() &&
+         "only attachments declared before can be resolved");
+  assert(target < graph.resources.size() && "unknown render graph resource");
+  assert(graph.resources[source].desc.samples != VK_SAMPLE_COUNT_1_BIT &&
+         graph.resources[target].desc.samples == VK_SAMPLE_COUNT_1_BIT &&
+         graph.resources[source].desc.format ==
+             graph.resources[target].desc.format &&
+         "resolves go from a multisampled image to a single-sample one of "
+         "the same format");
+  const bool depth = sourceUse->usage != Usage::ColorAttachment;
+  assert((!depth || graph.dynamicRendering) &&
+         "depth resolves need dynamic rendering");
+  // the resolve reads the source as the pass ends
+  sourceUse->stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+  use(target, depth ? Usage::DepthResolve : Usage::ColorResolve, 0, nullptr);
+  Use &resolveUse = uses.back();
+  resolveUse.resolveSource = source;
+  resolveUse.resolveMode = depth ? depthMode : VK_RESOLVE_MODE_AVERAGE_BIT;
+  return *this;
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::sampled(ResourceId image,
+                                     VkPipelineStageFlags stages) {
+  return use(image, Usage::Sampled, stages, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::storageRead(ResourceId resource,
+                                         VkPipelineStageFlags stages) {
+  return use(resource, Usage::StorageRead, stages, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::storageWrite(ResourceId resource,
+                                          VkPipelineStageFlags stages) {
+  return use(resource, Usage::StorageWrite, stages, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::uniformRead(ResourceId buffer,
+                                         VkPipelineStageFlags stages) {
+  return use(buffer, Usage::UniformRead, stages, nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::transferSrc(ResourceId resource) {
+  return use(resource, Usage::TransferSrc, VK_PIPELINE_STAGE_TRANSFER_BIT,
+             nullptr);
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::transferDst(ResourceId resource) {
+  return use(resource, Usage::TransferDst, VK_PIPELINE_STAGE_TRANSFER_BIT,
+             nullptr);
+}
+
+LveRenderGraph::PassBuilder &LveRenderGraph::PassBuilder::sideEffects() {
+  graph.passes[pass].sideEffects = true;
+  return *this;
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::condition(std::function<bool()> predicate) {
+  graph.passes[pass].condition = std::move(predicate);
+  return *this;
+}
+
+LveRenderGraph::PassBuilder &
+LveRenderGraph::PassBuilder::execute(ExecuteFunction function) {
+  graph.passes[pass].function = std::move(function);
+  return *this;
+}
+
+LveRenderGraph::LveRenderGraph(LveDevice &device, bool useDynamicRendering)
+    : lveDevice{device}, dynamicRendering{useDynamicRendering} {
+  assert((!dynamicRendering || lveDevice.dynamicRenderingSupported) &&
+         "dynamic rendering is not enabled on the device");
+}
+
+LveRenderGraph::~LveRenderGraph() {
+  destroyFramebuffers();
+  destroyTransientImages();
+  for (auto &cached : renderPassCache) {
+    vkDestroyRenderPass(lveDevice.device(), cached.second, nullptr);
+  }
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::createImage(std::string name,
+                                                       const ImageDesc &desc) {
+  assert(!compiled && "resources cannot be added once the graph is compiled");
+  Resource resource{};
+  resource.name = std::move(name);
+  resource.desc = desc;
+  resources.push_back(std::move(resource));
+  return static_cast<ResourceId>(resources.size() - 1);
+}
+
+LveRenderGraph::ResourceId
+LveRenderGraph::importImage(std::string name, const ImageDesc &desc,
+                            ResourceState initialState,
+                            ResourceState finalState) {
+  ResourceId id = createImage(std::move(name), desc);
+  resources[id].imported = true;
+  resources[id].initialState = initialState;
+  resources[id].finalState = finalState;
+  return id;
+}
+
+LveRenderGraph::ResourceId
+LveRenderGraph::importBuffer(std::string name, ResourceState initialState,
+                             ResourceState finalState) {
+  ResourceId id = importImage(std::move(name), {}, initialState, finalState);
+  resources[id].isImage = false;
+  return id;
+}
+
+LveRenderGraph::PassBuilder LveRenderGraph::addPass(std::string name) {
+  assert(!compiled && "passes cannot be added once the graph is compiled");
+  Pass pass{};
+  pass.name = std::move(name);
+  passes.push_back(std::move(pass));
+  return PassBuilder{*this, static_cast<PassId>(passes.size() - 1)};
+}
+
+void LveRenderGraph::compile(VkExtent2D frameExtent) {
+  assert(!compiled && "a render graph is compiled once; resize() after that");
+  extent = frameExtent;
+  stats.passes = static_cast<uint32_t>(passes.size());
+  cullPasses();
+  findLifetimes();
+  createTransientImages();
+  planBarriers();
+  createRenderPasses();
+  compiled = true;
+}
+
+void LveRenderGraph::resize(VkExtent2D frameExtent) {
+  assert(compiled && "compile the render graph before resizing it");
+  vkDeviceWaitIdle(lveDevice.device());
+  extent = frameExtent;
+  destroyFramebuffers();
+  destroyTransientImages();
+  createTransientImages();
+  // the images may have been packed into blocks differently
+  planBarriers();
+}
+
+void LveRenderGraph::cullPasses() {
+  // walking back from the end of the frame: whether what each resource
+  // holds at this point is read later, or outlives the frame
+  std::vector<bool> needed(resources.size());
+  for (size_t id = 0; id < resources.size(); id++) {
+    needed[id] = resources[id].imported;
+  }
+
+  stats.culledPasses = 0;
+  for (size_t index = passes.size(); index-- > 0;) {
+    Pass &pass = passes[index];
+    bool live = pass.sideEffects;
+    for (const Use &use : pass.uses) {
+      live = live || (isWrite(use.usage) && needed[use.resource]);
+    }
+    pass.culled = !live;
+    if (!live) {
+      stats.culledPasses++;
+      continue;
+    }
+    for (Use &use : pass.uses) {
+      use.store = needed[use.resource];
+      // everything but a clear or a resolve depends on what was there before
+      needed[use.resource] = !use.clear && !isResolve(use.usage);
+    }
+  }
+}
+
+void LveRenderGraph::findLifetimes() {
+  for (Resource &resource : resources) {
+    resource.used = false;
+    resource.lazy = !resource.imported;
+    resource.usage = 0;
+  }
+  for (PassId index = 0; index < passes.size(); index++) {
+    if (passes[index].culled) {
+      continue;
+    }
+    for (const Use &use : passes[index].uses) {
+      Resource &resource = resources[use.resource];
+      if (!resource.used) {
+        resource.used = true;
+        resource.firstPass = index;
+      }
+      resource.lastPass = index;
+      resource.usage |= imageUsageFor(use.usage);
+      resource.lazy = resource.lazy && isAttachment(use.usage) && !use.store;
+    }
+  }
+}
+
+VkExtent2D LveRenderGraph::imageExtent(const Resource &resource) const {
+  return resource.desc.extent.width == 0 ? extent : resource.desc.extent;
+}
+
+VkExtent2D LveRenderGraph::passExtent(const Pass &pass) const {
+  return imageExtent(resources[pass.uses[pass.attachments[0]].resource]);
+}
+
+void LveRenderGraph::createTransientImages() {
+  std::vector<ResourceId> order;
+  for (ResourceId id = 0; id < resources.size(); id++) {
+    if (resources[id].isImage && !resources[id].imported &&
+        resources[id].used) {
+      order.push_back(id);
+    }
+  }
+  // in order of first use, so every block's residents are too
+  std::stable_sort(order.begin(), order.end(),
+                   [&](ResourceId a, ResourceId b) {
+                     return resources[a].firstPass < resources[b].firstPass;
+                   });
+
+  stats.transientBytes = 0;
+  stats.lazyImages = 0;
+  for (ResourceId id : order) {
+    Resource &resource = resources[id];
+    VkExtent2D size = imageExtent(resource);
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {size.width, size.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = resource.desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = resource.usage;
+    if (resource.lazy) {
+      imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+    imageInfo.samples = resource.desc.samples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(lveDevice.device(), &imageInfo, nullptr,
+                      &resource.image) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create render graph image!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(lveDevice.device(), resource.image,
+                                 &requirements);
+    resource.size = requirements.size;
+    stats.transientBytes += requirements.size;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (resource.lazy &&
+        lveDevice.hasMemoryType(requirements.memoryTypeBits,
+                                properties |
+                                    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+      properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+      stats.lazyImages++;
+    }
+
+    // Of the blocks whose images are all done before this one is first
+    // used, the one that grows least. Residents never overlap and are in
+    // order, so the last one ends latest.
+    size_t best = blocks.size();
+    VkDeviceSize bestGrowth = 0;
+    for (size_t index = 0; index < blocks.size(); index++) {
+      const MemoryBlock &block = blocks[index];
+      if (block.properties != properties ||
+          (block.requirements.memoryTypeBits &
+           requirements.memoryTypeBits) == 0 ||
+          resources[block.residents.back()].lastPass >= resource.firstPass) {
+        continue;
+      }
+      VkDeviceSize growth =
+          std::max(block.requirements.size, requirements.size) -
+          block.requirements.size;
+      if (best == blocks.size() || growth < bestGrowth) {
+        best = index;
+        bestGrowth = growth;
+      }
+    }
+    if (best == blocks.size()) {
+      MemoryBlock block{};
+      block.requirements = requirements;
+      block.properties = properties;
+      blocks.push_back(block);
+    } else {
+      VkMemoryRequirements &merged = blocks[best].requirements;
+      merged.size = std::max(merged.size, requirements.size);
+      merged.alignment = std::max(merged.alignment, requirements.alignment);
+      merged.memoryTypeBits &= requirements.memoryTypeBits;
+    }
+    blocks[best].residents.push_back(id);
+    resource.block = static_cast<uint32_t>(best);
+  }
+
+  stats.allocatedBytes = 0;
+  for (MemoryBlock &block : blocks) {
+    block.memory = lveDevice.allocateMemory(
+        block.requirements, block.properties, MemoryCategory::RenderTarget);
+    stats.allocatedBytes += block.requirements.size;
+
+    for (ResourceId id : block.residents) {
+      Resource &resource = resources[id];
+      if (vkBindImageMemory(lveDevice.device(), resource.image, block.memory,
+                            0) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind render graph image memory!");
+      }
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = resource.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = resource.desc.format;
+      // depth only, so the view can be sampled as well
+      viewInfo.subresourceRange.aspectMask =
+          isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                              : VK_IMAGE_ASPECT_COLOR_BIT;
+      viewInfo.subresourceRange.levelCount = 1;
+      viewInfo.subresourceRange.layerCount = 1;
+      if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr,
+                            &resource.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph image view!");
+      }
+    }
+  }
+  stats.transientImages = static_cast<uint32_t>(order.size());
+  stats.memoryBlocks = static_cast<uint32_t>(blocks.size());
+}
+
+void LveRenderGraph::destroyTransientImages() {
+  for (Resource &resource : resources) {
+    if (resource.imported) {
+      continue;
+    }
+    if (resource.view != VK_NULL_HANDLE) {
+      vkDestroyImageView(lveDevice.device(), resource.view, nullptr);
+      resource.view = VK_NULL_HANDLE;
+    }
+    if (resource.image != VK_NULL_HANDLE) {
+      vkDestroyImage(lveDevice.device(), resource.image, nullptr);
+      resource.image = VK_NULL_HANDLE;
+    }
+  }
+  for (MemoryBlock &block : blocks) {
+    if (block.memory != VK_NULL_HANDLE) {
+      lveDevice.freeMemory(block.memory);
+    }
+  }
+  blocks.clear();
+}
+
+void LveRenderGraph::planBarriers() {
+  // each resource as the passes so far left it
+  struct State {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // the last write, plus layout transitions since, which later users
+    // must wait on as well
+    VkPipelineStageFlags writeStages = 0;
+    VkAccessFlags writeAccess = 0;
+    // reads since the last write
+    VkPipelineStageFlags readStages = 0;
+    // what a barrier already made the last write visible to
+    VkPipelineStageFlags visibleStages = 0;
+    VkAccessFlags visibleAccess = 0;
+    bool hasContents = false;
+  };
+
+  auto lastAccess = [&](ResourceId id) {
+    const Resource &resource = resources[id];
+    for (const Use &use : passes[resource.lastPass].uses) {
+      if (use.resource == id) {
+        return accessFor(use.usage, use.stages, resource.desc.format,
+                         use.load);
+      }
+    }
+    return Access{VK_IMAGE_LAYOUT_UNDEFINED, 0, 0};
+  };
+
+  std::vector<State> states(resources.size());
+  for (ResourceId id = 0; id < resources.size(); id++) {
+    const Resource &resource = resources[id];
+    State &state = states[id];
+    if (resource.imported) {
+      const ResourceState &initial = resource.initialState;
+      state.layout = resource.isImage ? initial.layout
+                                      : VK_IMAGE_LAYOUT_UNDEFINED;
+      state.hasContents =
+          !resource.isImage || initial.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+      if ((initial.access & WRITE_ACCESS) != 0) {
+        state.writeStages = initial.stages;
+        state.writeAccess = initial.access & WRITE_ACCESS;
+      } else {
+        state.readStages = initial.stages;
+      }
+    } else if (resource.used) {
+      // The contents start undefined, but whatever last used the memory,
+      // the block's previous image or its last one in the previous frame,
+      // must be done with it
+      const std::vector<ResourceId> &residents =
+          blocks[resource.block].residents;
+      auto position = std::find(residents.begin(), residents.end(), id);
+      ResourceId previous = position == residents.begin()
+                                ? residents.back()
+                                : *std::prev(position);
+      Access access = lastAccess(previous);
+      if ((access.access & WRITE_ACCESS) != 0) {
+        state.writeStages = access.stages;
+        state.writeAccess = access.access & WRITE_ACCESS;
+      } else {
+        state.readStages = access.stages;
+      }
+    }
+  }
+
+  stats.barriers = 0;
+  stats.barrierBatches = 0;
+  auto count = [&](const std::vector<Barrier> &barriers) {
+    stats.barriers += static_cast<uint32_t>(barriers.size());
+    stats.barrierBatches += barriers.empty() ? 0 : 1;
+  };
+
+  for (Pass &pass : passes) {
+    pass.barriers.clear();
+    if (pass.culled) {
+      continue;
+    }
+    for (Use &use : pass.uses) {
+      const Resource &resource = resources[use.resource];
+      State &state = states[use.resource];
+      if (isAttachment(use.usage)) {
+        use.load = !use.clear && state.hasContents;
+      }
+      Access need =
+          accessFor(use.usage, use.stages, resource.desc.format, use.load);
+      if (!resource.isImage) {
+        need.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      }
+      const bool writes = isWrite(use.usage);
+      const bool transition = need.layout != state.layout;
+
+      Barrier barrier{use.resource,  state.layout, need.layout, 0, 0,
+                      need.stages, need.access};
+      bool required;
+      if (transition || writes) {
+        // after reads only, an execution dependency is enough
+        barrier.srcStages = state.writeStages | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+        required = transition || barrier.srcStages != 0;
+      } else {
+        // a read needs the last write made visible to its stages, once
+        barrier.srcStages = state.writeStages;
+        barrier.srcAccess = state.writeAccess;
+        required = state.writeStages != 0 &&
+                   ((need.stages & ~state.visibleStages) != 0 ||
+                    (need.access & ~state.visibleAccess) != 0);
+      }
+      if (required) {
+        if (barrier.srcStages == 0) {
+          barrier.srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+        pass.barriers.push_back(barrier);
+      }
+
+      if (writes) {
+        state.writeStages = need.stages;
+        state.writeAccess = need.access & WRITE_ACCESS;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+        state.hasContents = true;
+      } else {
+        state.readStages |= need.stages;
+        if (transition) {
+          state.writeStages |= need.stages;
+          state.visibleStages = need.stages;
+          state.visibleAccess = need.access;
+        } else if (required) {
+          state.visibleStages |= need.stages;
+          state.visibleAccess |= need.access;
+        }
+      }
+      state.layout = need.layout;
+    }
+    count(pass.barriers);
+  }
+
+  // imported resources leave in the state declared for them
+  finalBarriers.clear();
+  for (ResourceId id = 0; id < resources.size(); id++) {
+    const Resource &resource = resources[id];
+    if (!resource.imported) {
+      continue;
+    }
+    const ResourceState &target = resource.finalState;
+    const State &state = states[id];
+    VkImageLayout layout =
+        resource.isImage && target.layout != VK_IMAGE_LAYOUT_UNDEFINED
+            ? target.layout
+            : state.layout;
+    bool transition = layout != state.layout;
+    if (!transition &&
+        !(resource.used && state.writeAccess != 0 && target.access != 0)) {
+      continue;
+    }
+    Barrier barrier{id,
+                    state.layout,
+                    layout,
+                    state.writeStages | state.readStages,
+                    state.writeAccess,
+                    target.stages,
+                    target.access};
+    if (barrier.srcStages == 0) {
+      barrier.srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    finalBarriers.push_back(barrier);
+  }
+  count(finalBarriers);
+}
+
+void LveRenderGraph::createRenderPasses() {
+  stats.renderPasses = 0;
+  for (Pass &pass : passes) {
+    pass.attachments.clear();
+    pass.resolves.clear();
+    pass.clearValues.clear();
+    pass.renderingAttachments.clear();
+    pass.renderPass = VK_NULL_HANDLE;
+    if (pass.culled) {
+      continue;
+    }
+    size_t depthUse = NO_ATTACHMENT;
+    for (size_t index = 0; index < pass.uses.size(); index++) {
+      Usage usage = pass.uses[index].usage;
+      if (usage == Usage::ColorAttachment) {
+        pass.attachments.push_back(index);
+      } else if (isAttachment(usage)) {
+        assert(depthUse == NO_ATTACHMENT &&
+               "a pass has at most one depth attachment");
+        depthUse = index;
+      }
+    }
+    if (depthUse != NO_ATTACHMENT) {
+      pass.attachments.push_back(depthUse);
+    }
+    if (pass.attachments.empty()) {
+      continue;
+    }
+    pass.resolves.assign(pass.attachments.size(), NO_ATTACHMENT);
+    for (size_t index = 0; index < pass.uses.size(); index++) {
+      const Use &use = pass.uses[index];
+      if (!isResolve(use.usage)) {
+        continue;
+      }
+      for (size_t attachment = 0; attachment < pass.attachments.size();
+           attachment++) {
+        if (pass.uses[pass.attachments[attachment]].resource ==
+            use.resolveSource) {
+          pass.resolves[attachment] = index;
+        }
+      }
+    }
+
+    std::vector<VkAttachmentDescription> descriptions;
+    std::vector<VkAttachmentReference> colorRefs;
+    VkAttachmentReference depthRef{};
+    std::vector<uint32_t> key;
+    for (uint32_t index = 0; index < pass.attachments.size(); index++) {
+      const Use &use = pass.uses[pass.attachments[index]];
+      const Resource &resource = resources[use.resource];
+      assert(imageExtent(resource).width == passExtent(pass).width &&
+             imageExtent(resource).height == passExtent(pass).height &&
+             "a pass's attachments must all be the same size");
+      assert(resource.desc.samples ==
+                 resources[pass.uses[pass.attachments[0]].resource]
+                     .desc.samples &&
+             "a pass's attachments must all have the same sample count");
+      VkImageLayout layout =
+          accessFor(use.usage, use.stages, resource.desc.format, use.load)
+              .layout;
+
+      VkAttachmentDescription description{};
+      description.format = resource.desc.format;
+      description.samples = resource.desc.samples;
+      description.loadOp = use.clear  ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                           : use.load ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                      : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.storeOp = use.store ? VK_ATTACHMENT_STORE_OP_STORE
+                                      : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      // the graph's barriers do every transition
+      description.initialLayout = layout;
+      description.finalLayout = layout;
+      descriptions.push_back(description);
+
+      if (use.usage == Usage::ColorAttachment) {
+        colorRefs.push_back({index, layout});
+      } else {
+        depthRef = {index, layout};
+      }
+      pass.clearValues.push_back(use.clearValue);
+
+      VkRenderingAttachmentInfo renderingAttachment{};
+      renderingAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+      renderingAttachment.imageLayout = layout;
+      renderingAttachment.loadOp = description.loadOp;
+      renderingAttachment.storeOp = description.storeOp;
+      renderingAttachment.clearValue = use.clearValue;
+      if (pass.resolves[index] != NO_ATTACHMENT) {
+        const Use &resolve = pass.uses[pass.resolves[index]];
+        renderingAttachment.resolveMode = resolve.resolveMode;
+        renderingAttachment.resolveImageLayout =
+            accessFor(resolve.usage, resolve.stages,
+                      resources[resolve.resource].desc.format, false)
+                .layout;
+      }
+      pass.renderingAttachments.push_back(renderingAttachment);
+
+      key.insert(key.end(), {static_cast<uint32_t>(description.format),
+                             static_cast<uint32_t>(description.samples),
+                             static_cast<uint32_t>(description.loadOp),
+                             static_cast<uint32_t>(description.storeOp),
+                             static_cast<uint32_t>(layout)});
+    }
+    stats.renderPasses++;
+    if (dynamicRendering) {
+      continue;
+    }
+
+    // colour resolves go after all the attachments, each referenced from
+    // the subpass in the slot of the colour attachment it resolves
+    std::vector<VkAttachmentReference> resolveRefs(
+        colorRefs.size(), {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+    bool hasResolves = false;
+    for (size_t index = 0; index < colorRefs.size(); index++) {
+      if (pass.resolves[index] == NO_ATTACHMENT) {
+        continue;
+      }
+      const Use &resolve = pass.uses[pass.resolves[index]];
+      VkAttachmentDescription description{};
+      description.format = resources[resolve.resource].desc.format;
+      description.samples = VK_SAMPLE_COUNT_1_BIT;
+      description.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.storeOp = resolve.store ? VK_ATTACHMENT_STORE_OP_STORE
+                                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      description.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      resolveRefs[index] = {static_cast<uint32_t>(descriptions.size()),
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      descriptions.push_back(description);
+      // clear values are indexed by attachment, resolves included
+      pass.clearValues.push_back({});
+      hasResolves = true;
+
+      key.insert(key.end(), {static_cast<uint32_t>(index),
+                             static_cast<uint32_t>(description.format),
+                             static_cast<uint32_t>(description.storeOp)});
+    }
+
+    auto cached = renderPassCache.find(key);
+    if (cached != renderPassCache.end()) {
+      pass.renderPass = cached->second;
+      continue;
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pResolveAttachments = hasResolves ? resolveRefs.data() : nullptr;
+    subpass.pDepthStencilAttachment =
+        depthUse != NO_ATTACHMENT ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount =
+        static_cast<uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments = descriptions.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    // no dependencies: the barriers before each pass order it
+    if (vkCreateRenderPass(lveDevice.device(), &renderPassInfo, nullptr,
+                           &pass.renderPass) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create render pass!");
+    }
+    renderPassCache.emplace(std::move(key), pass.renderPass);
+  }
+}
+
+void LveRenderGraph::destroyFramebuffers() {
+  for (Pass &pass : passes) {
+    for (auto &framebuffer : pass.framebuffers) {
+      vkDestroyFramebuffer(lveDevice.device(), framebuffer.second, nullptr);
+    }
+    pass.framebuffers.clear();
+  }
+}
+
+VkFramebuffer LveRenderGraph::getFramebuffer(Pass &pass) {
+  attachmentViews.clear();
+  for (size_t index : pass.attachments) {
+    const Resource &resource = resources[pass.uses[index].resource];
+    assert(resource.view != VK_NULL_HANDLE &&
+           "imported image was not bound for this frame");
+    attachmentViews.push_back(resource.view);
+  }
+  // in the order createRenderPasses() added them
+  for (size_t index : pass.resolves) {
+    if (index != NO_ATTACHMENT) {
+      const Resource &resource = resources[pass.uses[index].resource];
+      assert(resource.view != VK_NULL_HANDLE &&
+             "imported image was not bound for this frame");
+      attachmentViews.push_back(resource.view);
+    }
+  }
+  auto cached = pass.framebuffers.find(attachmentViews);
+  if (cached != pass.framebuffers.end()) {
+    return cached->second;
+  }
+
+  VkExtent2D size = passExtent(pass);
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = pass.renderPass;
+  framebufferInfo.attachmentCount =
+      static_cast<uint32_t>(attachmentViews.size());
+  framebufferInfo.pAttachments = attachmentViews.data();
+  framebufferInfo.width = size.width;
+  framebufferInfo.height = size.height;
+  framebufferInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  if (vkCreateFramebuffer(lveDevice.device(), &framebufferInfo, nullptr,
+                          &framebuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create framebuffer!");
+  }
+  pass.framebuffers.emplace(attachmentViews, framebuffer);
+  return framebuffer;
+}
+
+void LveRenderGraph::beginRendering(VkCommandBuffer commandBuffer,
+                                    Pass &pass) {
+  bool hasDepth = false;
+  for (size_t index = 0; index < pass.attachments.size(); index++) {
+    const Use &use = pass.uses[pass.attachments[index]];
+    const Resource &resource = resources[use.resource];
+    assert(resource.view != VK_NULL_HANDLE &&
+           "imported image was not bound for this frame");
+    pass.renderingAttachments[index].imageView = resource.view;
+    if (pass.resolves[index] != NO_ATTACHMENT) {
+      const Resource &target =
+          resources[pass.uses[pass.resolves[index]].resource];
+      assert(target.view != VK_NULL_HANDLE &&
+             "imported image was not bound for this frame");
+      pass.renderingAttachments[index].resolveImageView = target.view;
+    }
+    hasDepth = use.usage != Usage::ColorAttachment;
+  }
+  // depth is always last
+  const uint32_t colorCount = static_cast<uint32_t>(
+      pass.renderingAttachments.size() - (hasDepth ? 1 : 0));
+
+  VkRenderingInfo renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = passExtent(pass);
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = colorCount;
+  renderingInfo.pColorAttachments = pass.renderingAttachments.data();
+  renderingInfo.pDepthAttachment =
+      hasDepth ? &pass.renderingAttachments[colorCount] : nullptr;
+  lveDevice.cmdBeginRendering(commandBuffer, renderingInfo);
+}
+
+void LveRenderGraph::bindImage(ResourceId image, VkImage handle,
+                               VkImageView view) {
+  assert(resources[image].imported && resources[image].isImage &&
+         "only imported images are bound");
+  resources[image].image = handle;
+  resources[image].view = view;
+}
+
+void LveRenderGraph::bindBuffer(ResourceId buffer, VkBuffer handle) {
+  assert(resources[buffer].imported && !resources[buffer].isImage &&
+         "only imported buffers are bound");
+  resources[buffer].buffer = handle;
+}
+
+VkImageView LveRenderGraph::getImageView(ResourceId image) const {
+  return resources[image].view;
+}
+
+PipelineRenderTarget LveRenderGraph::getRenderTarget(PassId id) const {
+  assert(compiled && "render passes are created by compile()");
+  const Pass &pass = passes[id];
+  PipelineRenderTarget target{};
+  if (!pass.attachments.empty()) {
+    // every attachment has the same count
+    target.samples = resources[pass.uses[pass.attachments[0]].resource]
+                         .desc.samples;
+  }
+  if (!dynamicRendering) {
+    target.renderPass = pass.renderPass;
+    return target;
+  }
+  for (size_t index : pass.attachments) {
+    const Use &use = pass.uses[index];
+    VkFormat format = resources[use.resource].desc.format;
+    if (use.usage == Usage::ColorAttachment) {
+      target.colorFormats.push_back(format);
+    } else {
+      target.depthFormat = format;
+    }
+  }
+  return target;
+}
+
+bool LveRenderGraph::isCulled(PassId pass) const {
+  return passes[pass].culled;
+}
+
+void LveRenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                    const std::vector<Barrier> &barriers) {
+  if (barriers.empty()) {
+    return;
+  }
+  VkPipelineStageFlags srcStages = 0;
+  VkPipelineStageFlags dstStages = 0;
+  imageBarriers.clear();
+  bufferBarriers.clear();
+  for (const Barrier &barrier : barriers) {
+    srcStages |= barrier.srcStages;
+    dstStages |= barrier.dstStages;
+    // with nothing to flush or transition the stage masks are enough
+    if (barrier.oldLayout == barrier.newLayout && barrier.srcAccess == 0) {
+      continue;
+    }
+    const Resource &resource = resources[barrier.resource];
+    if (resource.isImage) {
+      assert(resource.image != VK_NULL_HANDLE &&
+             "imported image was not bound for this frame");
+      VkImageMemoryBarrier imageBarrier{};
+      imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      imageBarrier.srcAccessMask = barrier.srcAccess;
+      imageBarrier.dstAccessMask = barrier.dstAccess;
+      imageBarrier.oldLayout = barrier.oldLayout;
+      imageBarrier.newLayout = barrier.newLayout;
+      imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.image = resource.image;
+      imageBarrier.subresourceRange = {barrierAspect(resource.desc.format), 0,
+                                       1, 0, 1};
+      imageBarriers.push_back(imageBarrier);
+    } else {
+      assert(resource.buffer != VK_NULL_HANDLE &&
+             "imported buffer was not bound for this frame");
+      VkBufferMemoryBarrier bufferBarrier{};
+      bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      bufferBarrier.srcAccessMask = barrier.srcAccess;
+      bufferBarrier.dstAccessMask = barrier.dstAccess;
+      bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferBarrier.buffer = resource.buffer;
+      bufferBarrier.offset = 0;
+      bufferBarrier.size = VK_WHOLE_SIZE;
+      bufferBarriers.push_back(bufferBarrier);
+    }
+  }
+  vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr,
+                       static_cast<uint32_t>(bufferBarriers.size()),
+                       bufferBarriers.data(),
+                       static_cast<uint32_t>(imageBarriers.size()),
+                       imageBarriers.data());
+}
+
+void LveRenderGraph::execute(FrameInfo &frameInfo) {
+  assert(compiled && "compile the render graph before executing it");
+  VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+  stats.skippedPasses = 0;
+  for (Pass &pass : passes) {
+    if (pass.culled) {
+      continue;
+    }
+    recordBarriers(commandBuffer, pass.barriers);
+    if (pass.condition && !pass.condition()) {
+      stats.skippedPasses++;
+      continue;
+    }
+    if (pass.attachments.empty()) {
+      if (pass.function) {
+        pass.function(frameInfo);
+      }
+      continue;
+    }
+
+    VkExtent2D size = passExtent(pass);
+    if (dynamicRendering) {
+      beginRendering(commandBuffer, pass);
+    } else {
+      VkRenderPassBeginInfo renderPassInfo{};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      renderPassInfo.renderPass = pass.renderPass;
+      renderPassInfo.framebuffer = getFramebuffer(pass);
+      renderPassInfo.renderArea.offset = {0, 0};
+      renderPassInfo.renderArea.extent = size;
+      renderPassInfo.clearValueCount =
+          static_cast<uint32_t>(pass.clearValues.size());
+      renderPassInfo.pClearValues = pass.clearValues.data();
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                           VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(size.width);
+    viewport.height = static_cast<float>(size.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, size};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (pass.function) {
+      pass.function(frameInfo);
+    }
+    if (dynamicRendering) {
+      lveDevice.cmdEndRendering(commandBuffer);
+    } else {
+      vkCmdEndRenderPass(commandBuffer);
+    }
+  }
+  recordBarriers(commandBuffer, finalBarriers);
+}
+
+void LveRenderGraph::dump(std::ostream &out) const {
+  auto printBarriers = [&](const std::vector<Barrier> &barriers) {
+    for (const Barrier &barrier : barriers) {
+      const Resource &resource = resources[barrier.resource];
+      out << "    barrier \"" << resource.name << "\": ";
+      if (resource.isImage) {
+        out << layoutName(barrier.oldLayout) << " -> "
+            << layoutName(barrier.newLayout) << ", ";
+      }
+      out << flagNames(barrier.srcStages, STAGE_NAMES) << " -> "
+          << flagNames(barrier.dstStages, STAGE_NAMES);
+      if (barrier.oldLayout == barrier.newLayout && barrier.srcAccess == 0) {
+        out << " (execution only)";
+      } else {
+        out << ", " << flagNames(barrier.srcAccess, ACCESS_NAMES) << " -> "
+            << flagNames(barrier.dstAccess, ACCESS_NAMES);
+      }
+      out << "\n";
+    }
+  };
+
+  out << "render graph: " << stats.passes << " passes (" << stats.culledPasses
+      << " culled), " << stats.renderPasses
+      << (dynamicRendering ? " dynamic rendering passes, " : " render passes, ")
+      << stats.barriers << " barriers in " << stats.barrierBatches
+      << " batches, " << extent.width << "x" << extent.height << "\n";
+  for (PassId index = 0; index < passes.size(); index++) {
+    const Pass &pass = passes[index];
+    out << "  pass " << index << " \"" << pass.name << "\"";
+    if (pass.culled) {
+      out << ": culled, nothing uses what it writes\n";
+      continue;
+    }
+    out << (pass.sideEffects ? " (side effects)" : "")
+        << (pass.condition ? " (conditional)" : "") << "\n";
+    printBarriers(pass.barriers);
+    for (const Use &use : pass.uses) {
+      out << "    " << usageName(use.usage) << " \""
+          << resources[use.resource].name << "\"";
+      if (isAttachment(use.usage)) {
+        out << (use.clear  ? ", clear"
+                : use.load ? ", load"
+                           : ", don't care")
+            << (use.store ? ", store" : ", discard");
+      } else if (isResolve(use.usage)) {
+        out << " from \"" << resources[use.resolveSource].name << "\""
+            << (use.store ? ", store" : ", discard");
+      }
+      out << "\n";
+    }
+  }
+  out << "  end of frame\n";
+  printBarriers(finalBarriers);
+
+  out << "  transient images: " << stats.transientImages << " in "
+      << stats.memoryBlocks << " blocks, " << (stats.allocatedBytes >> 10)
+      << " KiB instead of " << (stats.transientBytes >> 10) << " KiB, "
+      << stats.lazyImages << " lazily allocated\n";
+  for (size_t index = 0; index < blocks.size(); index++) {
+    const MemoryBlock &block = blocks[index];
+    out << "    block " << index << ": " << (block.requirements.size >> 10)
+        << " KiB"
+        << ((block.properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0
+                ? ", lazily allocated"
+                : "")
+        << "\n";
+    for (ResourceId id : block.residents) {
+      const Resource &resource = resources[id];
+      out << "      \"" << resource.name << "\" " << (resource.size >> 10)
+          << " KiB, passes " << resource.firstPass << "-" << resource.lastPass
+          << "\n";
+    }
+  }
+  out.flush();
+}
+
+} // namespace lve
@@ -0,0 +1,92 @@
+#include "../include/lve_render_queue.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <utility>
+
+namespace lve {
+
+uint64_t LveRenderQueue::makeKey(uint32_t pipelineId, uint32_t materialId,
+                                 uint32_t meshId, float depth) {
+  constexpr uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+  uint64_t quantizedDepth = static_cast<uint64_t>(
+      std::clamp(depth, 0.f, 1.f) * static_cast<float>(depthMax));
+
+  uint64_t key = 0;
+  key |= (static_cast<uint64_t>(pipelineId) & ((1ull << PIPELINE_BITS) - 1))
+         << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS);
+  key |= (static_cast<uint64_t>(materialId) & ((1ull << MATERIAL_BITS) - 1))
+         << (MESH_BITS + DEPTH_BITS);
+  key |= (static_cast<uint64_t>(meshId) & ((1ull << MESH_BITS) - 1))
+         << DEPTH_BITS;
+  key |= quantizedDepth & depthMax;
+  return key;
+}
+
+void LveRenderQueue::begin(LveLinearAllocator &allocator, uint32_t maxDraws) {
+  draws = allocator.alloc<Draw>(maxDraws);
+  keys = allocator.alloc<uint64_t>(maxDraws);
+  order = allocator.alloc<uint32_t>(maxDraws);
+  scratchKeys = allocator.alloc<uint64_t>(maxDraws);
+  scratchOrder = allocator.alloc<uint32_t>(maxDraws);
+  capacity = maxDraws;
+  count = 0;
+}
+
+void LveRenderQueue::push(uint64_t key, const Draw &draw) {
+  assert(count < capacity && "Render queue is full");
+  draws[count] = draw;
+  keys[count] = key;
+  order[count] = count;
+  count++;
+}
+
+void LveRenderQueue::sort() {
+  // LSD radix sort, 8 bits per pass. All histograms are built in one sweep;
+  // passes where every key has the same digit (common for the pipeline and
+  // material bytes) are skipped.
+  constexpr int PASSES = 8;
+  std::array<std::array<uint32_t, 256>, PASSES> histograms{};
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t key = keys[i];
+    for (int pass = 0; pass < PASSES; pass++) {
+      histograms[pass][(key >> (pass * 8)) & 0xff]++;
+    }
+  }
+
+  uint64_t *srcKeys = keys;
+  uint32_t *srcOrder = order;
+  uint64_t *dstKeys = scratchKeys;
+  uint32_t *dstOrder = scratchOrder;
+  for (int pass = 0; pass < PASSES; pass++) {
+    auto &histogram = histograms[pass];
+    const int shift = pass * 8;
+    if (count == 0 || histogram[(srcKeys[0] >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (auto &bucket : histogram) {
+      uint32_t bucketCount = bucket;
+      bucket = offset;
+      offset += bucketCount;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t slot = histogram[(srcKeys[i] >> shift) & 0xff]++;
+      dstKeys[slot] = srcKeys[i];
+      dstOrder[slot] = srcOrder[i];
+    }
+    std::swap(srcKeys, dstKeys);
+    std::swap(srcOrder, dstOrder);
+  }
+
+  // keep the sorted result in the primary arrays
+  if (srcKeys != keys) {
+    std::swap(keys, scratchKeys);
+    std::swap(order, scratchOrder);
+  }
+}
+
+} // namespace lve
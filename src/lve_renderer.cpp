@@ -14,9 +14,19 @@ LveRenderer::LveRenderer(LveWindow &window, LveDevice &device)
     : lveWindow(window), lveDevice(device) {
   recreateSwapChain();
   createCommandBuffers();
+  createStatisticsQueryPool();
+  createTimestampQueryPool();
 }
 
-LveRenderer::~LveRenderer() { freeCommandBuffers(); }
+LveRenderer::~LveRenderer() {
+  if (statisticsQueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(lveDevice.device(), statisticsQueryPool, nullptr);
+  }
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(lveDevice.device(), timestampQueryPool, nullptr);
+  }
+  freeCommandBuffers();
+}
 
 void LveRenderer::recreateSwapChain() {
   auto extent = lveWindow.getExtent();
@@ -38,6 +48,7 @@ void LveRenderer::recreateSwapChain() {
           "Swap chain image and depth formats have changed!");
     }
   }
+  swapChainGeneration++;
 }
 
 void LveRenderer::createCommandBuffers() {
@@ -55,6 +66,80 @@ void LveRenderer::createCommandBuffers() {
   }
 }
 
+void LveRenderer::createStatisticsQueryPool() {
+  if (!lveDevice.enabledFeatures.pipelineStatisticsQuery) {
+    return;
+  }
+
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  queryPoolInfo.queryCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+  queryPoolInfo.pipelineStatistics =
+      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+  if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr,
+                        &statisticsQueryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline statistics query pool!");
+  }
+}
+
+void LveRenderer::createTimestampQueryPool() {
+  if (!lveDevice.properties.limits.timestampComputeAndGraphics) {
+    return;
+  }
+
+  // a begin and an end timestamp per frame in flight
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = 2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr,
+                        &timestampQueryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+}
+
+void LveRenderer::readStatistics() {
+  if (statisticsQueryPool == VK_NULL_HANDLE ||
+      !statisticsPending[currentFrameIndex]) {
+    return;
+  }
+
+  // results are ordered by statistic bit, vertex before fragment
+  std::array<uint64_t, 2> results{};
+  VkResult result = vkGetQueryPoolResults(
+      lveDevice.device(), statisticsQueryPool,
+      static_cast<uint32_t>(currentFrameIndex), 1, sizeof(results),
+      results.data(), sizeof(results), VK_QUERY_RESULT_64_BIT);
+  if (result == VK_SUCCESS) {
+    vertexInvocations = results[0];
+    fragmentInvocations = results[1];
+    statisticsPending[currentFrameIndex] = false;
+  }
+}
+
+void LveRenderer::readTimestamps() {
+  if (timestampQueryPool == VK_NULL_HANDLE ||
+      !timestampsPending[currentFrameIndex]) {
+    return;
+  }
+
+  std::array<uint64_t, 2> results{};
+  VkResult result = vkGetQueryPoolResults(
+      lveDevice.device(), timestampQueryPool,
+      static_cast<uint32_t>(2 * currentFrameIndex), 2, sizeof(results),
+      results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result == VK_SUCCESS) {
+    // timestampPeriod is in nanoseconds per tick
+    gpuMilliseconds = static_cast<double>(results[1] - results[0]) *
+                      lveDevice.properties.limits.timestampPeriod * 1e-6;
+    timestampsPending[currentFrameIndex] = false;
+  }
+}
+
 void LveRenderer::freeCommandBuffers() {
   vkFreeCommandBuffers(lveDevice.device(), lveDevice.getCommandPool(),
                        static_cast<uint32_t>(commandBuffers.size()),
@@ -78,6 +163,10 @@ VkCommandBuffer LveRenderer::beginFrame() {
 
   isFrameStarted = true;
 
+  // this frame's fence has signalled, so its last query is complete
+  readStatistics();
+  readTimestamps();
+
   auto commandBuffer = getCurrentCommandBuffer();
 
   VkCommandBufferBeginInfo beginInfo{};
@@ -92,13 +181,22 @@ void LveRenderer::endFrame() {
   assert(isFrameStarted && "Can't call end frame if Frame is not in progress!");
   auto commandBuffer = getCurrentCommandBuffer();
 
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-  void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record command buffer!");
   }
-  auto result =
-      lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+  auto result = lveSwapChain->submitCommandBuffers(
+      &commandBuffer, &currentImageIndex, waitSemaphores, waitStages,
+      signalSemaphores);
+  waitSemaphores.clear();
+  waitStages.clear();
+  signalSemaphores.clear();
+  for (const auto &followUp : followUpSubmits) {
+    if (vkQueueSubmit(followUp.queue, 1, &followUp.submitInfo,
+                      followUp.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit follow-up command buffer!");
+    }
+  }
+  followUpSubmits.clear();
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       lveWindow.wasWindowResized()) {
     lveWindow.resetWindowResizedFlag();
@@ -112,48 +210,61 @@ void LveRenderer::endFrame() {
       (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void LveRenderer::addWaitSemaphore(VkSemaphore semaphore,
+                                   VkPipelineStageFlags stage) {
+  assert(isFrameStarted && "Can't add a wait outside of a frame");
+  waitSemaphores.push_back(semaphore);
+  waitStages.push_back(stage);
+}
+
+void LveRenderer::addSignalSemaphore(VkSemaphore semaphore) {
+  assert(isFrameStarted && "Can't add a signal outside of a frame");
+  signalSemaphores.push_back(semaphore);
+}
+
+void LveRenderer::addFollowUpSubmit(VkQueue queue,
+                                    const VkSubmitInfo &submitInfo,
+                                    VkFence fence) {
+  assert(isFrameStarted && "Can't add a follow-up submit outside of a frame");
+  followUpSubmits.push_back({queue, submitInfo, fence});
+}
+
+void LveRenderer::beginStatisticsQuery(VkCommandBuffer commandBuffer) {
   assert(isFrameStarted &&
-         "Can not call beginSwapChainRenderPass if frame is not in progress");
+         "Can not begin statistics query if frame is not in progress");
   assert(commandBuffer == getCurrentCommandBuffer() &&
-         "Can't begin render pass on command buffer from a different frame");
-
-  VkRenderPassBeginInfo renderPassInfo{};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = lveSwapChain->getRenderPass();
-  renderPassInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
-
-  renderPassInfo.renderArea.offset = {0, 0};
-  renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
-
-  std::array<VkClearValue, 2> clearValues{};
-  clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
-  clearValues[1].depthStencil = {1.0f, 0};
-  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-  renderPassInfo.pClearValues = clearValues.data();
-
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(lveSwapChain->getSwapChainExtent().width);
-  viewport.height =
-      static_cast<float>(lveSwapChain->getSwapChainExtent().height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-  VkRect2D scissor{{0, 0}, lveSwapChain->getSwapChainExtent()};
-  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-}
-void LveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+         "Can't begin query on command buffer from a different frame");
+
+  if (statisticsQueryPool != VK_NULL_HANDLE) {
+    uint32_t query = static_cast<uint32_t>(currentFrameIndex);
+    vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, query, 1);
+    vkCmdBeginQuery(commandBuffer, statisticsQueryPool, query, 0);
+  }
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    uint32_t query = static_cast<uint32_t>(2 * currentFrameIndex);
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool, query, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestampQueryPool, query);
+  }
+}
+
+void LveRenderer::endStatisticsQuery(VkCommandBuffer commandBuffer) {
   assert(isFrameStarted &&
-         "Can not call endSwapChainRenderPass if frame is not in progress");
+         "Can not end statistics query if frame is not in progress");
   assert(commandBuffer == getCurrentCommandBuffer() &&
-         "Can't end render pass on command buffer from a different frame");
+         "Can't end query on command buffer from a different frame");
 
-  vkCmdEndRenderPass(commandBuffer);
+  if (statisticsQueryPool != VK_NULL_HANDLE) {
+    vkCmdEndQuery(commandBuffer, statisticsQueryPool,
+                  static_cast<uint32_t>(currentFrameIndex));
+    statisticsPending[currentFrameIndex] = true;
+  }
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        timestampQueryPool,
+                        static_cast<uint32_t>(2 * currentFrameIndex + 1));
+    timestampsPending[currentFrameIndex] = true;
+  }
 }
 
 } // namespace lve
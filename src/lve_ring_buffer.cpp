@@ -0,0 +1,83 @@
+#include "../include/lve_ring_buffer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace lve {
+
+LveRingBuffer::LveRingBuffer(LveDevice &device, VkDeviceSize frameCapacity,
+                             VkBufferUsageFlags usage)
+    : lveDevice{device}, usage{usage} {
+  const VkPhysicalDeviceLimits &limits = lveDevice.properties.limits;
+  // both limits are powers of two, so the larger satisfies both; never
+  // below 16 so shaders can address allocations in whole vec4s
+  alignment = std::max({VkDeviceSize{16}, limits.minUniformBufferOffsetAlignment,
+                        limits.minStorageBufferOffsetAlignment});
+  for (auto &frame : frames) {
+    createFrameBuffer(frame, frameCapacity);
+  }
+}
+
+LveRingBuffer::~LveRingBuffer() {
+  for (auto &frame : frames) {
+    destroyFrameBuffer(frame);
+  }
+}
+
+void LveRingBuffer::beginFrame(int frameIndex) {
+  Frame &frame = frames[frameIndex];
+  if (frame.failedAllocations > 0) {
+    // this frame's fence has signalled, so its buffer is no longer in use
+    VkDeviceSize capacity = frame.capacity * 2;
+    destroyFrameBuffer(frame);
+    createFrameBuffer(frame, capacity);
+    frame.generation++;
+  }
+  frame.offset = 0;
+  frame.failedAllocations = 0;
+  currentFrame = frameIndex;
+}
+
+bool LveRingBuffer::allocate(VkDeviceSize size, Allocation &allocation) {
+  Frame &frame = frames[currentFrame];
+  VkDeviceSize offset = (frame.offset + alignment - 1) & ~(alignment - 1);
+  if (offset + size > frame.capacity) {
+    frame.failedAllocations++;
+    return false;
+  }
+  frame.offset = offset + size;
+  allocation.data = frame.mapped + offset;
+  allocation.offset = static_cast<uint32_t>(offset);
+  return true;
+}
+
+void LveRingBuffer::createFrameBuffer(Frame &frame, VkDeviceSize capacity) {
+  // a ring that is copied from stages uploads; the others feed shaders
+  MemoryCategory category = (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) != 0
+                                ? MemoryCategory::Staging
+                                : MemoryCategory::Uniform;
+  lveDevice.createBuffer(capacity, usage,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         frame.buffer, frame.memory, category);
+  void *mapped = nullptr;
+  vkMapMemory(lveDevice.device(), frame.memory, 0, capacity, 0, &mapped);
+  frame.mapped = static_cast<std::byte *>(mapped);
+  frame.capacity = capacity;
+  frame.offset = 0;
+}
+
+void LveRingBuffer::destroyFrameBuffer(Frame &frame) {
+  if (frame.buffer == VK_NULL_HANDLE) {
+    return;
+  }
+  vkUnmapMemory(lveDevice.device(), frame.memory);
+  vkDestroyBuffer(lveDevice.device(), frame.buffer, nullptr);
+  lveDevice.freeMemory(frame.memory);
+  frame.buffer = VK_NULL_HANDLE;
+  frame.memory = VK_NULL_HANDLE;
+  frame.mapped = nullptr;
+}
+
+} // namespace lve
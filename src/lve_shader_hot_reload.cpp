@@ -0,0 +1,305 @@
+#include "../include/lve_shader_hot_reload.hpp"
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef LVE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace lve {
+
+namespace {
+// modification-time polling fallback
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+
+#ifdef LVE_SHADERC
+bool hasSuffix(const std::string &value, const std::string &suffix) {
+  return value.size() >= suffix.size() &&
+         value.compare(value.size() - suffix.size(), suffix.size(), suffix) ==
+             0;
+}
+#endif
+} // namespace
+
+LveShaderHotReload::LveShaderHotReload(std::string shaderDirectory)
+    : shaderDirectory{std::move(shaderDirectory)} {
+#ifdef __linux__
+  // editors either rewrite the file in place or rename a temporary over it
+  notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (notifyFd >= 0 &&
+      inotify_add_watch(notifyFd, this->shaderDirectory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(notifyFd);
+    notifyFd = -1;
+  }
+#endif
+  // one worker keeps rebuilds in order and off the render thread
+  worker = std::make_unique<LveThreadPool>(1);
+}
+
+LveShaderHotReload::~LveShaderHotReload() {
+  shuttingDown = true;
+  worker.reset();
+#ifdef __linux__
+  if (notifyFd >= 0) {
+    close(notifyFd);
+  }
+#endif
+}
+
+bool LveShaderHotReload::isSupported() {
+#ifdef LVE_SHADERC
+  return true;
+#else
+  return false;
+#endif
+}
+
+LveShaderHotReload::WatchId
+LveShaderHotReload::watch(std::vector<std::unique_ptr<LvePipeline> *> pipelines,
+                          std::vector<std::string> sources,
+                          PipelineFactory factory, ReloadCallback reloaded) {
+  for (const auto &source : sources) {
+    // rebuilds write it next to the source, so a mounted archive's copy
+    // would go stale
+    LveArchive::readLoose(source + ".spv");
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(source, error);
+    modificationTimes.emplace(
+        source, error ? std::filesystem::file_time_type::min() : time);
+  }
+
+  WatchId id = nextWatchId++;
+  Watch entry{};
+  entry.pipelines = std::move(pipelines);
+  entry.sources = std::move(sources);
+  entry.factory = std::move(factory);
+  entry.reloaded = std::move(reloaded);
+  watches.emplace(id, std::move(entry));
+  return id;
+}
+
+void LveShaderHotReload::unwatch(WatchId id) {
+  auto it = watches.find(id);
+  if (it == watches.end()) {
+    return;
+  }
+  // the factory may reference its owner, which is about to go away
+  if (it->second.building) {
+    worker->waitIdle();
+  }
+  watches.erase(it);
+
+  std::lock_guard<std::mutex> lock{rebuiltMutex};
+  rebuilt.erase(std::remove_if(rebuilt.begin(), rebuilt.end(),
+                               [&](const Rebuilt &r) { return r.id == id; }),
+                rebuilt.end());
+}
+
+void LveShaderHotReload::beginFrame(int frameIndex) {
+  // frameIndex's fence has signalled: no frame in flight still uses these
+  retired[frameIndex].clear();
+
+  std::vector<Rebuilt> finished;
+  {
+    std::lock_guard<std::mutex> lock{rebuiltMutex};
+    finished.swap(rebuilt);
+  }
+  for (auto &result : finished) {
+    auto it = watches.find(result.id);
+    if (it == watches.end()) {
+      continue;
+    }
+    Watch &entry = it->second;
+    entry.building = false;
+    if (result.pipelines.empty()) {
+      std::cerr << "shader reload failed: " << result.error << std::endl;
+      continue;
+    }
+    assert(result.pipelines.size() == entry.pipelines.size() &&
+           "a watch's factory must build each watched pipeline");
+    // the previous frame may still be executing with the old pipelines
+    for (size_t i = 0; i < entry.pipelines.size(); i++) {
+      retired[frameIndex].push_back(std::move(*entry.pipelines[i]));
+      *entry.pipelines[i] = std::move(result.pipelines[i]);
+    }
+    reloads++;
+    std::cout << "reloaded " << entry.pipelines.size() << " pipelines:";
+    for (const auto &source : entry.sources) {
+      std::cout << " " << source;
+    }
+    std::cout << std::endl;
+    if (entry.reloaded) {
+      entry.reloaded();
+    }
+  }
+
+  for (const auto &file : pollChangedFiles()) {
+    for (auto &kv : watches) {
+      Watch &entry = kv.second;
+      if (std::find(entry.sources.begin(), entry.sources.end(), file) !=
+              entry.sources.end() &&
+          std::find(entry.changed.begin(), entry.changed.end(), file) ==
+              entry.changed.end()) {
+        entry.changed.push_back(file);
+      }
+    }
+  }
+  startRebuilds();
+}
+
+std::vector<std::string> LveShaderHotReload::pollChangedFiles() {
+  std::vector<std::string> changed;
+#ifdef __linux__
+  if (notifyFd >= 0) {
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+      ssize_t length = read(notifyFd, buffer, sizeof(buffer));
+      if (length <= 0) {
+        break; // EAGAIN: nothing pending
+      }
+      for (char *ptr = buffer; ptr < buffer + length;) {
+        const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+        if (event->len > 0) {
+          changed.push_back(shaderDirectory + "/" + event->name);
+        }
+        ptr += sizeof(inotify_event) + event->len;
+      }
+    }
+    return changed;
+  }
+#endif
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - lastPoll < POLL_INTERVAL) {
+    return changed;
+  }
+  lastPoll = now;
+  for (auto &kv : modificationTimes) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(kv.first, error);
+    if (!error && time != kv.second) {
+      kv.second = time;
+      changed.push_back(kv.first);
+    }
+  }
+  return changed;
+}
+
+void LveShaderHotReload::startRebuilds() {
+  struct Job {
+    WatchId id;
+    std::vector<std::string> sources;
+    PipelineFactory factory;
+  };
+  std::vector<Job> jobs;
+  for (auto &kv : watches) {
+    Watch &entry = kv.second;
+    // changes made during a rebuild wait for it to finish
+    if (entry.building || entry.changed.empty()) {
+      continue;
+    }
+    entry.building = true;
+    jobs.push_back({kv.first, std::move(entry.changed), entry.factory});
+    entry.changed.clear();
+  }
+  if (jobs.empty()) {
+    return;
+  }
+
+  worker->submit([this, jobs] {
+    // sources shared by several pipelines are compiled once; "" is success
+    std::unordered_map<std::string, std::string> compileErrors;
+    for (const Job &job : jobs) {
+      Rebuilt result{job.id, {}, {}};
+      if (!shuttingDown) {
+        try {
+          for (const auto &source : job.sources) {
+            auto it = compileErrors.find(source);
+            if (it == compileErrors.end()) {
+              std::string error;
+              try {
+                compileToSpirv(source);
+              } catch (const std::exception &e) {
+                error = e.what();
+              }
+              it = compileErrors.emplace(source, error).first;
+            }
+            if (!it->second.empty()) {
+              throw std::runtime_error(it->second);
+            }
+          }
+          result.pipelines = job.factory();
+        } catch (const std::exception &e) {
+          result.pipelines.clear();
+          result.error = e.what();
+        }
+      }
+
+      std::lock_guard<std::mutex> lock{rebuiltMutex};
+      rebuilt.push_back(std::move(result));
+    }
+  });
+}
+
+void LveShaderHotReload::compileToSpirv(const std::string &source) {
+#ifdef LVE_SHADERC
+  shaderc_shader_kind kind;
+  if (hasSuffix(source, ".vert")) {
+    kind = shaderc_glsl_vertex_shader;
+  } else if (hasSuffix(source, ".frag")) {
+    kind = shaderc_glsl_fragment_shader;
+  } else if (hasSuffix(source, ".comp")) {
+    kind = shaderc_glsl_compute_shader;
+  } else {
+    throw std::runtime_error("unknown shader stage: " + source);
+  }
+
+  std::vector<char> glsl = LvePipeline::readFile(source);
+  shaderc::Compiler compiler;
+  shaderc::CompileOptions options;
+  shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+      glsl.data(), glsl.size(), kind, source.c_str(), options);
+  if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+    throw std::runtime_error(result.GetErrorMessage());
+  }
+
+  // written aside and renamed so a reader never sees a partial module
+  const std::string target = source + ".spv";
+  const std::string temporary = target + ".tmp";
+  {
+    std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+      throw std::runtime_error("failed to open file: " + temporary);
+    }
+    size_t bytes = static_cast<size_t>(result.cend() - result.cbegin()) *
+                   sizeof(uint32_t);
+    file.write(reinterpret_cast<const char *>(result.cbegin()), bytes);
+    if (!file) {
+      throw std::runtime_error("failed to write file: " + temporary);
+    }
+  }
+  if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+    throw std::runtime_error("failed to replace " + target);
+  }
+#else
+  throw std::runtime_error("built without libshaderc, cannot compile " +
+                           source);
+#endif
+}
+
+} // namespace lve
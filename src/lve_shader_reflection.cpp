@@ -0,0 +1,561 @@
+#include "../include/lve_shader_reflection.hpp"
+
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace lve {
+
+namespace {
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr size_t HEADER_WORDS = 5;
+
+// the subset of the SPIR-V grammar the interface is declared with
+enum Op : uint32_t {
+  OP_ENTRY_POINT = 15,
+  OP_TYPE_BOOL = 20,
+  OP_TYPE_INT = 21,
+  OP_TYPE_FLOAT = 22,
+  OP_TYPE_VECTOR = 23,
+  OP_TYPE_MATRIX = 24,
+  OP_TYPE_IMAGE = 25,
+  OP_TYPE_SAMPLER = 26,
+  OP_TYPE_SAMPLED_IMAGE = 27,
+  OP_TYPE_ARRAY = 28,
+  OP_TYPE_RUNTIME_ARRAY = 29,
+  OP_TYPE_STRUCT = 30,
+  OP_TYPE_POINTER = 32,
+  OP_CONSTANT = 43,
+  OP_SPEC_CONSTANT = 50,
+  OP_VARIABLE = 59,
+  OP_DECORATE = 71,
+  OP_MEMBER_DECORATE = 72,
+  OP_TYPE_ACCELERATION_STRUCTURE = 5341,
+};
+
+enum Decoration : uint32_t {
+  DECORATION_BUFFER_BLOCK = 3,
+  DECORATION_ARRAY_STRIDE = 6,
+  DECORATION_MATRIX_STRIDE = 7,
+  DECORATION_BUILT_IN = 11,
+  DECORATION_LOCATION = 30,
+  DECORATION_BINDING = 33,
+  DECORATION_DESCRIPTOR_SET = 34,
+  DECORATION_OFFSET = 35,
+};
+
+enum StorageClass : uint32_t {
+  STORAGE_UNIFORM_CONSTANT = 0,
+  STORAGE_INPUT = 1,
+  STORAGE_UNIFORM = 2,
+  STORAGE_PUSH_CONSTANT = 9,
+  STORAGE_STORAGE_BUFFER = 12,
+};
+
+constexpr uint32_t DIM_BUFFER = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+constexpr uint32_t IMAGE_SAMPLED_STORAGE = 2;
+
+constexpr uint32_t NONE = ~0u;
+
+struct Type {
+  uint32_t op = 0;
+  // int/float: width; vector/matrix: component count; array: length
+  uint32_t count = 0;
+  // vector/matrix/array/pointer: element type; image: dim
+  uint32_t element = 0;
+  uint32_t storageClass = 0; // pointer
+  bool isSigned = false;     // int
+  uint32_t imageSampled = 0; // image: 1 sampled, 2 storage
+  std::vector<uint32_t> members; // struct
+};
+
+struct Decorations {
+  uint32_t set = NONE;
+  uint32_t binding = NONE;
+  uint32_t location = NONE;
+  bool builtIn = false;
+  bool bufferBlock = false;
+  uint32_t arrayStride = 0;
+};
+
+struct MemberDecorations {
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+};
+
+struct Variable {
+  uint32_t id;
+  uint32_t type; // a pointer type
+  uint32_t storageClass;
+};
+
+VkShaderStageFlags stageForExecutionModel(uint32_t model) {
+  switch (model) {
+  case 0:
+    return VK_SHADER_STAGE_VERTEX_BIT;
+  case 1:
+    return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+  case 2:
+    return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+  case 3:
+    return VK_SHADER_STAGE_GEOMETRY_BIT;
+  case 4:
+    return VK_SHADER_STAGE_FRAGMENT_BIT;
+  case 5:
+    return VK_SHADER_STAGE_COMPUTE_BIT;
+  default:
+    return 0;
+  }
+}
+
+class Parser {
+public:
+  // code is read in place and must outlive the parser
+  Parser(const uint32_t *code, size_t codeSize)
+      : words{code}, size{codeSize / sizeof(uint32_t)} {
+    if (codeSize % sizeof(uint32_t) != 0 || size < HEADER_WORDS) {
+      throw std::runtime_error("shader module is not SPIR-V");
+    }
+    if (words[0] != SPIRV_MAGIC) {
+      throw std::runtime_error("shader module is not SPIR-V");
+    }
+  }
+
+  LveShaderReflection parse() {
+    types.resize(words[3]); // id bound
+    decorations.resize(words[3]);
+    size_t offset = HEADER_WORDS;
+    while (offset < size) {
+      uint32_t wordCount = words[offset] >> 16;
+      uint32_t opcode = words[offset] & 0xffff;
+      if (wordCount == 0 || offset + wordCount > size) {
+        throw std::runtime_error("malformed SPIR-V instruction");
+      }
+      instruction(opcode, &words[offset + 1], wordCount - 1);
+      offset += wordCount;
+    }
+
+    LveShaderReflection reflection{};
+    reflection.stages = stages;
+    for (const auto &variable : variables) {
+      reflectVariable(variable, reflection);
+    }
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+              [](const auto &a, const auto &b) {
+                return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    std::sort(
+        reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+        [](const auto &a, const auto &b) { return a.location < b.location; });
+    return reflection;
+  }
+
+private:
+  Type &type(uint32_t id) {
+    if (id >= types.size()) {
+      throw std::runtime_error("SPIR-V id out of range");
+    }
+    return types[id];
+  }
+
+  void instruction(uint32_t opcode, const uint32_t *operands,
+                   uint32_t operandCount) {
+    auto operand = [&](uint32_t i) {
+      if (i >= operandCount) {
+        throw std::runtime_error("malformed SPIR-V instruction");
+      }
+      return operands[i];
+    };
+
+    switch (opcode) {
+    case OP_ENTRY_POINT:
+      stages |= stageForExecutionModel(operand(0));
+      break;
+    case OP_DECORATE: {
+      uint32_t target = operand(0);
+      if (target >= decorations.size()) {
+        throw std::runtime_error("SPIR-V id out of range");
+      }
+      Decorations &d = decorations[target];
+      switch (operand(1)) {
+      case DECORATION_BUFFER_BLOCK:
+        d.bufferBlock = true;
+        break;
+      case DECORATION_ARRAY_STRIDE:
+        d.arrayStride = operand(2);
+        break;
+      case DECORATION_BUILT_IN:
+        d.builtIn = true;
+        break;
+      case DECORATION_LOCATION:
+        d.location = operand(2);
+        break;
+      case DECORATION_BINDING:
+        d.binding = operand(2);
+        break;
+      case DECORATION_DESCRIPTOR_SET:
+        d.set = operand(2);
+        break;
+      }
+      break;
+    }
+    case OP_MEMBER_DECORATE: {
+      auto &member = memberDecorations[operand(0)];
+      if (member.size() <= operand(1)) {
+        member.resize(operand(1) + 1);
+      }
+      if (operand(2) == DECORATION_OFFSET) {
+        member[operand(1)].offset = operand(3);
+      } else if (operand(2) == DECORATION_MATRIX_STRIDE) {
+        member[operand(1)].matrixStride = operand(3);
+      }
+      break;
+    }
+    case OP_TYPE_BOOL:
+    case OP_TYPE_SAMPLER:
+    case OP_TYPE_ACCELERATION_STRUCTURE:
+      type(operand(0)).op = opcode;
+      break;
+    case OP_TYPE_INT: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.count = operand(1);
+      t.isSigned = operand(2) != 0;
+      break;
+    }
+    case OP_TYPE_FLOAT: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.count = operand(1);
+      break;
+    }
+    case OP_TYPE_VECTOR:
+    case OP_TYPE_MATRIX: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.element = operand(1);
+      t.count = operand(2);
+      break;
+    }
+    case OP_TYPE_IMAGE: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.element = operand(2); // dim
+      t.imageSampled = operand(6);
+      break;
+    }
+    case OP_TYPE_SAMPLED_IMAGE:
+    case OP_TYPE_RUNTIME_ARRAY: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.element = operand(1);
+      break;
+    }
+    case OP_TYPE_ARRAY: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.element = operand(1);
+      // lengths are declared before the array; a specialized length keeps
+      // its default value
+      auto it = constants.find(operand(2));
+      t.count = it != constants.end() ? it->second : 1;
+      break;
+    }
+    case OP_TYPE_STRUCT: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.members.assign(operands + 1, operands + operandCount);
+      break;
+    }
+    case OP_TYPE_POINTER: {
+      Type &t = type(operand(0));
+      t.op = opcode;
+      t.storageClass = operand(1);
+      t.element = operand(2);
+      break;
+    }
+    case OP_CONSTANT:
+    case OP_SPEC_CONSTANT:
+      // only the low word matters for array lengths
+      constants[operand(1)] = operand(2);
+      break;
+    case OP_VARIABLE:
+      if (operand(1) >= decorations.size() ||
+          type(operand(0)).op != OP_TYPE_POINTER) {
+        throw std::runtime_error("malformed SPIR-V variable");
+      }
+      variables.push_back({operand(1), operand(0), operand(2)});
+      break;
+    }
+  }
+
+  // byte size of a type laid out with its Offset/Stride decorations
+  uint32_t sizeOf(uint32_t id, uint32_t matrixStride = 0) {
+    const Type &t = type(id);
+    switch (t.op) {
+    case OP_TYPE_BOOL:
+      return 4;
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+      return t.count / 8;
+    case OP_TYPE_VECTOR:
+      return t.count * sizeOf(t.element);
+    case OP_TYPE_MATRIX:
+      return t.count * (matrixStride != 0 ? matrixStride : sizeOf(t.element));
+    case OP_TYPE_ARRAY: {
+      uint32_t stride = decorations[id].arrayStride;
+      return t.count * (stride != 0 ? stride : sizeOf(t.element));
+    }
+    case OP_TYPE_RUNTIME_ARRAY:
+      return 0;
+    case OP_TYPE_STRUCT: {
+      uint32_t size = 0;
+      const auto &members = memberDecorations[id];
+      for (uint32_t i = 0; i < t.members.size(); i++) {
+        MemberDecorations member =
+            i < members.size() ? members[i] : MemberDecorations{};
+        size = std::max(size, member.offset +
+                                  sizeOf(t.members[i], member.matrixStride));
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("unsupported type in a push constant block");
+    }
+  }
+
+  VkFormat vertexFormat(uint32_t id) {
+    const Type &t = type(id);
+    uint32_t components = 1;
+    const Type *scalar = &t;
+    if (t.op == OP_TYPE_VECTOR) {
+      components = t.count;
+      scalar = &type(t.element);
+    }
+    if (scalar->count != 32 || components < 1 || components > 4) {
+      throw std::runtime_error("unsupported vertex input type");
+    }
+    static constexpr VkFormat FLOAT_FORMATS[4] = {
+        VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static constexpr VkFormat SINT_FORMATS[4] = {
+        VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+        VK_FORMAT_R32G32B32A32_SINT};
+    static constexpr VkFormat UINT_FORMATS[4] = {
+        VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+        VK_FORMAT_R32G32B32A32_UINT};
+    if (scalar->op == OP_TYPE_FLOAT) {
+      return FLOAT_FORMATS[components - 1];
+    }
+    if (scalar->op == OP_TYPE_INT) {
+      return scalar->isSigned ? SINT_FORMATS[components - 1]
+                              : UINT_FORMATS[components - 1];
+    }
+    throw std::runtime_error("unsupported vertex input type");
+  }
+
+  void reflectVariable(const Variable &variable,
+                       LveShaderReflection &reflection) {
+    const Decorations &d = decorations[variable.id];
+    uint32_t pointee = type(variable.type).element;
+
+    if (variable.storageClass == STORAGE_INPUT) {
+      if ((stages & VK_SHADER_STAGE_VERTEX_BIT) == 0 || d.builtIn ||
+          d.location == NONE) {
+        return;
+      }
+      // a matrix input takes one location per column
+      const Type &t = type(pointee);
+      uint32_t columns = t.op == OP_TYPE_MATRIX ? t.count : 1;
+      uint32_t column = t.op == OP_TYPE_MATRIX ? t.element : pointee;
+      for (uint32_t i = 0; i < columns; i++) {
+        reflection.vertexInputs.push_back(
+            {d.location + i, vertexFormat(column)});
+      }
+      return;
+    }
+
+    if (variable.storageClass == STORAGE_PUSH_CONSTANT) {
+      reflection.pushConstantSize =
+          std::max(reflection.pushConstantSize, sizeOf(pointee));
+      reflection.pushConstantStages |= stages;
+      return;
+    }
+
+    if (variable.storageClass != STORAGE_UNIFORM_CONSTANT &&
+        variable.storageClass != STORAGE_UNIFORM &&
+        variable.storageClass != STORAGE_STORAGE_BUFFER) {
+      return;
+    }
+    if (d.set == NONE || d.binding == NONE) {
+      return;
+    }
+
+    LveShaderReflection::DescriptorBinding binding{};
+    binding.set = d.set;
+    binding.binding = d.binding;
+    binding.count = 1;
+    binding.stages = stages;
+    uint32_t element = pointee;
+    if (type(element).op == OP_TYPE_ARRAY) {
+      binding.count = type(element).count;
+      element = type(element).element;
+    } else if (type(element).op == OP_TYPE_RUNTIME_ARRAY) {
+      binding.count = 0;
+      element = type(element).element;
+    }
+
+    const Type &t = type(element);
+    if (variable.storageClass == STORAGE_STORAGE_BUFFER) {
+      binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    } else if (variable.storageClass == STORAGE_UNIFORM) {
+      binding.type = decorations[element].bufferBlock
+                         ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                         : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    } else if (t.op == OP_TYPE_SAMPLER) {
+      binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    } else if (t.op == OP_TYPE_SAMPLED_IMAGE) {
+      binding.type = type(t.element).element == DIM_BUFFER
+                         ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                         : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    } else if (t.op == OP_TYPE_IMAGE) {
+      bool storage = t.imageSampled == IMAGE_SAMPLED_STORAGE;
+      if (t.element == DIM_SUBPASS_DATA) {
+        binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      } else if (t.element == DIM_BUFFER) {
+        binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                               : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      } else {
+        binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                               : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+      }
+    } else if (t.op == OP_TYPE_ACCELERATION_STRUCTURE) {
+      binding.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    } else {
+      throw std::runtime_error("unsupported descriptor type at set " +
+                               std::to_string(d.set) + " binding " +
+                               std::to_string(d.binding));
+    }
+    reflection.bindings.push_back(binding);
+  }
+
+  const uint32_t *words;
+  size_t size; // in words
+  std::vector<Type> types;
+  std::vector<Decorations> decorations;
+  std::unordered_map<uint32_t, std::vector<MemberDecorations>>
+      memberDecorations;
+  std::unordered_map<uint32_t, uint32_t> constants;
+  std::vector<Variable> variables;
+  VkShaderStageFlags stages = 0;
+};
+} // namespace
+
+LveShaderReflection LveShaderReflection::reflect(const uint32_t *code,
+                                                 size_t codeSize) {
+  return Parser{code, codeSize}.parse();
+}
+
+LveShaderReflection
+LveShaderReflection::reflect(const std::vector<char> &code) {
+  // a vector<char> makes no alignment promise for word reads
+  LveMappedFile words = LveMappedFile::fromBytes(code.data(), code.size());
+  return reflect(words.words(), words.size());
+}
+
+LveShaderReflection
+LveShaderReflection::reflectFiles(const std::vector<std::string> &filepaths) {
+  LveShaderReflection reflection{};
+  for (const auto &filepath : filepaths) {
+    if (!filepath.empty()) {
+      LveMappedFile code = LveArchive::openFile(filepath);
+      reflection.merge(reflect(code.words(), code.size()));
+    }
+  }
+  return reflection;
+}
+
+void LveShaderReflection::merge(const LveShaderReflection &other) {
+  stages |= other.stages;
+  for (const auto &binding : other.bindings) {
+    auto it = std::find_if(bindings.begin(), bindings.end(),
+                           [&](const DescriptorBinding &existing) {
+                             return existing.set == binding.set &&
+                                    existing.binding == binding.binding;
+                           });
+    if (it == bindings.end()) {
+      bindings.push_back(binding);
+      continue;
+    }
+    if (it->type != binding.type || it->count != binding.count) {
+      throw std::runtime_error(
+          "shader stages disagree on the descriptor at set " +
+          std::to_string(binding.set) + " binding " +
+          std::to_string(binding.binding));
+    }
+    it->stages |= binding.stages;
+  }
+  std::sort(bindings.begin(), bindings.end(),
+            [](const DescriptorBinding &a, const DescriptorBinding &b) {
+              return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+            });
+
+  pushConstantSize = std::max(pushConstantSize, other.pushConstantSize);
+  pushConstantStages |= other.pushConstantStages;
+  if (!other.vertexInputs.empty()) {
+    vertexInputs = other.vertexInputs;
+  }
+}
+
+void LveShaderReflection::useDynamicUniformBuffers() {
+  for (auto &binding : bindings) {
+    if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+      binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    }
+  }
+}
+
+uint32_t LveShaderReflection::setCount() const {
+  return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+std::vector<VkDescriptorSetLayoutBinding>
+LveShaderReflection::setLayoutBindings(uint32_t set) const {
+  std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+  for (const auto &binding : bindings) {
+    if (binding.set != set) {
+      continue;
+    }
+    if (binding.count == 0) {
+      throw std::runtime_error(
+          "runtime-sized descriptor array at set " + std::to_string(set) +
+          " binding " + std::to_string(binding.binding) +
+          " needs a layout from its owner");
+    }
+    VkDescriptorSetLayoutBinding layoutBinding{};
+    layoutBinding.binding = binding.binding;
+    layoutBinding.descriptorType = binding.type;
+    layoutBinding.descriptorCount = binding.count;
+    layoutBinding.stageFlags = binding.stages;
+    layoutBindings.push_back(layoutBinding);
+  }
+  return layoutBindings;
+}
+
+std::vector<VkPushConstantRange>
+LveShaderReflection::pushConstantRanges() const {
+  if (pushConstantSize == 0) {
+    return {};
+  }
+  VkPushConstantRange range{};
+  range.stageFlags = pushConstantStages;
+  range.offset = 0;
+  range.size = pushConstantSize;
+  return {range};
+}
+
+} // namespace lve
@@ -0,0 +1,342 @@
+#include "../include/lve_shadow_cascades.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+// Light space: the light looks along +z from the world origin, so moving
+// the camera never moves the texel grid
+glm::mat4 lightViewMatrix(const glm::vec3 &lightDirection) {
+  const glm::vec3 up = std::abs(lightDirection.y) > .99f
+                           ? glm::vec3{0.f, 0.f, 1.f}
+                           : glm::vec3{0.f, -1.f, 0.f};
+  LveCamera light{};
+  light.setViewDirection(glm::vec3{0.f}, lightDirection, up);
+  return light.getViewMatrix();
+}
+
+// Light space depth of the bounds' corner nearest the light
+float nearestDepth(const LveAabb &bounds, const glm::mat4 &lightView) {
+  if (bounds.isEmpty()) {
+    return std::numeric_limits<float>::max();
+  }
+  float nearest = std::numeric_limits<float>::max();
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec3 point{(corner & 1) ? bounds.max.x : bounds.min.x,
+                    (corner & 2) ? bounds.max.y : bounds.min.y,
+                    (corner & 4) ? bounds.max.z : bounds.min.z};
+    nearest = std::min(nearest, (lightView * glm::vec4(point, 1.f)).z);
+  }
+  return nearest;
+}
+} // namespace
+
+LveShadowCascades::LveShadowCascades(LveDevice &device, const Config &config)
+    : lveDevice{device}, config{config} {
+  for (uint32_t i = FIRST_CACHED_CASCADE; i < CASCADE_COUNT; i++) {
+    cascades[i].cached = true;
+  }
+  createImages();
+  createSampler();
+}
+
+LveShadowCascades::~LveShadowCascades() {
+  vkDestroySampler(lveDevice.device(), sampler, nullptr);
+  for (auto *images : {&maps, &caches}) {
+    for (DepthImage &image : *images) {
+      if (image.image == VK_NULL_HANDLE) {
+        continue;
+      }
+      vkDestroyImageView(lveDevice.device(), image.view, nullptr);
+      vkDestroyImage(lveDevice.device(), image.image, nullptr);
+      lveDevice.freeMemory(image.memory);
+    }
+  }
+}
+
+void LveShadowCascades::createImages() {
+  format = lveDevice.findSupportedFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++) {
+    maps[i] = createDepthImage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT |
+                               VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    if (cascades[i].cached) {
+      caches[i] =
+          createDepthImage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    }
+  }
+
+  // The render graph imports them in the layouts frames leave them in, so
+  // they start there. Nothing reads a map before its cascade is rendered.
+  std::vector<VkImageMemoryBarrier> barriers;
+  for (auto *images : {&maps, &caches}) {
+    for (const DepthImage &image : *images) {
+      if (image.image == VK_NULL_HANDLE) {
+        continue;
+      }
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = images == &maps
+                              ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                              : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image.image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+      barriers.push_back(barrier);
+    }
+  }
+  VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+  lveDevice.endSingleTimeCommands(commandBuffer);
+}
+
+LveShadowCascades::DepthImage
+LveShadowCascades::createDepthImage(VkImageUsageFlags usage) const {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = RESOLUTION;
+  imageInfo.extent.height = RESOLUTION;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  DepthImage image{};
+  lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                image.image, image.memory,
+                                MemoryCategory::RenderTarget);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &image.view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow map image view!");
+  }
+  return image;
+}
+
+void LveShadowCascades::createSampler() {
+  // with linear filtering the comparison results of the four nearest texels
+  // are blended, which smooths the edges of each PCF tap
+  bool linear = true;
+  try {
+    lveDevice.findSupportedFormat(
+        {format}, VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+  } catch (const std::runtime_error &) {
+    linear = false;
+  }
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+  samplerInfo.minFilter = samplerInfo.magFilter;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerInfo.compareEnable = VK_TRUE;
+  samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  samplerInfo.maxLod = 0.0f;
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow map sampler!");
+  }
+}
+
+void LveShadowCascades::update(const LveCamera &camera,
+                               const glm::vec3 &direction,
+                               const LveBvh &sceneBvh,
+                               const LveGameObject::Map &gameObjects) {
+  const glm::mat4 &projection = camera.getProjectionMatrix();
+  assert(projection[2][3] == 1.f && projection[3][3] == 0.f &&
+         "shadow cascades need a perspective projection");
+  lightDirection = glm::normalize(direction);
+
+  // setPerspectiveProjection's depth terms give back its planes
+  const float nearPlane = -projection[3][2] / projection[2][2];
+  const float farPlane = projection[3][2] / (1.f - projection[2][2]);
+  const float shadowFar = std::min(farPlane, config.shadowDistance);
+  // a slice's far corners are k times its depth off the view axis
+  const float k = std::sqrt(1.f / (projection[0][0] * projection[0][0]) +
+                            1.f / (projection[1][1] * projection[1][1]));
+
+  const glm::mat4 lightView = lightViewMatrix(lightDirection);
+  const LveAabb sceneBounds = sceneBvh.getBounds();
+  const float sceneNear = nearestDepth(sceneBounds, lightView);
+  const float cosThreshold = std::cos(config.lightAngleThreshold);
+
+  const uint32_t totalCacheUpdates = stats.totalCacheUpdates;
+  stats = {};
+  stats.totalCacheUpdates = totalCacheUpdates;
+
+  float sliceNear = nearPlane;
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++) {
+    Cascade &cascade = cascades[i];
+    const float t = static_cast<float>(i + 1) / CASCADE_COUNT;
+    const float uniformSplit = nearPlane + (shadowFar - nearPlane) * t;
+    const float logSplit = nearPlane * std::pow(shadowFar / nearPlane, t);
+    const float sliceFar = config.splitLambda * logSplit +
+                           (1.f - config.splitLambda) * uniformSplit;
+
+    // The smallest sphere through the slice's corners sits on the view
+    // axis, or at its far cap when the slice is wide
+    const float center = std::min(
+        (sliceNear + sliceFar) * (1.f + k * k) * .5f, sliceFar);
+    const float nearCorner = (center - sliceNear) * (center - sliceNear) +
+                             k * k * sliceNear * sliceNear;
+    const float farCorner = (sliceFar - center) * (sliceFar - center) +
+                            k * k * sliceFar * sliceFar;
+    const float radius = std::sqrt(std::max(nearCorner, farCorner));
+    const glm::vec3 worldCenter = glm::vec3(
+        camera.getInverseViewMatrix() * glm::vec4(0.f, 0.f, center, 1.f));
+
+    glm::mat4 cascadeView = lightView;
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    if (!cascade.cached) {
+      fitBox(glm::vec3(lightView * glm::vec4(worldCenter, 1.f)), radius,
+             sceneNear, boxMin, boxMax);
+    } else {
+      CacheFit &fit = fits[i];
+      bool refit = !fit.valid ||
+                   glm::dot(fit.lightDirection, lightDirection) < cosThreshold;
+      if (!refit) {
+        // kept while the sphere, and the scene towards the light, fit
+        const glm::vec3 lightCenter =
+            glm::vec3(fit.lightView * glm::vec4(worldCenter, 1.f));
+        const float near =
+            std::min(nearestDepth(sceneBounds, fit.lightView),
+                     lightCenter.z - radius);
+        refit = glm::any(glm::lessThan(glm::vec2(lightCenter) - radius,
+                                       glm::vec2(fit.boxMin))) ||
+                glm::any(glm::greaterThan(glm::vec2(lightCenter) + radius,
+                                          glm::vec2(fit.boxMax))) ||
+                near < fit.boxMin.z || lightCenter.z + radius > fit.boxMax.z;
+      }
+      if (refit) {
+        const float margin = radius * config.cacheMargin;
+        fit.lightView = lightView;
+        fit.lightDirection = lightDirection;
+        fitBox(glm::vec3(lightView * glm::vec4(worldCenter, 1.f)),
+               radius + margin, sceneNear - margin, fit.boxMin, fit.boxMax);
+        fit.valid = true;
+        fit.dirty = true;
+      }
+      cascadeView = fit.lightView;
+      boxMin = fit.boxMin;
+      boxMax = fit.boxMax;
+    }
+    cascade.lightProjectionView = lightProjection(boxMin, boxMax) * cascadeView;
+
+    query.clear();
+    sceneBvh.queryFrustum(LveFrustum::fromMatrix(cascade.lightProjectionView),
+                          query);
+    cascade.casters.clear();
+    cascade.cacheCasters.clear();
+    if (!cascade.cached) {
+      cascade.casters = query;
+      stats.casterDraws += static_cast<uint32_t>(cascade.casters.size());
+    } else {
+      CacheFit &fit = fits[i];
+      for (LveGameObject::id_t id : query) {
+        if (!gameObjects.at(id).isStatic) {
+          cascade.casters.push_back(id);
+        } else if (fit.dirty) {
+          cascade.cacheCasters.push_back(id);
+        }
+      }
+      // the map is the cache plus this frame's casters; it only needs
+      // the copy when either changed
+      cascade.renderCache = fit.dirty;
+      cascade.drawCasters = !cascade.casters.empty();
+      cascade.copyCache = fit.dirty || fit.mapHasCasters;
+      fit.mapHasCasters = cascade.drawCasters;
+      fit.dirty = false;
+      if (cascade.renderCache) {
+        stats.cacheUpdates++;
+        stats.casterDraws += static_cast<uint32_t>(cascade.cacheCasters.size());
+      }
+      stats.casterDraws += static_cast<uint32_t>(cascade.casters.size());
+    }
+
+    params.lightProjectionViews[i] = cascade.lightProjectionView;
+    params.splitDepths[i] = sliceFar;
+    params.texelSizes[i] = (boxMax.x - boxMin.x) / RESOLUTION;
+    sliceNear = sliceFar;
+  }
+  stats.totalCacheUpdates += stats.cacheUpdates;
+}
+
+void LveShadowCascades::fitBox(const glm::vec3 &center, float radius,
+                               float sceneNear, glm::vec3 &boxMin,
+                               glm::vec3 &boxMax) const {
+  // Snapping moves the centre by up to half a texel, so the box reaches a
+  // texel past the sphere on each side
+  const float halfSize = radius * RESOLUTION / (RESOLUTION - 2);
+  const float texel = 2.f * halfSize / RESOLUTION;
+  const glm::vec2 snapped = glm::floor(glm::vec2(center) / texel + .5f) * texel;
+  const float near = std::min(sceneNear, center.z - radius);
+  boxMin = glm::vec3(snapped - halfSize, near);
+  boxMax = glm::vec3(snapped + halfSize, center.z + radius);
+}
+
+glm::mat4 LveShadowCascades::lightProjection(const glm::vec3 &boxMin,
+                                             const glm::vec3 &boxMax) const {
+  LveCamera light{};
+  light.setOrthographicProjection(boxMin.x, boxMax.x, boxMin.y, boxMax.y,
+                                  boxMin.z, boxMax.z);
+  return light.getProjectionMatrix();
+}
+
+void LveShadowCascades::invalidate(uint32_t cascade) {
+  assert(cascade < CASCADE_COUNT && "shadow cascade out of range");
+  fits[cascade].dirty = true;
+}
+
+void LveShadowCascades::invalidateCache() {
+  for (CacheFit &fit : fits) {
+    fit.dirty = true;
+  }
+}
+
+void LveShadowCascades::recordCacheCopy(VkCommandBuffer commandBuffer,
+                                        uint32_t cascade) const {
+  assert(cascades[cascade].cached && "shadow cascade has no cache");
+  VkImageCopy region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+  region.extent = {RESOLUTION, RESOLUTION, 1};
+  vkCmdCopyImage(commandBuffer, caches[cascade].image,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, maps[cascade].image,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+} // namespace lve
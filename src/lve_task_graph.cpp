@@ -0,0 +1,179 @@
+#include "../include/lve_task_graph.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+namespace lve {
+
+LveTaskGraph::TaskId LveTaskGraph::add(std::string name,
+                                       std::function<void()> work,
+                                       std::vector<TaskId> dependencies,
+                                       Affinity affinity) {
+  assert(!hasRun && "tasks cannot be added once the graph has run");
+  TaskId id = static_cast<TaskId>(tasks.size());
+  Task task{};
+  task.work = std::move(work);
+  task.affinity = affinity;
+  for (TaskId dependency : dependencies) {
+    assert(dependency < id && "a task can only depend on earlier tasks");
+    tasks[dependency].dependents.push_back(id);
+    task.dependencyCount++;
+  }
+  tasks.push_back(std::move(task));
+  taskDependencies.push_back(std::move(dependencies));
+  timings.push_back({std::move(name), affinity, false, 0.0, 0.0});
+  return id;
+}
+
+void LveTaskGraph::run(LveThreadPool &pool) {
+  assert(!hasRun && "a task graph runs once");
+  hasRun = true;
+  const auto start = std::chrono::steady_clock::now();
+  auto now = [&] {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<TaskId> mainReady;
+  std::vector<uint32_t> waitingOn(tasks.size());
+  // a dependency failed or was skipped
+  std::vector<bool> skipped(tasks.size(), false);
+  size_t finished = 0;
+  std::exception_ptr firstError;
+
+  // no lock held; each timing is only written by the thread running it
+  auto runTask = [&](TaskId id) {
+    Timing &timing = timings[id];
+    timing.ran = true;
+    timing.startMilliseconds = now();
+    bool succeeded = true;
+    try {
+      tasks[id].work();
+    } catch (...) {
+      succeeded = false;
+      std::lock_guard<std::mutex> lock{mutex};
+      if (!firstError) {
+        firstError = std::current_exception();
+      }
+    }
+    timing.endMilliseconds = now();
+    return succeeded;
+  };
+
+  // the rest run with the lock held
+  std::function<void(TaskId)> schedule;
+  auto finish = [&](TaskId id, bool succeeded) {
+    finished++;
+    for (TaskId dependent : tasks[id].dependents) {
+      if (!succeeded) {
+        skipped[dependent] = true;
+      }
+      if (--waitingOn[dependent] == 0) {
+        schedule(dependent);
+      }
+    }
+    changed.notify_all();
+  };
+  schedule = [&](TaskId id) {
+    if (skipped[id]) {
+      finish(id, false);
+    } else if (tasks[id].affinity == Affinity::Main) {
+      mainReady.push_back(id);
+    } else {
+      pool.submit([&, id] {
+        bool succeeded = runTask(id);
+        std::lock_guard<std::mutex> lock{mutex};
+        finish(id, succeeded);
+      });
+    }
+  };
+
+  std::unique_lock<std::mutex> lock{mutex};
+  for (TaskId id = 0; id < tasks.size(); id++) {
+    waitingOn[id] = tasks[id].dependencyCount;
+  }
+  for (TaskId id = 0; id < tasks.size(); id++) {
+    if (waitingOn[id] == 0) {
+      schedule(id);
+    }
+  }
+  while (finished < tasks.size()) {
+    if (mainReady.empty()) {
+      changed.wait(lock);
+      continue;
+    }
+    TaskId id = mainReady.front();
+    mainReady.pop_front();
+    lock.unlock();
+    bool succeeded = runTask(id);
+    lock.lock();
+    finish(id, succeeded);
+  }
+  milliseconds = now();
+
+  if (firstError) {
+    std::rethrow_exception(firstError);
+  }
+}
+
+void LveTaskGraph::report() const {
+  // longest chain ending at each task; dependencies always come first
+  std::vector<double> chain(tasks.size(), 0.0);
+  std::vector<TaskId> previous(tasks.size(), ~0u);
+  double workMilliseconds = 0.0;
+  TaskId last = ~0u;
+  for (TaskId id = 0; id < tasks.size(); id++) {
+    for (TaskId dependency : taskDependencies[id]) {
+      if (chain[dependency] > chain[id]) {
+        chain[id] = chain[dependency];
+        previous[id] = dependency;
+      }
+    }
+    double duration =
+        timings[id].endMilliseconds - timings[id].startMilliseconds;
+    chain[id] += duration;
+    workMilliseconds += duration;
+    if (last == ~0u || chain[id] > chain[last]) {
+      last = id;
+    }
+  }
+
+  std::ios flags{nullptr};
+  flags.copyfmt(std::cout);
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "startup: " << tasks.size() << " tasks, " << workMilliseconds
+            << " ms of work in " << milliseconds << " ms" << std::endl;
+  for (const Timing &timing : timings) {
+    std::cout << "  " << std::setw(8) << timing.startMilliseconds << " -"
+              << std::setw(8) << timing.endMilliseconds << " ms  "
+              << timing.name
+              << (timing.affinity == Affinity::Main ? " (main thread)" : "")
+              << (timing.ran ? "" : " (skipped)") << std::endl;
+  }
+  if (last != ~0u) {
+    std::vector<TaskId> path;
+    for (TaskId id = last; id != ~0u; id = previous[id]) {
+      path.push_back(id);
+    }
+    std::cout << "  critical path (" << chain[last] << " ms):";
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      std::cout << (it == path.rbegin() ? " " : " -> ")
+                << timings[*it].name;
+    }
+    std::cout << std::endl;
+  }
+  std::cout.copyfmt(flags);
+}
+
+} // namespace lve
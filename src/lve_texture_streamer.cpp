@@ -0,0 +1,865 @@
+#include "../include/lve_texture_streamer.hpp"
+
+#include "../include/lve_archive.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace lve {
+
+namespace {
+constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+constexpr VkDeviceSize BYTES_PER_TEXEL = 4;
+
+bool isRgba8(VkFormat format) {
+  return format == VK_FORMAT_R8G8B8A8_SRGB ||
+         format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+// bytes of a full mip chain starting at width x height
+VkDeviceSize chainBytes(uint32_t width, uint32_t height) {
+  VkDeviceSize bytes = 0;
+  for (;;) {
+    bytes += static_cast<VkDeviceSize>(width) * height * BYTES_PER_TEXEL;
+    if (width == 1 && height == 1) {
+      return bytes;
+    }
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+}
+} // namespace
+
+LveTextureStreamer::LveTextureStreamer(LveDevice &device, const Config &config,
+                                       LveBindlessTable *bindlessTable)
+    : lveDevice{device}, config{config}, bindlessTable{bindlessTable},
+      staging{device, config.stagingBytesPerFrame,
+              VK_BUFFER_USAGE_TRANSFER_SRC_BIT} {
+  auto supports = [&](VkFormat format, VkFormatFeatureFlags features) {
+    try {
+      lveDevice.findSupportedFormat({format}, VK_IMAGE_TILING_OPTIMAL,
+                                    features);
+      return true;
+    } catch (const std::runtime_error &) {
+      return false;
+    }
+  };
+
+  // blits need linear filtering and blit support on the texture formats;
+  // UNORM is what linear BC data transcodes to
+  const VkFormatFeatureFlags blitFeatures =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  gpuMipGeneration = supports(TEXTURE_FORMAT, blitFeatures) &&
+                     supports(VK_FORMAT_R8G8B8A8_UNORM, blitFeatures);
+
+  if (lveDevice.enabledFeatures.textureCompressionBC) {
+    for (VkFormat format :
+         {VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+          VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+          VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC2_SRGB_BLOCK,
+          VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK,
+          VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK,
+          VK_FORMAT_BC6H_UFLOAT_BLOCK, VK_FORMAT_BC6H_SFLOAT_BLOCK,
+          VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK}) {
+      if (supports(format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                               VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+        nativeBlockFormats.push_back(format);
+      }
+    }
+  }
+
+  createSampler();
+  createFallbackTexture();
+  if (lveDevice.hasDedicatedTransferQueue()) {
+    createTransferCommands();
+  }
+  workers = std::make_unique<LveThreadPool>(config.workerThreads);
+  if (config.prefetchFiles) {
+    prefetcher = std::make_unique<LveFilePrefetcher>();
+  }
+  pressureCallback = lveDevice.addMemoryPressureCallback(
+      [this](const LveDevice::MemoryPressure &pressure) -> VkDeviceSize {
+        // failed allocations on other threads, e.g. meshes built during
+        // startup, must not touch the streamer's state
+        if (!pressure.deviceLocal ||
+            std::this_thread::get_id() != renderThread) {
+          return 0;
+        }
+        uint64_t evictedBefore = evictions;
+        VkDeviceSize freed = evictLeastRecent(pressure.bytesToFree, uploading);
+        pressureEvictions += evictions - evictedBefore;
+        if (pressure.allocationFailed && freed > 0) {
+          // the allocation is retried as soon as this returns, so the
+          // evicted images cannot wait for their frame's fence. Nothing
+          // recorded this frame samples them, since they were idle.
+          vkDeviceWaitIdle(lveDevice.device());
+          for (auto &frame : retired) {
+            destroyRetired(frame);
+          }
+        }
+        return freed;
+      });
+}
+
+LveTextureStreamer::~LveTextureStreamer() {
+  lveDevice.removeMemoryPressureCallback(pressureCallback);
+  shuttingDown = true;
+  workers.reset();
+
+  for (auto &texture : textures) {
+    if (texture.image != VK_NULL_HANDLE) {
+      retire(texture);
+    }
+  }
+  for (auto &frame : retired) {
+    destroyRetired(frame);
+  }
+  if (bindlessTable != nullptr) {
+    bindlessTable->releaseImage(fallbackBindlessIndex);
+  }
+  vkDestroyImageView(lveDevice.device(), fallbackView, nullptr);
+  vkDestroyImage(lveDevice.device(), fallbackImage, nullptr);
+  lveDevice.freeMemory(fallbackMemory);
+  vkDestroySampler(lveDevice.device(), sampler, nullptr);
+  if (transferQueueUploads) {
+    vkFreeCommandBuffers(lveDevice.device(),
+                         lveDevice.getTransferCommandPool(),
+                         static_cast<uint32_t>(transferCommandBuffers.size()),
+                         transferCommandBuffers.data());
+    for (VkSemaphore semaphore : transferSemaphores) {
+      vkDestroySemaphore(lveDevice.device(), semaphore, nullptr);
+    }
+  }
+}
+
+void LveTextureStreamer::createTransferCommands() {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = lveDevice.getTransferCommandPool();
+  allocInfo.commandBufferCount =
+      static_cast<uint32_t>(transferCommandBuffers.size());
+  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo,
+                               transferCommandBuffers.data()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate transfer command buffers!");
+  }
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (VkSemaphore &semaphore : transferSemaphores) {
+    if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr,
+                          &semaphore) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create texture upload semaphore!");
+    }
+  }
+  transferQueueUploads = true;
+}
+
+VkCommandBuffer LveTextureStreamer::beginTransferCommands() {
+  // the frame that last submitted these waited for them before its fence
+  // signalled, and beginFrame() runs after that fence
+  VkCommandBuffer commandBuffer = transferCommandBuffers[currentFrame];
+  if (!transferRecording) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin transfer command buffer!");
+    }
+    transferRecording = true;
+  }
+  return commandBuffer;
+}
+
+void LveTextureStreamer::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.anisotropyEnable = VK_TRUE;
+  samplerInfo.maxAnisotropy = lveDevice.properties.limits.maxSamplerAnisotropy;
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture sampler!");
+  }
+}
+
+void LveTextureStreamer::createFallbackTexture() {
+  createImage(TEXTURE_FORMAT, 1, 1, 1, fallbackImage, fallbackMemory,
+              fallbackView);
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+  lveDevice.createBuffer(BYTES_PER_TEXEL, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         stagingBuffer, stagingMemory,
+                         MemoryCategory::Staging);
+  void *data;
+  vkMapMemory(lveDevice.device(), stagingMemory, 0, BYTES_PER_TEXEL, 0, &data);
+  const uint8_t white[BYTES_PER_TEXEL] = {255, 255, 255, 255};
+  std::memcpy(data, white, sizeof(white));
+  vkUnmapMemory(lveDevice.device(), stagingMemory);
+
+  VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = fallbackImage;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {1, 1, 1};
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, fallbackImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  lveDevice.endSingleTimeCommands(commandBuffer);
+
+  vkDestroyBuffer(lveDevice.device(), stagingBuffer, nullptr);
+  lveDevice.freeMemory(stagingMemory);
+
+  if (bindlessTable != nullptr) {
+    fallbackBindlessIndex = bindlessTable->addImage(
+        fallbackView, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+}
+
+void LveTextureStreamer::createImage(VkFormat format, uint32_t width,
+                                     uint32_t height, uint32_t mipLevels,
+                                     VkImage &image, VkDeviceMemory &memory,
+                                     VkImageView &view) {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {width, height, 1};
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                image, memory, MemoryCategory::Texture);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
+  }
+}
+
+LveTextureStreamer::TextureId
+LveTextureStreamer::load(const std::string &filepath) {
+  Texture texture{};
+  texture.filepath = filepath;
+  textures.push_back(std::move(texture));
+  // mounted archives are prefetched as a whole when they are mounted
+  if (prefetcher && !LveArchive::isMountedFile(filepath)) {
+    prefetcher->prefetch(filepath);
+  }
+  return static_cast<TextureId>(textures.size() - 1);
+}
+
+void LveTextureStreamer::markRequested(TextureId id) {
+  Texture &texture = textures[id];
+  if (texture.lastRequestedFrame != frameNumber) {
+    texture.lastRequestedFrame = frameNumber;
+    texture.wantedMip = NOT_RESIDENT;
+    texture.wantedCoverage = 0.f;
+    requested.push_back(id);
+  }
+}
+
+void LveTextureStreamer::request(TextureId id, uint32_t mipLevel) {
+  assert(id < textures.size() && "Unknown texture id");
+  markRequested(id);
+  Texture &texture = textures[id];
+  texture.wantedMip = std::min(texture.wantedMip, mipLevel);
+}
+
+void LveTextureStreamer::requestForBounds(TextureId id,
+                                          const LveAabb &worldBounds,
+                                          const glm::vec3 &cameraPosition,
+                                          float projectionScaleY,
+                                          float viewportHeight) {
+  assert(id < textures.size() && "Unknown texture id");
+  float radius = 0.5f * glm::length(worldBounds.extent());
+  float distance = glm::length(worldBounds.center() - cameraPosition) - radius;
+  // inside the bounds: the object can cover the whole screen
+  float pixels = distance > radius * 1e-3f
+                     ? 2.f * radius / distance * projectionScaleY * 0.5f *
+                           viewportHeight
+                     : viewportHeight;
+
+  Texture &texture = textures[id];
+  if (texture.mipLevels == 0) {
+    // size unknown until the first decode, which picks the mip itself
+    markRequested(id);
+    texture.wantedCoverage = std::max(texture.wantedCoverage, pixels);
+    return;
+  }
+  request(id, mipForCoverage(std::max(texture.width, texture.height), pixels));
+}
+
+uint32_t LveTextureStreamer::mipForCoverage(uint32_t textureSize,
+                                            float screenPixels) {
+  if (screenPixels <= 1.f) {
+    return LveImageLoader::mipLevelCount(textureSize, textureSize) - 1;
+  }
+  float ratio = static_cast<float>(textureSize) / screenPixels;
+  if (ratio <= 1.f) {
+    return 0;
+  }
+  return std::min(static_cast<uint32_t>(std::floor(std::log2(ratio))),
+                  LveImageLoader::mipLevelCount(textureSize, textureSize) - 1);
+}
+
+void LveTextureStreamer::beginFrame(int frameIndex) {
+  destroyRetired(retired[frameIndex]);
+  staging.beginFrame(frameIndex);
+  currentFrame = frameIndex;
+  frameNumber++;
+}
+
+void LveTextureStreamer::update(VkCommandBuffer commandBuffer,
+                                LveRenderer &renderer) {
+  uploadsLastFrame = 0;
+  stagedBytesLastFrame = 0;
+
+  {
+    std::lock_guard<std::mutex> lock{decodedMutex};
+    for (auto &result : decoded) {
+      readyForUpload.push_back(std::move(result));
+    }
+    decoded.clear();
+  }
+
+  // uploads go in completion order until the staging ring is full
+  size_t uploaded = 0;
+  for (; uploaded < readyForUpload.size(); uploaded++) {
+    if (!upload(commandBuffer, readyForUpload[uploaded])) {
+      break;
+    }
+  }
+  readyForUpload.erase(readyForUpload.begin(),
+                       readyForUpload.begin() + uploaded);
+
+  if (transferRecording) {
+    VkCommandBuffer transferCommands = transferCommandBuffers[currentFrame];
+    if (vkEndCommandBuffer(transferCommands) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record transfer command buffer!");
+    }
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &transferCommands;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &transferSemaphores[currentFrame];
+    if (vkQueueSubmit(lveDevice.transferQueue(), 1, &submitInfo,
+                      VK_NULL_HANDLE) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit texture uploads!");
+    }
+    transferRecording = false;
+    // the acquires and mip blits in commandBuffer start at the transfer stage
+    renderer.addWaitSemaphore(transferSemaphores[currentFrame],
+                              VK_PIPELINE_STAGE_TRANSFER_BIT);
+  }
+
+  for (TextureId id : requested) {
+    Texture &texture = textures[id];
+    if (texture.failed || texture.decodeInFlight) {
+      continue;
+    }
+    if (texture.mipLevels == 0) {
+      startDecode(id, texture.wantedMip == NOT_RESIDENT ? 0 : texture.wantedMip,
+                  texture.wantedCoverage);
+      continue;
+    }
+    uint32_t wanted = std::min(texture.wantedMip, texture.mipLevels - 1);
+    if (texture.budgetEpoch == budgetEpoch) {
+      wanted = std::max(wanted, texture.budgetMip);
+    }
+    if (texture.residentMip == NOT_RESIDENT || wanted < texture.residentMip) {
+      startDecode(id, wanted, 0.f);
+    }
+  }
+  requested.clear();
+
+  // the budget may have been lowered or overshot by a texture that had to
+  // go in to be visible at all
+  makeRoom(0, INVALID_TEXTURE);
+}
+
+void LveTextureStreamer::startDecode(TextureId id, uint32_t mip,
+                                     float coveragePixels) {
+  Texture &texture = textures[id];
+  texture.decodeInFlight = true;
+  pendingDecodes++;
+
+  std::string filepath = texture.filepath;
+  bool fullChain = !gpuMipGeneration;
+  workers->submit([this, id, filepath, mip, coveragePixels, fullChain] {
+    if (shuttingDown) {
+      pendingDecodes--;
+      return;
+    }
+    DecodedTexture result{id, 0, 0, mip, TEXTURE_FORMAT, {}, {}};
+    try {
+      if (LveCompressedImage::isCompressedFile(filepath)) {
+        decodeCompressed(filepath, mip, coveragePixels, result);
+      } else {
+        LveImageData image = LveImageLoader::loadRgba8(filepath);
+        result.baseWidth = image.width;
+        result.baseHeight = image.height;
+        uint32_t size = std::max(image.width, image.height);
+        uint32_t mipLevels =
+            LveImageLoader::mipLevelCount(image.width, image.height);
+        result.mip = coveragePixels > 0.f
+                         ? mipForCoverage(size, coveragePixels)
+                         : std::min(mip, mipLevels - 1);
+        for (uint32_t i = 0; i < result.mip; i++) {
+          image = LveImageLoader::downsample(image);
+        }
+        result.levels.push_back(std::move(image));
+      }
+      while (fullChain && isRgba8(result.format) &&
+             (result.levels.back().width > 1 ||
+              result.levels.back().height > 1)) {
+        result.levels.push_back(
+            LveImageLoader::downsample(result.levels.back()));
+      }
+    } catch (const std::exception &e) {
+      result.levels.clear();
+      result.blocks.reset();
+      result.error = e.what();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{decodedMutex};
+      decoded.push_back(std::move(result));
+    }
+    pendingDecodes--;
+  });
+}
+
+void LveTextureStreamer::decodeCompressed(const std::string &filepath,
+                                          uint32_t mip, float coveragePixels,
+                                          DecodedTexture &result) const {
+  LveCompressedImage image = LveCompressedImage::load(filepath);
+  result.baseWidth = image.width;
+  result.baseHeight = image.height;
+  uint32_t size = std::max(image.width, image.height);
+  uint32_t mipLevels = LveImageLoader::mipLevelCount(image.width, image.height);
+  uint32_t fileLevels = static_cast<uint32_t>(image.levels.size());
+  uint32_t wanted = coveragePixels > 0.f ? mipForCoverage(size, coveragePixels)
+                                         : std::min(mip, mipLevels - 1);
+
+  if (std::find(nativeBlockFormats.begin(), nativeBlockFormats.end(),
+                image.format) != nativeBlockFormats.end()) {
+    // copied as stored; mips the file lacks cannot be blitted into a block
+    // format, so the chain ends where the file's does
+    result.mip = std::min(wanted, fileLevels - 1);
+    result.format = image.format;
+    for (uint32_t i = result.mip; i < fileLevels; i++) {
+      LveImageData extent{};
+      extent.width = image.levels[i].width;
+      extent.height = image.levels[i].height;
+      result.levels.push_back(std::move(extent));
+    }
+    // the mapping travels with the result; upload() copies from it
+    result.firstFileLevel = result.mip;
+    result.blocks = std::make_unique<LveCompressedImage>(std::move(image));
+    return;
+  }
+
+  // transcode the closest stored level; the rest of the chain is made like
+  // any RGBA8 image's
+  uint32_t source = std::min(wanted, fileLevels - 1);
+  LveImageData decoded =
+      LveBlockDecoder::decode(image.blockFormat, image.levelData(source),
+                              image.levels[source].width,
+                              image.levels[source].height);
+  for (uint32_t i = source; i < wanted; i++) {
+    decoded = LveImageLoader::downsample(decoded);
+  }
+  result.mip = wanted;
+  result.format =
+      image.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  result.levels.push_back(std::move(decoded));
+}
+
+size_t LveTextureStreamer::DecodedTexture::levelBytes(size_t level) const {
+  return blocks ? blocks->levels[firstFileLevel + level].size
+                : levels[level].sizeBytes();
+}
+
+const void *
+LveTextureStreamer::DecodedTexture::levelData(size_t level) const {
+  return blocks ? blocks->levelData(firstFileLevel + level)
+                : levels[level].pixels.data();
+}
+
+bool LveTextureStreamer::upload(VkCommandBuffer commandBuffer,
+                                DecodedTexture &result) {
+  Texture &texture = textures[result.id];
+  if (!result.error.empty()) {
+    std::cerr << "failed to load texture: " << result.error << std::endl;
+    texture.decodeInFlight = false;
+    texture.failed = true;
+    return true;
+  }
+
+  texture.width = result.baseWidth;
+  texture.height = result.baseHeight;
+  texture.mipLevels =
+      LveImageLoader::mipLevelCount(result.baseWidth, result.baseHeight);
+
+  // a finer image arrived first, or nothing has asked for this one lately
+  bool stale = texture.lastRequestedFrame + config.minIdleFramesBeforeEviction <
+               frameNumber;
+  if ((texture.residentMip != NOT_RESIDENT &&
+       texture.residentMip <= result.mip) ||
+      stale) {
+    texture.decodeInFlight = false;
+    return true;
+  }
+
+  VkDeviceSize stagingBytes = 0;
+  for (size_t i = 0; i < result.levels.size(); i++) {
+    stagingBytes += result.levelBytes(i) + staging.getAlignment();
+  }
+  if (staging.bytesUsed() + stagingBytes > staging.capacity()) {
+    if (staging.bytesUsed() == 0) {
+      // larger than the whole ring: the failed allocation makes it grow
+      // when this frame index is next begun
+      LveRingBuffer::Allocation allocation{};
+      staging.allocate(stagingBytes, allocation);
+    }
+    return false; // try again next frame
+  }
+
+  // RGBA8 images get a full chain; block compressed ones what the file had
+  const LveImageData &top = result.levels.front();
+  uint32_t levelCount = static_cast<uint32_t>(result.levels.size());
+  VkDeviceSize imageBytes = 0;
+  if (isRgba8(result.format)) {
+    levelCount = LveImageLoader::mipLevelCount(top.width, top.height);
+    imageBytes = chainBytes(top.width, top.height);
+  } else {
+    for (size_t i = 0; i < result.levels.size(); i++) {
+      imageBytes += result.levelBytes(i);
+    }
+  }
+  if (!makeRoom(imageBytes, result.id)) {
+    // keep the coarser image until something else is evicted
+    texture.budgetMip = result.mip + 1;
+    texture.budgetEpoch = budgetEpoch;
+    texture.decodeInFlight = false;
+    return true;
+  }
+
+  std::vector<LveRingBuffer::Allocation> allocations(result.levels.size());
+  for (size_t i = 0; i < result.levels.size(); i++) {
+    size_t bytes = result.levelBytes(i);
+    bool staged = staging.allocate(bytes, allocations[i]);
+    assert(staged && "Staging space was checked above");
+    (void)staged;
+    std::memcpy(allocations[i].data, result.levelData(i), bytes);
+    stagedBytesLastFrame += bytes;
+  }
+
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  uploading = result.id;
+  try {
+    createImage(result.format, top.width, top.height, levelCount, image,
+                memory, view);
+  } catch (...) {
+    uploading = INVALID_TEXTURE;
+    throw;
+  }
+  uploading = INVALID_TEXTURE;
+
+  // the copies go to the transfer queue when there is a dedicated one
+  VkCommandBuffer copyCommands =
+      transferQueueUploads ? beginTransferCommands() : commandBuffer;
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(copyCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  for (size_t i = 0; i < result.levels.size(); i++) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = allocations[i].offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT,
+                               static_cast<uint32_t>(i), 0, 1};
+    region.imageExtent = {result.levels[i].width, result.levels[i].height, 1};
+    vkCmdCopyBufferToImage(copyCommands,
+                           staging.getBuffer(currentFrame), image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  }
+  if (transferQueueUploads) {
+    // the graphics queue takes the whole chain over for the blits
+    lveDevice.releaseImageOwnership(
+        copyCommands, image, barrier.subresourceRange,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, lveDevice.transferQueueFamily(),
+        lveDevice.graphicsQueueFamily(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT);
+    lveDevice.acquireImageOwnership(
+        commandBuffer, image, barrier.subresourceRange,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, lveDevice.transferQueueFamily(),
+        lveDevice.graphicsQueueFamily(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+  }
+  recordMipChain(commandBuffer, image, result, levelCount);
+
+  if (texture.image != VK_NULL_HANDLE) {
+    residentBytes -= texture.residentBytes;
+    residentTextures--;
+    retire(texture);
+  }
+  texture.image = image;
+  texture.memory = memory;
+  texture.view = view;
+  texture.residentMip = result.mip;
+  texture.residentBytes = imageBytes;
+  texture.decodeInFlight = false;
+  if (bindlessTable != nullptr) {
+    texture.bindlessIndex = bindlessTable->addImage(
+        view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+  residentBytes += imageBytes;
+  residentTextures++;
+  uploadsLastFrame++;
+  return true;
+}
+
+void LveTextureStreamer::recordMipChain(VkCommandBuffer commandBuffer,
+                                        VkImage image,
+                                        const DecodedTexture &result,
+                                        uint32_t levelCount) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+  // every level was uploaded: one transition for the whole chain
+  uint32_t firstGenerated = static_cast<uint32_t>(result.levels.size());
+  if (firstGenerated >= levelCount) {
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+    return;
+  }
+
+  // each level is blitted from the one above it, which then becomes
+  // readable by shaders
+  int32_t mipWidth = static_cast<int32_t>(result.levels.front().width);
+  int32_t mipHeight = static_cast<int32_t>(result.levels.front().height);
+  for (uint32_t i = 1; i < levelCount; i++) {
+    barrier.subresourceRange.baseMipLevel = i - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    int32_t nextWidth = std::max(1, mipWidth / 2);
+    int32_t nextHeight = std::max(1, mipHeight / 2);
+    VkImageBlit blit{};
+    blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1};
+    blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+    vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                   VK_FILTER_LINEAR);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+
+    mipWidth = nextWidth;
+    mipHeight = nextHeight;
+  }
+
+  barrier.subresourceRange.baseMipLevel = levelCount - 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+bool LveTextureStreamer::makeRoom(VkDeviceSize bytes, TextureId keep) {
+  // the image being replaced is freed along with the upload
+  VkDeviceSize replaced = keep != INVALID_TEXTURE ? textures[keep].residentBytes
+                                                  : 0;
+  auto needed = [&] { return residentBytes - replaced + bytes; };
+  if (needed() > config.budgetBytes) {
+    evictLeastRecent(needed() - config.budgetBytes, keep);
+  }
+  return needed() <= config.budgetBytes;
+}
+
+VkDeviceSize LveTextureStreamer::evictLeastRecent(VkDeviceSize bytes,
+                                                  TextureId keep) {
+  std::vector<TextureId> candidates;
+  for (TextureId id = 0; id < textures.size(); id++) {
+    const Texture &texture = textures[id];
+    if (id != keep && texture.image != VK_NULL_HANDLE &&
+        texture.lastRequestedFrame + config.minIdleFramesBeforeEviction <=
+            frameNumber) {
+      candidates.push_back(id);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [&](TextureId a, TextureId b) {
+              return textures[a].lastRequestedFrame <
+                     textures[b].lastRequestedFrame;
+            });
+
+  VkDeviceSize freed = 0;
+  for (TextureId id : candidates) {
+    if (freed >= bytes) {
+      break;
+    }
+    freed += textures[id].residentBytes;
+    evict(textures[id]);
+  }
+  return freed;
+}
+
+void LveTextureStreamer::evict(Texture &texture) {
+  residentBytes -= texture.residentBytes;
+  residentTextures--;
+  retire(texture);
+  evictions++;
+  // space was freed, so earlier budget clamps no longer hold
+  budgetEpoch++;
+}
+
+void LveTextureStreamer::destroyRetired(std::vector<RetiredImage> &images) {
+  for (auto &image : images) {
+    vkDestroyImageView(lveDevice.device(), image.view, nullptr);
+    vkDestroyImage(lveDevice.device(), image.image, nullptr);
+    lveDevice.freeMemory(image.memory);
+  }
+  images.clear();
+}
+
+void LveTextureStreamer::retire(Texture &texture) {
+  retired[currentFrame].push_back({texture.image, texture.memory, texture.view});
+  if (bindlessTable != nullptr &&
+      texture.bindlessIndex != LveBindlessTable::INVALID_INDEX) {
+    bindlessTable->releaseImage(texture.bindlessIndex);
+  }
+  texture.image = VK_NULL_HANDLE;
+  texture.memory = VK_NULL_HANDLE;
+  texture.view = VK_NULL_HANDLE;
+  texture.residentBytes = 0;
+  texture.residentMip = NOT_RESIDENT;
+  texture.bindlessIndex = LveBindlessTable::INVALID_INDEX;
+}
+
+VkImageView LveTextureStreamer::getImageView(TextureId id) const {
+  if (id >= textures.size() || textures[id].view == VK_NULL_HANDLE) {
+    return fallbackView;
+  }
+  return textures[id].view;
+}
+
+uint32_t LveTextureStreamer::getBindlessIndex(TextureId id) const {
+  if (id >= textures.size() ||
+      textures[id].bindlessIndex == LveBindlessTable::INVALID_INDEX) {
+    return fallbackBindlessIndex;
+  }
+  return textures[id].bindlessIndex;
+}
+
+uint32_t LveTextureStreamer::getResidentMip(TextureId id) const {
+  return id < textures.size() ? textures[id].residentMip : NOT_RESIDENT;
+}
+
+LveTextureStreamer::Stats LveTextureStreamer::getStats() const {
+  Stats stats{};
+  stats.residentBytes = residentBytes;
+  stats.budgetBytes = config.budgetBytes;
+  stats.residentTextures = residentTextures;
+  stats.pendingDecodes = pendingDecodes.load();
+  stats.uploadsLastFrame = uploadsLastFrame;
+  stats.stagedBytesLastFrame = stagedBytesLastFrame;
+  stats.evictions = evictions;
+  stats.pressureEvictions = pressureEvictions;
+  stats.prefetchedBytes = prefetcher ? prefetcher->prefetchedBytes() : 0;
+  stats.transferQueueUploads = transferQueueUploads;
+  return stats;
+}
+
+} // namespace lve
@@ -0,0 +1,75 @@
+#include "../include/lve_thread_pool.hpp"
+
+// std
+#include <algorithm>
+#include <utility>
+
+namespace lve {
+
+LveThreadPool::LveThreadPool(uint32_t threadCount) {
+  if (threadCount == 0) {
+    uint32_t cores = std::thread::hardware_concurrency();
+    threadCount = std::max(1u, cores > 1 ? cores - 1 : 1u);
+  }
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back([this] { workerLoop(); });
+  }
+}
+
+LveThreadPool::~LveThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LveThreadPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    jobs.push_back(std::move(job));
+  }
+  jobAvailable.notify_one();
+}
+
+void LveThreadPool::waitIdle() {
+  std::unique_lock<std::mutex> lock{mutex};
+  idle.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+uint32_t LveThreadPool::pendingJobs() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return static_cast<uint32_t>(jobs.size()) + activeJobs;
+}
+
+void LveThreadPool::workerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+        return; // stopping and drained
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      activeJobs++;
+    }
+
+    job();
+
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      activeJobs--;
+      if (jobs.empty() && activeJobs == 0) {
+        idle.notify_all();
+      }
+    }
+  }
+}
+
+} // namespace lve
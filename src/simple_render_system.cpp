@@ -1,5 +1,6 @@
 #include "../include/simple_render_system.hpp"
 #include "../include/lve_device.hpp"
+#include "../include/lve_shader_reflection.hpp"
 #include "vulkan/vulkan_core.h"
 
 // std
@@ -14,75 +15,501 @@
 
 namespace lve {
 
-struct SimplePushConstantData {
-  glm::mat4 transform{1.f};
-  alignas(16) glm::vec3 color;
+// std140 layouts matching simple_shader.vert; the fragment shader reads all
+// of GlobalUbo
+struct GlobalUbo {
+  glm::mat4 projectionView{1.f};
+  glm::vec4 cameraPosition{};
+  glm::vec4 ambientLight{1.f, 1.f, 1.f, .15f}; // w is intensity
+  // the directional light the shadow cascades are for
+  glm::vec4 lightDirection{};
+  glm::vec4 lightColor{1.f, .95f, .85f, .8f}; // w is intensity
+  LveShadowCascades::ShaderParams shadows{};
+  LveClusteredLights::ShaderParams clusters{};
 };
 
-SimpleRenderSystem::SimpleRenderSystem(LveDevice &device,
-                                       VkRenderPass renderPass)
-    : lveDevice(device) {
-  createPipelineLayout();
-  createPipeline(renderPass);
+struct ObjectUbo {
+  glm::mat4 modelMatrix{1.f};
+  glm::vec4 color{};
+};
+
+// matches simple_shader_bindless.vert
+struct BindlessPush {
+  uint32_t objectBuffer;
+  uint32_t objectOffset; // in vec4s
+};
+
+// GLSL sources; pipelines load the .spv the Makefile builds next to them
+constexpr const char *VERTEX_SHADER = "shaders/simple_shader.vert";
+constexpr const char *BINDLESS_VERTEX_SHADER =
+    "shaders/simple_shader_bindless.vert";
+constexpr const char *FRAGMENT_SHADER = "shaders/simple_shader.frag";
+constexpr uint32_t VIEW_MODE_CONSTANT_ID = 0;
+// GRID_X, GRID_Y and GRID_Z follow
+constexpr uint32_t CLUSTER_GRID_CONSTANT_ID = 1;
+
+SimpleRenderSystem::SimpleRenderSystem(
+    LveDevice &device, const PipelineRenderTarget &target,
+    LveRingBuffer &uniformRing, LveClusteredLights &clusteredLights,
+    LveShadowCascades &shadowCascades, const PipelineRenderTarget &shadowTarget,
+    LvePipelineLayoutCache &layoutCache,
+    const PipelineRenderTarget &depthPrepassTarget,
+    LveBindlessTable *bindlessTable, LveShaderHotReload *hotReload,
+    LvePipelineLibrary *pipelineLibrary)
+    : lveDevice(device), uniformRing(uniformRing),
+      clusteredLights(clusteredLights), shadowCascades(shadowCascades),
+      bindlessTable(bindlessTable), depthPrepass(!depthPrepassTarget.empty()),
+      hotReload(hotReload), pipelineLibrary(pipelineLibrary) {
+  ringIndices.fill(LveBindlessTable::INVALID_INDEX);
+  createPipelineLayout(layoutCache);
+  createPipeline(target, depthPrepassTarget, shadowTarget);
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
-  vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+  for (auto watch : hotReloadWatches) {
+    hotReload->unwatch(watch);
+  }
+  // queued variants are built against this system's render target, which
+  // its owner may destroy next
+  if (pipelineLibrary != nullptr) {
+    pipelineLibrary->waitIdle();
+  }
+  if (bindlessTable != nullptr) {
+    for (uint32_t index : ringIndices) {
+      if (index != LveBindlessTable::INVALID_INDEX) {
+        bindlessTable->releaseStorageBuffer(index);
+      }
+    }
+  }
+}
+
+void SimpleRenderSystem::prepareDescriptorSets(FrameInfo &frameInfo) {
+  if (!descriptorSetsReady) {
+    allocateDescriptorSets(frameInfo);
+    descriptorSetsReady = true;
+  }
+}
+
+void SimpleRenderSystem::allocateDescriptorSets(FrameInfo &frameInfo) {
+  // transient sets: the frame's pools are reset once its fence signals, so
+  // a ring buffer that grew is picked up without tracking generations (the
+  // bindless table is persistent and does track them)
+  VkBuffer ringBuffer = uniformRing.getBuffer(frameInfo.frameIndex);
+  globalSet = frameInfo.frameDescriptors.allocate(globalSetLayout);
+  // the lights are in their own ring, rewritten every frame
+  LveDescriptorWriter writer{};
+  writer
+      .writeBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                   {ringBuffer, 0, sizeof(GlobalUbo)})
+      .writeBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   clusteredLights.getLightBuffer())
+      .writeBuffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   clusteredLights.getClusterBuffer())
+      .writeBuffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   clusteredLights.getIndexBuffer());
+  // the render graph leaves the maps in this layout for the main pass; the
+  // shadow passes bind the set too, but their pipeline has no fragment
+  // shader to read them
+  for (uint32_t i = 0; i < LveShadowCascades::CASCADE_COUNT; i++) {
+    writer.writeImage(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      {shadowCascades.getSampler(),
+                       shadowCascades.getImageView(i),
+                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL},
+                      i);
+  }
+  writer.update(lveDevice, globalSet);
+
+  if (bindlessTable != nullptr) {
+    updateBindlessRing(frameInfo.frameIndex);
+    return;
+  }
+
+  objectSet = frameInfo.frameDescriptors.allocate(objectSetLayout);
+  LveDescriptorWriter{}
+      .writeBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                   {ringBuffer, 0, sizeof(ObjectUbo)})
+      .update(lveDevice, objectSet);
+}
+
+void SimpleRenderSystem::updateBindlessRing(int frameIndex) {
+  uint32_t &index = ringIndices[frameIndex];
+  uint32_t generation = uniformRing.getGeneration(frameIndex);
+  if (index != LveBindlessTable::INVALID_INDEX &&
+      ringGenerations[frameIndex] == generation) {
+    return;
+  }
+  if (index != LveBindlessTable::INVALID_INDEX) {
+    bindlessTable->releaseStorageBuffer(index);
+  }
+  index = bindlessTable->addStorageBuffer(uniformRing.getBuffer(frameIndex));
+  ringGenerations[frameIndex] = generation;
 }
 
-void SimpleRenderSystem::createPipelineLayout() {
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags =
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(SimplePushConstantData);
+void SimpleRenderSystem::createPipelineLayout(
+    LvePipelineLayoutCache &layoutCache) {
+  // the layout follows what the shaders declare rather than a copy of it
+  LveShaderReflection reflection = LveShaderReflection::reflectFiles(
+      {vertexShaderSource() + ".spv", std::string(FRAGMENT_SHADER) + ".spv"});
+  reflection.useDynamicUniformBuffers();
 
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pSetLayouts = nullptr;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-  if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr,
-                             &pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create pipeline layout!");
+  // identical interfaces, so the cache hands back the same layout for both
+  auto &setLayoutCache = layoutCache.getSetLayoutCache();
+  globalSetLayout = setLayoutCache.getLayout(reflection.setLayoutBindings(0));
+  if (bindlessTable != nullptr) {
+    // the table's layout carries binding flags the shader cannot express
+    objectSetLayout = bindlessTable->getSetLayout();
+    assert(reflection.pushConstantSize == sizeof(BindlessPush) &&
+           "BindlessPush does not match simple_shader_bindless.vert");
+  } else {
+    objectSetLayout =
+        setLayoutCache.getLayout(reflection.setLayoutBindings(1));
   }
+
+  pipelineLayout = layoutCache.getLayout({globalSetLayout, objectSetLayout},
+                                         reflection.pushConstantRanges());
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+void SimpleRenderSystem::createPipeline(
+    const PipelineRenderTarget &target,
+    const PipelineRenderTarget &depthTarget,
+    const PipelineRenderTarget &shadowTarget) {
   assert(pipelineLayout != nullptr &&
          "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
-  LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-  pipelineConfig.renderPass = renderPass;
-  pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(
-      lveDevice, "shaders/simple_shader.vert.spv",
-      "shaders/simple_shader.frag.spv", pipelineConfig);
+  mainPipelineConfigInfo(pipelineConfig, target, pipelineLayout, depthPrepass);
+  coneCulling =
+      (pipelineConfig.rasterizationInfo.cullMode & VK_CULL_MODE_BACK_BIT) != 0;
+
+  lvePipeline = createMainPipeline(target);
+  if (depthPrepass) {
+    depthPipeline = createDepthPipeline(depthTarget);
+  }
+  shadowPipeline = createShadowPipeline(shadowTarget);
+
+  if (pipelineLibrary != nullptr) {
+    addViewModeVariants(target);
+  }
+
+  // One watch for every pipeline sharing the vertex shader, so they swap
+  // in together: the pre-pass and the EQUAL-tested main pass must never
+  // run different vertex code. The view-mode variants are rebuilt after.
+  if (hotReload != nullptr) {
+    std::vector<std::unique_ptr<LvePipeline> *> pipelines{&lvePipeline,
+                                                          &shadowPipeline};
+    if (depthPrepass) {
+      pipelines.push_back(&depthPipeline);
+    }
+    hotReloadWatches.push_back(hotReload->watch(
+        std::move(pipelines), shaderSources(bindlessTable != nullptr),
+        [this, target, depthTarget, shadowTarget] {
+          LveShaderHotReload::Pipelines rebuilt;
+          rebuilt.push_back(createMainPipeline(target));
+          rebuilt.push_back(createShadowPipeline(shadowTarget));
+          if (depthPrepass) {
+            rebuilt.push_back(createDepthPipeline(depthTarget));
+          }
+          return rebuilt;
+        },
+        [this] {
+          if (pipelineLibrary != nullptr) {
+            for (size_t mode = 1; mode < viewModeKeys.size(); mode++) {
+              pipelineLibrary->rebuild(viewModeKeys[mode]);
+            }
+          }
+        }));
+  }
+}
+
+void SimpleRenderSystem::addViewModeVariants(
+    const PipelineRenderTarget &target) {
+  // Shaded is lvePipeline itself
+  for (uint32_t mode = 1; mode < static_cast<uint32_t>(ViewMode::Count);
+       mode++) {
+    viewModeKeys[mode] = pipelineLibrary->add(
+        vertexShaderSource() + ".spv", std::string(FRAGMENT_SHADER) + ".spv",
+        [target, layout = pipelineLayout, depthPrepass = depthPrepass,
+         mode](PipelineConfigInfo &configInfo) {
+          mainPipelineConfigInfo(configInfo, target, layout, depthPrepass);
+          configInfo.setSpecializationConstant(VIEW_MODE_CONSTANT_ID, mode);
+        });
+  }
+}
+
+LvePipeline *SimpleRenderSystem::viewModePipeline() {
+  if (viewMode == ViewMode::Shaded || pipelineLibrary == nullptr) {
+    return lvePipeline.get();
+  }
+  LvePipeline *variant =
+      pipelineLibrary->get(viewModeKeys[static_cast<size_t>(viewMode)]);
+  return variant != nullptr ? variant : lvePipeline.get();
+}
+
+std::string SimpleRenderSystem::vertexShaderSource() const {
+  return bindlessTable != nullptr ? BINDLESS_VERTEX_SHADER : VERTEX_SHADER;
+}
+
+std::vector<std::string> SimpleRenderSystem::shaderSources(bool bindless) {
+  return {bindless ? BINDLESS_VERTEX_SHADER : VERTEX_SHADER, FRAGMENT_SHADER};
+}
+
+void SimpleRenderSystem::mainPipelineConfigInfo(
+    PipelineConfigInfo &configInfo, const PipelineRenderTarget &target,
+    VkPipelineLayout pipelineLayout, bool depthPrepass) {
+  if (depthPrepass) {
+    LvePipeline::depthEqualPipelineConfigInfo(configInfo);
+  } else {
+    LvePipeline::defaultPipelineConfigInfo(configInfo);
+  }
+  configInfo.renderTarget = target;
+  configInfo.pipelineLayout = pipelineLayout;
+  configInfo.setSpecializationConstant(CLUSTER_GRID_CONSTANT_ID,
+                                       LveClusteredLights::GRID_X);
+  configInfo.setSpecializationConstant(CLUSTER_GRID_CONSTANT_ID + 1,
+                                       LveClusteredLights::GRID_Y);
+  configInfo.setSpecializationConstant(CLUSTER_GRID_CONSTANT_ID + 2,
+                                       LveClusteredLights::GRID_Z);
+}
+
+std::unique_ptr<LvePipeline>
+SimpleRenderSystem::createMainPipeline(
+    const PipelineRenderTarget &target) const {
+  PipelineConfigInfo pipelineConfig{};
+  mainPipelineConfigInfo(pipelineConfig, target, pipelineLayout, depthPrepass);
+  return std::make_unique<LvePipeline>(
+      lveDevice, vertexShaderSource() + ".spv",
+      std::string(FRAGMENT_SHADER) + ".spv", pipelineConfig);
+}
+
+std::unique_ptr<LvePipeline>
+SimpleRenderSystem::createDepthPipeline(
+    const PipelineRenderTarget &target) const {
+  PipelineConfigInfo depthConfig{};
+  LvePipeline::depthPrepassPipelineConfigInfo(depthConfig);
+  depthConfig.renderTarget = target;
+  depthConfig.pipelineLayout = pipelineLayout;
+  // same vertex shader as the main pass so depth matches exactly
+  return std::make_unique<LvePipeline>(
+      lveDevice, vertexShaderSource() + ".spv", "", depthConfig);
 }
 
-void SimpleRenderSystem::renderGameObjects(
-    VkCommandBuffer commandBuffer, std::vector<LveGameObject> &gameObjects,
-    const LveCamera &camera) {
-  lvePipeline->bind(commandBuffer);
+std::unique_ptr<LvePipeline>
+SimpleRenderSystem::createShadowPipeline(
+    const PipelineRenderTarget &target) const {
+  PipelineConfigInfo shadowConfig{};
+  LvePipeline::shadowPipelineConfigInfo(shadowConfig);
+  shadowConfig.renderTarget = target;
+  shadowConfig.pipelineLayout = pipelineLayout;
+  return std::make_unique<LvePipeline>(
+      lveDevice, vertexShaderSource() + ".spv", "", shadowConfig);
+}
 
+void SimpleRenderSystem::buildDrawList(FrameInfo &frameInfo) {
+  const LveCamera &camera = frameInfo.camera;
   auto projectionView = camera.getProjectionMatrix() * camera.getViewMatrix();
+  meshletStats = {};
+  drawRanges.clear();
+
+  prepareDescriptorSets(frameInfo);
+
+  renderQueue.begin(frameInfo.frameArena.frameAllocator(),
+                    static_cast<uint32_t>(frameInfo.visibleObjects.size()));
+  renderQueue.resetStats();
+
+  GlobalUbo globalUbo{};
+  globalUbo.projectionView = projectionView;
+  globalUbo.cameraPosition = glm::vec4(camera.getPosition(), 1.f);
+  globalUbo.lightDirection =
+      glm::vec4(shadowCascades.getLightDirection(), 0.f);
+  globalUbo.shadows = shadowCascades.getShaderParams();
+  globalUbo.clusters = clusteredLights.getShaderParams();
+  if (!uniformRing.write(globalUbo, globalOffset)) {
+    return;
+  }
+
+  // no materials yet; every draw shares material 0
+  constexpr uint32_t materialId = 0;
+  LvePipeline *pipeline = viewModePipeline();
+
+  for (auto id : frameInfo.visibleObjects) {
+    auto &obj = frameInfo.gameObjects.at(id);
+    if (obj.model == nullptr) {
+      continue;
+    }
+    glm::mat4 modelMatrix = obj.transform.mat4();
+
+    glm::mat4 transform = projectionView * modelMatrix;
+
+    LveRenderQueue::Draw draw{};
+    draw.pipeline = pipeline;
+    draw.model = obj.model.get();
+    draw.objectId = id;
+    draw.firstRange = static_cast<uint32_t>(drawRanges.size());
+
+    const auto &meshlets = obj.model->getMeshlets();
+    if (!meshlets.empty()) {
+      // cull clusters in model space so their bounds never need transforming
+      glm::vec3 cameraPosition = glm::vec3(
+          glm::inverse(modelMatrix) * glm::vec4(camera.getPosition(), 1.f));
+      cullMeshlets(meshlets, LveFrustum::fromMatrix(transform),
+                   cameraPosition, coneCulling, drawRanges, meshletStats);
+      draw.rangeCount =
+          static_cast<uint32_t>(drawRanges.size()) - draw.firstRange;
+      if (draw.rangeCount == 0) {
+        continue;
+      }
+    }
+
+    ObjectUbo objectUbo{};
+    objectUbo.modelMatrix = modelMatrix;
+    objectUbo.color = glm::vec4(obj.color, 1.f);
+    if (!uniformRing.write(objectUbo, draw.uniformOffset)) {
+      drawRanges.resize(draw.firstRange);
+      continue; // ring is full; it grows when this frame index comes round
+    }
+
+    glm::vec4 center =
+        transform * glm::vec4(obj.model->getBoundingBox().center(), 1.f);
+    float depth = center.w > 0.f ? center.z / center.w : 0.f;
+    renderQueue.push(LveRenderQueue::makeKey(draw.pipeline->getId(),
+                                             materialId,
+                                             draw.model->getId(), depth),
+                     draw);
+  }
+
+  renderQueue.sort();
+}
+
+void SimpleRenderSystem::drawObject(VkCommandBuffer commandBuffer,
+                                    const LveRenderQueue::Draw &draw) {
+  if (draw.rangeCount == 0) {
+    draw.model->draw(commandBuffer);
+    return;
+  }
+  for (uint32_t i = 0; i < draw.rangeCount; i++) {
+    const auto &range = drawRanges[draw.firstRange + i];
+    draw.model->drawRange(commandBuffer, range.firstIndex, range.indexCount);
+  }
+}
+
+void SimpleRenderSystem::recordDraws(FrameInfo &frameInfo,
+                                     LvePipeline *pipelineOverride) {
+  if (renderQueue.size() == 0) {
+    return;
+  }
+
+  // camera data is bound once per pass; only the object offset changes
+  vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                          &globalSet, 1, &globalOffset);
+
+  if (bindlessTable != nullptr) {
+    // the table stays bound; draws only change push constants
+    bindlessTable->bind(frameInfo.commandBuffer, pipelineLayout, 1);
+    BindlessPush push{};
+    push.objectBuffer = ringIndices[frameInfo.frameIndex];
+    renderQueue.submit(
+        frameInfo.commandBuffer,
+        [&](VkCommandBuffer commandBuffer, const LveRenderQueue::Draw &draw) {
+          push.objectOffset =
+              static_cast<uint32_t>(draw.uniformOffset / sizeof(glm::vec4));
+          vkCmdPushConstants(commandBuffer, pipelineLayout,
+                             VK_SHADER_STAGE_VERTEX_BIT, 0,
+                             sizeof(BindlessPush), &push);
+          drawObject(commandBuffer, draw);
+        },
+        pipelineOverride);
+    return;
+  }
 
-  for (auto &obj : gameObjects) {
+  renderQueue.submit(
+      frameInfo.commandBuffer,
+      [&](VkCommandBuffer commandBuffer, const LveRenderQueue::Draw &draw) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipelineLayout, 1, 1, &objectSet, 1,
+                                &draw.uniformOffset);
+        drawObject(commandBuffer, draw);
+      },
+      pipelineOverride);
+}
+
+void SimpleRenderSystem::renderDepthPrepass(FrameInfo &frameInfo) {
+  assert(depthPrepass &&
+         "renderDepthPrepass requires a system created with depthPrepass");
+  buildDrawList(frameInfo);
+  drawListReady = true;
+  recordDraws(frameInfo, depthPipeline.get());
+}
+
+void SimpleRenderSystem::renderGameObjects(FrameInfo &frameInfo) {
+  if (!drawListReady) {
+    buildDrawList(frameInfo);
+  }
+  drawListReady = false;
+  recordDraws(frameInfo, nullptr);
+  // the main pass is the frame's last
+  descriptorSetsReady = false;
+}
 
-    SimplePushConstantData push{};
-    push.color = obj.color;
-    push.transform = projectionView * obj.transform.mat4();
+bool SimpleRenderSystem::renderShadowCasters(
+    FrameInfo &frameInfo, const glm::mat4 &lightProjectionView,
+    const std::vector<LveGameObject::id_t> &casters) {
+  if (casters.empty()) {
+    return true;
+  }
+  prepareDescriptorSets(frameInfo);
 
-    vkCmdPushConstants(commandBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT |
-                           VK_SHADER_STAGE_FRAGMENT_BIT,
-                       0, sizeof(SimplePushConstantData), &push);
+  // the vertex shader only reads projectionView
+  GlobalUbo globalUbo{};
+  globalUbo.projectionView = lightProjectionView;
+  uint32_t lightOffset = 0;
+  if (!uniformRing.write(globalUbo, lightOffset)) {
+    return false;
+  }
+
+  // one pipeline and depth only, so the casters are drawn in the order
+  // they were culled in rather than through the render queue
+  VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+  shadowPipeline->bind(commandBuffer);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 0, 1, &globalSet, 1, &lightOffset);
+  BindlessPush push{};
+  if (bindlessTable != nullptr) {
+    bindlessTable->bind(commandBuffer, pipelineLayout, 1);
+    push.objectBuffer = ringIndices[frameInfo.frameIndex];
+  }
 
-    obj.model->bind(commandBuffer);
+  LveModel *boundModel = nullptr;
+  for (auto id : casters) {
+    auto &obj = frameInfo.gameObjects.at(id);
+    if (obj.model == nullptr) {
+      continue;
+    }
+    ObjectUbo objectUbo{};
+    objectUbo.modelMatrix = obj.transform.mat4();
+    objectUbo.color = glm::vec4(obj.color, 1.f);
+    uint32_t objectOffset = 0;
+    if (!uniformRing.write(objectUbo, objectOffset)) {
+      return false;
+    }
+    if (bindlessTable != nullptr) {
+      push.objectOffset =
+          static_cast<uint32_t>(objectOffset / sizeof(glm::vec4));
+      vkCmdPushConstants(commandBuffer, pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BindlessPush),
+                         &push);
+    } else {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              pipelineLayout, 1, 1, &objectSet, 1,
+                              &objectOffset);
+    }
+    if (obj.model.get() != boundModel) {
+      obj.model->bind(commandBuffer);
+      boundModel = obj.model.get();
+    }
     obj.model->draw(commandBuffer);
   }
+  return true;
 }
 
 } // namespace lve